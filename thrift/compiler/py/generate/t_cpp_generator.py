@@ -91,6 +91,14 @@ class CppGenerator(t_generator.Generator):
         'future': 'enable wangle futures',
         'process_in_event_base': 'Process request in event base thread',
         'frozen2': 'enable frozen structures',
+        'size_hints': 'Size output buffers from previous writes instead of '
+                      'a serializedSize pass',
+        'table_serializer': 'Serialize structs from a field table instead '
+                            'of generated read/write code',
+        'arena': 'Allocate strings and containers from the current '
+                 'apache::thrift::Arena',
+        'projection': 'Generate readProjected/writeProjected, which only '
+                      'read or write the fields in a mask',
     }
     _out_dir_base = 'gen-cpp2'
     _compatibility_dir_base = 'gen-cpp'
@@ -110,6 +118,7 @@ class CppGenerator(t_generator.Generator):
     _serialized_fields_name = '__serialized'
     _serialized_fields_type = 'apache::thrift::CloneableIOBuf'
     _serialized_fields_protocol_name = '__serialized_protocol'
+    _view_anchor_name = '__views'
 
     def __init__(self, *args, **kwargs):
         # super constructor
@@ -119,6 +128,7 @@ class CppGenerator(t_generator.Generator):
             self.program.include_prefix = prefix
         terse_writes = self._flags.get('terse_writes')
         self.safe_terse_writes = (terse_writes == 'safe')
+        self._table_structs = {}
 
     def _base_type_name(self, tbase):
         if tbase in self._base_to_cpp_typename:
@@ -151,6 +161,8 @@ class CppGenerator(t_generator.Generator):
             # cast it
             btype = ttype.as_base_type
             bname = self._base_type_name(btype.base)
+            if self.flag_arena and ttype.is_string:
+                bname = '::apache::thrift::ArenaString'
             if arg and ttype.is_string:
                 return self._reference_name(bname, unique)
             return self._cpp_type_name(ttype, bname)
@@ -191,6 +203,9 @@ class CppGenerator(t_generator.Generator):
                 inner_types = [self._type_name(tlist.elem_type, in_typedef,
                                                scope=scope)]
                 cname = cname + "<{0}>"
+            if self.flag_arena and not template and \
+                    not self._cpp_type_name(tcontainer):
+                cname = self._arena_container_name(ttype, cname)
             if inner_types:
                 cname = cname.format(*inner_types)
             if arg:
@@ -222,6 +237,21 @@ class CppGenerator(t_generator.Generator):
         else:
             return tname
 
+    def _arena_container_name(self, ttype, cname):
+        'Adds ArenaAllocator to the std container template cname'
+        alloc = '::apache::thrift::ArenaAllocator< {0}>'
+        if ttype.is_map:
+            alloc = alloc.format('std::pair<const {0}, {1}> ')
+            if ttype.as_map.is_unordered:
+                args = '{0}, {1}, std::hash<{0}>, std::equal_to<{0}>, '
+            else:
+                args = '{0}, {1}, std::less<{0}>, '
+        elif ttype.is_set:
+            args = '{0}, std::less<{0}>, '
+        else:
+            args = '{0}, '
+        return cname[:cname.index('<') + 1] + args + alloc + ' >'
+
     def _is_orderable_type(self, ttype):
         if ttype.is_base_type:
             return True
@@ -247,6 +277,35 @@ class CppGenerator(t_generator.Generator):
     def _is_reference(self, f):
         return self._has_cpp_annotation(f, "ref")
 
+    def _is_lazy(self, f):
+        'Whether f is kept serialized until it is used (cpp.lazy)'
+        if not self._has_cpp_annotation(f, "lazy") or \
+                self._is_reference(f) or self._type_access_suffix(f.type) or \
+                self.flag_compatibility or self.flag_frozen2:
+            return False
+        t = self._get_true_type(f.type)
+        return t.is_struct or t.is_xception or t.is_container or t.is_string
+
+    def _lazy_ops_name(self, f):
+        return '__lazy_{0}_ops'.format(f.name)
+
+    def _is_view(self, f):
+        'Whether f is a string whose cpp.type points into the read buffer'
+        if self._is_reference(f):
+            return False
+        ttype = f.type
+        while True:
+            cpp_type = self._cpp_type_name(ttype)
+            if cpp_type is not None or not ttype.is_typedef:
+                break
+            ttype = ttype.as_typedef.type
+        return self._get_true_type(f.type).is_string and \
+            cpp_type is not None and \
+            cpp_type.lstrip(':') in ('folly::StringPiece', 'folly::ByteRange')
+
+    def _has_views(self, obj):
+        return any(map(self._is_view, obj.members))
+
     def _has_isset(self, f):
         return not self._is_reference(f) and f.req != e_req.required
 
@@ -1178,6 +1237,7 @@ class CppGenerator(t_generator.Generator):
                            'iprot(new apache::thrift::' +
                            '{0}Reader());').format(protname))
                         out('iprot->setInput(buf.get());')
+                        out('setRequestSkipIndex(iprot.get(), context);')
                         with out('try'):
                             out('iprot->readMessageBegin(fname, mtype,' + \
                                   ' protoSeqId);')
@@ -1729,6 +1789,8 @@ class CppGenerator(t_generator.Generator):
                     for key, val, prot in self.protocols:
                         with out().case("apache::thrift::protocol::" + prot):
                             out("apache::thrift::{0}Writer writer;".format(val))
+                            out("apache::thrift::setSkipIndex(&writer, "
+                                "getChannel()->getSkipIndex());")
                             out("{name}T({args});".
                               format(name=function.name, args=args_list))
 
@@ -1768,6 +1830,9 @@ class CppGenerator(t_generator.Generator):
                 out("size_t bufSize = "
                   "{0}_{1}_pargs_serializedSizeZC(prot, &args);".
                   format(service.name, function.name))
+            elif self.flag_size_hints:
+                out("size_t bufSize = "
+                    "apache::thrift::serializedSizeHint(prot, &args);")
             else:
                 out("size_t bufSize = args.serializedSizeZC(prot);")
 
@@ -1786,6 +1851,8 @@ class CppGenerator(t_generator.Generator):
                 if self.flag_compatibility:
                     out("{0}_{1}_pargs_write(prot, &args);".format(
                             service.name, function.name))
+                elif self.flag_size_hints:
+                    out("apache::thrift::writeWithSizeHint(prot, &args);")
                 else:
                     out("args.write(prot);")
                 out("prot->writeMessageEnd();")
@@ -2198,7 +2265,7 @@ class CppGenerator(t_generator.Generator):
 
     def _generate_struct_complete(self, s, obj, is_exception,
                                   pointers, read, write, swap,
-                                  result, has_isset=True):
+                                  result, has_isset=True, table=False):
         for a,b,c in self.protocols:
             if not self.flag_compatibility:
                 s.impl(("template uint32_t {1}::read<apache::thrift::{0}Reader>"
@@ -2252,6 +2319,9 @@ class CppGenerator(t_generator.Generator):
                             obj.name))
 
         if self.flag_compatibility:
+            if self._has_views(obj):
+                raise CompilerError('folly::StringPiece and folly::ByteRange '
+                                    'fields need cpp2 structs: ' + obj.name)
             base = self._namespace_prefix(
                     self._program.get_namespace('cpp')) + obj.name
             s('typedef{0} {1};'.format(base, obj.name))
@@ -2266,6 +2336,14 @@ class CppGenerator(t_generator.Generator):
                 self._generate_struct_writer(s, obj, pointers, result)
             return
 
+        if obj.is_union and any(map(self._is_lazy, obj.members)):
+            raise CompilerError('cpp.lazy is not supported in unions: ' +
+                                obj.name)
+        if (obj.is_union or pointers) and self._has_views(obj):
+            raise CompilerError('folly::StringPiece and folly::ByteRange '
+                                'fields are only supported in structs: ' +
+                                obj.name)
+
         extends = ' : private boost::totally_ordered<{0}>'.format(obj.name)
         if is_exception:
             extends += ', public apache::thrift::TException'
@@ -2337,6 +2415,9 @@ class CppGenerator(t_generator.Generator):
                             name=member.name)
                     if should_generate_isset:
                         i['__isset'] = 'other.__isset'
+                    if self._has_views(obj):
+                        i[self._view_anchor_name] = 'std::move(other.{0})' \
+                            .format(self._view_anchor_name)
                     c = struct.defn('{name}({name}&& other)',
                                     name=obj.name,
                                     in_header=True,
@@ -2367,6 +2448,9 @@ class CppGenerator(t_generator.Generator):
                                 if self._has_isset(member):
                                     out('__isset.{0} = {1}.__isset.{0};'.format(
                                         member.name, src))
+                            if self._has_views(obj):
+                                out('{0} = {1}.{0};'.format(
+                                    self._view_anchor_name, src))
                     else:
                         c = struct.defn(
                             '{name}(const {name}&)',
@@ -2407,7 +2491,9 @@ class CppGenerator(t_generator.Generator):
                             t = self._get_true_type(member.type)
                             name = member.name + \
                                 self._type_access_suffix(member.type)
-                            if t.is_base_type or t.is_enum:
+                            if self._is_lazy(member):
+                                out('{0}.clear();'.format(name))
+                            elif t.is_base_type or t.is_enum:
                                 dval = self._member_default_value(
                                         member, explicit=True)
                                 out('{0} = {1};'.format(name, dval))
@@ -2436,6 +2522,8 @@ class CppGenerator(t_generator.Generator):
                         if struct_options.has_serialized_fields:
                             out('{0}.reset();'.format(
                                 self._serialized_fields_name))
+                        if self._has_views(obj):
+                            out('{0}.reset();'.format(self._view_anchor_name))
         # END if not pointers
 
         if 'final' not in obj.annotations:
@@ -2452,6 +2540,9 @@ class CppGenerator(t_generator.Generator):
 
         # Declare all fields.
         for member in members:
+            if not pointers and self._is_lazy(member):
+                self._generate_lazy_field(s1, member)
+                continue
             s1(self._declare_field(
                 member,
                 pointers and not member.type.is_xception,
@@ -2486,6 +2577,12 @@ class CppGenerator(t_generator.Generator):
                        self._serialized_fields_protocol_name))
             struct('{0} {1};'.format(self._serialized_fields_type,
                                      self._serialized_fields_name))
+        if self._has_views(obj):
+            struct()
+            struct('// The buffers the folly::StringPiece and '
+                   'folly::ByteRange fields point to')
+            struct('apache::thrift::CloneableIOBuf {0};'.format(
+                       self._view_anchor_name))
         if not pointers and not struct_options.has_serialized_fields:
             # Generate an equality testing operator.
             with struct.defn('bool {{name}}(const {0}& {1}) const'
@@ -2510,9 +2607,12 @@ class CppGenerator(t_generator.Generator):
 
                         ctype = self._get_true_type(m.type)
                         if ctype.is_base_type and ctype.as_base_type.is_binary:
+                            value = m.name
+                            if self._is_lazy(m):
+                                value += '.get()'
                             check = "apache::thrift::StringTraits<{0}>::" \
                                 "isEqual({1}, rhs.{1})".format(
-                                self._type_name(ctype), m.name)
+                                self._type_name(ctype), value)
                         if m.req != e_req.optional or not self._has_isset(m):
                             with out('if (!({0}))'.format(
                                     check)):
@@ -2591,13 +2691,21 @@ class CppGenerator(t_generator.Generator):
 
         if read or write:
             struct()
-        if read:
-            self._generate_struct_reader(struct, obj, pointers)
-        if write:
-            for zc in False, True:
-                self._generate_struct_compute_length(
-                        struct, obj, pointers, result, zero_copy=zc)
-            self._generate_struct_writer(struct, obj, pointers, result)
+        if table:
+            self._generate_struct_table(s, struct, obj)
+        else:
+            if read:
+                self._generate_struct_reader(struct, obj, pointers)
+            if write:
+                for zc in False, True:
+                    self._generate_struct_compute_length(
+                            struct, obj, pointers, result, zero_copy=zc)
+                self._generate_struct_writer(struct, obj, pointers, result)
+        if self._has_projection(obj, pointers, result):
+            if read:
+                self._generate_struct_reader(struct, obj, projected=True)
+            if write:
+                self._generate_struct_writer(struct, obj, projected=True)
         if is_exception:
             if 'message' in obj.annotations:
                 what = '{0}.c_str()'.format(obj.annotations['message'])
@@ -2650,15 +2758,195 @@ class CppGenerator(t_generator.Generator):
                                 self._serialized_fields_protocol_name))
                         out('swap(a.{0}, b.{0});'.format(
                                 self._serialized_fields_name))
+                    if self._has_views(obj):
+                        out('swap(a.{0}, b.{0});'.format(
+                                self._view_anchor_name))
+
+    def _generate_lazy_field(self, struct, field):
+        '''Declares a cpp.lazy field, and the class its LazyField uses to read
+        and write the value once it is needed'''
+        type_name = self._type_name(field.type)
+        ops = self._lazy_ops_name(field)
+        struct()
+        with struct.cls('struct ' + ops) as s:
+            with s.defn('template <class Protocol_>\n'
+                        'uint32_t {{name}}(Protocol_* iprot, {0}& value)'
+                        .format(type_name), name='read',
+                        modifiers='static', in_header=True):
+                out('uint32_t xfer = 0;')
+                self._generate_deserialize_type(out(), field.type, 'value')
+                out('return xfer;')
+            for method, struct_method in (('write', 'write'),
+                                          ('serializedSize', 'serializedSize'),
+                                          ('serializedSize',
+                                           'serializedSizeZC')):
+                with s.defn('template <class Protocol_>\n'
+                            'uint32_t {{name}}(Protocol_* prot_, '
+                            'const {0}& value)'.format(type_name),
+                            name=struct_method, modifiers='static',
+                            in_header=True):
+                    out('uint32_t xfer = 0;')
+                    self._generate_serialize_type(
+                        out(), field.type, 'value', method,
+                        struct_method=struct_method,
+                        binary_method=struct_method)
+                    out('return xfer;')
+        struct('::apache::thrift::LazyField<{0}, {1}> {2};'.format(
+            type_name, ops, field.name))
+
+    # ======================================================================
+    # TABLE SERIALIZATION CODE
+    # ======================================================================
+
+    def _table_type_supported(self, ttype):
+        'Whether TypeInfoOf<> describes the C++ type generated for ttype'
+        while True:
+            for key in ('type', 'template', 'indirection'):
+                if self._has_cpp_annotation(ttype, key):
+                    return False
+            if not ttype.is_typedef:
+                break
+            ttype = ttype.as_typedef.type
+        # TypeInfoOf<> only knows the standard allocator
+        if self.flag_arena and (ttype.is_string or ttype.is_container):
+            return False
+        if ttype.is_base_type:
+            return not ttype.is_void
+        elif ttype.is_enum:
+            return True
+        elif ttype.is_struct or ttype.is_xception:
+            return ttype.program == self._program and \
+                self._table_supported(ttype)
+        elif ttype.is_map:
+            return not ttype.as_map.is_unordered and \
+                self._table_type_supported(ttype.as_map.key_type) and \
+                self._table_type_supported(ttype.as_map.value_type)
+        elif ttype.is_set:
+            return self._table_type_supported(ttype.as_set.elem_type)
+        elif ttype.is_list:
+            return self._table_type_supported(ttype.as_list.elem_type)
+        return False
+
+    def _table_supported(self, obj):
+        'Whether TableReader and TableWriter can serialize obj'
+        if obj.name not in self._table_structs:
+            self._find_table_structs(
+                list(self._program.objects) + [obj])
+        return self._table_structs[obj.name]
+
+    def _find_table_structs(self, objs):
+        '''Decides _table_supported() for objs together.  Structs that refer
+        to each other are all assumed supported, then dropped until none of
+        them refers to a dropped one, so no table keeps a TypeInfoOf<> of a
+        struct that ends up without one'''
+        objs = [obj for obj in objs if obj.name not in self._table_structs]
+        for obj in objs:
+            self._table_structs[obj.name] = True
+        changed = True
+        while changed:
+            changed = False
+            for obj in objs:
+                if self._table_structs[obj.name] and \
+                        not self._table_fields_supported(obj):
+                    self._table_structs[obj.name] = False
+                    changed = True
+
+    def _table_fields_supported(self, obj):
+        '''Whether the table can describe obj, given what _table_structs
+        says about the structs it refers to'''
+        supported = not obj.is_union and not self.flag_terse_writes and \
+            not self.flag_compatibility and \
+            not self._get_serialized_fields_options(obj).has_serialized_fields
+        fields = sorted(obj.members, key=lambda field: field.key)
+        for i, field in enumerate(fields):
+            if not supported:
+                break
+            # TableReader tracks required fields in a 64 bit mask
+            supported = self._should_generate_field(field) and \
+                not self._is_reference(field) and not self._is_lazy(field) and \
+                not (field.req == e_req.required and i >= 64) and \
+                self._table_type_supported(field.type)
+        return supported
+
+    def _generate_struct_table(self, scope, struct, obj):
+        '''Generates the field table of obj, and read() and write() methods
+        that interpret it'''
+        fields = sorted(obj.members, key=lambda field: field.key)
+        if fields:
+            struct('static const ::apache::thrift::FieldInfo __fields[];')
+        struct('static const ::apache::thrift::StructInfo __table;')
+        struct()
+
+        with struct.defn('template <class Protocol_>\n'
+                         'uint32_t {name}(Protocol_* iprot)', name='read',
+                         output=self._out_tcc):
+            out('return ::apache::thrift::TableReader<Protocol_>::'
+                'read(iprot, __table, this);')
+        for method in ('serializedSize', 'serializedSizeZC'):
+            with struct.defn('template <class Protocol_>\n'
+                             'uint32_t {name}(Protocol_* prot_) const',
+                             name=method, output=self._out_tcc):
+                out('return ::apache::thrift::TableWriter<Protocol_>::'
+                    'serializedSize(prot_, __table, this);')
+        with struct.defn('template <class Protocol_>\n'
+                         'uint32_t {name}(Protocol_* prot_) const',
+                         name='write', output=self._out_tcc):
+            out('return ::apache::thrift::TableWriter<Protocol_>::'
+                'write(prot_, __table, this);')
+
+        # Offsets are constant, and the tables constant initialized, even
+        # for structs that are not standard layout
+        lines = ['#pragma GCC diagnostic push',
+                 '#pragma GCC diagnostic ignored "-Winvalid-offsetof"']
+        reqs = {e_req.required: 'REQUIRED', e_req.optional: 'OPTIONAL'}
+        if fields:
+            lines.append('const ::apache::thrift::FieldInfo {0}::__fields[] '
+                         '= {{'.format(obj.name))
+            for field in fields:
+                if field.req == e_req.required:
+                    isset = '-1'
+                else:
+                    isset = 'offsetof({0}, __isset.{1})'.format(
+                        obj.name, field.name)
+                lines.append(
+                    '  {{{0}, ::apache::thrift::FieldInfo::{1}, "{2}", '
+                    'offsetof({3}, {2}), {4}, '
+                    '&::apache::thrift::TypeInfoOf<{5}>::info}},'.format(
+                        field.key, reqs.get(field.req, 'DEFAULT'),
+                        field.name, obj.name, isset,
+                        self._type_name(field.type)))
+            lines.append('};')
+            table = '{{"{0}", {0}::__fields, {1}}}'.format(obj.name,
+                                                           len(fields))
+        else:
+            table = '{{"{0}", nullptr, 0}}'.format(obj.name)
+        lines.append('const ::apache::thrift::StructInfo {0}::__table = '
+                     '{1};'.format(obj.name, table))
+        lines.append('#pragma GCC diagnostic pop')
+        scope.impl('\n'.join(lines) + '\n')
 
     # ======================================================================
     # DESERIALIZATION CODE
     # ======================================================================
 
+    def _has_projection(self, obj, pointers, result):
+        'Whether obj gets readProjected and writeProjected'
+        return (self.flag_projection and not pointers and not result and
+                not obj.is_union and
+                not self._get_serialized_fields_options(obj)
+                    .has_serialized_fields)
+
     def _generate_struct_reader(self, scope, obj,
-                                pointers=False, has_isset=True):
+                                pointers=False, has_isset=True,
+                                projected=False):
         this = 'this'
-        if self.flag_compatibility:
+        if projected:
+            # Like read(), but skips the fields that are not in mask
+            d = scope.defn('template <class Protocol_, class Mask_>\n'
+                           'uint32_t {name}(Protocol_* iprot, '
+                           'const Mask_& mask)', name='readProjected',
+                           output=self._out_tcc)
+        elif self.flag_compatibility:
             this = 'obj'
             name = '{0}_read'.format(obj.name)
             d = scope.defn('template <class Protocol_>\n' +
@@ -2685,6 +2973,14 @@ class CppGenerator(t_generator.Generator):
         s()
         s('xfer += iprot->readStructBegin(fname);')
         s()
+        if self._has_views(obj):
+            # A struct read into again must not keep the buffers of its
+            # earlier reads, nor views into them
+            s('{0}->{1}.reset();'.format(this, self._view_anchor_name))
+            for field in ifilter(self._is_view, fields):
+                s('{0}->{1} = {2}();'.format(
+                    this, field.name, self._type_name(field.type)))
+            s()
         s('using apache::thrift::TProtocolException;')
         s()
         # Special handling for serialized fields
@@ -2734,8 +3030,12 @@ class CppGenerator(t_generator.Generator):
                 s3('xfer += iprot->skip(ftype);')
                 s3.release()  # "break;"
                 continue
-            s4 = s3('if (ftype == {0})'.format(self._type_to_enum(
-                    field.type))).scope
+            check = 'ftype == {0}'.format(self._type_to_enum(field.type))
+            if projected:
+                # Tested with the constant id, so that a StaticFieldMask
+                # folds it away; fields not in mask are skipped below
+                check = 'mask.contains({0}) && {1}'.format(field.key, check)
+            s4 = s3('if ({0})'.format(check)).scope
             with s4:
                 field_prefix = this + '->'
                 field_suffix = ''
@@ -2752,6 +3052,13 @@ class CppGenerator(t_generator.Generator):
                                 self._type_name(field.type)) +
                                                 field_prefix,
                                                 field_suffix + '))')
+                elif self._is_lazy(field):
+                    s4('xfer += {0}{1}.read(iprot, ftype);'.format(
+                        field_prefix, field.name))
+                elif self._is_view(field):
+                    s4('xfer += ::apache::thrift::readStringView(iprot, '
+                       '{0}{1}, {0}{2});'.format(
+                        field_prefix, field.name, self._view_anchor_name))
                 else:
                     self._generate_deserialize_field(s4, field, field_prefix,
                                                      field_suffix)
@@ -2804,7 +3111,10 @@ class CppGenerator(t_generator.Generator):
         for field in filter(self._should_generate_field, fields):
             if not field.req == e_req.required:
                 continue
-            with s('if (!isset_{0.name})'.format(field)):
+            check = '!isset_{0.name}'.format(field)
+            if projected:
+                check += ' && mask.contains({0})'.format(field.key)
+            with s('if ({0})'.format(check)):
                 out(('throw TProtocolException(TProtocolException::'
                 'MISSING_REQUIRED_FIELD, "Required field \'{0}\' was not found'
                 'in serialized data! Struct: {1}");').format(
@@ -2894,6 +3204,24 @@ class CppGenerator(t_generator.Generator):
                   'iprot, &{1});'.format(
                       self._type_name(otype), prefix))
 
+    _numeric_list_ops = {
+        'int32_t': 'I32List',
+        'int64_t': 'I64List',
+        'double': 'DoubleList',
+    }
+
+    def _numeric_list_op(self, tlist):
+        '''Name of the NumericListOps method suffix for a list that can be
+        read and written as a whole (a std::vector of i32, i64 or double),
+        or None'''
+        if self._cpp_type_name(tlist) or \
+                self._has_cpp_annotation(tlist, 'template'):
+            return None
+        elem = self._get_true_type(tlist.as_list.elem_type)
+        if not elem.is_base_type:
+            return None
+        return self._numeric_list_ops.get(self._type_name(elem))
+
     def _generate_deserialize_container(self, scope, cont, prefix):
         s = scope
         size = self.tmp('_size')
@@ -2921,6 +3249,13 @@ class CppGenerator(t_generator.Generator):
             s(txt)
             if not use_push:
                 s('{0}.resize({1});'.format(prefix, size))
+            list_op = self._numeric_list_op(cont)
+            if list_op:
+                s('xfer += ::apache::thrift::NumericListOps<Protocol_>::'
+                  'read{0}(iprot, {1}.data(), {2});'.format(
+                      list_op, prefix, size))
+                s('xfer += iprot->readListEnd();')
+                return
         # For loop iterates over elements
         i = self.tmp('_i')
         s('uint32_t {0};'.format(i))
@@ -3053,6 +3388,9 @@ class CppGenerator(t_generator.Generator):
                     method="serializedSize",
                     struct_method=method,
                     binary_method=method)
+            elif self._is_lazy(field):
+                s1('xfer += {0}{1}.{2}(prot_);'.format(
+                    field_prefix, field.name, method))
             else:
                 self._generate_serialize_field(s1, field, field_prefix,
                                                field_suffix,
@@ -3080,6 +3418,10 @@ class CppGenerator(t_generator.Generator):
         if t.is_void or t.is_struct or t.is_xception:
             return s
 
+        # Checking a lazy field for emptiness would deserialize it
+        if self._is_lazy(field):
+            return s
+
         # Terse write is unsafe to use without explicitly setting default
         # value as in PHP / Python that would change result of deserialization
         # (comparing with the case when terse_writes is not used): field set
@@ -3114,10 +3456,16 @@ class CppGenerator(t_generator.Generator):
         return s
 
     def _generate_struct_writer(self, scope, obj, pointers=False,
-                                result=False):
+                                result=False, projected=False):
         'Generates the write function.'
         this = 'this'
-        if self.flag_compatibility:
+        if projected:
+            # Like write(), but leaves out the fields that are not in mask
+            d = scope.defn('template <class Protocol_, class Mask_>\n'
+                           'uint32_t {name}(Protocol_* prot_, '
+                           'const Mask_& mask) const', name='writeProjected',
+                           output=self._out_tcc)
+        elif self.flag_compatibility:
             this = 'obj'
             name = '{0}_write'.format(obj.name)
             d = scope.defn('template <class Protocol_>\n' +
@@ -3153,7 +3501,11 @@ class CppGenerator(t_generator.Generator):
             s = s0('switch({0}->getType())'.format(this)).scope
 
         first = True
+        fields_scope = s
         for field in fields:
+            if projected:
+                s = fields_scope('if (mask.contains({0}))'.format(
+                    field.key)).scope
             isset_expr = ('{0}->{1}' if self._is_reference(field)
                           else '{0}->__isset.{1}').format(this, field.name)
             if result == True:
@@ -3185,6 +3537,9 @@ class CppGenerator(t_generator.Generator):
                     '(*const_cast<{0}*>('.format(
                         self._type_name(field.type)) + field_prefix,
                     field_suffix + '))')
+            elif self._is_lazy(field):
+                s1('xfer += {0}{1}.write(prot_);'.format(
+                    field_prefix, field.name))
             else:
                 self._generate_serialize_field(s1, field, field_prefix,
                                                field_suffix)
@@ -3192,6 +3547,9 @@ class CppGenerator(t_generator.Generator):
             s1('xfer += prot_->writeFieldEnd();')
             if s1 is not s:
                 s1.release()  # if this->_isset.{0}
+            if projected:
+                s.release()  # if (mask.contains(...))
+                s = fields_scope
         if s0 is not s:
             s('case ' + obj.name + '::Type::__EMPTY__:;')
             s.release()
@@ -3318,6 +3676,13 @@ class CppGenerator(t_generator.Generator):
                     method,
                     tte(ttype.as_list.elem_type),
                     prefix))
+            list_op = self._numeric_list_op(ttype)
+            if list_op and method == 'write':
+                s('xfer += ::apache::thrift::NumericListOps<Protocol_>::'
+                  'write{0}(prot_, {1}.data(), {1}.size());'.format(
+                      list_op, prefix))
+                s('xfer += prot_->writeListEnd();')
+                return
         ite = self.tmp('_iter')
         typename = self._type_name(ttype)
         with s('for (auto {0} = {1}.begin(); {0} != {1}.end(); ++{0})'.format(
@@ -3395,6 +3760,10 @@ class CppGenerator(t_generator.Generator):
                 else:
                     out('return obj->{method}(proto);'.format(**locals()))
 
+        if self.flag_size_hints:
+            out('template <> struct HasSizeHint<{0}> : std::true_type {{}};'
+                .format(compat_full_name))
+
     def _generate_frozen_layout(self, obj, s):
         fields = sorted(obj.as_struct.members, key=lambda field: field.key)
         type_name = self._type_name(obj)
@@ -3432,8 +3801,9 @@ class CppGenerator(t_generator.Generator):
     def _generate_cpp_struct(self, obj, is_exception=False):
         # We write all of these to the types scope
         scope = self._types_scope
-        self._generate_struct_complete(scope, obj, is_exception,
-                                       False, True, True, True, False)
+        self._generate_struct_complete(
+            scope, obj, is_exception, False, True, True, True, False,
+            table=self.flag_table_serializer and self._table_supported(obj))
 
         # We're at types scope now
         scope.release()
@@ -3715,6 +4085,17 @@ class CppGenerator(t_generator.Generator):
             s('#include <thrift/lib/cpp2/protocol/{0}.h>'.format(b))
         s('#include <thrift/lib/cpp2/protocol/DebugProtocol.h>')
         s('#include <thrift/lib/cpp2/protocol/VirtualProtocol.h>')
+        if self.flag_table_serializer:
+            s('#include <thrift/lib/cpp2/protocol/TableSerializer.h>')
+        if self.flag_arena:
+            s('#include <thrift/lib/cpp2/Arena.h>')
+        if self.flag_projection:
+            s('#include <thrift/lib/cpp2/protocol/FieldMask.h>')
+        if any(self._is_lazy(field) for obj in self._program.objects
+               for field in obj.members):
+            s('#include <thrift/lib/cpp2/protocol/LazyField.h>')
+        if any(self._has_views(obj) for obj in self._program.objects):
+            s('#include <thrift/lib/cpp2/protocol/StringView.h>')
         s('#include <thrift/lib/cpp/protocol/TProtocol.h>')
         if not self.flag_bootstrap:
             s('#include <thrift/lib/cpp/TApplicationException.h>')
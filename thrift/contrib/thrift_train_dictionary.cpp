@@ -0,0 +1,128 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+// Trains a zstd dictionary for THeader's ZSTD_TRANSFORM from captured
+// payloads.  Load the result with TCompressionDictionary::addFromFile() on
+// both clients and servers, and offer it with THeader::setDictionaryId()
+// or ThriftServer::setCompressionDictionaryId().
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <zdict.h>
+
+#include <folly/FileUtil.h>
+#include <folly/io/IOBufQueue.h>
+
+#include <thrift/lib/cpp/transport/THeader.h>
+
+using std::string;
+using std::vector;
+using apache::thrift::transport::THeader;
+
+void usage() {
+  fprintf(stderr,
+      "usage: thrift_train_dictionary [-m] [-s size] -o output input...\n"
+      "  -m inputs are captured THeader message streams; default is\n"
+      "     one serialized payload per input file\n"
+      "  -s maximum dictionary size in bytes (default 16384)\n"
+      "  -o file to write the dictionary to\n");
+  exit(EXIT_FAILURE);
+}
+
+// Append the payloads of all complete messages in data to samples
+void readMessages(const string& data, string& samples,
+                  vector<size_t>& sizes) {
+  THeader header;
+  folly::IOBufQueue queue(folly::IOBufQueue::cacheChainLength());
+  queue.append(folly::IOBuf::copyBuffer(data));
+  while (!queue.empty()) {
+    size_t needed = 0;
+    auto buf = header.removeHeader(&queue, needed);
+    if (!buf) {
+      fprintf(stderr, "ignoring truncated message at end of input\n");
+      break;
+    }
+    auto payload = buf->moveToFbString();
+    samples.append(payload.data(), payload.size());
+    sizes.push_back(payload.size());
+  }
+}
+
+int main(int argc, char *argv[]) {
+  bool messages = false;
+  size_t maxSize = 16 * 1024;
+  const char* output = nullptr;
+  vector<const char*> inputs;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-m") == 0) {
+      messages = true;
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      maxSize = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      output = argv[++i];
+    } else if (argv[i][0] == '-') {
+      usage();
+    } else {
+      inputs.push_back(argv[i]);
+    }
+  }
+  if (!output || inputs.empty() || maxSize == 0) {
+    usage();
+  }
+
+  // ZDICT wants all samples back to back plus their sizes
+  string samples;
+  vector<size_t> sizes;
+  for (auto input : inputs) {
+    string data;
+    if (!folly::readFile(input, data)) {
+      fprintf(stderr, "could not read %s: %s\n", input, strerror(errno));
+      return EXIT_FAILURE;
+    }
+    if (messages) {
+      readMessages(data, samples, sizes);
+    } else {
+      samples.append(data);
+      sizes.push_back(data.size());
+    }
+  }
+
+  string dictionary(maxSize, '\0');
+  size_t size = ZDICT_trainFromBuffer(&dictionary[0], dictionary.size(),
+                                      samples.data(), sizes.data(),
+                                      sizes.size());
+  if (ZDICT_isError(size)) {
+    fprintf(stderr, "training failed on %zu samples: %s\n",
+            sizes.size(), ZDICT_getErrorName(size));
+    return EXIT_FAILURE;
+  }
+  dictionary.resize(size);
+
+  if (!folly::writeFile(dictionary, output)) {
+    fprintf(stderr, "could not write %s: %s\n", output, strerror(errno));
+    return EXIT_FAILURE;
+  }
+  printf("dictionary %u: %zu bytes from %zu samples\n",
+         ZDICT_getDictID(dictionary.data(), dictionary.size()),
+         dictionary.size(), sizes.size());
+  return EXIT_SUCCESS;
+}
@@ -21,6 +21,8 @@
 #include <thrift/lib/cpp/transport/TSocketAddress.h>
 #include <thrift/lib/cpp/transport/TTransportException.h>
 #include <thrift/lib/cpp/concurrency/SpinLock.h>
+#include <thrift/lib/cpp/concurrency/ThreadManager.h>
+#include <thrift/lib/cpp/concurrency/FunctionRunner.h>
 
 #include <errno.h>
 #include <unistd.h>
@@ -55,8 +57,33 @@ using apache::thrift::async::TAsyncSSLSocket;
 using apache::thrift::concurrency::Util;
 using apache::thrift::concurrency::SpinLock;
 using apache::thrift::concurrency::SpinLockGuard;
+using apache::thrift::concurrency::FunctionRunner;
 using folly::Optional;
 
+// What an SSL_accept() call on another thread returned.  SSL_get_error()
+// and the error queue have to be read on that thread.
+struct SSLAcceptResult {
+  int ret;
+  int error;
+  long lastError;
+  int errnoCopy;
+};
+
+SSLAcceptResult runSSLAccept(SSL* ssl) {
+  SSLAcceptResult result;
+  errno = 0;
+  result.ret = SSL_accept(ssl);
+  result.error = SSL_ERROR_NONE;
+  result.lastError = 0;
+  if (result.ret <= 0) {
+    result.error = SSL_get_error(ssl, result.ret);
+    result.lastError = ERR_get_error();
+  }
+  result.errnoCopy = errno;
+  ERR_clear_error();
+  return result;
+}
+
 /** Try to avoid calling SSL_write() for buffers smaller than this: */
 size_t MIN_WRITE_SIZE = 1500;
 
@@ -301,7 +328,7 @@ TAsyncSSLSocket::~TAsyncSSLSocket() {
 
 void TAsyncSSLSocket::closeNow() {
   // Close the SSL connection.
-  if (ssl_ != nullptr && fd_ != -1) {
+  if (ssl_ != nullptr && fd_ != -1 && !handshakeOffloaded_) {
     int rc = SSL_shutdown(ssl_);
     if (rc == 0) {
       rc = SSL_shutdown(ssl_);
@@ -327,12 +354,19 @@ void TAsyncSSLSocket::closeNow() {
   if (handshakeCallback_) {
     TTransportException ex(TTransportException::END_OF_FILE,
                            "SSL connection closed locally");
-    HandshakeCallback* callback = handshakeCallback_;
-    handshakeCallback_ = nullptr;
-    callback->handshakeError(this, ex);
+    if (handshakeOffloaded_) {
+      // The pool thread may be in sslVerifyCallback() right now
+      deferHandshakeError(ex);
+    } else {
+      HandshakeCallback* callback = handshakeCallback_;
+      handshakeCallback_ = nullptr;
+      callback->handshakeError(this, ex);
+    }
   }
 
-  if (ssl_ != nullptr) {
+  // An offloaded SSL_accept() still uses ssl_; offloadedAcceptDone()
+  // frees it
+  if (ssl_ != nullptr && !handshakeOffloaded_) {
     SSL_free(ssl_);
     ssl_ = nullptr;
   }
@@ -341,6 +375,18 @@ void TAsyncSSLSocket::closeNow() {
   TAsyncSocket::closeNow();
 }
 
+void TAsyncSSLSocket::doClose() {
+  if (handshakeOffloaded_ && fd_ != -1) {
+    // Keep the fd open until the offloaded SSL_accept() returns, so that
+    // its number cannot be reused under it.  The socket is closed to us
+    // already.
+    offloadedFd_ = fd_;
+    fd_ = -1;
+    return;
+  }
+  TAsyncSocket::doClose();
+}
+
 void TAsyncSSLSocket::shutdownWrite() {
   // SSL sockets do not support half-shutdown, so just perform a full shutdown.
   //
@@ -598,7 +644,9 @@ void TAsyncSSLSocket::failHandshake(const char* fn,
   if (handshakeTimeout_.isScheduled()) {
     handshakeTimeout_.cancelTimeout();
   }
-  if (handshakeCallback_ != nullptr) {
+  if (handshakeOffloaded_) {
+    deferHandshakeError(ex);
+  } else if (handshakeCallback_ != nullptr) {
     HandshakeCallback* callback = handshakeCallback_;
     handshakeCallback_ = nullptr;
     callback->handshakeError(this, ex);
@@ -607,6 +655,14 @@ void TAsyncSSLSocket::failHandshake(const char* fn,
   finishFail();
 }
 
+void TAsyncSSLSocket::deferHandshakeError(const TTransportException& ex) {
+  // handshakeCallback_ is left alone until offloadedAcceptDone(); only the
+  // first error is reported
+  if (handshakeCallback_ != nullptr && !offloadedError_) {
+    offloadedError_.reset(new TTransportException(ex));
+  }
+}
+
 void TAsyncSSLSocket::invokeHandshakeCallback() {
   if (handshakeTimeout_.isScheduled()) {
     handshakeTimeout_.cancelTimeout();
@@ -780,6 +836,15 @@ int TAsyncSSLSocket::getSSLCertSize() const {
 
 bool TAsyncSSLSocket::willBlock(int ret, int *errorOut) noexcept {
   int error = *errorOut = SSL_get_error(ssl_, ret);
+  if (waitForSSL(error)) {
+    return true;
+  }
+  recordSSLError(ret, error, ERR_get_error(), errorOut);
+  ERR_clear_error();
+  return false;
+}
+
+bool TAsyncSSLSocket::waitForSSL(int error) noexcept {
   if (error == SSL_ERROR_WANT_READ) {
     // Register for read event if not already.
     updateEventRegistration(TEventHandler::READ, TEventHandler::WRITE);
@@ -823,33 +888,34 @@ bool TAsyncSSLSocket::willBlock(int ret, int *errorOut) noexcept {
     // The timeout (if set) keeps running here
     return true;
 #endif
-  } else {
-    // SSL_ERROR_ZERO_RETURN is processed here so we can get some detail
-    // in the log
-    long lastError = ERR_get_error();
-    VLOG(6) << "TAsyncSSLSocket(fd=" << fd_ << ", "
-            << "state=" << state_ << ", "
-            << "sslState=" << sslState_ << ", "
-            << "events=" << std::hex << eventFlags_ << "): "
-            << "SSL error: " << error << ", "
-            << "errno: " << errno << ", "
-            << "ret: " << ret << ", "
-            << "read: " << BIO_number_read(SSL_get_rbio(ssl_)) << ", "
-            << "written: " << BIO_number_written(SSL_get_wbio(ssl_)) << ", "
-            << "func: " << ERR_func_error_string(lastError) << ", "
-            << "reason: " << ERR_reason_error_string(lastError);
-    if (error != SSL_ERROR_SYSCALL) {
-      if (error == SSL_ERROR_SSL) {
-        *errorOut = lastError;
-      }
-      if ((unsigned long)lastError < 0x8000) {
-        errno = ENOSYS;
-      } else {
-        errno = lastError;
-      }
+  }
+  return false;
+}
+
+void TAsyncSSLSocket::recordSSLError(int ret, int error, long lastError,
+                                     int *errorOut) noexcept {
+  // SSL_ERROR_ZERO_RETURN is processed here so we can get some detail
+  // in the log
+  VLOG(6) << "TAsyncSSLSocket(fd=" << fd_ << ", "
+          << "state=" << state_ << ", "
+          << "sslState=" << sslState_ << ", "
+          << "events=" << std::hex << eventFlags_ << "): "
+          << "SSL error: " << error << ", "
+          << "errno: " << errno << ", "
+          << "ret: " << ret << ", "
+          << "read: " << BIO_number_read(SSL_get_rbio(ssl_)) << ", "
+          << "written: " << BIO_number_written(SSL_get_wbio(ssl_)) << ", "
+          << "func: " << ERR_func_error_string(lastError) << ", "
+          << "reason: " << ERR_reason_error_string(lastError);
+  if (error != SSL_ERROR_SYSCALL) {
+    if (error == SSL_ERROR_SSL) {
+      *errorOut = lastError;
+    }
+    if ((unsigned long)lastError < 0x8000) {
+      errno = ENOSYS;
+    } else {
+      errno = lastError;
     }
-    ERR_clear_error();
-    return false;
   }
 }
 
@@ -857,7 +923,7 @@ void TAsyncSSLSocket::checkForImmediateRead() noexcept {
   // openssl may have buffered data that it read from the socket already.
   // In this case we have to process it immediately, rather than waiting for
   // the socket to become readable again.
-  if (ssl_ != nullptr && SSL_pending(ssl_) > 0) {
+  if (ssl_ != nullptr && !handshakeOffloaded_ && SSL_pending(ssl_) > 0) {
     TAsyncSocket::handleRead();
   }
 }
@@ -899,6 +965,13 @@ TAsyncSSLSocket::handleAccept() noexcept {
   assert(server_);
   assert(state_ == StateEnum::ESTABLISHED &&
          sslState_ == STATE_ACCEPTING);
+  if (handshakeOffloaded_) {
+    // Something registered for events again; offloadedAcceptDone() takes
+    // it from here
+    updateEventRegistration(TEventHandler::NONE,
+                            TEventHandler::READ | TEventHandler::WRITE);
+    return;
+  }
   if (!ssl_) {
     /* lazily create the SSL structure */
     try {
@@ -922,6 +995,10 @@ TAsyncSSLSocket::handleAccept() noexcept {
     SSL_set_msg_callback(ssl_, &TAsyncSSLSocket::clientHelloParsingCallback);
   }
 
+  if (handshakeThreadManager_) {
+    return offloadAccept();
+  }
+
   errno = 0;
   int ret = SSL_accept(ssl_);
   if (ret <= 0) {
@@ -935,6 +1012,11 @@ TAsyncSSLSocket::handleAccept() noexcept {
     }
   }
 
+  acceptComplete();
+}
+
+void
+TAsyncSSLSocket::acceptComplete() noexcept {
   handshakeComplete_ = true;
   updateEventRegistration(0, TEventHandler::READ | TEventHandler::WRITE);
 
@@ -970,6 +1052,81 @@ TAsyncSSLSocket::handleAccept() noexcept {
   TAsyncSocket::handleInitialReadWrite();
 }
 
+void
+TAsyncSSLSocket::offloadAccept() noexcept {
+  // Nothing may use the socket or ssl_ on this thread until SSL_accept()
+  // comes back; the handshake timeout keeps running
+  updateEventRegistration(TEventHandler::NONE,
+                          TEventHandler::READ | TEventHandler::WRITE);
+  handshakeOffloaded_ = true;
+
+  TEventBase* evb = eventBase_;
+  SSL* ssl = ssl_;
+  // Created and deleted on the event base thread
+  auto dg = new DestructorGuard(this);
+  try {
+    handshakeThreadManager_->add(std::make_shared<FunctionRunner>([=] {
+      SSLAcceptResult result = runSSLAccept(ssl);
+      evb->runInEventBaseThread([=] {
+        offloadedAcceptDone(result.ret, result.error, result.lastError,
+                            result.errnoCopy);
+        delete dg;
+      });
+    }));
+  } catch (const std::exception& e) {
+    // The pool is overloaded: take the hit here rather than fail
+    T_DEBUG_L(3, "TAsyncSSLSocket(this=%p, fd=%d): cannot offload "
+              "SSL_accept(): %s", this, fd_, e.what());
+    SSLAcceptResult result = runSSLAccept(ssl);
+    offloadedAcceptDone(result.ret, result.error, result.lastError,
+                        result.errnoCopy);
+    delete dg;
+  }
+}
+
+void
+TAsyncSSLSocket::offloadedAcceptDone(int ret, int error, long lastError,
+                                     int errnoCopy) noexcept {
+  handshakeOffloaded_ = false;
+  if (offloadedFd_ != -1) {
+    // Closed while SSL_accept() ran: finish closing now
+    fd_ = offloadedFd_;
+    offloadedFd_ = -1;
+    TAsyncSocket::doClose();
+  }
+  if (offloadedError_) {
+    // Report the timeout or close that happened while SSL_accept() ran
+    unique_ptr<TTransportException> ex(std::move(offloadedError_));
+    if (handshakeCallback_ != nullptr) {
+      HandshakeCallback* callback = handshakeCallback_;
+      handshakeCallback_ = nullptr;
+      callback->handshakeError(this, *ex);
+    }
+  }
+  if (state_ != StateEnum::ESTABLISHED || sslState_ != STATE_ACCEPTING) {
+    // The handshake timed out or the socket was closed in the meantime,
+    // and closeNow() left ssl_ to us
+    if (ssl_ != nullptr) {
+      SSL_free(ssl_);
+      ssl_ = nullptr;
+    }
+    return;
+  }
+
+  if (ret <= 0) {
+    if (waitForSSL(error)) {
+      return;
+    }
+    errno = errnoCopy;
+    recordSSLError(ret, error, lastError, &error);
+    sslState_ = STATE_ERROR;
+    TSSLException ex(error, errno);
+    return failHandshake(__func__, ex);
+  }
+
+  acceptComplete();
+}
+
 void
 TAsyncSSLSocket::handleConnect() noexcept {
   T_DEBUG_L(3, "TAsyncSSLSocket::handleConnect() this=%p, fd=%d, state=%d, "
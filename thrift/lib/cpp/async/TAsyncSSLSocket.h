@@ -40,6 +40,10 @@ using std::unique_ptr;
 
 namespace apache { namespace thrift {
 
+namespace concurrency {
+class ThreadManager;
+}
+
 namespace async {
 
 class TSSLException: public apache::thrift::transport::TTransportException {
@@ -305,6 +309,22 @@ class TAsyncSSLSocket : public TAsyncSocket {
    */
   void restartSSLAccept();
 
+  /**
+   * Run the SSL_accept() calls of sslAccept() on threadManager rather than
+   * on the event base thread, so that the private key operations of a
+   * handshake do not hold up the other sockets of the event base.  Each
+   * call is handed back to the event base thread when it returns, which
+   * waits for the socket there as usual.
+   *
+   * The OpenSSL callbacks of the handshake (server name, session cache,
+   * HandshakeCallback::handshakeVerify()) then run on threadManager too.
+   * Set it before sslAccept().
+   */
+  void setHandshakeThreadManager(
+      const std::shared_ptr<concurrency::ThreadManager>& threadManager) {
+    handshakeThreadManager_ = threadManager;
+  }
+
   /**
    * Connect to the given address, invoking callback when complete or on error
    *
@@ -659,6 +679,16 @@ class TAsyncSSLSocket : public TAsyncSocket {
 
   void invalidState(HandshakeCallback* callback);
   bool willBlock(int ret, int *errorOut) noexcept;
+  bool waitForSSL(int error) noexcept;
+  void recordSSLError(int ret, int error, long lastError,
+                      int *errorOut) noexcept;
+  void acceptComplete() noexcept;
+
+  void offloadAccept() noexcept;
+  void deferHandshakeError(const transport::TTransportException& ex);
+  void offloadedAcceptDone(int ret, int error, long lastError,
+                           int errnoCopy) noexcept;
+  void doClose();
 
   virtual void checkForImmediateRead() noexcept;
   // TAsyncSocket calls this at the wrong time for SSL
@@ -742,6 +772,14 @@ class TAsyncSSLSocket : public TAsyncSocket {
 
   bool parseClientHello_{false};
   unique_ptr<ClientHelloInfo> clientHelloInfo_;
+
+  std::shared_ptr<concurrency::ThreadManager> handshakeThreadManager_;
+  // Set while SSL_accept() runs on handshakeThreadManager_.  ssl_, the
+  // socket and handshakeCallback_ are its own until it returns, so closing
+  // them and reporting a handshake error wait until then.
+  bool handshakeOffloaded_{false};
+  int offloadedFd_{-1};
+  unique_ptr<transport::TTransportException> offloadedError_;
 };
 
 }}} // apache::thrift::async
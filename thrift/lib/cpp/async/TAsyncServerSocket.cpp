@@ -132,6 +132,7 @@ TAsyncServerSocket::TAsyncServerSocket(TEventBase* eventBase)
     backoffTimeout_(nullptr),
     callbacks_(),
     keepAliveEnabled_(true),
+    reusePortEnabled_(false),
     closeOnExec_(true),
     shutdownSocketSet_(nullptr) {
 }
@@ -196,7 +197,11 @@ int TAsyncServerSocket::stopAccepting(int shutdownFlags) {
   for (std::vector<CallbackInfo>::iterator it = callbacksCopy.begin();
        it != callbacksCopy.end();
        ++it) {
-    it->consumer->stop(it->eventBase, it->callback);
+    if (it->consumer) {
+      it->consumer->stop(it->eventBase, it->callback);
+    } else {
+      it->callback->acceptStopped();
+    }
   }
 
   return result;
@@ -371,6 +376,53 @@ void TAsyncServerSocket::bind(uint16_t port) {
   }
 }
 
+void TAsyncServerSocket::bind(
+    const std::vector<transport::TSocketAddress>& addresses) {
+  assert(eventBase_ == nullptr || eventBase_->isInEventBaseThread());
+
+  if (sockets_.size() > 0) {
+    throw TTransportException(TTransportException::ALREADY_OPEN,
+                              "cannot bind a list of addresses on a "
+                              "TAsyncServerSocket that already has a socket");
+  }
+
+  // Mirror bind(uint16_t): when listening on both families, keep the IPv6
+  // sockets from also claiming the IPv4 addresses.
+  bool hasInet = false;
+  for (const auto& address : addresses) {
+    if (address.getFamily() == AF_INET) {
+      hasInet = true;
+    }
+  }
+
+  for (const auto& address : addresses) {
+    int fd = createSocket(address.getFamily());
+    sockets_.push_back(
+      ServerEventHandler(eventBase_, fd, this, address.getFamily()));
+    sockets_.back().changeHandlerFD(fd);
+
+    if (hasInet && address.getFamily() == AF_INET6) {
+      int v6only = 1;
+      if (setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY,
+                     &v6only, sizeof(v6only)) != 0) {
+        throw TTransportException(TTransportException::COULD_NOT_BIND,
+                                  "failed to set IPV6_V6ONLY on async "
+                                  "server socket", errno);
+      }
+    }
+
+    sockaddr_storage addrStorage;
+    address.getAddress(&addrStorage);
+    sockaddr* saddr = reinterpret_cast<sockaddr*>(&addrStorage);
+    if (::bind(fd, saddr, address.getActualSize()) != 0) {
+      throw TTransportException(TTransportException::COULD_NOT_BIND,
+                                "failed to bind to async server socket: " +
+                                address.describe(),
+                                errno);
+    }
+  }
+}
+
 void TAsyncServerSocket::listen(int backlog) {
   assert(eventBase_ == nullptr || eventBase_->isInEventBaseThread());
 
@@ -446,6 +498,21 @@ void TAsyncServerSocket::addAcceptCallback(AcceptCallback *callback,
   }
 }
 
+void TAsyncServerSocket::addInlineAcceptCallback(AcceptCallback *callback) {
+  assert(eventBase_ == nullptr || eventBase_->isInEventBaseThread());
+
+  bool runStartAccepting = accepting_ && callbacks_.empty();
+
+  // No TEventBase and no consumer: dispatchSocket() calls the callback
+  // straight from handlerReady()
+  callbacks_.push_back(CallbackInfo(callback, nullptr));
+  callback->acceptStarted();
+
+  if (runStartAccepting) {
+    startAccepting();
+  }
+}
+
 void TAsyncServerSocket::removeAcceptCallback(AcceptCallback *callback,
                                               TEventBase *eventBase) {
   assert(eventBase_ == nullptr || eventBase_->isInEventBaseThread());
@@ -490,7 +557,11 @@ void TAsyncServerSocket::removeAcceptCallback(AcceptCallback *callback,
     }
   }
 
-  info.consumer->stop(info.eventBase, info.callback);
+  if (info.consumer) {
+    info.consumer->stop(info.eventBase, info.callback);
+  } else {
+    info.callback->acceptStopped();
+  }
 
   // If we are supposed to be accepting but the last accept callback
   // was removed, unregister for events until a callback is added.
@@ -570,6 +641,21 @@ void TAsyncServerSocket::setupSocket(int fd) {
             strerror(errno));
   }
 
+  // Share the address with other listeners if requested
+  if (reusePortEnabled_) {
+#ifdef SO_REUSEPORT
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0) {
+      throw TTransportException(TTransportException::NOT_OPEN,
+                                "failed to set SO_REUSEPORT on async server "
+                                "socket", errno);
+    }
+#else
+    throw TTransportException(TTransportException::NOT_OPEN,
+                              "SO_REUSEPORT is not supported on this "
+                              "platform");
+#endif
+  }
+
   // Set keepalive as desired
   int zero = 0;
   if (setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE,
@@ -26,6 +26,7 @@
 #include <thrift/lib/cpp/async/TNotificationQueue.h>
 #include <thrift/lib/cpp/async/TAsyncTimeout.h>
 #include <thrift/lib/cpp/transport/TSocketAddress.h>
+#include <atomic>
 #include <memory>
 #include <exception>
 #include <vector>
@@ -262,6 +263,21 @@ class TAsyncServerSocket : public TDelayedDestruction {
    */
   virtual void bind(uint16_t port);
 
+  /**
+   * Bind one new socket to each of the specified addresses.
+   *
+   * This is mostly useful together with setReusePortEnabled(), to open
+   * additional listeners on the addresses another TAsyncServerSocket is
+   * already bound to (see getAddresses()).
+   *
+   * This must be called from the primary TEventBase thread, before any
+   * other bind() or useExistingSocket() call.
+   *
+   * Throws TTransportException on error.
+   */
+  virtual void bind(
+    const std::vector<transport::TSocketAddress>& addresses);
+
   /**
    * Get the local address to which the socket is bound.
    *
@@ -336,6 +352,20 @@ class TAsyncServerSocket : public TDelayedDestruction {
     TEventBase *eventBase,
     uint32_t maxAtOnce = kDefaultCallbackAcceptAtOnce);
 
+  /**
+   * Add an AcceptCallback that is invoked directly from the accept loop in
+   * the TAsyncServerSocket's primary TEventBase, without a notification
+   * queue.
+   *
+   * The callback's acceptStarted() is called before this method returns.
+   * setMaxAcceptAtOnce() controls how many connections are accepted at once.
+   * The callback must be removed with a nullptr TEventBase.
+   *
+   * This method must be invoked from the TAsyncServerSocket's primary
+   * TEventBase thread.
+   */
+  virtual void addInlineAcceptCallback(AcceptCallback *callback);
+
   /**
    * Remove an AcceptCallback.
    *
@@ -479,7 +509,7 @@ class TAsyncServerSocket : public TDelayedDestruction {
    * Get the number of connections dropped by the TAsyncServerSocket
    */
   uint64_t getNumDroppedConnections() const {
-    return numDroppedConnections_;
+    return numDroppedConnections_.load(std::memory_order_relaxed);
   }
 
   /**
@@ -515,6 +545,25 @@ class TAsyncServerSocket : public TDelayedDestruction {
     return keepAliveEnabled_;
   }
 
+  /**
+   * Set whether or not SO_REUSEPORT should be enabled on the server socket,
+   * allowing several sockets to bind to the same address and letting the
+   * kernel load balance incoming connections between them.  By default,
+   * SO_REUSEPORT is disabled.
+   *
+   * This must be called before bind() to have any effect.
+   */
+  void setReusePortEnabled(bool enabled) {
+    reusePortEnabled_ = enabled;
+  }
+
+  /**
+   * Get whether or not SO_REUSEPORT is enabled on the server socket.
+   */
+  bool getReusePortEnabled() const {
+    return reusePortEnabled_;
+  }
+
   /**
    * Set whether or not the socket should close during exec() (FD_CLOEXEC). By
    * default, this is enabled
@@ -675,11 +724,13 @@ class TAsyncServerSocket : public TDelayedDestruction {
   double acceptRateAdjustSpeed_;  //0 to disable auto adjust
   double acceptRate_;
   int64_t lastAccepTimestamp_;  // milliseconds
-  uint64_t numDroppedConnections_;
+  // Read from other threads, see getNumDroppedConnections()
+  std::atomic<uint64_t> numDroppedConnections_;
   uint32_t callbackIndex_;
   BackoffTimeout *backoffTimeout_;
   std::vector<CallbackInfo> callbacks_;
   bool keepAliveEnabled_;
+  bool reusePortEnabled_;
   bool closeOnExec_;
   ShutdownSocketSet* shutdownSocketSet_;
 };
@@ -32,6 +32,14 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
+
+#if defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY) && \
+    defined(SO_EE_ORIGIN_ZEROCOPY)
+#define THRIFT_HAVE_MSG_ZEROCOPY 1
+#endif
 
 using apache::thrift::transport::TSocketAddress;
 using apache::thrift::transport::TTransportException;
@@ -45,6 +53,9 @@ namespace apache { namespace thrift { namespace async {
 const TAsyncSocket::OptionMap TAsyncSocket::emptyOptionMap;
 const transport::TSocketAddress TAsyncSocket::anyAddress =
   transport::TSocketAddress("0.0.0.0", 0);
+const size_t TAsyncSocket::kDefaultZeroCopyThreshold;
+const uint32_t TAsyncSocket::kZeroCopyPollInterval;
+const uint32_t TAsyncSocket::kZeroCopyMaxLinger;
 
 const TTransportException socketClosedLocallyEx(
     TTransportException::END_OF_FILE, "socket closed locally");
@@ -122,6 +133,11 @@ class TAsyncSocket::WriteRequest {
     return opCount_ - opIndex_;
   }
 
+  // A reference to the buffers not yet released by consume()
+  unique_ptr<IOBuf> cloneIOBuf() const {
+    return ioBuf_ ? ioBuf_->clone() : nullptr;
+  }
+
   void consume(uint32_t wholeOps, uint32_t partialBytes,
                uint32_t totalBytesWritten) {
     // Advance opIndex_ forward by wholeOps
@@ -184,7 +200,8 @@ class TAsyncSocket::WriteRequest {
 TAsyncSocket::TAsyncSocket(TEventBase* evb)
   : eventBase_(evb)
   , writeTimeout_(this, evb)
-  , ioHandler_(this, evb) {
+  , ioHandler_(this, evb)
+  , zeroCopyTimeout_(this, evb) {
   VLOG(5) << "new TAsyncSocket(" << this << ", evb=" << evb << ")";
   init();
 }
@@ -194,7 +211,8 @@ TAsyncSocket::TAsyncSocket(TEventBase* evb,
                            uint32_t connectTimeout)
   : eventBase_(evb)
   , writeTimeout_(this, evb)
-  , ioHandler_(this, evb) {
+  , ioHandler_(this, evb)
+  , zeroCopyTimeout_(this, evb) {
   VLOG(5) << "new TAsyncSocket(" << this << ", evb=" << evb << ")";
   init();
   connect(nullptr, address, connectTimeout);
@@ -206,7 +224,8 @@ TAsyncSocket::TAsyncSocket(TEventBase* evb,
                            uint32_t connectTimeout)
   : eventBase_(evb)
   , writeTimeout_(this, evb)
-  , ioHandler_(this, evb) {
+  , ioHandler_(this, evb)
+  , zeroCopyTimeout_(this, evb) {
   VLOG(5) << "new TAsyncSocket(" << this << ", evb=" << evb << ")";
   init();
   connect(nullptr, ip, port, connectTimeout);
@@ -215,7 +234,8 @@ TAsyncSocket::TAsyncSocket(TEventBase* evb,
 TAsyncSocket::TAsyncSocket(TEventBase* evb, int fd)
   : eventBase_(evb)
   , writeTimeout_(this, evb)
-  , ioHandler_(this, evb, fd) {
+  , ioHandler_(this, evb, fd)
+  , zeroCopyTimeout_(this, evb) {
   VLOG(5) << "new TAsyncSocket(" << this << ", evb=" << evb << ", fd="
           << fd << ")";
   init();
@@ -240,6 +260,9 @@ void TAsyncSocket::init() {
   shutdownSocketSet_ = nullptr;
   appBytesWritten_ = 0;
   appBytesReceived_ = 0;
+  zeroCopyEnabled_ = false;
+  zeroCopyThreshold_ = kDefaultZeroCopyThreshold;
+  zeroCopySeq_ = 0;
 }
 
 TAsyncSocket::~TAsyncSocket() {
@@ -591,6 +614,8 @@ void TAsyncSocket::write(WriteCallback* callback,
   iovec op;
   op.iov_base = const_cast<void*>(buf);
   op.iov_len = bytes;
+  // The caller owns buf, so it cannot be held until the kernel is done
+  flags = unSet(flags, WriteFlags::ZEROCOPY);
   writeImpl(callback, &op, 1, std::move(unique_ptr<IOBuf>()), flags);
 }
 
@@ -598,11 +623,23 @@ void TAsyncSocket::writev(WriteCallback* callback,
                           const iovec* vec,
                           size_t count,
                           WriteFlags flags) {
+  flags = unSet(flags, WriteFlags::ZEROCOPY);
   writeImpl(callback, vec, count, std::move(unique_ptr<IOBuf>()), flags);
 }
 
 void TAsyncSocket::writeChain(WriteCallback* callback, unique_ptr<IOBuf>&& buf,
                               WriteFlags flags) {
+  if (!zeroCopyEnabled_) {
+    flags = unSet(flags, WriteFlags::ZEROCOPY);
+  } else if (isSet(flags, WriteFlags::ZEROCOPY) ||
+             buf->computeChainDataLength() >= zeroCopyThreshold_) {
+    flags = flags | WriteFlags::ZEROCOPY;
+    // Release what we can before pinning more pages
+    if (!zeroCopyBufs_.empty()) {
+      handleZeroCopyCompletions();
+    }
+  }
+
   size_t count = buf->countChainElements();
   if (count <= 64) {
     iovec vec[count];
@@ -666,6 +703,7 @@ void TAsyncSocket::writeImpl(WriteCallback* callback, const iovec* vec,
       assert(writeReqTail_ == nullptr);
       assert((eventFlags_ & TEventHandler::WRITE) == 0);
 
+      uint32_t zeroCopySeq = zeroCopySeq_;
       bytesWritten = performWrite(vec, count, flags,
                                   &countWritten, &partialWritten);
       if (bytesWritten < 0) {
@@ -674,12 +712,18 @@ void TAsyncSocket::writeImpl(WriteCallback* callback, const iovec* vec,
         return failWrite(__func__, callback, 0, ex);
       } else if (countWritten == count) {
         // We successfully wrote everything.
+        if (zeroCopySeq_ != zeroCopySeq) {
+          holdZeroCopyBuf(std::move(ioBuf));
+        }
         // Invoke the callback and return.
         if (callback) {
           callback->writeSuccess();
         }
         return;
       } // else { continue writing the next writeReq }
+      if (zeroCopySeq_ != zeroCopySeq) {
+        holdZeroCopyBuf(ioBuf->clone());
+      }
       mustRegister = true;
     }
   } else if (!connecting()) {
@@ -1016,6 +1060,8 @@ void TAsyncSocket::attachEventBase(TEventBase* eventBase) {
   eventBase_ = eventBase;
   ioHandler_.attachEventBase(eventBase);
   writeTimeout_.attachEventBase(eventBase);
+  zeroCopyTimeout_.attachEventBase(eventBase);
+  scheduleZeroCopyPoll();
 }
 
 void TAsyncSocket::detachEventBase() {
@@ -1028,6 +1074,9 @@ void TAsyncSocket::detachEventBase() {
   eventBase_ = nullptr;
   ioHandler_.detachEventBase();
   writeTimeout_.detachEventBase();
+  // Polling resumes in attachEventBase()
+  zeroCopyTimeout_.cancelTimeout();
+  zeroCopyTimeout_.detachEventBase();
 }
 
 bool TAsyncSocket::isDetachable() const {
@@ -1174,6 +1223,12 @@ void TAsyncSocket::ioReady(uint16_t events) noexcept {
   assert(events & TEventHandler::READ_WRITE);
   assert(eventBase_->isInEventBaseThread());
 
+  // Zero copy completions arrive as POLLERR, which wakes up whichever
+  // events we are registered for.
+  if (!zeroCopyBufs_.empty()) {
+    handleZeroCopyCompletions();
+  }
+
   uint16_t relevantEvents = events & TEventHandler::READ_WRITE;
   if (relevantEvents == TEventHandler::READ) {
     handleRead();
@@ -1347,6 +1402,7 @@ void TAsyncSocket::handleWrite() noexcept {
     if (writeReqHead_->getNext() != nullptr) {
       writeFlags = writeFlags | WriteFlags::CORK;
     }
+    uint32_t zeroCopySeq = zeroCopySeq_;
     int bytesWritten = performWrite(writeReqHead_->getOps(),
                                     writeReqHead_->getOpCount(),
                                     writeFlags, &countWritten, &partialWritten);
@@ -1354,7 +1410,11 @@ void TAsyncSocket::handleWrite() noexcept {
       TTransportException ex(TTransportException::INTERNAL_ERROR,
                              withAddr("writev() failed"), errno);
       return failWrite(__func__, ex);
-    } else if (countWritten == writeReqHead_->getOpCount()) {
+    }
+    if (zeroCopySeq_ != zeroCopySeq) {
+      holdZeroCopyBuf(writeReqHead_->cloneIOBuf());
+    }
+    if (countWritten == writeReqHead_->getOpCount()) {
       // We finished this request
       WriteRequest* req = writeReqHead_;
       writeReqHead_ = req->getNext();
@@ -1632,7 +1692,24 @@ ssize_t TAsyncSocket::performWrite(const iovec* vec,
     // marks that this is the last byte of a record (response)
     msg_flags |= MSG_EOR;
   }
+#ifdef THRIFT_HAVE_MSG_ZEROCOPY
+  if (isSet(flags, WriteFlags::ZEROCOPY)) {
+    msg_flags |= MSG_ZEROCOPY;
+  }
+#endif
   ssize_t totalWritten = ::sendmsg(fd_, &msg, msg_flags);
+#ifdef THRIFT_HAVE_MSG_ZEROCOPY
+  if (msg_flags & MSG_ZEROCOPY) {
+    if (totalWritten < 0 && errno == ENOBUFS) {
+      // Out of optmem for the pinned pages; copy this one instead.
+      msg_flags &= ~MSG_ZEROCOPY;
+      totalWritten = ::sendmsg(fd_, &msg, msg_flags);
+    } else if (totalWritten > 0) {
+      // The kernel numbers each zero copy send that sent data
+      ++zeroCopySeq_;
+    }
+  }
+#endif
   if (totalWritten < 0) {
     if (errno == EAGAIN) {
       // TCP buffer is full; we can't write any more data right now.
@@ -1921,14 +1998,181 @@ void TAsyncSocket::invalidState(WriteCallback* callback) {
   }
 }
 
+/**
+ * Keeps the file descriptor of a closed socket open, and the chains of its
+ * zero copy sends alive, until the kernel reports that it is done with
+ * them.  TCP keeps sending the data from the chains after close(), but the
+ * completions would be lost with the file descriptor.
+ */
+class TAsyncSocket::ZeroCopyLinger : public TAsyncTimeout {
+ public:
+  ZeroCopyLinger(TEventBase* eventBase,
+                 int fd,
+                 ShutdownSocketSet* shutdownSocketSet,
+                 std::deque<ZeroCopyBuf>&& bufs)
+    : TAsyncTimeout(eventBase)
+    , fd_(fd)
+    , shutdownSocketSet_(shutdownSocketSet)
+    , bufs_(std::move(bufs))
+    , pollsLeft_(kZeroCopyMaxLinger / kZeroCopyPollInterval) {
+    // The peer reads EOF after the data, as it would after close()
+    ::shutdown(fd_, SHUT_RDWR);
+  }
+
+  void start() {
+    if (!scheduleTimeout(kZeroCopyPollInterval)) {
+      finish();
+    }
+  }
+
+  virtual void timeoutExpired() noexcept {
+    readZeroCopyCompletions(fd_, &bufs_);
+    if (!bufs_.empty() && --pollsLeft_ > 0 &&
+        scheduleTimeout(kZeroCopyPollInterval)) {
+      return;
+    }
+    finish();
+  }
+
+ private:
+  void finish() {
+    if (!bufs_.empty()) {
+      LOG(WARNING) << "TAsyncSocket: closing fd " << fd_ << " with "
+                   << bufs_.size() << " zero copy sends still pending";
+    }
+    if (shutdownSocketSet_) {
+      shutdownSocketSet_->close(fd_);
+    } else {
+      ::close(fd_);
+    }
+    delete this;
+  }
+
+  int fd_;
+  ShutdownSocketSet* shutdownSocketSet_;
+  std::deque<ZeroCopyBuf> bufs_;
+  uint32_t pollsLeft_;
+};
+
 void TAsyncSocket::doClose() {
   if (fd_ == -1) return;
+  zeroCopyTimeout_.cancelTimeout();
+  if (!zeroCopyBufs_.empty()) {
+    readZeroCopyCompletions(fd_, &zeroCopyBufs_);
+  }
+  if (!zeroCopyBufs_.empty() && eventBase_ != nullptr) {
+    // After closeWithReset() nothing more is sent from the chains
+    struct linger optLinger = {0, 0};
+    socklen_t len = sizeof(optLinger);
+    bool reset = getsockopt(fd_, SOL_SOCKET, SO_LINGER, &optLinger, &len) == 0
+      && optLinger.l_onoff && optLinger.l_linger == 0;
+    if (!reset) {
+      auto linger = new ZeroCopyLinger(eventBase_, fd_, shutdownSocketSet_,
+                                       std::move(zeroCopyBufs_));
+      zeroCopyBufs_.clear();
+      fd_ = -1;
+      linger->start();
+      return;
+    }
+  }
   if (shutdownSocketSet_) {
     shutdownSocketSet_->close(fd_);
   } else {
     ::close(fd_);
   }
   fd_ = -1;
+  // Reset, or detached from its event base (which nothing could poll on)
+  zeroCopyBufs_.clear();
+}
+
+bool TAsyncSocket::setZeroCopy(bool enable) {
+  if (enable == zeroCopyEnabled_) {
+    return true;
+  }
+  if (!enable) {
+    // SO_ZEROCOPY stays set: it only allows MSG_ZEROCOPY, which we stop
+    // passing.  Buffers already sent are released as completions arrive.
+    zeroCopyEnabled_ = false;
+    return true;
+  }
+#ifdef THRIFT_HAVE_MSG_ZEROCOPY
+  if (fd_ == -1) {
+    return false;
+  }
+  int val = 1;
+  if (setSockOpt(SOL_SOCKET, SO_ZEROCOPY, &val) != 0) {
+    VLOG(2) << "TAsyncSocket::setZeroCopy(): error setting SO_ZEROCOPY on "
+            << fd_ << ": errno=" << errno;
+    return false;
+  }
+  zeroCopyEnabled_ = true;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void TAsyncSocket::holdZeroCopyBuf(unique_ptr<IOBuf>&& buf) {
+  ZeroCopyBuf held;
+  held.seq = zeroCopySeq_ - 1;
+  held.buf = std::move(buf);
+  zeroCopyBufs_.push_back(std::move(held));
+  scheduleZeroCopyPoll();
+}
+
+void TAsyncSocket::handleZeroCopyCompletions() noexcept {
+  if (fd_ != -1) {
+    readZeroCopyCompletions(fd_, &zeroCopyBufs_);
+  }
+  scheduleZeroCopyPoll();
+}
+
+void TAsyncSocket::scheduleZeroCopyPoll() {
+  if (zeroCopyBufs_.empty() || fd_ == -1) {
+    zeroCopyTimeout_.cancelTimeout();
+  } else if (eventBase_ != nullptr && !zeroCopyTimeout_.isScheduled()) {
+    // Also covers the sockets that are not registered for any event, and
+    // so would not wake up for the completions
+    zeroCopyTimeout_.scheduleTimeout(kZeroCopyPollInterval);
+  }
+}
+
+void TAsyncSocket::readZeroCopyCompletions(
+    int fd, std::deque<ZeroCopyBuf>* bufs) noexcept {
+#ifdef THRIFT_HAVE_MSG_ZEROCOPY
+  while (!bufs->empty()) {
+    char control[CMSG_SPACE(sizeof(struct sock_extended_err)) +
+                 CMSG_SPACE(sizeof(struct sockaddr_in6))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+      // EAGAIN: nothing left in the error queue
+      return;
+    }
+
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+            (cmsg->cmsg_level == SOL_IPV6 &&
+             cmsg->cmsg_type == IPV6_RECVERR))) {
+        continue;
+      }
+      const struct sock_extended_err* err =
+        reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(cmsg));
+      if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+        continue;
+      }
+      // Sends ee_info through ee_data are done.  TCP completes them in
+      // order, so everything up to ee_data can go.
+      uint32_t last = err->ee_data;
+      while (!bufs->empty() && int32_t(bufs->front().seq - last) <= 0) {
+        bufs->pop_front();
+      }
+    }
+  }
+#endif
 }
 
 std::ostream& operator << (std::ostream& os,
@@ -26,6 +26,7 @@
 #include <thrift/lib/cpp/async/TAsyncTransport.h>
 #include <thrift/lib/cpp/async/TEventHandler.h>
 
+#include <deque>
 #include <memory>
 #include <map>
 
@@ -309,6 +310,72 @@ class TAsyncSocket : public TAsyncTransport {
     return maxReadsPerEvent_;
   }
 
+  /**
+   * Default for setZeroCopyThreshold().  Below a few pages, pinning the
+   * pages and reading the completion costs more than the copy it saves.
+   */
+  static const size_t kDefaultZeroCopyThreshold = 32768;
+
+  /**
+   * How often the error queue is read while zero copy sends are pending.
+   * Completions only wake up the socket while it is registered for events.
+   */
+  static const uint32_t kZeroCopyPollInterval = 10;
+
+  /**
+   * How long a closed socket waits for its zero copy completions, so that
+   * a peer that stops reading does not hold the file descriptor forever.
+   */
+  static const uint32_t kZeroCopyMaxLinger = 120000;
+
+  /**
+   * Enable or disable zero copy writes.
+   *
+   * When enabled, writeChain() sends chains of at least the zero copy
+   * threshold (or with WriteFlags::ZEROCOPY) with MSG_ZEROCOPY: the kernel
+   * sends straight from the IOBufs instead of copying them.  The socket
+   * keeps a reference to the chain after writeSuccess() until the kernel
+   * reports on the socket's error queue that it is done with the pages, so
+   * the data must not be modified in place after writeChain().  The error
+   * queue is read when the socket is ready for reading or writing, before
+   * each zero copy write, and every kZeroCopyPollInterval milliseconds
+   * while sends are pending.  Closing the socket with sends pending keeps
+   * the file descriptor open, and the chains alive, until their
+   * completions arrive (or for at most kZeroCopyMaxLinger milliseconds).
+   * write() and writev() always copy.
+   *
+   * Must be called once the socket has a file descriptor.
+   *
+   * @return Returns false if zero copy could not be enabled (the kernel
+   *         does not support SO_ZEROCOPY, or there is no socket yet); the
+   *         socket then keeps copying.
+   */
+  bool setZeroCopy(bool enable);
+
+  bool getZeroCopy() const {
+    return zeroCopyEnabled_;
+  }
+
+  /**
+   * Smallest chain, in bytes, that writeChain() sends with MSG_ZEROCOPY
+   * when zero copy is enabled.
+   */
+  void setZeroCopyThreshold(size_t threshold) {
+    zeroCopyThreshold_ = threshold;
+  }
+
+  size_t getZeroCopyThreshold() const {
+    return zeroCopyThreshold_;
+  }
+
+  /**
+   * Number of zero copy sends whose buffers the kernel has not released
+   * yet.
+   */
+  size_t getZeroCopyPending() const {
+    return zeroCopyBufs_.size();
+  }
+
   // Methods inherited from TAsyncTransport
   // See the documentation in TAsyncTransport.h
   void setReadCallback(ReadCallback* callback) override;
@@ -509,6 +576,22 @@ class TAsyncSocket : public TAsyncTransport {
     TAsyncSocket* socket_;
   };
 
+  class ZeroCopyTimeout : public TAsyncTimeout {
+   public:
+    ZeroCopyTimeout(TAsyncSocket* socket, TEventBase* eventBase)
+      : TAsyncTimeout(eventBase)
+      , socket_(socket) {}
+
+    virtual void timeoutExpired() noexcept {
+      socket_->handleZeroCopyCompletions();
+    }
+
+   private:
+    TAsyncSocket* socket_;
+  };
+
+  class ZeroCopyLinger;
+
   class IoHandler : public TEventHandler {
    public:
     IoHandler(TAsyncSocket* socket, TEventBase* eventBase)
@@ -603,6 +686,35 @@ class TAsyncSocket : public TAsyncTransport {
                                WriteFlags flags, uint32_t* countWritten,
                                uint32_t* partialWritten);
 
+  struct ZeroCopyBuf {
+    uint32_t seq;                       ///< Last zero copy send of buf
+    std::unique_ptr<folly::IOBuf> buf;
+  };
+
+  /**
+   * Keep buf alive until the kernel completes the last zero copy send.
+   * Called after performWrite() has sent part of buf with MSG_ZEROCOPY.
+   */
+  void holdZeroCopyBuf(std::unique_ptr<folly::IOBuf>&& buf);
+
+  /**
+   * Read the zero copy completions from the socket's error queue and
+   * release the buffers they cover.
+   */
+  void handleZeroCopyCompletions() noexcept;
+
+  /**
+   * Poll the error queue while zero copy sends are pending.
+   */
+  void scheduleZeroCopyPoll();
+
+  /**
+   * Read the zero copy completions from fd's error queue, and drop the
+   * buffers of bufs they cover.
+   */
+  static void readZeroCopyCompletions(int fd,
+                                      std::deque<ZeroCopyBuf>* bufs) noexcept;
+
   bool updateEventRegistration();
 
   /**
@@ -620,7 +732,7 @@ class TAsyncSocket : public TAsyncTransport {
 
   // Actually close the file descriptor and set it to -1 so we don't
   // accidentally close it again.
-  void doClose();
+  virtual void doClose();
 
   // error handling methods
   void startFail();
@@ -649,6 +761,7 @@ class TAsyncSocket : public TAsyncTransport {
   TEventBase* eventBase_;               ///< The TEventBase
   WriteTimeout writeTimeout_;           ///< A timeout for connect and write
   IoHandler ioHandler_;                 ///< A TEventHandler to monitor the fd
+  ZeroCopyTimeout zeroCopyTimeout_;     ///< Polls for zero copy completions
 
   ConnectCallback* connectCallback_;    ///< ConnectCallback
   ReadCallback* readCallback_;          ///< ReadCallback
@@ -657,6 +770,11 @@ class TAsyncSocket : public TAsyncTransport {
   ShutdownSocketSet* shutdownSocketSet_;
   size_t appBytesReceived_;             ///< Num of bytes received from socket
   size_t appBytesWritten_;              ///< Num of bytes written to socket
+
+  bool zeroCopyEnabled_;                ///< SO_ZEROCOPY is set
+  size_t zeroCopyThreshold_;            ///< Min chain size sent zero copy
+  uint32_t zeroCopySeq_;                ///< Zero copy sends so far
+  std::deque<ZeroCopyBuf> zeroCopyBufs_; ///< Chains the kernel still uses
 };
 
 
@@ -53,6 +53,12 @@ enum class WriteFlags : uint32_t {
    * will be acknowledged.
    */
   EOR = 0x02,
+  /*
+   * Send the data with MSG_ZEROCOPY instead of copying it into the kernel.
+   * Only honored by writeChain() on a TAsyncSocket with zero copy enabled,
+   * which also sets it on chains of at least the zero copy threshold.
+   */
+  ZEROCOPY = 0x04,
 };
 
 /*
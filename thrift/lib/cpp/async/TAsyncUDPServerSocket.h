@@ -74,6 +74,7 @@ class TAsyncUDPServerSocket : private TAsyncUDPSocket::ReadCallback {
   explicit TAsyncUDPServerSocket(TEventBase* evb, size_t sz = 1500)
       : evb_(evb),
         packetSize_(sz),
+        readBatchSize_(0),
         nextListener_(0) {
   }
 
@@ -88,6 +89,20 @@ class TAsyncUDPServerSocket : private TAsyncUDPSocket::ReadCallback {
 
     socket_ = folly::make_unique<TAsyncUDPSocket>(evb_);
     socket_->bind(address);
+    socket_->setReadBatch(readBatchSize_, packetSize_);
+  }
+
+  /**
+   * Read up to batchSize packets per ::recvmmsg (see
+   * TAsyncUDPSocket::setReadBatch()), and hand each listener its share of
+   * a batch with a single runInEventBaseThread().  0 or 1 reads one packet
+   * at a time.
+   */
+  void setReadBatch(size_t batchSize) {
+    readBatchSize_ = batchSize;
+    if (socket_) {
+      socket_->setReadBatch(readBatchSize_, packetSize_);
+    }
   }
 
   transport::TSocketAddress address() const {
@@ -164,6 +179,47 @@ class TAsyncUDPServerSocket : private TAsyncUDPSocket::ReadCallback {
     ++nextListener_;
   }
 
+  void onDataBatchAvailable(const TAsyncUDPSocket::Datagram* datagrams,
+                            size_t count) noexcept {
+    if (listeners_.empty()) {
+      LOG(WARNING) << "UDP server socket dropping " << count << " packets, "
+                   << "no listener registered";
+      return;
+    }
+
+    // Packets still go round robin, but each listener gets one callback
+    // into its event base per batch instead of one per packet
+    std::vector<std::vector<Packet>> batches(listeners_.size());
+    for (size_t i = 0; i < count; ++i) {
+      if (nextListener_ >= listeners_.size()) {
+        nextListener_ = 0;
+      }
+      Packet packet;
+      packet.client = datagrams[i].client;
+      packet.data = folly::IOBuf::copyBuffer(datagrams[i].data,
+                                             datagrams[i].len);
+      packet.truncated = datagrams[i].truncated;
+      batches[nextListener_].push_back(std::move(packet));
+      ++nextListener_;
+    }
+
+    for (size_t i = 0; i < batches.size(); ++i) {
+      if (batches[i].empty()) {
+        continue;
+      }
+      auto callback = listeners_[i].second;
+      auto mvp = folly::makeMoveWrapper(std::move(batches[i]));
+      std::function<void()> f = [callback, mvp] () mutable {
+        for (auto& packet : *mvp) {
+          callback->onDataAvailable(packet.client,
+                                    std::move(packet.data),
+                                    packet.truncated);
+        }
+      };
+      listeners_[i].first->runInEventBaseThread(f);
+    }
+  }
+
   void onReadError(const transport::TTransportException& ex) noexcept {
     LOG(ERROR) << ex.what();
 
@@ -184,6 +240,15 @@ class TAsyncUDPServerSocket : private TAsyncUDPSocket::ReadCallback {
   TEventBase* const evb_;
   const size_t packetSize_;
 
+  // Packets per ::recvmmsg, 0 if reads are not batched
+  size_t readBatchSize_;
+
+  struct Packet {
+    transport::TSocketAddress client;
+    std::unique_ptr<folly::IOBuf> data;
+    bool truncated;
+  };
+
   std::unique_ptr<TAsyncUDPSocket> socket_;
 
   // List of listener to distribute packets among
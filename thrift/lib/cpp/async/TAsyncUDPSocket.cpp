@@ -20,18 +20,87 @@
 
 #include <thrift/lib/cpp/async/TEventBase.h>
 
+#include <algorithm>
 #include <errno.h>
+#include <limits.h>
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
 using apache::thrift::transport::TTransportException;
 
 namespace apache { namespace thrift { namespace async {
 
+namespace {
+
+// Points msg at address and at the non-empty buffers of buf.  iov must have
+// room for buf->countChainElements() entries.
+void fillMessage(msghdr* msg,
+                 const transport::TSocketAddress& address,
+                 sockaddr_storage* addrStorage,
+                 const folly::IOBuf* buf,
+                 iovec* iov) {
+  address.getAddress(addrStorage);
+  memset(msg, 0, sizeof(*msg));
+  msg->msg_name = addrStorage;
+  msg->msg_namelen = address.getActualSize();
+  msg->msg_iov = iov;
+
+  const folly::IOBuf* next = buf;
+  do {
+    if (next->length() != 0) {
+      iov[msg->msg_iovlen].iov_base = const_cast<uint8_t*>(next->data());
+      iov[msg->msg_iovlen].iov_len = next->length();
+      ++msg->msg_iovlen;
+    }
+    next = next->next();
+  } while (next != buf);
+}
+
+// Number of iovecs fillMessage() needs for buf, coalescing buf if it has
+// more buffers than a single message can take
+size_t prepareIovecs(const std::unique_ptr<folly::IOBuf>& buf) {
+  size_t count = buf->countChainElements();
+  if (count > IOV_MAX) {
+    buf->coalesce();
+    count = 1;
+  }
+  return count;
+}
+
+}
+
+void TAsyncUDPSocket::ReadCallback::onDataBatchAvailable(
+    const Datagram* datagrams, size_t count) noexcept {
+  for (size_t i = 0; i < count; ++i) {
+    void* buf{nullptr};
+    size_t len{0};
+    getReadBuffer(&buf, &len);
+    if (buf == nullptr || len == 0) {
+      onReadError(TTransportException(
+          TTransportException::BAD_ARGS,
+          "TAsyncUDPSocket::getReadBuffer() returned empty buffer"));
+      return;
+    }
+
+    bool truncated = datagrams[i].truncated;
+    size_t copied = datagrams[i].len;
+    if (copied > len) {
+      truncated = true;
+      copied = len;
+    }
+    memcpy(buf, datagrams[i].data, copied);
+    onDataAvailable(datagrams[i].client, copied, truncated);
+  }
+}
+
 TAsyncUDPSocket::TAsyncUDPSocket(TEventBase* evb)
     : TEventHandler(CHECK_NOTNULL(evb)),
       eventBase_(evb),
       fd_(-1),
-      readCallback_(nullptr) {
+      readCallback_(nullptr),
+      readBatchSize_(0) {
   DCHECK(evb->isInEventBaseThread());
 }
 
@@ -111,19 +180,110 @@ ssize_t TAsyncUDPSocket::write(const transport::TSocketAddress& address,
                                const std::unique_ptr<folly::IOBuf>& buf) {
   CHECK_NE(-1, fd_) << "Socket not yet bound";
 
-  // XXX: Use `sendmsg` instead of coalescing here
-  buf->coalesce();
+  writeIovecs_.resize(prepareIovecs(buf));
+  sockaddr_storage addrStorage;
+  msghdr msg;
+  fillMessage(&msg, address, &addrStorage, buf.get(), writeIovecs_.data());
 
+  return ::sendmsg(fd_, &msg, MSG_DONTWAIT);
+}
+
+int TAsyncUDPSocket::writeBatch(const transport::TSocketAddress* addrs,
+                                const std::unique_ptr<folly::IOBuf>* bufs,
+                                size_t count) {
+  CHECK_NE(-1, fd_) << "Socket not yet bound";
+
+  size_t iovCount = 0;
+  for (size_t i = 0; i < count; ++i) {
+    iovCount += prepareIovecs(bufs[i]);
+  }
+  writeMsgs_.resize(count);
+  writeAddrs_.resize(count);
+  writeIovecs_.resize(iovCount);
+
+  iovec* iov = writeIovecs_.data();
+  for (size_t i = 0; i < count; ++i) {
+    msghdr* msg = &writeMsgs_[i].msg_hdr;
+    fillMessage(msg, addrs[i], &writeAddrs_[i], bufs[i].get(), iov);
+    writeMsgs_[i].msg_len = 0;
+    iov += msg->msg_iovlen;
+  }
+
+  return ::sendmmsg(fd_, writeMsgs_.data(), count, MSG_DONTWAIT);
+}
+
+ssize_t TAsyncUDPSocket::writeGSO(const transport::TSocketAddress& address,
+                                  const std::unique_ptr<folly::IOBuf>& buf,
+                                  uint16_t segmentSize) {
+  CHECK_NE(-1, fd_) << "Socket not yet bound";
+  CHECK_GT(segmentSize, 0);
+
+#ifdef UDP_SEGMENT
+  writeIovecs_.resize(prepareIovecs(buf));
   sockaddr_storage addrStorage;
-  address.getAddress(&addrStorage);
-  sockaddr* saddr = reinterpret_cast<sockaddr*>(&addrStorage);
+  msghdr msg;
+  fillMessage(&msg, address, &addrStorage, buf.get(), writeIovecs_.data());
+
+  char control[CMSG_SPACE(sizeof(uint16_t))];
+  memset(control, 0, sizeof(control));
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_UDP;
+  cmsg->cmsg_type = UDP_SEGMENT;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+  memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof(segmentSize));
+
+  return ::sendmsg(fd_, &msg, MSG_DONTWAIT);
+#else
+  // Split it ourselves; the slices only need to live through writeBatch()
+  buf->coalesce();
+  std::vector<std::unique_ptr<folly::IOBuf>> segments;
+  for (size_t offset = 0; offset < buf->length(); offset += segmentSize) {
+    size_t len = std::min<size_t>(segmentSize, buf->length() - offset);
+    segments.push_back(folly::IOBuf::wrapBuffer(buf->data() + offset, len));
+  }
+  std::vector<transport::TSocketAddress> addrs(segments.size(), address);
+  int sent = writeBatch(addrs.data(), segments.data(), segments.size());
+  if (sent < 0) {
+    return -1;
+  }
+  ssize_t bytes = 0;
+  for (int i = 0; i < sent; ++i) {
+    bytes += segments[i]->length();
+  }
+  return bytes;
+#endif
+}
 
-  return ::sendto(fd_,
-                  buf->data(),
-                  buf->length(),
-                  MSG_DONTWAIT,
-                  saddr,
-                  address.getActualSize());
+void TAsyncUDPSocket::setReadBatch(size_t batchSize, size_t datagramSize) {
+  if (batchSize <= 1) {
+    readBatchSize_ = 0;
+    readBatchBuf_.reset();
+    readMsgs_.clear();
+    readIovecs_.clear();
+    readAddrs_.clear();
+    readDatagrams_.clear();
+    return;
+  }
+  CHECK_GT(datagramSize, 0);
+
+  readBatchSize_ = batchSize;
+  readBatchBuf_.reset(new uint8_t[batchSize * datagramSize]);
+  readMsgs_.resize(batchSize);
+  readIovecs_.resize(batchSize);
+  readAddrs_.resize(batchSize);
+  readDatagrams_.resize(batchSize);
+  for (size_t i = 0; i < batchSize; ++i) {
+    readIovecs_[i].iov_base = readBatchBuf_.get() + i * datagramSize;
+    readIovecs_[i].iov_len = datagramSize;
+
+    msghdr* msg = &readMsgs_[i].msg_hdr;
+    memset(msg, 0, sizeof(*msg));
+    msg->msg_name = &readAddrs_[i];
+    msg->msg_iov = &readIovecs_[i];
+    msg->msg_iovlen = 1;
+  }
 }
 
 void TAsyncUDPSocket::resumeRead(ReadCallback* cob) {
@@ -175,6 +335,11 @@ void TAsyncUDPSocket::handlerReady(uint16_t events) noexcept {
 }
 
 void TAsyncUDPSocket::handleRead() noexcept {
+  if (readBatchSize_ > 0) {
+    handleReadBatch();
+    return;
+  }
+
   void* buf{nullptr};
   size_t len{0};
 
@@ -193,8 +358,8 @@ void TAsyncUDPSocket::handleRead() noexcept {
     return;
   }
 
-  socklen_t addrLen;
   sockaddr_storage addrStorage;
+  socklen_t addrLen = sizeof(addrStorage);
   struct sockaddr* rawAddr = reinterpret_cast<sockaddr*>(&addrStorage);
   rawAddr->sa_family = localAddress_.getFamily();
 
@@ -232,6 +397,53 @@ void TAsyncUDPSocket::handleRead() noexcept {
   }
 }
 
+void TAsyncUDPSocket::handleReadBatch() noexcept {
+  for (auto& msg : readMsgs_) {
+    msg.msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+  }
+
+  int count = ::recvmmsg(fd_, readMsgs_.data(), readBatchSize_,
+                         MSG_DONTWAIT, nullptr);
+  if (count < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      // No data could be read without blocking the socket
+      return;
+    }
+
+    TTransportException ex(TTransportException::INTERNAL_ERROR,
+                           "::recvmmsg() failed",
+                           errno);
+
+    // As with single reads, the caller can resume reading
+    auto cob = readCallback_;
+    readCallback_ = nullptr;
+
+    cob->onReadError(ex);
+    updateRegistration();
+    return;
+  }
+
+  // Empty datagrams are dropped, as with single reads
+  size_t delivered = 0;
+  for (int i = 0; i < count; ++i) {
+    const mmsghdr& msg = readMsgs_[i];
+    if (msg.msg_len == 0) {
+      continue;
+    }
+    Datagram& datagram = readDatagrams_[delivered++];
+    datagram.client.setFromSockaddr(
+      reinterpret_cast<const sockaddr*>(&readAddrs_[i]),
+      msg.msg_hdr.msg_namelen);
+    datagram.data = static_cast<const uint8_t*>(readIovecs_[i].iov_base);
+    datagram.len = msg.msg_len;
+    datagram.truncated = (msg.msg_hdr.msg_flags & MSG_TRUNC) != 0;
+  }
+
+  if (delivered > 0) {
+    readCallback_->onDataBatchAvailable(readDatagrams_.data(), delivered);
+  }
+}
+
 bool TAsyncUDPSocket::updateRegistration() noexcept {
   uint16_t flags = NONE;
 
@@ -26,6 +26,9 @@
 #include <thrift/lib/cpp/transport/TSocketAddress.h>
 
 #include <memory>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
 namespace apache { namespace thrift { namespace async {
 
@@ -39,6 +42,16 @@ class TAsyncUDPSocket : public TEventHandler {
     SHARED
   };
 
+  /**
+   * A datagram read by a batched read, see setReadBatch()
+   */
+  struct Datagram {
+    transport::TSocketAddress client;
+    const uint8_t* data;
+    size_t len;
+    bool truncated;
+  };
+
   class ReadCallback {
    public:
     /**
@@ -60,6 +73,19 @@ class TAsyncUDPSocket : public TEventHandler {
                                  size_t len,
                                  bool truncated) noexcept = 0;
 
+    /**
+     * Invoked instead of getReadBuffer()/onDataAvailable() when reads are
+     * batched (see setReadBatch()), with the datagrams read by a single
+     * recvmmsg().  Their data lives in buffers owned by the socket, which
+     * are reused for the next batch: it is only valid until this returns.
+     * The socket must not be destroyed from within this call.
+     *
+     * The default copies each datagram into getReadBuffer() and passes it
+     * on to onDataAvailable(), so any callback can be used with batching.
+     */
+    virtual void onDataBatchAvailable(const Datagram* datagrams,
+                                      size_t count) noexcept;
+
     /**
      * Invoked when there is an error reading from the socket.
      *
@@ -116,6 +142,36 @@ class TAsyncUDPSocket : public TEventHandler {
   ssize_t write(const transport::TSocketAddress& address,
                 const std::unique_ptr<folly::IOBuf>& buf);
 
+  /**
+   * Send bufs[i] to addrs[i] for each of the count datagrams, with a single
+   * ::sendmmsg.  Returns the number of datagrams sent, which is less than
+   * count if the socket buffer fills up, or -1 if none could be sent.
+   */
+  int writeBatch(const transport::TSocketAddress* addrs,
+                 const std::unique_ptr<folly::IOBuf>* bufs,
+                 size_t count);
+
+  /**
+   * Send buf to address as datagrams of segmentSize bytes each (the last
+   * one may be shorter) with a single ::sendmsg, and let the kernel or the
+   * NIC split it (UDP generic segmentation offload).  buf must be under
+   * 64KB and 64 segments.  Where UDP_SEGMENT is not available, the
+   * datagrams are sent with writeBatch().  Returns the number of bytes
+   * sent, or -1 on error.
+   */
+  ssize_t writeGSO(const transport::TSocketAddress& address,
+                   const std::unique_ptr<folly::IOBuf>& buf,
+                   uint16_t segmentSize);
+
+  /**
+   * Read up to batchSize datagrams of at most datagramSize bytes each with
+   * a single ::recvmmsg per read event, into a ring of buffers allocated
+   * here and reused for every batch, and deliver them with
+   * ReadCallback::onDataBatchAvailable().  A batchSize of 0 or 1 goes
+   * back to reading one datagram per event into getReadBuffer().
+   */
+  void setReadBatch(size_t batchSize, size_t datagramSize);
+
   /**
    * Start reading datagrams
    */
@@ -146,6 +202,7 @@ class TAsyncUDPSocket : public TEventHandler {
   void handlerReady(uint16_t events) noexcept;
 
   void handleRead() noexcept;
+  void handleReadBatch() noexcept;
   bool updateRegistration() noexcept;
 
   TEventBase* eventBase_;
@@ -159,6 +216,20 @@ class TAsyncUDPSocket : public TEventHandler {
 
   // Non-null only when we are reading
   ReadCallback* readCallback_;
+
+  // Batched reads, see setReadBatch().  readBatchSize_ is 0 when reads
+  // are not batched.
+  size_t readBatchSize_;
+  std::unique_ptr<uint8_t[]> readBatchBuf_;
+  std::vector<mmsghdr> readMsgs_;
+  std::vector<iovec> readIovecs_;
+  std::vector<sockaddr_storage> readAddrs_;
+  std::vector<Datagram> readDatagrams_;
+
+  // Scratch space for write(), writeBatch() and writeGSO()
+  std::vector<mmsghdr> writeMsgs_;
+  std::vector<iovec> writeIovecs_;
+  std::vector<sockaddr_storage> writeAddrs_;
 };
 
 }}}
@@ -127,6 +127,10 @@ void NumaThreadFactory::setNumaNode() {
 __thread int NumaThreadFactory::node_{-1};
 int NumaThreadFactory::workerNode_{0};
 
+int NumaThreadFactory::getNumaNodeCount() {
+  return isNumaEnabled() ? numa_max_node() + 1 : 1;
+}
+
 int NumaThreadFactory::getNumaNode() {
   auto data = RequestContext::get()->getContextData(
     NumaContextData::ContextDataVal);
@@ -144,16 +148,21 @@ int NumaThreadFactory::getNumaNode() {
 
 std::shared_ptr<Thread> NumaThreadFactory::newThread(
   const std::shared_ptr<Runnable>& runnable) const {
-  return PosixThreadFactory::newThread(
-    std::make_shared<NumaRunnable>(setNode_, runnable));
+  auto numaRunnable = std::make_shared<NumaRunnable>(setNode_, runnable);
+  if (baseFactory_) {
+    return baseFactory_->newThread(numaRunnable);
+  }
+  return PosixThreadFactory::newThread(numaRunnable);
 }
 
 std::shared_ptr<Thread> NumaThreadFactory::newThread(
   const std::shared_ptr<Runnable>& runnable,
   DetachState detachState) const {
-  return PosixThreadFactory::newThread(
-    std::make_shared<NumaRunnable>(setNode_, runnable),
-    detachState);
+  auto numaRunnable = std::make_shared<NumaRunnable>(setNode_, runnable);
+  if (baseFactory_) {
+    return baseFactory_->newThread(numaRunnable, detachState);
+  }
+  return PosixThreadFactory::newThread(numaRunnable, detachState);
 }
 
 NumaThreadManager::NumaThreadManager(size_t normalThreadsCount,
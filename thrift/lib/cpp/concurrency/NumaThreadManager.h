@@ -28,9 +28,15 @@ class NumaThreadFactory : public PosixThreadFactory {
  public:
   // if setNode is -1, threads will be round robin spread
   // over nodes.  Otherwise, all threads will be created on
-  // setNode node.
-  explicit NumaThreadFactory(int setNode = -1)
-      : setNode_(setNode) {}
+  // setNode node.  The threads themselves are created by
+  // baseFactory if given, so its settings (stack size,
+  // priority, ...) still apply; by this PosixThreadFactory
+  // otherwise.
+  explicit NumaThreadFactory(
+    int setNode = -1,
+    std::shared_ptr<ThreadFactory> baseFactory = nullptr)
+      : setNode_(setNode)
+      , baseFactory_(std::move(baseFactory)) {}
 
   // Overridden methods to implement numa binding
   std::shared_ptr<Thread> newThread(
@@ -50,10 +56,28 @@ class NumaThreadFactory : public PosixThreadFactory {
   // the current node.
   static void setNumaNode();
 
+  // Node the calling thread is bound to, or -1 if it was not started by a
+  // NumaThreadFactory (or NUMA is disabled).  Unlike getNumaNode(), this
+  // ignores the request context.
+  static int getThreadNumaNode() {
+    return node_;
+  }
+
+  // Number of nodes threads are spread over: 1 unless NUMA is available
+  // and --thrift_numa_enabled is set.
+  static int getNumaNodeCount();
+
+  // Node of the index-th thread of a set spread evenly over nodes nodes,
+  // or -1 (no binding) if there is only one node.
+  static int getSpreadNode(size_t index, int nodes) {
+    return nodes > 1 ? index % nodes : -1;
+  }
+
  private:
   friend class NumaRunnable;
 
   int setNode_{-1};
+  std::shared_ptr<ThreadFactory> baseFactory_;
   static __thread int node_;
   static int workerNode_;
 };
@@ -89,7 +89,8 @@ class ThreadManager::ImplT : public ThreadManager  {
  public:
   ImplT(size_t pendingTaskCountMaxArg = 0,
        bool enableTaskStats = false,
-       size_t maxQueueLen = 0) :
+       size_t maxQueueLen = 0,
+       size_t numQueues = 1) :
     workerCount_(0),
     intendedWorkerCount_(0),
     idleCount_(0),
@@ -103,15 +104,9 @@ class ThreadManager::ImplT : public ThreadManager  {
     executingTimeUs_(0),
     numTasks_(0),
     state_(ThreadManager::UNINITIALIZED),
-    tasks_(maxQueueLen == 0
-             ? (pendingTaskCountMax_ > 0
-                  // TODO(philipp): Fix synchronization issues between "pending"
-                  // and queuing logic.  For now, if pendingTaskCountMax_ > 0,
-                  // let's have more room in the queue to avoid issues in most
-                  // of cases.
-                  ? pendingTaskCountMax_ + 1024
-                  : ThreadManager::DEFAULT_MAX_QUEUE_SIZE)
-             : maxQueueLen),
+    nextWorkerQueue_(0),
+    stopTasks_(0),
+    maxWaiters_(0),
     monitor_(&mutex_),
     maxMonitor_(&mutex_),
     deadWorkerMonitor_(&mutex_),
@@ -119,6 +114,20 @@ class ThreadManager::ImplT : public ThreadManager  {
     namePrefix_(""),
     namePrefixCounter_(0),
     codelEnabled_(false || FLAGS_codel_enabled) {
+      size_t capacity = maxQueueLen == 0
+        ? (pendingTaskCountMax_ > 0
+           // TODO(philipp): Fix synchronization issues between "pending"
+           // and queuing logic.  For now, if pendingTaskCountMax_ > 0,
+           // let's have more room in the queue to avoid issues in most
+           // of cases.
+           ? pendingTaskCountMax_ + 1024
+           : ThreadManager::DEFAULT_MAX_QUEUE_SIZE)
+        : maxQueueLen;
+      numQueues = std::max<size_t>(numQueues, 1);
+      for (size_t i = 0; i < numQueues; ++i) {
+        queues_.emplace_back(new folly::MPMCQueue<Task*>(
+          std::max<size_t>(capacity / numQueues, 1)));
+      }
       RequestContext::getStaticContext();
   }
 
@@ -167,7 +176,7 @@ class ThreadManager::ImplT : public ThreadManager  {
   }
 
   size_t pendingTaskCount() const {
-    return tasks_.size();
+    return queuedTaskCount();
   }
 
   size_t totalTaskCount() const {
@@ -210,7 +219,7 @@ class ThreadManager::ImplT : public ThreadManager  {
   void reportTaskStats(const SystemClockTimePoint& queueBegin,
                        const SystemClockTimePoint& workBegin,
                        const SystemClockTimePoint& workEnd);
-  Task* waitOnTask();
+  Task* waitOnTask(size_t queue);
   void taskExpired(Task* task);
 
   Codel codel_;
@@ -221,6 +230,12 @@ class ThreadManager::ImplT : public ThreadManager  {
   void maybeNotifyMaxMonitor(bool shouldLock);
   bool shouldStop();
 
+  // Queue operations over all of queues_, starting at the given queue
+  bool writeTask(Task* task, size_t queue);
+  bool readTask(Task*& task, size_t queue);
+  bool takeTask(Task*& task, size_t queue);
+  size_t queuedTaskCount() const;
+
   size_t workerCount_;
   // intendedWorkerCount_ tracks the number of worker threads that we currently
   // want to have.  This may be different from workerCount_ while we are
@@ -246,7 +261,14 @@ class ThreadManager::ImplT : public ThreadManager  {
   ThreadManager::STATE state_;
   shared_ptr<ThreadFactory> threadFactory_;
 
-  folly::MPMCQueue<Task*> tasks_;
+  // A single queue, or one per worker in work stealing mode.  Workers read
+  // their own queue first and steal from the others when it is empty.
+  std::vector<std::unique_ptr<folly::MPMCQueue<Task*>>> queues_;
+  std::atomic<size_t> nextWorkerQueue_;
+  // Number of nullptr tasks queued by join() to stop workers
+  std::atomic<size_t> stopTasks_;
+  // Number of threads blocked in add() on maxMonitor_
+  std::atomic<size_t> maxWaiters_;
 
   Mutex mutex_;
   // monitor_ is signaled on any of the following events:
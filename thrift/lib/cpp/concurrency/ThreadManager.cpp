@@ -59,6 +59,9 @@ using apache::thrift::async::RequestContext;
 
 folly::RWSpinLock ThreadManager::observerLock_;
 std::shared_ptr<ThreadManager::Observer> ThreadManager::observer_;
+__thread const ThreadManager* ThreadManager::workerManager_ = nullptr;
+__thread size_t ThreadManager::workerQueue_ = 0;
+__thread size_t ThreadManager::producerQueue_ = 0;
 
 shared_ptr<ThreadManager> ThreadManager::newThreadManager() {
   return make_shared<ThreadManager::Impl>();
@@ -220,6 +220,20 @@ class ThreadManager {
                            bool enableTaskStats = false,
                            size_t maxQueueLen = 0);
 
+  /**
+   * Like newSimpleThreadManager, but with a task queue per worker thread
+   * instead of one shared by all of them.  Workers take tasks from their
+   * own queue and steal from the others when it is empty, and tasks added
+   * from a worker thread go to its own queue.  This avoids contention on
+   * the queue with many threads, at the cost of strict FIFO order.
+   */
+  template <typename SemType = folly::LifoSem>
+  static std::shared_ptr<ThreadManager>
+    newWorkStealingThreadManager(size_t count = 4,
+                                 size_t pendingTaskCountMax = 0,
+                                 bool enableTaskStats = false,
+                                 size_t maxQueueLen = 0);
+
   /**
    * Get an internal statistics.
    *
@@ -256,6 +270,12 @@ class ThreadManager {
  protected:
   static folly::RWSpinLock observerLock_;
   static std::shared_ptr<Observer> observer_;
+
+  // Manager and queue of the worker running on this thread, if any, and
+  // the next queue to add to from other threads; see ImplT::add()
+  static __thread const ThreadManager* workerManager_;
+  static __thread size_t workerQueue_;
+  static __thread size_t producerQueue_;
 };
 
 /**
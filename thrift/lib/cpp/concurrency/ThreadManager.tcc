@@ -27,6 +27,7 @@
 #include <folly/MPMCQueue.h>
 #include <thrift/lib/cpp/async/Request.h>
 #include <folly/Logging.h>
+#include <folly/ScopeGuard.h>
 
 #include <memory>
 
@@ -34,6 +35,8 @@
 #include <queue>
 #include <set>
 #include <atomic>
+#include <algorithm>
+#include <vector>
 
 #if defined(DEBUG)
 #include <iostream>
@@ -64,8 +67,9 @@ template <typename SemType>
 template <typename SemTypeT>
 class ThreadManager::ImplT<SemType>::Worker : public Runnable {
  public:
-  Worker(ThreadManager::ImplT<SemTypeT>* manager) :
-    manager_(manager) {}
+  Worker(ThreadManager::ImplT<SemTypeT>* manager, size_t queue) :
+    manager_(manager),
+    queue_(queue) {}
 
   ~Worker() {}
 
@@ -78,13 +82,16 @@ class ThreadManager::ImplT<SemType>::Worker : public Runnable {
   void run() {
     // Inform our manager that we are starting
     manager_->workerStarted(this);
+    workerManager_ = manager_;
+    workerQueue_ = queue_;
 
     while (true) {
       // Wait for a task to run
-      Task* task = manager_->waitOnTask();
+      Task* task = manager_->waitOnTask(queue_);
 
       // A nullptr task means that this thread is supposed to exit
       if (!task) {
+        workerManager_ = nullptr;
         manager_->workerExiting(this);
         return;
       }
@@ -143,12 +150,15 @@ class ThreadManager::ImplT<SemType>::Worker : public Runnable {
 
  private:
   ThreadManager::ImplT<SemType>* manager_;
+  // Queue this worker reads first and adds its own tasks to
+  const size_t queue_;
 };
 
 template <typename SemType>
 void ThreadManager::ImplT<SemType>::addWorker(size_t value) {
   for (size_t ix = 0; ix < value; ix++) {
-    auto worker = make_shared<Worker<SemType>>(this);
+    auto worker = make_shared<Worker<SemType>>(
+      this, nextWorkerQueue_++ % queues_.size());
     auto thread = threadFactory_->newThread(worker,
                                             ThreadFactory::ATTACHED);
     {
@@ -242,17 +252,18 @@ void ThreadManager::ImplT<SemType>::stopImpl(bool joinArg) {
     if (joinArg) {
       state_ = ThreadManager::JOINING;
       removeWorkerImpl(intendedWorkerCount_, true);
-      assert(tasks_.isEmpty());
+      assert(queuedTaskCount() == 0);
     } else {
       state_ = ThreadManager::STOPPING;
       removeWorkerImpl(intendedWorkerCount_);
       // Empty the task queue, in case we stopped without running
       // all of the tasks.
-      totalTaskCount_ -= tasks_.size();
+      totalTaskCount_ -= queuedTaskCount();
       Task* task;
-      while (tasks_.read(task)) {
+      while (readTask(task, 0)) {
         delete task;
       }
+      stopTasks_ = 0;
     }
     state_ = ThreadManager::STOPPED;
     monitor_.notifyAll();
@@ -291,11 +302,12 @@ void ThreadManager::ImplT<SemType>::removeWorkerImpl(size_t value, bool afterTas
     // after all current tasks are completed
     size_t bad = 0;
     for (size_t n = 0; n < value; ++n) {
-      if (!tasks_.write(nullptr)) {
+      if (!writeTask(nullptr, n)) {
         T_ERROR("ThreadManager: Can't remove worker. Increase maxQueueLen?");
         bad++;
         continue;
       }
+      ++stopTasks_;
       ++totalTaskCount_;
     }
     monitor_.notifyAll();
@@ -349,15 +361,22 @@ void ThreadManager::ImplT<SemType>::add(shared_ptr<Runnable> value,
                                 "not started");
   }
 
-  if (pendingTaskCountMax_ > 0 && (tasks_.size() >= pendingTaskCountMax_)) {
+  if (pendingTaskCountMax_ > 0 &&
+      (queuedTaskCount() >= pendingTaskCountMax_)) {
     Guard g(mutex_, timeout);
 
     if (!g) {
       throw TimedOutException();
     }
     if (canSleep() && timeout >= 0) {
+      // Workers only take mutex_ to notify maxMonitor_ while someone waits
+      ++maxWaiters_;
+      folly::ScopeGuard waiterGuard = folly::makeGuard([&] {
+        --maxWaiters_;
+      });
+      std::atomic_thread_fence(std::memory_order_seq_cst);
       while (pendingTaskCountMax_ > 0
-             && tasks_.size() >= pendingTaskCountMax_) {
+             && queuedTaskCount() >= pendingTaskCountMax_) {
         // This is thread safe because the mutex is shared between monitors.
         maxMonitor_.wait(timeout);
       }
@@ -370,7 +389,14 @@ void ThreadManager::ImplT<SemType>::add(shared_ptr<Runnable> value,
   // running and will get around to this task in time.
   Task* task = new ThreadManager::Task(std::move(value),
                                        std::chrono::milliseconds{expiration});
-  if (!tasks_.write(task)) {
+  // With several queues, a worker adding a follow-up task keeps it on its
+  // own queue, where it is likely to run soon on a warm cache; idle workers
+  // steal it otherwise.  Other threads spread their tasks round robin.
+  size_t queue = 0;
+  if (queues_.size() > 1) {
+    queue = workerManager_ == this ? workerQueue_ : producerQueue_++;
+  }
+  if (!writeTask(task, queue)) {
     T_ERROR("ThreadManager: Failed to enqueue item. Increase maxQueueLen?");
     delete task;
     throw TooManyPendingTasksException();
@@ -405,7 +431,7 @@ std::shared_ptr<Runnable> ThreadManager::ImplT<SemType>::removeNextPending() {
   }
 
   ThreadManager::Task* task;
-  if (tasks_.read(task)) {
+  if (readTask(task, 0)) {
     std::shared_ptr<Runnable> r = task->getRunnable();
     delete task;
     --totalTaskCount_;
@@ -432,7 +458,66 @@ bool ThreadManager::ImplT<SemType>::shouldStop() {
 }
 
 template <typename SemType>
-ThreadManager::Task* ThreadManager::ImplT<SemType>::waitOnTask() {
+bool ThreadManager::ImplT<SemType>::writeTask(Task* task, size_t queue) {
+  // Only fall back to the other queues when this one is full
+  size_t n = queues_.size();
+  for (size_t i = 0; i < n; ++i) {
+    if (queues_[(queue + i) % n]->write(task)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename SemType>
+bool ThreadManager::ImplT<SemType>::readTask(Task*& task, size_t queue) {
+  size_t n = queues_.size();
+  for (size_t i = 0; i < n; ++i) {
+    if (queues_[(queue + i) % n]->read(task)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename SemType>
+bool ThreadManager::ImplT<SemType>::takeTask(Task*& task, size_t queue) {
+  while (readTask(task, queue)) {
+    if (task) {
+      return true;
+    }
+    // A stop task from join().  With several queues, tasks queued before
+    // join() may still sit on other queues, so only exit once everything
+    // left is a stop task; otherwise put it back and look further along.
+    --stopTasks_;
+    if (queues_.size() == 1 || queuedTaskCount() == stopTasks_) {
+      return true;
+    }
+    ++stopTasks_;
+    if (!writeTask(nullptr, queue)) {
+      // Cannot happen: we just freed a slot, and add() is refused while
+      // joining.
+      T_ERROR("ThreadManager: Failed to requeue stop task");
+      --stopTasks_;
+      return true;
+    }
+    queue = (queue + 1) % queues_.size();
+  }
+  return false;
+}
+
+template <typename SemType>
+size_t ThreadManager::ImplT<SemType>::queuedTaskCount() const {
+  ssize_t count = 0;
+  for (auto& queue : queues_) {
+    count += queue->size();
+  }
+  // size() is negative while readers wait on an empty queue
+  return count > 0 ? count : 0;
+}
+
+template <typename SemType>
+ThreadManager::Task* ThreadManager::ImplT<SemType>::waitOnTask(size_t queue) {
   if (shouldStop()) {
     return nullptr;
   }
@@ -440,26 +525,20 @@ ThreadManager::Task* ThreadManager::ImplT<SemType>::waitOnTask() {
   ThreadManager::Task* task;
 
   // Fast path - if tasks are ready, get one
-  if (tasks_.read(task)) {
+  if (takeTask(task, queue)) {
     --totalTaskCount_;
     maybeNotifyMaxMonitor(true);
     return task;
   }
 
-  // Otherwise, no tasks on the horizon, so go sleep
-  Guard g(mutex_);
-  if (shouldStop()) {
-    // check again because it might have changed by the time we got the mutex
-    return nullptr;
-  }
-
+  // Otherwise, no tasks on the horizon, so go sleep.  No lock is needed:
+  // add() posts waitSem_ after queueing whenever it sees an idle worker,
+  // and the semaphore keeps the post even if we have not started waiting.
   ++idleCount_;
   --totalTaskCount_;
-  g.release();
-  while (!tasks_.read(task)) {
+  while (!takeTask(task, queue)) {
     waitSem_.wait();
     if (shouldStop()) {
-      Guard f(mutex_);
       --idleCount_;
       ++totalTaskCount_;
       return nullptr;
@@ -475,7 +554,12 @@ ThreadManager::Task* ThreadManager::ImplT<SemType>::waitOnTask() {
 
 template <typename SemType>
 void ThreadManager::ImplT<SemType>::maybeNotifyMaxMonitor(bool shouldLock) {
-  if (pendingTaskCountMax_ != 0 && tasks_.size() < pendingTaskCountMax_) {
+  if (pendingTaskCountMax_ == 0) {
+    return;
+  }
+  // Pairs with the fence in add() after it registers as a waiter
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (maxWaiters_ > 0 && queuedTaskCount() < pendingTaskCountMax_) {
     if (shouldLock) {
       Guard g(mutex_);
       maxMonitor_.notify();
@@ -578,8 +662,10 @@ class SimpleThreadManager : public ThreadManager::ImplT<SemType> {
   explicit SimpleThreadManager(size_t workerCount = 4,
                                size_t pendingTaskCountMax = 0,
                                bool enableTaskStats = false,
-                               size_t maxQueueLen = 0) :
-    ThreadManager::Impl(pendingTaskCountMax, enableTaskStats, maxQueueLen)
+                               size_t maxQueueLen = 0,
+                               size_t numQueues = 1) :
+    ThreadManager::Impl(pendingTaskCountMax, enableTaskStats, maxQueueLen,
+                        numQueues)
     , workerCount_(workerCount) {
   }
 
@@ -606,6 +692,17 @@ shared_ptr<ThreadManager> ThreadManager::newSimpleThreadManager(
                                           enableTaskStats, maxQueueLen);
 }
 
+template <typename SemType>
+shared_ptr<ThreadManager> ThreadManager::newWorkStealingThreadManager(
+                                                    size_t count,
+                                                    size_t pendingTaskCountMax,
+                                                    bool enableTaskStats,
+                                                    size_t maxQueueLen) {
+  return make_shared<SimpleThreadManager<SemType>>(count, pendingTaskCountMax,
+                                                   enableTaskStats,
+                                                   maxQueueLen, count);
+}
+
 template <typename SemType>
 class PriorityThreadManager::PriorityImplT : public PriorityThreadManager {
 public:
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2014 Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares the shared queue of SimpleThreadManager with the per-worker
+// queues of the work stealing ThreadManager, running tiny tasks on 1 to 64
+// worker threads.  Tasks are added both from outside the pool, as a server
+// does, and from the tasks themselves.
+
+#include <thrift/lib/cpp/concurrency/ThreadManager.h>
+#include <thrift/lib/cpp/concurrency/FunctionRunner.h>
+#include <thrift/lib/cpp/concurrency/PosixThreadFactory.h>
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <gflags/gflags.h>
+
+#include <folly/Benchmark.h>
+
+DEFINE_int32(num_producers, 4, "Number of threads adding tasks from outside "
+                               "the pool");
+DEFINE_int32(fanout, 4, "Tasks added by each task in the fanout benchmarks");
+
+using namespace apache::thrift::concurrency;
+
+typedef std::function<std::shared_ptr<ThreadManager>(size_t)> Factory;
+
+std::shared_ptr<ThreadManager> simpleManager(size_t threads) {
+  return ThreadManager::newSimpleThreadManager(threads);
+}
+
+std::shared_ptr<ThreadManager> workStealingManager(size_t threads) {
+  return ThreadManager::newWorkStealingThreadManager(threads);
+}
+
+std::shared_ptr<ThreadManager> startManager(const Factory& factory,
+                                            size_t threads) {
+  auto tm = factory(threads);
+  tm->threadFactory(std::make_shared<PosixThreadFactory>());
+  tm->start();
+  return tm;
+}
+
+void waitFor(const std::atomic<int64_t>& done, int64_t count) {
+  while (done.load(std::memory_order_acquire) < count) {
+    std::this_thread::yield();
+  }
+}
+
+// iters tasks added by num_producers outside threads
+void runProducers(const Factory& factory, size_t threads, int64_t iters) {
+  std::shared_ptr<ThreadManager> tm;
+  BENCHMARK_SUSPEND {
+    tm = startManager(factory, threads);
+  }
+
+  std::atomic<int64_t> done(0);
+  auto task = FunctionRunner::create([&done] {
+    done.fetch_add(1, std::memory_order_release);
+  });
+  std::vector<std::thread> producers;
+  int64_t perProducer = iters / FLAGS_num_producers + 1;
+  for (int p = 0; p < FLAGS_num_producers; ++p) {
+    producers.emplace_back([&] {
+      for (int64_t i = 0; i < perProducer; ++i) {
+        tm->add(task);
+      }
+    });
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  waitFor(done, perProducer * FLAGS_num_producers);
+
+  BENCHMARK_SUSPEND {
+    tm->join();
+    tm.reset();
+  }
+}
+
+// Every task adds fanout more until iters have been added
+void runFanout(const Factory& factory, size_t threads, int64_t iters) {
+  std::shared_ptr<ThreadManager> tm;
+  BENCHMARK_SUSPEND {
+    tm = startManager(factory, threads);
+  }
+
+  std::atomic<int64_t> added(0);
+  std::atomic<int64_t> done(0);
+  std::shared_ptr<Runnable> task;
+  task = FunctionRunner::create([&] {
+    for (int i = 0; i < FLAGS_fanout; ++i) {
+      if (added.fetch_add(1) >= iters) {
+        break;
+      }
+      tm->add(task);
+    }
+    done.fetch_add(1, std::memory_order_release);
+  });
+  for (size_t i = 0; i < threads; ++i) {
+    added.fetch_add(1);
+    tm->add(task);
+  }
+  waitFor(done, std::max<int64_t>(iters, threads));
+
+  BENCHMARK_SUSPEND {
+    tm->join();
+    tm.reset();
+  }
+}
+
+#define THREAD_MANAGER_BENCHMARKS(threads)                              \
+  BENCHMARK(producers_simple_##threads, iters) {                        \
+    runProducers(simpleManager, threads, iters);                        \
+  }                                                                     \
+  BENCHMARK_RELATIVE(producers_work_stealing_##threads, iters) {        \
+    runProducers(workStealingManager, threads, iters);                  \
+  }                                                                     \
+  BENCHMARK(fanout_simple_##threads, iters) {                           \
+    runFanout(simpleManager, threads, iters);                           \
+  }                                                                     \
+  BENCHMARK_RELATIVE(fanout_work_stealing_##threads, iters) {           \
+    runFanout(workStealingManager, threads, iters);                     \
+  }                                                                     \
+  BENCHMARK_DRAW_LINE();
+
+THREAD_MANAGER_BENCHMARKS(1)
+THREAD_MANAGER_BENCHMARKS(2)
+THREAD_MANAGER_BENCHMARKS(4)
+THREAD_MANAGER_BENCHMARKS(8)
+THREAD_MANAGER_BENCHMARKS(16)
+THREAD_MANAGER_BENCHMARKS(32)
+THREAD_MANAGER_BENCHMARKS(64)
+
+int main(int argc, char *argv[]) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  folly::runBenchmarks();
+  return 0;
+}
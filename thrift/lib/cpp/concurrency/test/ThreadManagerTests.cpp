@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <atomic>
 #include <deque>
 #include <iostream>
 #include <chrono>
@@ -671,6 +672,37 @@ BOOST_AUTO_TEST_CASE(OnlyStartedTest) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(WorkStealingJoinTest) {
+  // join() must run every queued task, including tasks on other workers'
+  // queues and tasks added by tasks, before the workers exit.
+  std::shared_ptr<ThreadManager> threadManager =
+    ThreadManager::newWorkStealingThreadManager(8);
+  threadManager->threadFactory(std::make_shared<PosixThreadFactory>());
+  threadManager->start();
+
+  std::atomic<int> count(0);
+  std::atomic<int> added(0);
+  for (int i = 0; i < 1000; ++i) {
+    threadManager->add(FunctionRunner::create([&] {
+      if (count++ % 10 == 0) {
+        threadManager->add(FunctionRunner::create([&] {
+          usleep(100);
+          ++count;
+        }));
+      }
+      ++added;
+    }));
+  }
+  // Tasks can't add more once join() has started
+  while (added < 1000) {
+    usleep(100);
+  }
+  threadManager->join();
+
+  BOOST_CHECK_EQUAL(count, 1100);
+  BOOST_CHECK_EQUAL(threadManager->pendingTaskCount(), 0);
+}
+
 class TestObserver : public ThreadManager::Observer {
  public:
   TestObserver(int64_t timeout, const std::string& expectedName)
@@ -851,6 +883,43 @@ BOOST_AUTO_TEST_CASE(NumaThreadManagerBind) {
   numa->join();
 }
 
+BOOST_AUTO_TEST_CASE(NumaThreadFactorySpreadNode) {
+  for (size_t i = 0; i < 8; i++) {
+    BOOST_CHECK_EQUAL(NumaThreadFactory::getSpreadNode(i, 4), i % 4);
+    BOOST_CHECK_EQUAL(NumaThreadFactory::getSpreadNode(i, 2), i % 2);
+    // A single node is not worth binding to
+    BOOST_CHECK_EQUAL(NumaThreadFactory::getSpreadNode(i, 1), -1);
+  }
+}
+
+class CountingThreadFactory : public PosixThreadFactory {
+ public:
+  std::shared_ptr<Thread> newThread(
+      const std::shared_ptr<Runnable>& runnable,
+      DetachState detachState) const {
+    ++threads;
+    return PosixThreadFactory::newThread(runnable, detachState);
+  }
+
+  mutable std::atomic<int> threads{0};
+};
+
+BOOST_AUTO_TEST_CASE(NumaThreadFactoryComposes) {
+  auto base = std::make_shared<CountingThreadFactory>();
+  NumaThreadFactory factory(0, base);
+
+  // The base factory creates the thread, and the node binding still runs
+  std::atomic<int> node(-2);
+  auto thread = factory.newThread(FunctionRunner::create([&] {
+      node = NumaThreadFactory::getThreadNumaNode();
+    }), ThreadFactory::ATTACHED);
+  thread->start();
+  thread->join();
+  BOOST_CHECK_EQUAL(base->threads, 1);
+  bool numaEnabled = numa_available() >= 0 && FLAGS_thrift_numa_enabled;
+  BOOST_CHECK_EQUAL(node, numaEnabled ? 0 : -1);
+}
+
 BOOST_AUTO_TEST_CASE(ObserverTest) {
   int64_t timeout = 1000;
   auto observer = std::make_shared<TestObserver>(1000, "foo");
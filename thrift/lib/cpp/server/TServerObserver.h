@@ -82,6 +82,12 @@ class TServerObserver {
 
   virtual void callCompleted(const CallTimestamps& runtimes) {}
 
+  // Completed SSL handshakes that resumed a session, from the session cache
+  // or a ticket, and full ones
+  virtual void sslSessionCacheHit() {}
+
+  virtual void sslSessionCacheMiss() {}
+
   // The observer has to specify a sample rate for callCompleted notifications
   inline uint32_t getSampleRate() const {
     return sampleRate_;
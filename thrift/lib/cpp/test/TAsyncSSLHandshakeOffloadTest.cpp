@@ -0,0 +1,365 @@
+/*
+ * Copyright 2014 Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Handshakes run on a ThreadManager with
+// TAsyncSSLSocket::setHandshakeThreadManager().  The reconnect storm
+// benchmarks, run with --benchmark, time pings on an established
+// connection over loopback while other clients reconnect as fast as they
+// can, with the handshakes on the event base and then on a handshake pool.
+// They also log the ping percentiles and the storm's connection rate.
+
+#include <thrift/lib/cpp/async/TAsyncSSLServerSocket.h>
+#include <thrift/lib/cpp/async/TAsyncSSLSocket.h>
+#include <thrift/lib/cpp/async/TEventBase.h>
+#include <thrift/lib/cpp/concurrency/PosixThreadFactory.h>
+#include <thrift/lib/cpp/concurrency/ThreadManager.h>
+#include <thrift/lib/cpp/transport/TSSLSocket.h>
+#include <thrift/lib/cpp/transport/TSocketAddress.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <folly/Benchmark.h>
+
+using std::shared_ptr;
+using std::vector;
+using apache::thrift::async::TAsyncSSLServerSocket;
+using apache::thrift::async::TAsyncSSLSocket;
+using apache::thrift::async::TAsyncTransport;
+using apache::thrift::async::TEventBase;
+using apache::thrift::concurrency::PosixThreadFactory;
+using apache::thrift::concurrency::ThreadManager;
+using apache::thrift::transport::SSLContext;
+using apache::thrift::transport::TSSLSocket;
+using apache::thrift::transport::TSocketAddress;
+using apache::thrift::transport::TTransportException;
+
+namespace {
+
+class EchoServer;
+
+// Echoes what it reads until the client goes away
+class EchoConnection : public TAsyncSSLSocket::HandshakeCallback,
+                       public TAsyncTransport::ReadCallback {
+ public:
+  EchoConnection(EchoServer* server, const shared_ptr<TAsyncSSLSocket>& sock)
+    : server_(server)
+    , sock_(sock)
+    , finished_(false) {}
+
+  virtual void handshakeSuccess(TAsyncSSLSocket* sock) noexcept;
+
+  virtual void handshakeError(TAsyncSSLSocket* sock,
+                              const TTransportException& ex) noexcept {
+    finish();
+  }
+
+  virtual void getReadBuffer(void** bufReturn, size_t* lenReturn) {
+    *bufReturn = buf_;
+    *lenReturn = sizeof(buf_);
+  }
+
+  virtual void readDataAvailable(size_t len) noexcept {
+    sock_->write(nullptr, buf_, len);
+  }
+
+  virtual void readEOF() noexcept {
+    finish();
+  }
+
+  virtual void readError(const TTransportException& ex) noexcept {
+    finish();
+  }
+
+  void finish();
+
+ private:
+  EchoServer* server_;
+  shared_ptr<TAsyncSSLSocket> sock_;
+  // closeNow() calls handshakeError() during the handshake
+  bool finished_;
+  char buf_[64];
+};
+
+class EchoServer : public TAsyncSSLServerSocket::SSLAcceptCallback {
+ public:
+  explicit EchoServer(const shared_ptr<ThreadManager>& handshakeThreadManager)
+    : ctx_(new SSLContext)
+    , handshakeThreadManager_(handshakeThreadManager)
+    , handshakes_(0)
+    , connections_(0)
+    , hellosOnEventBase_(0)
+    , hellosOffEventBase_(0) {
+    ctx_->loadCertificate("thrift/lib/cpp/test/ssl/tests-cert.pem");
+    ctx_->loadPrivateKey("thrift/lib/cpp/test/ssl/tests-key.pem");
+    ctx_->ciphers("ALL:!ADH:!LOW:!EXP:!MD5:@STRENGTH");
+#if OPENSSL_VERSION_NUMBER >= 0x1000105fL && !defined(OPENSSL_NO_TLSEXT)
+    // The ClientHello is read inside SSL_accept()
+    ctx_->addClientHelloCallback([this](SSL* ssl) {
+      if (evb_.isInEventBaseThread()) {
+        ++hellosOnEventBase_;
+      } else {
+        ++hellosOffEventBase_;
+      }
+    });
+#endif
+
+    socket_ = TAsyncSSLServerSocket::newSocket(ctx_, &evb_);
+    socket_->bind(0);
+    socket_->getAddress(&address_);
+    socket_->listen(1024);
+    socket_->setSSLAcceptCallback(this);
+    thread_ = std::thread([this] { evb_.loopForever(); });
+  }
+
+  // The clients must be gone: their connections finish on their own,
+  // including the handshakes still running on the handshake pool
+  ~EchoServer() {
+    evb_.runInEventBaseThread([this] {
+      socket_->setSSLAcceptCallback(nullptr);
+      socket_.reset();
+    });
+    while (connections_ > 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    evb_.terminateLoopSoon();
+    thread_.join();
+  }
+
+  virtual void connectionAccepted(
+      const shared_ptr<TAsyncSSLSocket>& sock) noexcept {
+    if (handshakeThreadManager_) {
+      sock->setHandshakeThreadManager(handshakeThreadManager_);
+    }
+    ++connections_;
+    sock->sslAccept(new EchoConnection(this, sock));
+  }
+
+  virtual void acceptError(const std::exception& ex) noexcept {
+    ADD_FAILURE() << "accept failed: " << ex.what();
+  }
+
+  const TSocketAddress& getAddress() const {
+    return address_;
+  }
+
+  uint64_t getHandshakes() const {
+    return handshakes_;
+  }
+
+  uint64_t getHellosOnEventBase() const {
+    return hellosOnEventBase_;
+  }
+
+  uint64_t getHellosOffEventBase() const {
+    return hellosOffEventBase_;
+  }
+
+ private:
+  friend class EchoConnection;
+
+  TEventBase evb_;
+  shared_ptr<SSLContext> ctx_;
+  shared_ptr<ThreadManager> handshakeThreadManager_;
+  shared_ptr<TAsyncSSLServerSocket> socket_;
+  TSocketAddress address_;
+  std::thread thread_;
+  std::atomic<uint64_t> handshakes_;
+  std::atomic<uint64_t> connections_;
+  std::atomic<uint64_t> hellosOnEventBase_;
+  std::atomic<uint64_t> hellosOffEventBase_;
+};
+
+void EchoConnection::handshakeSuccess(TAsyncSSLSocket* sock) noexcept {
+  ++server_->handshakes_;
+  sock_->setReadCallback(this);
+}
+
+void EchoConnection::finish() {
+  if (finished_) {
+    return;
+  }
+  finished_ = true;
+  sock_->setReadCallback(nullptr);
+  sock_->closeNow();
+  --server_->connections_;
+  delete this;
+}
+
+shared_ptr<SSLContext> newClientContext() {
+  shared_ptr<SSLContext> ctx(new SSLContext);
+  ctx->ciphers("ALL:!ADH:!LOW:!EXP:!MD5:@STRENGTH");
+  return ctx;
+}
+
+// Ping an established connection one byte at a time, as soon as the reply
+// to the previous one comes back
+vector<int64_t> ping(const TSocketAddress& address, size_t count) {
+  TSSLSocket socket(newClientContext(), address);
+  socket.open();
+  vector<int64_t> rtts;
+  uint8_t byte = 'p';
+  for (size_t i = 0; i < count; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    socket.write(&byte, 1);
+    EXPECT_EQ(socket.readAll(&byte, 1), 1);
+    rtts.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - start).count());
+  }
+  socket.close();
+  return rtts;
+}
+
+struct StormResult {
+  vector<int64_t> rtts;
+  uint64_t handshakes;
+  // Storm connections per second
+  double connectionRate;
+};
+
+// Ping while stormThreads clients connect, do a full handshake and close
+// in a loop.  Only the pings count towards a benchmark's time.
+StormResult pingDuringStorm(const shared_ptr<ThreadManager>& threadManager,
+                            size_t stormThreads,
+                            size_t pings) {
+  folly::BenchmarkSuspender braces;
+  EchoServer server(threadManager);
+  std::atomic<bool> stop(false);
+  std::atomic<uint64_t> connections(0);
+  vector<std::thread> storm;
+  auto ctx = newClientContext();
+  for (size_t i = 0; i < stormThreads; ++i) {
+    storm.emplace_back([&] {
+      while (!stop) {
+        try {
+          TSSLSocket socket(ctx, server.getAddress());
+          socket.open();
+          socket.close();
+          ++connections;
+        } catch (const std::exception&) {
+          // Out of ephemeral ports or a full backlog; keep going
+        }
+      }
+    });
+  }
+  // Let the storm get going
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  StormResult result;
+  uint64_t startConnections = connections;
+  auto start = std::chrono::steady_clock::now();
+  braces.dismiss();
+  result.rtts = ping(server.getAddress(), pings);
+  braces.rehire();
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - start).count();
+  result.connectionRate = (connections - startConnections) * 1000000.0 /
+                          std::max<int64_t>(elapsed, 1);
+  result.handshakes = server.getHandshakes();
+  stop = true;
+  for (auto& thread : storm) {
+    thread.join();
+  }
+  std::sort(result.rtts.begin(), result.rtts.end());
+  return result;
+}
+
+int64_t percentile(const vector<int64_t>& sorted, double p) {
+  return sorted[std::min(sorted.size() - 1, size_t(sorted.size() * p))];
+}
+
+shared_ptr<ThreadManager> newHandshakeThreadManager(size_t threads) {
+  auto threadManager = ThreadManager::newSimpleThreadManager(threads);
+  threadManager->threadFactory(std::make_shared<PosixThreadFactory>());
+  threadManager->start();
+  return threadManager;
+}
+
+}
+
+TEST(TAsyncSSLHandshakeOffloadTest, OffloadedHandshakes) {
+  auto threadManager = newHandshakeThreadManager(2);
+  {
+    EchoServer server(threadManager);
+    for (int i = 0; i < 10; ++i) {
+      auto rtts = ping(server.getAddress(), 10);
+      EXPECT_EQ(rtts.size(), 10);
+    }
+    EXPECT_EQ(server.getHandshakes(), 10);
+#if OPENSSL_VERSION_NUMBER >= 0x1000105fL && !defined(OPENSSL_NO_TLSEXT)
+    EXPECT_EQ(server.getHellosOnEventBase(), 0);
+    EXPECT_EQ(server.getHellosOffEventBase(), 10);
+#endif
+  }
+  threadManager->stop();
+}
+
+TEST(TAsyncSSLHandshakeOffloadTest, InlineHandshakes) {
+  EchoServer server(nullptr);
+  for (int i = 0; i < 10; ++i) {
+    auto rtts = ping(server.getAddress(), 10);
+    EXPECT_EQ(rtts.size(), 10);
+  }
+  EXPECT_EQ(server.getHandshakes(), 10);
+#if OPENSSL_VERSION_NUMBER >= 0x1000105fL && !defined(OPENSSL_NO_TLSEXT)
+  EXPECT_EQ(server.getHellosOnEventBase(), 10);
+  EXPECT_EQ(server.getHellosOffEventBase(), 0);
+#endif
+}
+
+const size_t kStormThreads = 8;
+
+void stormBenchmark(const char* name, size_t handshakeThreads, int iters) {
+  shared_ptr<ThreadManager> threadManager;
+  BENCHMARK_SUSPEND {
+    if (handshakeThreads > 0) {
+      threadManager = newHandshakeThreadManager(handshakeThreads);
+    }
+  }
+  auto result = pingDuringStorm(threadManager, kStormThreads, iters);
+  BENCHMARK_SUSPEND {
+    if (threadManager) {
+      threadManager->stop();
+    }
+    LOG(INFO) << name << ": " << result.handshakes << " handshakes, "
+              << result.connectionRate << " storm connections/s, ping p50 "
+              << percentile(result.rtts, 0.5) << "us, p99 "
+              << percentile(result.rtts, 0.99) << "us";
+  }
+}
+
+BENCHMARK(ping_during_storm_inline, iters) {
+  stormBenchmark("handshakes on the event base", 0, iters);
+}
+
+BENCHMARK_RELATIVE(ping_during_storm_offloaded, iters) {
+  stormBenchmark("handshakes offloaded", kStormThreads, iters);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  auto ret = RUN_ALL_TESTS();
+  if (!ret) {
+    folly::runBenchmarksOnFlag();
+  }
+  return ret;
+}
@@ -23,6 +23,8 @@
 #include <thrift/lib/cpp/async/TAsyncSSLSocket.h>
 #include <thrift/lib/cpp/async/TEventBase.h>
 #include <thrift/lib/cpp/concurrency/Util.h>
+#include <thrift/lib/cpp/transport/SSLSessionCache.h>
+#include <thrift/lib/cpp/transport/TLSTicketKeyManager.h>
 #include <thrift/lib/cpp/transport/TSSLSocket.h>
 #include <thrift/lib/cpp/transport/TSocketAddress.h>
 
@@ -30,6 +32,7 @@
 #include <iostream>
 #include <list>
 #include <set>
+#include <thread>
 #include <unistd.h>
 #include <fcntl.h>
 #include <poll.h>
@@ -53,6 +56,8 @@ using apache::thrift::concurrency::Util;
 using apache::thrift::transport::TSocketAddress;
 using apache::thrift::transport::TTransportException;
 using apache::thrift::transport::SSLContext;
+using apache::thrift::transport::SSLSessionCache;
+using apache::thrift::transport::TLSTicketKeyManager;
 using apache::thrift::transport::TSSLSocket;
 using apache::thrift::transport::TSSLException;
 
@@ -519,6 +524,161 @@ TEST(TAsyncSSLSocketTest, SSLClientTestReuse) {
   cerr << "SSLClientTestReuse test completed" << endl;
 }
 
+/**
+ * Test session re-use through a SSLSessionCache on the server
+ */
+TEST(TAsyncSSLSocketTest, SSLServerSessionCacheTest) {
+  // Start listening on a local port
+  WriteCallbackBase writeCallback;
+  ReadCallback readCallback(&writeCallback);
+  HandshakeCallback handshakeCallback(&readCallback);
+  SSLServerAcceptCallbackDelay acceptCallback(&handshakeCallback);
+  TestSSLServer server(&acceptCallback);
+  auto cache = std::make_shared<SSLSessionCache>(4, 2);
+  server.getSSLContext()->setSessionCache(cache);
+
+  // Set up SSL client
+  TEventBase eventBase;
+  std::shared_ptr<SSLClient> client(
+    new SSLClient(&eventBase, server.getAddress(), 10));
+
+  client->connect();
+  EventBaseAborter eba(&eventBase, 3000);
+  eventBase.loop();
+
+  EXPECT_EQ(client->getMiss(), 1);
+  EXPECT_EQ(client->getHit(), 9);
+  EXPECT_EQ(cache->size(), 1);
+  EXPECT_EQ(cache->getHits(), 9);
+  EXPECT_EQ(cache->getMisses(), 0);
+
+  cerr << "SSLServerSessionCacheTest test completed" << endl;
+}
+
+namespace {
+
+std::shared_ptr<SSLContext> makeTicketServerContext(
+    const std::shared_ptr<TLSTicketKeyManager>& manager) {
+  auto ctx = std::make_shared<SSLContext>();
+  ctx->loadCertificate("thrift/lib/cpp/test/ssl/tests-cert.pem");
+  ctx->loadPrivateKey("thrift/lib/cpp/test/ssl/tests-key.pem");
+  ctx->setTicketKeyManager(manager);
+  return ctx;
+}
+
+/**
+ * Connect a client over a blocking socketpair, offering session, and
+ * return the client's session afterwards (which holds the ticket the
+ * server issued, if any).
+ */
+SSL_SESSION* ticketConnect(const std::shared_ptr<SSLContext>& serverCtx,
+                           SSL_SESSION* session,
+                           bool* reused) {
+  int fds[2];
+  EXPECT_EQ(socketpair(PF_LOCAL, SOCK_STREAM, 0, fds), 0);
+  std::thread server([&] {
+    SSL* ssl = SSL_new(serverCtx->getSSLCtx());
+    SSL_set_fd(ssl, fds[1]);
+    char c;
+    // The client's ticket arrives after the handshake with TLS 1.3
+    if (SSL_accept(ssl) == 1 && SSL_read(ssl, &c, 1) == 1) {
+      SSL_write(ssl, &c, 1);
+    }
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+    close(fds[1]);
+  });
+
+  SSLContext clientCtx;
+  SSL* ssl = SSL_new(clientCtx.getSSLCtx());
+  SSL_set_fd(ssl, fds[0]);
+  if (session) {
+    SSL_set_session(ssl, session);
+  }
+  char c = 'x';
+  EXPECT_EQ(SSL_connect(ssl), 1);
+  EXPECT_EQ(SSL_write(ssl, &c, 1), 1);
+  EXPECT_EQ(SSL_read(ssl, &c, 1), 1);
+  *reused = SSL_session_reused(ssl);
+  SSL_SESSION* newSession = SSL_get1_session(ssl);
+  SSL_shutdown(ssl);
+  SSL_free(ssl);
+  close(fds[0]);
+  server.join();
+  return newSession;
+}
+
+} // anonymous
+
+/**
+ * Test resuming sessions from tickets across a rotation of the keys
+ */
+TEST(TAsyncSSLSocketTest, SSLTicketKeyRotationTest) {
+  auto manager = std::make_shared<TLSTicketKeyManager>(1);
+  auto serverCtx = makeTicketServerContext(manager);
+
+  bool reused;
+  SSL_SESSION* first = ticketConnect(serverCtx, nullptr, &reused);
+  EXPECT_FALSE(reused);
+  SSL_SESSION_free(ticketConnect(serverCtx, first, &reused));
+  EXPECT_TRUE(reused);
+
+  // The old key still decrypts, and the client gets a ticket under the
+  // new one
+  manager->rotate();
+  EXPECT_EQ(manager->getNumKeys(), 2);
+  SSL_SESSION* renewed = ticketConnect(serverCtx, first, &reused);
+  EXPECT_TRUE(reused);
+
+  // Only one old key is kept
+  manager->rotate();
+  EXPECT_EQ(manager->getNumKeys(), 2);
+  SSL_SESSION_free(ticketConnect(serverCtx, first, &reused));
+  EXPECT_FALSE(reused);
+  SSL_SESSION_free(ticketConnect(serverCtx, renewed, &reused));
+  EXPECT_TRUE(reused);
+
+  SSL_SESSION_free(first);
+  SSL_SESSION_free(renewed);
+}
+
+/**
+ * Test that servers with the same secrets resume each other's tickets,
+ * including under an old secret
+ */
+TEST(TAsyncSSLSocketTest, SSLTicketKeySecretsTest) {
+  auto manager1 = std::make_shared<TLSTicketKeyManager>();
+  auto manager2 = std::make_shared<TLSTicketKeyManager>();
+  manager1->setSecrets("secret1", {});
+  manager2->setSecrets("secret1", {});
+  auto serverCtx1 = makeTicketServerContext(manager1);
+  auto serverCtx2 = makeTicketServerContext(manager2);
+
+  bool reused;
+  SSL_SESSION* session = ticketConnect(serverCtx1, nullptr, &reused);
+  EXPECT_FALSE(reused);
+  SSL_SESSION_free(ticketConnect(serverCtx2, session, &reused));
+  EXPECT_TRUE(reused);
+
+  manager2->setSecrets("secret2", {"secret1"});
+  SSL_SESSION_free(ticketConnect(serverCtx2, session, &reused));
+  EXPECT_TRUE(reused);
+  manager2->setSecrets("secret3", {"secret2"});
+  SSL_SESSION_free(ticketConnect(serverCtx2, session, &reused));
+  EXPECT_FALSE(reused);
+  SSL_SESSION_free(session);
+
+  // Old secrets past maxOldKeys are dropped
+  manager2->setSecrets("secret4", {"secret3", "secret2", "secret1"});
+  EXPECT_EQ(manager2->getNumKeys(),
+            TLSTicketKeyManager::kDefaultMaxOldKeys + 1);
+
+  EXPECT_THROW(manager2->setSecrets("", {}), TTransportException);
+  EXPECT_THROW(manager2->setSecrets("secret5", {""}), TTransportException);
+  EXPECT_EQ(manager2->getNumKeys(),
+            TLSTicketKeyManager::kDefaultMaxOldKeys + 1);
+}
+
 /**
  * Test SSL client socket timeout
  */
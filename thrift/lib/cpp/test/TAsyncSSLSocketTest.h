@@ -550,6 +550,11 @@ class TestSSLServer {
 
   apache::thrift::async::TEventBase &getEventBase() { return evb_; }
 
+  const std::shared_ptr<apache::thrift::transport::SSLContext>&
+  getSSLContext() const {
+    return ctx_;
+  }
+
   const apache::thrift::transport::TSocketAddress& getAddress() const {
     return address_;
   }
@@ -1376,6 +1376,187 @@ BOOST_AUTO_TEST_CASE(WriteIOBufCorked) {
   socket->close();
 }
 
+/**
+ * Test writing IOBuf chains with zero copy: the data must arrive intact and
+ * the socket must release the chains once the kernel reports completion.
+ */
+BOOST_AUTO_TEST_CASE(WriteIOBufZeroCopy) {
+  TestServer server;
+
+  // connect()
+  TEventBase evb;
+  std::shared_ptr<TAsyncSocket> socket =
+    TAsyncSocket::newSocket(&evb, server.getAddress(), 30);
+  evb.loop(); // loop until the socket is connected
+
+  if (!socket->setZeroCopy(true)) {
+    LOG(WARNING) << "zero copy is not supported, skipping";
+    return;
+  }
+  BOOST_CHECK(socket->getZeroCopy());
+
+  auto acceptedSocket = server.acceptAsync(&evb);
+  ReadCallback rcb;
+  acceptedSocket->setReadCallback(&rcb);
+  // Completions wake up the socket's read events
+  ReadCallback clientRcb;
+  socket->setReadCallback(&clientRcb);
+
+  // A chain above the threshold, one below it, and one forced with the flag
+  size_t chunkLength = 64 * 1024;
+  size_t numChunks = 16;
+  size_t smallLength = 100;
+  size_t totalLength = chunkLength * numChunks + 2 * smallLength;
+  std::unique_ptr<char[]> expected(new char[totalLength]);
+  for (size_t i = 0; i < totalLength; ++i) {
+    expected[i] = 'a' + i % 26;
+  }
+
+  unique_ptr<IOBuf> bigBuf;
+  for (size_t i = 0; i < numChunks; ++i) {
+    auto chunk = IOBuf::copyBuffer(expected.get() + i * chunkLength,
+                                   chunkLength);
+    if (bigBuf) {
+      bigBuf->prependChain(std::move(chunk));
+    } else {
+      bigBuf = std::move(chunk);
+    }
+  }
+  const char* small = expected.get() + chunkLength * numChunks;
+  WriteCallback wcb1;
+  WriteCallback wcb2;
+  WriteCallback wcb3;
+  socket->writeChain(&wcb1, std::move(bigBuf));
+  socket->writeChain(&wcb2, IOBuf::copyBuffer(small, smallLength));
+  socket->writeChain(&wcb3,
+                     IOBuf::copyBuffer(small + smallLength, smallLength),
+                     WriteFlags::ZEROCOPY);
+  socket->shutdownWrite();
+
+  while (rcb.state == STATE_WAITING || socket->getZeroCopyPending() > 0) {
+    evb.loopOnce();
+  }
+
+  BOOST_CHECK_EQUAL(wcb1.state, STATE_SUCCEEDED);
+  BOOST_CHECK_EQUAL(wcb2.state, STATE_SUCCEEDED);
+  BOOST_CHECK_EQUAL(wcb3.state, STATE_SUCCEEDED);
+  BOOST_CHECK_EQUAL(rcb.state, STATE_SUCCEEDED);
+  rcb.verifyData(expected.get(), totalLength);
+
+  acceptedSocket->close();
+  socket->close();
+}
+
+/**
+ * Test that zero copy chains are released on a socket that is not registered
+ * for any event once its writes are done.
+ */
+BOOST_AUTO_TEST_CASE(WriteIOBufZeroCopyIdle) {
+  TestServer server;
+
+  // connect()
+  TEventBase evb;
+  std::shared_ptr<TAsyncSocket> socket =
+    TAsyncSocket::newSocket(&evb, server.getAddress(), 30);
+  evb.loop(); // loop until the socket is connected
+
+  if (!socket->setZeroCopy(true)) {
+    LOG(WARNING) << "zero copy is not supported, skipping";
+    return;
+  }
+
+  auto acceptedSocket = server.acceptAsync(&evb);
+  ReadCallback rcb;
+  acceptedSocket->setReadCallback(&rcb);
+
+  size_t length = 256 * 1024;
+  std::unique_ptr<char[]> expected(new char[length]);
+  memset(expected.get(), 'z', length);
+  WriteCallback wcb;
+  socket->writeChain(&wcb, IOBuf::copyBuffer(expected.get(), length));
+  socket->shutdownWrite();
+
+  // The client never reads, so only the poll wakes it up for completions.
+  // loop() returns once that stops.
+  evb.loop();
+
+  BOOST_CHECK_EQUAL(wcb.state, STATE_SUCCEEDED);
+  BOOST_CHECK_EQUAL(rcb.state, STATE_SUCCEEDED);
+  rcb.verifyData(expected.get(), length);
+  BOOST_CHECK_EQUAL(socket->getZeroCopyPending(), 0);
+
+  acceptedSocket->close();
+  socket->close();
+}
+
+namespace {
+void setFreed(void* buf, void* userData) {
+  delete[] static_cast<char*>(buf);
+  *static_cast<bool*>(userData) = true;
+}
+}
+
+/**
+ * Test closing a socket whose zero copy sends the kernel still uses: the
+ * chain must stay alive, and the data must still arrive whole.
+ */
+BOOST_AUTO_TEST_CASE(CloseWithZeroCopyPending) {
+  TestServer server;
+
+  // connect()
+  TEventBase evb;
+  std::shared_ptr<TAsyncSocket> socket =
+    TAsyncSocket::newSocket(&evb, server.getAddress(), 30);
+  evb.loop(); // loop until the socket is connected
+
+  if (!socket->setZeroCopy(true)) {
+    LOG(WARNING) << "zero copy is not supported, skipping";
+    return;
+  }
+
+  auto acceptedSocket = server.acceptAsync(&evb);
+
+  // More than the socket buffers hold, so that the receiver, which does not
+  // read yet, leaves most of it unsent
+  size_t length = 32 * 1024 * 1024;
+  char* data = new char[length];
+  for (size_t i = 0; i < length; ++i) {
+    data[i] = 'a' + i % 26;
+  }
+  bool freed = false;
+  WriteCallback wcb;
+  socket->writeChain(&wcb, IOBuf::takeOwnership(data, length, setFreed,
+                                                &freed));
+  size_t pending = socket->getZeroCopyPending();
+  socket->closeNow();
+
+  BOOST_CHECK_EQUAL(wcb.state, STATE_FAILED);
+  BOOST_CHECK_EQUAL(socket->getZeroCopyPending(), 0);
+  if (pending == 0) {
+    // The kernel fell back to copying
+    BOOST_CHECK(freed);
+    acceptedSocket->close();
+    return;
+  }
+  BOOST_CHECK(!freed);
+
+  // What was sent before the close arrives, then EOF
+  ReadCallback rcb;
+  acceptedSocket->setReadCallback(&rcb);
+  evb.loop();
+
+  BOOST_CHECK(freed);
+  BOOST_CHECK_EQUAL(rcb.state, STATE_SUCCEEDED);
+  size_t received = 0;
+  for (const auto& buf : rcb.buffers) {
+    received += buf.length;
+  }
+  BOOST_CHECK_EQUAL(received, wcb.bytesWritten);
+  BOOST_CHECK(received > 0);
+
+  acceptedSocket->close();
+}
+
 /**
  * Test performing a zero-length write
  */
@@ -1915,6 +2096,47 @@ BOOST_AUTO_TEST_CASE(OtherThreadAcceptCallback) {
 
 }
 
+/**
+ * Test that a callback added with addInlineAcceptCallback() is invoked
+ * directly from the server socket's TEventBase
+ */
+BOOST_AUTO_TEST_CASE(InlineAcceptCallback) {
+  TEventBase eventBase;
+  std::shared_ptr<TAsyncServerSocket> serverSocket(
+      TAsyncServerSocket::newSocket(&eventBase));
+  serverSocket->bind(0);
+  serverSocket->listen(16);
+  TSocketAddress serverAddress;
+  serverSocket->getAddress(&serverAddress);
+
+  TestAcceptCallback cb1;
+  bool started = false;
+  cb1.setAcceptStartedFn([&](){
+    started = true;
+  });
+  cb1.setConnectionAcceptedFn([&](int fd, const TSocketAddress& addr){
+    BOOST_CHECK(eventBase.isInEventBaseThread());
+    serverSocket->removeAcceptCallback(&cb1, nullptr);
+  });
+
+  serverSocket->addInlineAcceptCallback(&cb1);
+  // No trip through the loop
+  BOOST_CHECK(started);
+  serverSocket->startAccepting();
+
+  std::shared_ptr<TAsyncSocket> sock1(
+      TAsyncSocket::newSocket(&eventBase, serverAddress));
+  eventBase.loop();
+
+  BOOST_CHECK_EQUAL(cb1.getEvents()->size(), 3);
+  BOOST_CHECK_EQUAL(cb1.getEvents()->at(0).type,
+                    TestAcceptCallback::TYPE_START);
+  BOOST_CHECK_EQUAL(cb1.getEvents()->at(1).type,
+                    TestAcceptCallback::TYPE_ACCEPT);
+  BOOST_CHECK_EQUAL(cb1.getEvents()->at(2).type,
+                    TestAcceptCallback::TYPE_STOP);
+}
+
 void serverSocketSanityTest(TAsyncServerSocket* serverSocket) {
   // Add a callback to accept one connection then stop accepting
   TestAcceptCallback acceptCallback;
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2014 Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares TAsyncSocket::writeChain() throughput with and without zero copy
+// over a loopback TCP connection, for several write sizes.  A thread on the
+// other end reads and discards the data.
+//
+// Loopback delivers the sent pages straight to the receiving socket, so the
+// kernel copies them there anyway: this shows the cost of the zero copy
+// bookkeeping.  The copy it saves only shows on a real NIC.
+
+#include <thrift/lib/cpp/async/TAsyncSocket.h>
+#include <thrift/lib/cpp/async/TEventBase.h>
+
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <folly/Benchmark.h>
+#include <folly/io/IOBuf.h>
+
+using namespace std;
+using namespace folly;
+using apache::thrift::async::TAsyncSocket;
+using apache::thrift::async::TEventBase;
+
+// Sockets of a connected loopback TCP connection
+pair<int, int> makeConnection() {
+  int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+  CHECK_GE(listenFd, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addrLen = sizeof(addr);
+  CHECK_EQ(::bind(listenFd, (struct sockaddr*)&addr, addrLen), 0);
+  CHECK_EQ(getsockname(listenFd, (struct sockaddr*)&addr, &addrLen), 0);
+  CHECK_EQ(listen(listenFd, 1), 0);
+
+  int clientFd = socket(AF_INET, SOCK_STREAM, 0);
+  CHECK_GE(clientFd, 0);
+  CHECK_EQ(connect(clientFd, (struct sockaddr*)&addr, addrLen), 0);
+  int serverFd = accept(listenFd, nullptr, nullptr);
+  CHECK_GE(serverFd, 0);
+  close(listenFd);
+  return make_pair(clientFd, serverFd);
+}
+
+void runWrites(bool zeroCopy, size_t size, size_t iters) {
+  BenchmarkSuspender braces;
+  auto fds = makeConnection();
+  thread reader([&] {
+    vector<char> buf(1 << 20);
+    while (recv(fds.second, buf.data(), buf.size(), 0) > 0) {
+    }
+    close(fds.second);
+  });
+
+  TEventBase evb;
+  auto socket = TAsyncSocket::newSocket(&evb, fds.first);
+  if (zeroCopy) {
+    CHECK(socket->setZeroCopy(true)) << "zero copy is not supported";
+    socket->setZeroCopyThreshold(0);
+  }
+  auto payload = IOBuf::create(size);
+  memset(payload->writableData(), 'x', size);
+  payload->append(size);
+  braces.dismiss();
+
+  while (iters--) {
+    socket->writeChain(nullptr, payload->clone());
+    // Keep the socket buffer full without queueing every write
+    if (iters % 16 == 0) {
+      evb.loop();
+    }
+  }
+  evb.loop();
+
+  braces.rehire();
+  socket->close();
+  reader.join();
+}
+
+#define ZEROCOPY_BENCHMARKS(size)                                        \
+  BENCHMARK(copy_##size, iters) {                                        \
+    runWrites(false, size, iters);                                       \
+  }                                                                      \
+  BENCHMARK_RELATIVE(zerocopy_##size, iters) {                           \
+    runWrites(true, size, iters);                                        \
+  }                                                                      \
+  BENCHMARK_DRAW_LINE();
+
+ZEROCOPY_BENCHMARKS(16384)
+ZEROCOPY_BENCHMARKS(65536)
+ZEROCOPY_BENCHMARKS(262144)
+ZEROCOPY_BENCHMARKS(1048576)
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  runBenchmarks();
+  return 0;
+}
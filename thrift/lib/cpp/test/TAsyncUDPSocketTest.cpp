@@ -308,6 +308,90 @@ BOOST_AUTO_TEST_CASE(PingPong) {
   serverThread.join();
 }
 
+class BatchReader : public TAsyncUDPSocket::ReadCallback {
+ public:
+  BatchReader(TEventBase* evb, size_t expected)
+      : evb_(evb), expected_(expected) {
+  }
+
+  void getReadBuffer(void** buf, size_t* len) noexcept {
+    CHECK(false) << "Batched reads do not use getReadBuffer()";
+  }
+
+  void onDataAvailable(const TSocketAddress& client,
+                       size_t len,
+                       bool truncated) noexcept {
+    CHECK(false) << "Batched reads use onDataBatchAvailable()";
+  }
+
+  void onDataBatchAvailable(const TAsyncUDPSocket::Datagram* datagrams,
+                            size_t count) noexcept {
+    ++batches;
+    for (size_t i = 0; i < count; ++i) {
+      messages.emplace_back(reinterpret_cast<const char*>(datagrams[i].data),
+                            datagrams[i].len);
+    }
+    if (messages.size() >= expected_) {
+      evb_->terminateLoopSoon();
+    }
+  }
+
+  void onReadError(const TTransportException& ex) noexcept {
+    BOOST_FAIL(ex.what());
+  }
+
+  void onReadClosed() noexcept {
+  }
+
+  std::vector<std::string> messages;
+  size_t batches{0};
+
+ private:
+  TEventBase* const evb_;
+  const size_t expected_;
+};
+
+BOOST_AUTO_TEST_CASE(BatchedReadsAndWrites) {
+  TEventBase evb;
+  TAsyncUDPSocket server(&evb);
+  server.bind(TSocketAddress("127.0.0.1", 0));
+  server.setReadBatch(32, 1500);
+  TAsyncUDPSocket client(&evb);
+  client.bind(TSocketAddress("127.0.0.1", 0));
+
+  // 10 datagrams with sendmmsg, and a 4 segment GSO send
+  std::vector<std::string> expected;
+  std::vector<TSocketAddress> addrs;
+  std::vector<std::unique_ptr<IOBuf>> bufs;
+  for (int i = 0; i < 10; ++i) {
+    expected.push_back(folly::to<std::string>("datagram ", i));
+    addrs.push_back(server.address());
+    bufs.push_back(IOBuf::copyBuffer(expected.back()));
+  }
+  BOOST_CHECK_EQUAL(client.writeBatch(addrs.data(), bufs.data(), 10), 10);
+
+  std::string segments(3 * 100 + 50, 'g');
+  for (int i = 0; i < 4; ++i) {
+    expected.push_back(segments.substr(i * 100, 100));
+  }
+  BOOST_CHECK_EQUAL(
+    client.writeGSO(server.address(), IOBuf::copyBuffer(segments), 100),
+    segments.size());
+
+  BatchReader reader(&evb, expected.size());
+  server.resumeRead(&reader);
+  evb.loop();
+
+  BOOST_CHECK_EQUAL_COLLECTIONS(reader.messages.begin(),
+                                reader.messages.end(),
+                                expected.begin(),
+                                expected.end());
+  // Everything was waiting in the socket buffer, so it takes one batch
+  BOOST_CHECK_EQUAL(reader.batches, 1);
+
+  server.pauseRead();
+}
+
 unit_test::test_suite* init_unit_test_suite(int argc, char* argv[]) {
   google::ParseCommandLineFlags(&argc, &argv, true);
   google::InitGoogleLogging(argv[0]);
@@ -0,0 +1,140 @@
+/*
+ * Copyright 2014 Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares the THeader compression transforms on a serialized-struct-like
+// payload of several sizes.  Input is split into 4KB buffers, the way it
+// comes out of the serializers, so the chain-walking codecs get a chain.
+
+#include <thrift/lib/cpp/transport/THeader.h>
+
+#include <random>
+#include <string>
+#include <vector>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <folly/Benchmark.h>
+#include <folly/io/IOBufQueue.h>
+
+using namespace std;
+using namespace folly;
+using apache::thrift::transport::THeader;
+
+const size_t kChunkSize = 4096;
+
+// Mostly repetitive field tags and small ints, with some random bytes
+string makePayload(size_t size) {
+  mt19937 rng(size);
+  string data;
+  data.reserve(size);
+  while (data.size() < size) {
+    data.append("\x15\x02\x18\x0bhello world", 15);
+    for (int i = 0; i < 8; ++i) {
+      data.push_back(rng());
+    }
+  }
+  data.resize(size);
+  return data;
+}
+
+unique_ptr<IOBuf> makeChain(const string& data) {
+  IOBufQueue queue;
+  for (size_t pos = 0; pos < data.size(); pos += kChunkSize) {
+    queue.append(IOBuf::copyBuffer(data.data() + pos,
+                                   min(kChunkSize, data.size() - pos)));
+  }
+  return queue.move();
+}
+
+void runTransform(uint16_t transId, size_t size, size_t iters) {
+  BenchmarkSuspender braces;
+  auto buf = makeChain(makePayload(size));
+  braces.dismiss();
+
+  while (iters--) {
+    vector<uint16_t> trans{transId};
+    auto out = THeader::transform(buf->clone(), trans, 0);
+    doNotOptimizeAway(out->length());
+  }
+}
+
+void runUntransform(uint16_t transId, size_t size, size_t iters) {
+  BenchmarkSuspender braces;
+  vector<uint16_t> trans{transId};
+  auto buf = THeader::transform(makeChain(makePayload(size)), trans, 0);
+  braces.dismiss();
+
+  while (iters--) {
+    auto out = THeader::untransform(buf->clone(), trans);
+    doNotOptimizeAway(out->length());
+  }
+}
+
+#define TRANSFORM_BENCHMARKS(size)                                       \
+  BENCHMARK(compress_zlib_##size, iters) {                               \
+    runTransform(THeader::ZLIB_TRANSFORM, size, iters);                  \
+  }                                                                      \
+  BENCHMARK_RELATIVE(compress_snappy_##size, iters) {                    \
+    runTransform(THeader::SNAPPY_TRANSFORM, size, iters);                \
+  }                                                                      \
+  BENCHMARK_RELATIVE(compress_lz4_##size, iters) {                       \
+    runTransform(THeader::LZ4_TRANSFORM, size, iters);                   \
+  }                                                                      \
+  BENCHMARK_RELATIVE(compress_zstd_##size, iters) {                      \
+    runTransform(THeader::ZSTD_TRANSFORM, size, iters);                  \
+  }                                                                      \
+  BENCHMARK(uncompress_zlib_##size, iters) {                             \
+    runUntransform(THeader::ZLIB_TRANSFORM, size, iters);                \
+  }                                                                      \
+  BENCHMARK_RELATIVE(uncompress_snappy_##size, iters) {                  \
+    runUntransform(THeader::SNAPPY_TRANSFORM, size, iters);              \
+  }                                                                      \
+  BENCHMARK_RELATIVE(uncompress_lz4_##size, iters) {                     \
+    runUntransform(THeader::LZ4_TRANSFORM, size, iters);                 \
+  }                                                                      \
+  BENCHMARK_RELATIVE(uncompress_zstd_##size, iters) {                    \
+    runUntransform(THeader::ZSTD_TRANSFORM, size, iters);                \
+  }                                                                      \
+  BENCHMARK_DRAW_LINE();
+
+TRANSFORM_BENCHMARKS(256)
+TRANSFORM_BENCHMARKS(4096)
+TRANSFORM_BENCHMARKS(65536)
+TRANSFORM_BENCHMARKS(1048576)
+
+void printRatios() {
+  vector<pair<const char*, uint16_t>> transforms = {
+    {"zlib", THeader::ZLIB_TRANSFORM},
+    {"snappy", THeader::SNAPPY_TRANSFORM},
+    {"lz4", THeader::LZ4_TRANSFORM},
+    {"zstd", THeader::ZSTD_TRANSFORM},
+  };
+  for (size_t size : {256, 4096, 65536, 1048576}) {
+    for (auto& transform : transforms) {
+      vector<uint16_t> trans{transform.second};
+      auto out = THeader::transform(makeChain(makePayload(size)), trans, 0);
+      LOG(INFO) << transform.first << " " << size << " bytes -> "
+                << out->computeChainDataLength();
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  printRatios();
+  runBenchmarks();
+  return 0;
+}
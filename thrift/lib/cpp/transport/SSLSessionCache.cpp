@@ -0,0 +1,212 @@
+/*
+ * Copyright 2014 Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <thrift/lib/cpp/transport/SSLSessionCache.h>
+
+#include <algorithm>
+#include <functional>
+#include <glog/logging.h>
+
+using std::string;
+using namespace apache::thrift::concurrency;
+
+namespace apache { namespace thrift { namespace transport {
+
+namespace {
+
+string getSessionId(SSL_SESSION* session) {
+  unsigned int len = 0;
+  const unsigned char* id = SSL_SESSION_get_id(session, &len);
+  return string(reinterpret_cast<const char*>(id), len);
+}
+
+void upRef(SSL_SESSION* session) {
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+  SSL_SESSION_up_ref(session);
+#else
+  CRYPTO_add(&session->references, 1, CRYPTO_LOCK_SSL_SESSION);
+#endif
+}
+
+}
+
+const size_t SSLSessionCache::kDefaultMaxSessions;
+const size_t SSLSessionCache::kDefaultNumShards;
+
+SSLSessionCache::SSLSessionCache(size_t maxSessions, size_t numShards)
+  : maxSessionsPerShard_(std::max<size_t>(maxSessions / numShards, 1))
+  , hits_(0)
+  , misses_(0) {
+  CHECK_GT(numShards, 0);
+  for (size_t i = 0; i < numShards; ++i) {
+    shards_.emplace_back(new Shard);
+  }
+}
+
+SSLSessionCache::~SSLSessionCache() {
+  for (auto& shard : shards_) {
+    for (auto& it : shard->sessions) {
+      SSL_SESSION_free(it.second.session);
+    }
+  }
+}
+
+void SSLSessionCache::attach(SSL_CTX* ctx) {
+  SSL_CTX_set_ex_data(ctx, getExDataIndex(), this);
+  SSL_CTX_set_session_cache_mode(ctx,
+                                 SSL_SESS_CACHE_SERVER |
+                                 SSL_SESS_CACHE_NO_INTERNAL);
+  SSL_CTX_sess_set_new_cb(ctx, newSessionCallback);
+  SSL_CTX_sess_set_get_cb(ctx, getSessionCallback);
+  SSL_CTX_sess_set_remove_cb(ctx, removeSessionCallback);
+}
+
+size_t SSLSessionCache::size() const {
+  size_t count = 0;
+  for (auto& shard : shards_) {
+    Guard g(shard->mutex);
+    count += shard->sessions.size();
+  }
+  return count;
+}
+
+void SSLSessionCache::add(SSL_SESSION* session) {
+  string id = getSessionId(session);
+  SSL_SESSION* evicted = nullptr;
+  SSL_SESSION* replaced = nullptr;
+  {
+    Shard& shard = getShard(id);
+    Guard g(shard.mutex);
+    auto it = shard.sessions.find(id);
+    if (it != shard.sessions.end()) {
+      replaced = it->second.session;
+      it->second.session = session;
+      shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lruPos);
+    } else {
+      if (shard.sessions.size() >= maxSessionsPerShard_) {
+        auto oldest = shard.sessions.find(shard.lru.back());
+        evicted = oldest->second.session;
+        shard.sessions.erase(oldest);
+        shard.lru.pop_back();
+      }
+      shard.lru.push_front(id);
+      Shard::Entry entry;
+      entry.session = session;
+      entry.lruPos = shard.lru.begin();
+      shard.sessions.emplace(id, entry);
+    }
+  }
+  // Free outside of the lock
+  if (evicted) {
+    SSL_SESSION_free(evicted);
+  }
+  if (replaced) {
+    SSL_SESSION_free(replaced);
+  }
+}
+
+SSL_SESSION* SSLSessionCache::lookup(const string& id) {
+  SSL_SESSION* session = nullptr;
+  {
+    Shard& shard = getShard(id);
+    Guard g(shard.mutex);
+    auto it = shard.sessions.find(id);
+    if (it != shard.sessions.end()) {
+      session = it->second.session;
+      // Taken under the lock, so that remove() cannot free it first
+      upRef(session);
+      shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lruPos);
+    }
+  }
+
+  if (session) {
+    hits_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    misses_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return session;
+}
+
+void SSLSessionCache::remove(const string& id) {
+  SSL_SESSION* session = nullptr;
+  {
+    Shard& shard = getShard(id);
+    Guard g(shard.mutex);
+    auto it = shard.sessions.find(id);
+    if (it == shard.sessions.end()) {
+      return;
+    }
+    session = it->second.session;
+    shard.lru.erase(it->second.lruPos);
+    shard.sessions.erase(it);
+  }
+  SSL_SESSION_free(session);
+}
+
+SSLSessionCache::Shard& SSLSessionCache::getShard(const string& id) {
+  return *shards_[std::hash<string>()(id) % shards_.size()];
+}
+
+int SSLSessionCache::newSessionCallback(SSL* ssl, SSL_SESSION* session) {
+  auto cache = getCache(SSL_get_SSL_CTX(ssl));
+  if (!cache) {
+    return 0;
+  }
+  cache->add(session);
+  // We keep the reference OpenSSL gave us
+  return 1;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+SSL_SESSION* SSLSessionCache::getSessionCallback(SSL* ssl,
+                                                 const unsigned char* id,
+                                                 int idLen,
+                                                 int* copy) {
+#else
+SSL_SESSION* SSLSessionCache::getSessionCallback(SSL* ssl,
+                                                 unsigned char* id,
+                                                 int idLen,
+                                                 int* copy) {
+#endif
+  // lookup() already took the reference OpenSSL will release
+  *copy = 0;
+  auto cache = getCache(SSL_get_SSL_CTX(ssl));
+  if (!cache) {
+    return nullptr;
+  }
+  return cache->lookup(string(reinterpret_cast<const char*>(id), idLen));
+}
+
+void SSLSessionCache::removeSessionCallback(SSL_CTX* ctx,
+                                            SSL_SESSION* session) {
+  auto cache = getCache(ctx);
+  if (cache) {
+    cache->remove(getSessionId(session));
+  }
+}
+
+SSLSessionCache* SSLSessionCache::getCache(SSL_CTX* ctx) {
+  return static_cast<SSLSessionCache*>(
+    SSL_CTX_get_ex_data(ctx, getExDataIndex()));
+}
+
+int SSLSessionCache::getExDataIndex() {
+  static int index = SSL_CTX_get_ex_new_index(
+    0, (void*)"SSLSessionCache index", nullptr, nullptr, nullptr);
+  return index;
+}
+
+}}} // apache::thrift::transport
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2014 Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef THRIFT_TRANSPORT_SSLSESSIONCACHE_H_
+#define THRIFT_TRANSPORT_SSLSESSIONCACHE_H_ 1
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <openssl/ssl.h>
+#include <thrift/lib/cpp/concurrency/Mutex.h>
+
+namespace apache { namespace thrift { namespace transport {
+
+/**
+ * Server side SSL session cache, keyed by session id.
+ *
+ * It replaces OpenSSL's internal cache, which takes a single lock per
+ * SSL_CTX for every lookup and insertion, with a cache split into shards
+ * that each have their own lock and LRU list.  All the threads accepting
+ * with one SSLContext (such as the Cpp2Workers of a ThriftServer) share it.
+ *
+ * Install it with SSLContext::setSessionCache().  Sessions expire after
+ * the SSL_CTX session timeout, which OpenSSL checks on lookup.
+ */
+class SSLSessionCache {
+ public:
+  static const size_t kDefaultMaxSessions = 20480;
+  static const size_t kDefaultNumShards = 16;
+
+  /**
+   * @param maxSessions Sessions to keep in all; when a shard is full its
+   *                    least recently used session is dropped.
+   * @param numShards   Number of independently locked shards.
+   */
+  explicit SSLSessionCache(size_t maxSessions = kDefaultMaxSessions,
+                           size_t numShards = kDefaultNumShards);
+  ~SSLSessionCache();
+
+  /**
+   * Install the cache on ctx, turning off OpenSSL's internal cache.  The
+   * cache must outlive ctx; SSLContext::setSessionCache() takes care of
+   * that.
+   */
+  void attach(SSL_CTX* ctx);
+
+  size_t size() const;
+
+  uint64_t getHits() const {
+    return hits_.load(std::memory_order_relaxed);
+  }
+
+  uint64_t getMisses() const {
+    return misses_.load(std::memory_order_relaxed);
+  }
+
+  // The operations behind the OpenSSL callbacks
+
+  // Takes a reference to session
+  void add(SSL_SESSION* session);
+
+  // Returns a new reference to the session, or nullptr
+  SSL_SESSION* lookup(const std::string& id);
+
+  void remove(const std::string& id);
+
+ private:
+  struct Shard {
+    typedef std::list<std::string> LRUList;
+    struct Entry {
+      SSL_SESSION* session;
+      LRUList::iterator lruPos;
+    };
+
+    concurrency::Mutex mutex;
+    // Most recently used first
+    LRUList lru;
+    std::unordered_map<std::string, Entry> sessions;
+  };
+
+  Shard& getShard(const std::string& id);
+
+  static int newSessionCallback(SSL* ssl, SSL_SESSION* session);
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+  static SSL_SESSION* getSessionCallback(SSL* ssl,
+                                         const unsigned char* id,
+                                         int idLen,
+                                         int* copy);
+#else
+  static SSL_SESSION* getSessionCallback(SSL* ssl,
+                                         unsigned char* id,
+                                         int idLen,
+                                         int* copy);
+#endif
+  static void removeSessionCallback(SSL_CTX* ctx, SSL_SESSION* session);
+  static SSLSessionCache* getCache(SSL_CTX* ctx);
+  static int getExDataIndex();
+
+  const size_t maxSessionsPerShard_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> misses_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef THRIFT_TRANSPORT_SSLSESSIONCACHE_H_
@@ -0,0 +1,260 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/lib/cpp/transport/TAdaptiveCompression.h>
+
+#include <thrift/lib/cpp/transport/THeader.h>
+#include <thrift/lib/cpp/transport/TTransportException.h>
+
+#include <algorithm>
+#include <chrono>
+
+using folly::IOBuf;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace apache { namespace thrift { namespace transport {
+
+const uint32_t TAdaptiveCompression::kDefaultSampleRate;
+const uint32_t TAdaptiveCompression::kDefaultWarmupSamples;
+const uint32_t TAdaptiveCompression::kDefaultMinBytesSavedPerUsec;
+
+namespace {
+
+// Weight of a new sample in the running estimates
+const double kSampleWeight = 1.0 / 8;
+
+void addSample(TAdaptiveCompression::TransformStats& stats,
+               double ratio, double nsPerByte) {
+  if (stats.samples == 0) {
+    stats.ratio = ratio;
+    stats.nsPerByte = nsPerByte;
+  } else {
+    stats.ratio += (ratio - stats.ratio) * kSampleWeight;
+    stats.nsPerByte += (nsPerByte - stats.nsPerByte) * kSampleWeight;
+  }
+  ++stats.samples;
+}
+
+}
+
+TAdaptiveCompression::TAdaptiveCompression()
+    : TAdaptiveCompression({THeader::SNAPPY_TRANSFORM,
+                            THeader::ZLIB_TRANSFORM}) {}
+
+TAdaptiveCompression::TAdaptiveCompression(const vector<uint16_t>& candidates)
+    : sampleRate_(kDefaultSampleRate)
+    , minBytesSavedPerUsec_(kDefaultMinBytesSavedPerUsec) {
+  for (auto transId : candidates) {
+    if (transId == THeader::NONE) {
+      continue;
+    }
+    if (!isCompressionTransform(transId)) {
+      throw TTransportException(TTransportException::BAD_ARGS,
+                                "Not a compression transform");
+    }
+    if (std::find(candidates_.begin(), candidates_.end(), transId) ==
+        candidates_.end()) {
+      candidates_.push_back(transId);
+    }
+  }
+}
+
+bool TAdaptiveCompression::isCompressionTransform(uint16_t transId) {
+  return transId == THeader::ZLIB_TRANSFORM ||
+    transId == THeader::SNAPPY_TRANSFORM ||
+    transId == THeader::QLZ_TRANSFORM ||
+    transId == THeader::LZ4_TRANSFORM ||
+    transId == THeader::ZSTD_TRANSFORM;
+}
+
+TAdaptiveCompression::MethodState::MethodState(
+    const vector<uint16_t>& candidateIds)
+    : transform(THeader::NONE)
+    , messages(0)
+    , sampled(0)
+    , bytesIn(0)
+    , bytesOut(0) {
+  for (auto transId : candidateIds) {
+    candidates.emplace_back();
+    candidates.back().transform = transId;
+  }
+}
+
+TAdaptiveCompression::MethodState&
+TAdaptiveCompression::getMethodState(const string& method) {
+  {
+    folly::RWSpinLock::ReadHolder g(&lock_);
+    auto it = methods_.find(method);
+    if (it != methods_.end()) {
+      return *it->second;
+    }
+  }
+  folly::RWSpinLock::WriteHolder g(&lock_);
+  auto& state = methods_[method];
+  if (!state) {
+    state.reset(new MethodState(candidates_));
+  }
+  return *state;
+}
+
+bool TAdaptiveCompression::shouldSample(uint64_t messages,
+                                        uint64_t sampled) const {
+  if (candidates_.empty()) {
+    return false;
+  }
+  if (sampled < kDefaultWarmupSamples) {
+    return true;
+  }
+  return sampleRate_ > 0 && messages % sampleRate_ == 0;
+}
+
+uint16_t TAdaptiveCompression::choose(
+    const vector<TransformStats>& candidates) const {
+  vector<const TransformStats*> byCost;
+  for (auto& candidate : candidates) {
+    if (candidate.samples > 0) {
+      byCost.push_back(&candidate);
+    }
+  }
+  std::sort(byCost.begin(), byCost.end(),
+            [](const TransformStats* a, const TransformStats* b) {
+              return a->nsPerByte < b->nsPerByte;
+            });
+
+  // Walk up the cost ladder, moving to a more expensive transform only if
+  // what it saves on top of the current choice is worth the extra CPU.
+  uint16_t best = THeader::NONE;
+  double bestRatio = 1.0;
+  double bestNsPerByte = 0;
+  for (auto candidate : byCost) {
+    double saved = bestRatio - candidate->ratio;
+    if (saved <= 0) {
+      continue;
+    }
+    double extraUsPerByte = (candidate->nsPerByte - bestNsPerByte) / 1000;
+    if (extraUsPerByte <= 0 ||
+        saved / extraUsPerByte >= minBytesSavedPerUsec_) {
+      best = candidate->transform;
+      bestRatio = candidate->ratio;
+      bestNsPerByte = candidate->nsPerByte;
+    }
+  }
+  return best;
+}
+
+unique_ptr<IOBuf> TAdaptiveCompression::transform(
+    unique_ptr<IOBuf> buf,
+    const string& method,
+    vector<uint16_t>& writeTrans,
+    uint32_t minCompressBytes,
+    const TCompressionDictionary* dictionary) {
+  writeTrans.erase(std::remove_if(writeTrans.begin(), writeTrans.end(),
+                                  isCompressionTransform),
+                   writeTrans.end());
+
+  size_t dataSize = buf->computeChainDataLength();
+  if (dataSize == 0 || dataSize < minCompressBytes) {
+    return THeader::transform(std::move(buf), writeTrans, 0);
+  }
+
+  auto& state = getMethodState(method);
+  uint64_t messages =
+    state.messages.fetch_add(1, std::memory_order_relaxed) + 1;
+  bool sample = shouldSample(messages,
+                             state.sampled.load(std::memory_order_relaxed));
+  uint16_t chosen = state.transform.load(std::memory_order_relaxed);
+
+  unique_ptr<IOBuf> out;
+  if (sample) {
+    vector<unique_ptr<IOBuf>> outputs;
+    vector<std::pair<double, double>> results;
+    for (auto transId : candidates_) {
+      vector<uint16_t> trans{transId};
+      auto start = std::chrono::steady_clock::now();
+      outputs.push_back(THeader::transform(buf->clone(), trans, 0,
+                                           dictionary));
+      auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+      results.emplace_back(
+        double(outputs.back()->computeChainDataLength()) / dataSize,
+        double(ns) / dataSize);
+    }
+
+    {
+      std::lock_guard<std::mutex> g(state.mutex);
+      for (size_t i = 0; i < results.size(); ++i) {
+        addSample(state.candidates[i], results[i].first, results[i].second);
+      }
+      chosen = choose(state.candidates);
+      state.transform.store(chosen, std::memory_order_relaxed);
+      state.sampled.fetch_add(1, std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < candidates_.size(); ++i) {
+      if (candidates_[i] == chosen) {
+        out = std::move(outputs[i]);
+      }
+    }
+  } else if (chosen != THeader::NONE) {
+    vector<uint16_t> trans{chosen};
+    out = THeader::transform(std::move(buf), trans, 0, dictionary);
+  }
+  if (!out) {
+    out = std::move(buf);
+  }
+
+  state.bytesIn.fetch_add(dataSize, std::memory_order_relaxed);
+  state.bytesOut.fetch_add(out->computeChainDataLength(),
+                           std::memory_order_relaxed);
+
+  if (chosen != THeader::NONE) {
+    writeTrans.insert(writeTrans.begin(), chosen);
+    if (writeTrans.size() == 1) {
+      return std::move(out);
+    }
+    // The remaining transforms still have to be applied after compression
+    vector<uint16_t> rest(writeTrans.begin() + 1, writeTrans.end());
+    out = THeader::transform(std::move(out), rest, 0);
+    writeTrans.resize(1);
+    writeTrans.insert(writeTrans.end(), rest.begin(), rest.end());
+    return std::move(out);
+  }
+  return THeader::transform(std::move(out), writeTrans, 0);
+}
+
+std::map<string, TAdaptiveCompression::MethodStats>
+TAdaptiveCompression::getStats() const {
+  std::map<string, MethodStats> result;
+  folly::RWSpinLock::ReadHolder g(&lock_);
+  for (auto& entry : methods_) {
+    auto& state = *entry.second;
+    auto& stats = result[entry.first];
+    stats.transform = state.transform.load(std::memory_order_relaxed);
+    stats.messages = state.messages.load(std::memory_order_relaxed);
+    stats.sampled = state.sampled.load(std::memory_order_relaxed);
+    stats.bytesIn = state.bytesIn.load(std::memory_order_relaxed);
+    stats.bytesOut = state.bytesOut.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> sg(state.mutex);
+    stats.candidates = state.candidates;
+  }
+  return result;
+}
+
+}}} // apache::thrift::transport
@@ -0,0 +1,172 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef THRIFT_TRANSPORT_TADAPTIVECOMPRESSION_H_
+#define THRIFT_TRANSPORT_TADAPTIVECOMPRESSION_H_ 1
+
+#include <folly/io/IOBuf.h>
+#include <folly/RWSpinLock.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace apache { namespace thrift { namespace transport {
+
+class TCompressionDictionary;
+
+/**
+ * Picks the compression transform for each message from what previous
+ * messages of the same method looked like.
+ *
+ * Every method keeps a running estimate, per candidate transform, of the
+ * compressed size ratio and of the compression cost in nanoseconds per
+ * input byte.  A sample of the messages (the first few of every method,
+ * then one in getSampleRate()) is compressed with every candidate to
+ * refresh these estimates; all other messages use the current choice.
+ *
+ * Candidates are considered from cheapest to most expensive, and a more
+ * expensive one is chosen only if the extra bytes it saves per extra
+ * microsecond of CPU is at least getMinBytesSavedPerUsec().  With the
+ * default candidates this ends up as NONE for incompressible payloads,
+ * and SNAPPY or ZLIB for repetitive ones depending on how much more ZLIB
+ * saves.
+ *
+ * Only the write side is adaptive; the chosen transform is recorded in the
+ * header like any other, so every THeader reader can untransform it.
+ * ZSTD_TRANSFORM uses the compression dictionary of the connection, if it
+ * has one, both when sampling and when compressing.  The estimates of a
+ * method are shared by connections with and without a dictionary.
+ *
+ * Thread safe; one instance is normally shared by the whole server.  Only
+ * the first message of a method and sampled messages take a lock; the
+ * per-message counters are atomic.
+ */
+class TAdaptiveCompression {
+ public:
+  static const uint32_t kDefaultSampleRate = 100;
+  static const uint32_t kDefaultWarmupSamples = 8;
+  static const uint32_t kDefaultMinBytesSavedPerUsec = 16;
+
+  struct TransformStats {
+    TransformStats() : transform(0), samples(0), ratio(1.0), nsPerByte(0) {}
+
+    uint16_t transform;
+    uint64_t samples;
+    // Compressed size / uncompressed size
+    double ratio;
+    double nsPerByte;
+  };
+
+  struct MethodStats {
+    MethodStats() : transform(0), messages(0), sampled(0),
+                    bytesIn(0), bytesOut(0) {}
+
+    // Transform currently used for unsampled messages
+    uint16_t transform;
+    uint64_t messages;
+    uint64_t sampled;
+    // Payload bytes before and after compression
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+    std::vector<TransformStats> candidates;
+  };
+
+  /**
+   * Candidates must be compression transforms (ZLIB, SNAPPY, QLZ, LZ4,
+   * ZSTD), and NONE is always a candidate.  The default is NONE, SNAPPY,
+   * ZLIB.
+   */
+  TAdaptiveCompression();
+  explicit TAdaptiveCompression(const std::vector<uint16_t>& candidates);
+
+  void setSampleRate(uint32_t rate) {
+    sampleRate_ = rate;
+  }
+
+  uint32_t getSampleRate() const {
+    return sampleRate_;
+  }
+
+  void setMinBytesSavedPerUsec(uint32_t bytes) {
+    minBytesSavedPerUsec_ = bytes;
+  }
+
+  uint32_t getMinBytesSavedPerUsec() const {
+    return minBytesSavedPerUsec_;
+  }
+
+  /**
+   * Transform buf for a message of the given method.  Any compression
+   * transforms in writeTrans are replaced by the chosen one (or removed),
+   * which is applied first; the remaining transforms are applied after it
+   * as THeader::transform would.  writeTrans is left as the list to put
+   * in the header.  Messages smaller than minCompressBytes are never
+   * compressed.  dictionary is the one ZSTD_TRANSFORM may use, see
+   * THeader::getWriteDictionary().
+   */
+  std::unique_ptr<folly::IOBuf> transform(
+    std::unique_ptr<folly::IOBuf> buf,
+    const std::string& method,
+    std::vector<uint16_t>& writeTrans,
+    uint32_t minCompressBytes,
+    const TCompressionDictionary* dictionary = nullptr);
+
+  /**
+   * Snapshot of the statistics of every method seen so far.
+   */
+  std::map<std::string, MethodStats> getStats() const;
+
+  static bool isCompressionTransform(uint16_t transId);
+
+ private:
+  // Live statistics of one method
+  struct MethodState {
+    explicit MethodState(const std::vector<uint16_t>& candidates);
+
+    std::atomic<uint16_t> transform;
+    std::atomic<uint64_t> messages;
+    std::atomic<uint64_t> sampled;
+    std::atomic<uint64_t> bytesIn;
+    std::atomic<uint64_t> bytesOut;
+    // Guards the estimates, only taken for sampled messages
+    std::mutex mutex;
+    std::vector<TransformStats> candidates;
+  };
+
+  MethodState& getMethodState(const std::string& method);
+  bool shouldSample(uint64_t messages, uint64_t sampled) const;
+  uint16_t choose(const std::vector<TransformStats>& candidates) const;
+
+  std::vector<uint16_t> candidates_;
+  uint32_t sampleRate_;
+  uint32_t minBytesSavedPerUsec_;
+
+  // Guards methods_; states are never removed, so references stay valid
+  mutable folly::RWSpinLock lock_;
+  std::unordered_map<std::string, std::unique_ptr<MethodState>> methods_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef THRIFT_TRANSPORT_TADAPTIVECOMPRESSION_H_
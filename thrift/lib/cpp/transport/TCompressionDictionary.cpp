@@ -0,0 +1,109 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/lib/cpp/transport/TCompressionDictionary.h>
+
+#include <thrift/lib/cpp/transport/TTransportException.h>
+
+#include <folly/FileUtil.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <zdict.h>
+
+using folly::ByteRange;
+using std::string;
+
+namespace apache { namespace thrift { namespace transport {
+
+const int TCompressionDictionary::kCompressionLevel;
+
+namespace {
+
+typedef std::map<uint32_t, const TCompressionDictionary*> DictionaryMap;
+
+// get() runs for every dictionary compressed message on every IO thread, so
+// it only loads the current map.  add() copies it under registryMutex and
+// publishes the copy.  Old maps and the dictionaries are never freed, so
+// they outlive every static THeader and any reader still holding them.
+std::mutex registryMutex;
+std::atomic<const DictionaryMap*>& registry() {
+  static std::atomic<const DictionaryMap*> dictionaries(new DictionaryMap);
+  return dictionaries;
+}
+
+}
+
+TCompressionDictionary::TCompressionDictionary(uint32_t id, ByteRange data)
+    : id_(id)
+    , cdict_(ZSTD_createCDict(data.data(), data.size(), kCompressionLevel))
+    , ddict_(ZSTD_createDDict(data.data(), data.size())) {
+  if (!cdict_ || !ddict_) {
+    ZSTD_freeCDict(cdict_);
+    ZSTD_freeDDict(ddict_);
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "Could not load compression dictionary");
+  }
+}
+
+TCompressionDictionary::~TCompressionDictionary() {
+  ZSTD_freeCDict(cdict_);
+  ZSTD_freeDDict(ddict_);
+}
+
+uint32_t TCompressionDictionary::add(ByteRange data) {
+  // Raw content dictionaries have no ID and could not be told apart on
+  // the wire, so only trained (ZDICT) dictionaries are accepted.
+  uint32_t id = ZDICT_getDictID(data.data(), data.size());
+  if (id == 0) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "Not a zstd dictionary");
+  }
+
+  std::lock_guard<std::mutex> g(registryMutex);
+  const DictionaryMap* dictionaries = registry().load();
+  if (dictionaries->find(id) == dictionaries->end()) {
+    std::unique_ptr<TCompressionDictionary> dictionary(
+      new TCompressionDictionary(id, data));
+    std::unique_ptr<DictionaryMap> copy(new DictionaryMap(*dictionaries));
+    (*copy)[id] = dictionary.release();
+    registry().store(copy.release(), std::memory_order_release);
+  }
+  return id;
+}
+
+uint32_t TCompressionDictionary::addFromFile(const string& path) {
+  string data;
+  if (!folly::readFile(path.c_str(), data)) {
+    throw TTransportException(TTransportException::NOT_OPEN,
+                              "Could not read compression dictionary " + path);
+  }
+  return add(ByteRange(folly::StringPiece(data)));
+}
+
+const TCompressionDictionary* TCompressionDictionary::get(uint32_t id) {
+  const DictionaryMap* dictionaries =
+    registry().load(std::memory_order_acquire);
+  auto it = dictionaries->find(id);
+  return it == dictionaries->end() ? nullptr : it->second;
+}
+
+}}} // apache::thrift::transport
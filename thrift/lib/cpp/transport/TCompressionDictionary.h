@@ -0,0 +1,86 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef THRIFT_TRANSPORT_TCOMPRESSIONDICTIONARY_H_
+#define THRIFT_TRANSPORT_TCOMPRESSIONDICTIONARY_H_ 1
+
+#include <folly/Range.h>
+
+#include <string>
+#include <zstd.h>
+
+namespace apache { namespace thrift { namespace transport {
+
+/**
+ * A trained zstd dictionary, used by ZSTD_TRANSFORM once both ends of a
+ * THeader connection have it (see THeader::setDictionaryId()).
+ *
+ * Dictionaries are trained offline from captured payloads with
+ * thrift/contrib/thrift_train_dictionary and registered at startup on both
+ * clients and servers.  The ID is the one zstd stores in the dictionary,
+ * and also in every frame compressed with it.
+ *
+ * Registered dictionaries are never removed, so the pointers returned by
+ * get() stay valid for the life of the process.
+ */
+class TCompressionDictionary {
+ public:
+  static const int kCompressionLevel = 3;
+
+  /**
+   * Register a dictionary and return its ID.  Throws TTransportException
+   * if data is not a zstd dictionary.  Registering an ID again keeps the
+   * first dictionary.
+   */
+  static uint32_t add(folly::ByteRange data);
+  static uint32_t addFromFile(const std::string& path);
+
+  /**
+   * The registered dictionary with this ID, or nullptr.
+   */
+  static const TCompressionDictionary* get(uint32_t id);
+
+  ~TCompressionDictionary();
+
+  uint32_t getId() const {
+    return id_;
+  }
+
+  const ZSTD_CDict* getCDict() const {
+    return cdict_;
+  }
+
+  const ZSTD_DDict* getDDict() const {
+    return ddict_;
+  }
+
+ private:
+  TCompressionDictionary(uint32_t id, folly::ByteRange data);
+
+  TCompressionDictionary(const TCompressionDictionary&) = delete;
+  TCompressionDictionary& operator=(const TCompressionDictionary&) = delete;
+
+  uint32_t id_;
+  ZSTD_CDict* cdict_;
+  ZSTD_DDict* ddict_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef THRIFT_TRANSPORT_TCOMPRESSIONDICTIONARY_H_
@@ -23,9 +23,13 @@
 #include <thrift/lib/cpp/TApplicationException.h>
 #include <thrift/lib/cpp/protocol/TProtocolTypes.h>
 #include <thrift/lib/cpp/transport/TBufferTransports.h>
+#include <thrift/lib/cpp/transport/TCompressionDictionary.h>
 #include <thrift/lib/cpp/util/VarintUtils.h>
 #include <thrift/lib/cpp/concurrency/Thread.h>
+#include <folly/ThreadLocal.h>
 #include "snappy.h"
+#include <lz4frame.h>
+#include <zstd.h>
 
 #ifdef HAVE_QUICKLZ
 extern "C" {
@@ -36,6 +40,7 @@ extern "C" {
 #include <algorithm>
 #include <bitset>
 #include <cassert>
+#include <cstring>
 #include <string>
 #include <zlib.h>
 
@@ -59,6 +64,7 @@ const string THeader::ID_VERSION_HEADER = "id_version";
 const string THeader::ID_VERSION = "1";
 const string THeader::PRIORITY_HEADER = "thrift_priority";
 const string THeader::CLIENT_TIMEOUT_HEADER = "client_timeout";
+const string THeader::SKIP_INDEX_HEADER = "thrift_skip_index";
 
 string THeader::s_identity = "";
 
@@ -159,6 +165,10 @@ unique_ptr<IOBuf> THeader::removeHeader(IOBufQueue* queue,
   size_t chainSize = queue->front()->computeChainDataLength();
   unique_ptr<IOBuf> buf;
   needed = 0;
+  if (recordReadTimes_) {
+    headerParsedTime_ = std::chrono::steady_clock::time_point();
+    untransformedTime_ = std::chrono::steady_clock::time_point();
+  }
 
   if (chainSize < 4) {
     needed = 4 - chainSize;
@@ -419,6 +429,14 @@ unique_ptr<IOBuf> THeader::readHeaderFormat(unique_ptr<IOBuf> buf) {
       case infoIdType::PKEYVALUE:
         readInfoHeaders(c, persisReadHeaders_);
         break;
+      case infoIdType::DICTIONARY: {
+        uint32_t id = readVarint<uint32_t>(c);
+        if (id != peerDictionaryId_) {
+          peerDictionaryId_ = id;
+          writeDictionary_ = TCompressionDictionary::get(id);
+        }
+        break;
+      }
     }
   }
 
@@ -459,7 +477,13 @@ unique_ptr<IOBuf> THeader::readHeaderFormat(unique_ptr<IOBuf> buf) {
   }
 
   // Untransform data section
+  if (recordReadTimes_) {
+    headerParsedTime_ = std::chrono::steady_clock::now();
+  }
   buf = untransform(std::move(buf), readTrans_);
+  if (recordReadTimes_) {
+    untransformedTime_ = std::chrono::steady_clock::now();
+  }
 
   if (protoId_ == T_JSON_PROTOCOL && clientType != THRIFT_HTTP_SERVER_TYPE) {
     throw TApplicationException(TApplicationException::UNSUPPORTED_CLIENT_TYPE,
@@ -469,6 +493,342 @@ unique_ptr<IOBuf> THeader::readHeaderFormat(unique_ptr<IOBuf> buf) {
   return std::move(buf);
 }
 
+namespace {
+
+// Preallocation limit for uncompressed output whose size comes from the
+// (untrusted) frame header; bigger messages grow chunk by chunk.
+const size_t kMaxUncompressPrealloc = 64 * 1024 * 1024;
+const size_t kUncompressChunkSize = 64 * 1024;
+
+const int kZstdCompressionLevel = 1;
+// ZSTD_FRAMEHEADERSIZE_MAX, which zstd.h only exports to static users
+const size_t kZstdFrameHeaderSizeMax = 18;
+
+/**
+ * Streaming codec state, one set per thread.  Contexts are created on
+ * first use and then only reset between messages, which is much cheaper
+ * than setting them up for every message.
+ */
+class CompressionContexts {
+ public:
+  CompressionContexts()
+    : deflaterInit_(false)
+    , inflaterInit_(false)
+    , zstdCompressor_(nullptr)
+    , zstdDecompressor_(nullptr)
+    , lz4Compressor_(nullptr)
+    , lz4Decompressor_(nullptr) {}
+
+  ~CompressionContexts() {
+    if (deflaterInit_) {
+      deflateEnd(&deflater_);
+    }
+    if (inflaterInit_) {
+      inflateEnd(&inflater_);
+    }
+    ZSTD_freeCCtx(zstdCompressor_);
+    ZSTD_freeDCtx(zstdDecompressor_);
+    if (lz4Compressor_) {
+      LZ4F_freeCompressionContext(lz4Compressor_);
+    }
+    if (lz4Decompressor_) {
+      LZ4F_freeDecompressionContext(lz4Decompressor_);
+    }
+  }
+
+  z_stream& getDeflater() {
+    if (!deflaterInit_) {
+      // Setting these to 0 means use the default free/alloc functions
+      deflater_.zalloc = (alloc_func)0;
+      deflater_.zfree = (free_func)0;
+      deflater_.opaque = (voidpf)0;
+      if (deflateInit(&deflater_, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                  "Error while zlib deflateInit");
+      }
+      deflaterInit_ = true;
+    } else if (deflateReset(&deflater_) != Z_OK) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "Error while zlib deflateReset");
+    }
+    return deflater_;
+  }
+
+  z_stream& getInflater() {
+    if (!inflaterInit_) {
+      inflater_.zalloc = (alloc_func)0;
+      inflater_.zfree = (free_func)0;
+      inflater_.opaque = (voidpf)0;
+      inflater_.next_in = Z_NULL;
+      inflater_.avail_in = 0;
+      if (inflateInit(&inflater_) != Z_OK) {
+        throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                    "Error while zlib inflate Init");
+      }
+      inflaterInit_ = true;
+    } else if (inflateReset(&inflater_) != Z_OK) {
+      throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                  "Error while zlib inflateReset");
+    }
+    return inflater_;
+  }
+
+  ZSTD_CCtx* getZstdCompressor() {
+    if (!zstdCompressor_) {
+      zstdCompressor_ = ZSTD_createCCtx();
+      if (!zstdCompressor_) {
+        throw std::bad_alloc();
+      }
+      ZSTD_CCtx_setParameter(zstdCompressor_, ZSTD_c_compressionLevel,
+                             kZstdCompressionLevel);
+    } else {
+      ZSTD_CCtx_reset(zstdCompressor_, ZSTD_reset_session_only);
+    }
+    return zstdCompressor_;
+  }
+
+  ZSTD_DCtx* getZstdDecompressor() {
+    if (!zstdDecompressor_) {
+      zstdDecompressor_ = ZSTD_createDCtx();
+      if (!zstdDecompressor_) {
+        throw std::bad_alloc();
+      }
+    } else {
+      ZSTD_DCtx_reset(zstdDecompressor_, ZSTD_reset_session_only);
+    }
+    return zstdDecompressor_;
+  }
+
+  LZ4F_cctx* getLz4Compressor() {
+    // LZ4F_compressBegin() resets the context for every frame
+    if (!lz4Compressor_ &&
+        LZ4F_isError(LZ4F_createCompressionContext(&lz4Compressor_,
+                                                   LZ4F_VERSION))) {
+      throw std::bad_alloc();
+    }
+    return lz4Compressor_;
+  }
+
+  LZ4F_dctx* getLz4Decompressor() {
+    if (!lz4Decompressor_) {
+      if (LZ4F_isError(LZ4F_createDecompressionContext(&lz4Decompressor_,
+                                                       LZ4F_VERSION))) {
+        throw std::bad_alloc();
+      }
+    } else {
+      LZ4F_resetDecompressionContext(lz4Decompressor_);
+    }
+    return lz4Decompressor_;
+  }
+
+ private:
+  z_stream deflater_;
+  bool deflaterInit_;
+  z_stream inflater_;
+  bool inflaterInit_;
+  ZSTD_CCtx* zstdCompressor_;
+  ZSTD_DCtx* zstdDecompressor_;
+  LZ4F_cctx* lz4Compressor_;
+  LZ4F_dctx* lz4Decompressor_;
+};
+
+folly::ThreadLocal<CompressionContexts> compressionContexts;
+
+/**
+ * The zstd and lz4 codecs below feed the IOBuf chain to the streaming
+ * APIs one buffer at a time, so neither side has to coalesce it.
+ */
+unique_ptr<IOBuf> zstdCompress(const IOBuf& buf,
+                               const TCompressionDictionary* dictionary) {
+  size_t dataSize = buf.computeChainDataLength();
+  ZSTD_CCtx* cctx = compressionContexts->getZstdCompressor();
+  ZSTD_CCtx_refCDict(cctx, dictionary ? dictionary->getCDict() : nullptr);
+  ZSTD_CCtx_setPledgedSrcSize(cctx, dataSize);
+
+  // Always big enough, so the output is a single buffer
+  unique_ptr<IOBuf> out(IOBuf::create(ZSTD_compressBound(dataSize)));
+  ZSTD_outBuffer output = {out->writableTail(), out->tailroom(), 0};
+
+  const IOBuf* cur = &buf;
+  do {
+    bool last = cur->next() == &buf;
+    ZSTD_inBuffer input = {cur->data(), cur->length(), 0};
+    size_t rc;
+    do {
+      rc = ZSTD_compressStream2(cctx, &output, &input,
+                                last ? ZSTD_e_end : ZSTD_e_continue);
+      if (ZSTD_isError(rc) || (rc != 0 && output.pos == output.size)) {
+        throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                  "Error while zstd compress");
+      }
+    } while (last ? rc != 0 : input.pos < input.size);
+    cur = cur->next();
+  } while (cur != &buf);
+
+  out->append(output.pos);
+  return std::move(out);
+}
+
+unique_ptr<IOBuf> zstdUncompress(const IOBuf& buf) {
+  ZSTD_DCtx* dctx = compressionContexts->getZstdDecompressor();
+
+  // The frame header has the uncompressed size, so the output normally
+  // ends up in a single buffer.
+  uint8_t header[kZstdFrameHeaderSizeMax];
+  size_t headerSize = Cursor(&buf).pullAtMost(header, sizeof(header));
+  unsigned long long contentSize =
+    ZSTD_getFrameContentSize(header, headerSize);
+  size_t chunkSize = kUncompressChunkSize;
+  if (contentSize != ZSTD_CONTENTSIZE_UNKNOWN &&
+      contentSize != ZSTD_CONTENTSIZE_ERROR && contentSize > 0) {
+    chunkSize = std::min<unsigned long long>(contentSize,
+                                             kMaxUncompressPrealloc);
+  }
+
+  // The frame names the dictionary it was compressed with, if any
+  const ZSTD_DDict* ddict = nullptr;
+  uint32_t dictId = ZSTD_getDictID_fromFrame(header, headerSize);
+  if (dictId != 0) {
+    auto dictionary = TCompressionDictionary::get(dictId);
+    if (!dictionary) {
+      throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                  "Unknown zstd dictionary");
+    }
+    ddict = dictionary->getDDict();
+  }
+  ZSTD_DCtx_refDDict(dctx, ddict);
+
+  IOBufQueue out;
+  size_t rc = 1;
+  const IOBuf* cur = &buf;
+  do {
+    ZSTD_inBuffer input = {cur->data(), cur->length(), 0};
+    ZSTD_outBuffer output;
+    do {
+      auto space = out.preallocate(1, chunkSize);
+      output = {space.first, space.second, 0};
+      rc = ZSTD_decompressStream(dctx, &output, &input);
+      if (ZSTD_isError(rc)) {
+        throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                    "zstd uncompress failure");
+      }
+      out.postallocate(output.pos);
+    } while (rc != 0 &&
+             (input.pos < input.size || output.pos == output.size));
+    cur = cur->next();
+  } while (cur != &buf && rc != 0);
+
+  if (rc != 0) {
+    throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                "Not enough zstd data in message");
+  }
+  auto result = out.move();
+  return result ? std::move(result) : IOBuf::create(0);
+}
+
+unique_ptr<IOBuf> lz4Compress(const IOBuf& buf) {
+  size_t dataSize = buf.computeChainDataLength();
+  LZ4F_cctx* cctx = compressionContexts->getLz4Compressor();
+
+  LZ4F_preferences_t prefs;
+  memset(&prefs, 0, sizeof(prefs));
+  prefs.frameInfo.contentSize = dataSize;
+
+  IOBufQueue out;
+  auto space = out.preallocate(
+    LZ4F_HEADER_SIZE_MAX,
+    LZ4F_HEADER_SIZE_MAX + LZ4F_compressBound(dataSize, &prefs));
+  size_t rc = LZ4F_compressBegin(cctx, space.first, space.second, &prefs);
+  if (LZ4F_isError(rc)) {
+    throw TTransportException(TTransportException::CORRUPTED_DATA,
+                              "Error while lz4 compressBegin");
+  }
+  out.postallocate(rc);
+
+  const IOBuf* cur = &buf;
+  do {
+    if (cur->length() > 0) {
+      size_t bound = LZ4F_compressBound(cur->length(), &prefs);
+      space = out.preallocate(bound, bound);
+      rc = LZ4F_compressUpdate(cctx, space.first, space.second,
+                               cur->data(), cur->length(), nullptr);
+      if (LZ4F_isError(rc)) {
+        throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                  "Error while lz4 compress");
+      }
+      out.postallocate(rc);
+    }
+    cur = cur->next();
+  } while (cur != &buf);
+
+  size_t bound = LZ4F_compressBound(0, &prefs);
+  space = out.preallocate(bound, bound);
+  rc = LZ4F_compressEnd(cctx, space.first, space.second, nullptr);
+  if (LZ4F_isError(rc)) {
+    throw TTransportException(TTransportException::CORRUPTED_DATA,
+                              "Error while lz4 compressEnd");
+  }
+  out.postallocate(rc);
+  return out.move();
+}
+
+unique_ptr<IOBuf> lz4Uncompress(const IOBuf& buf) {
+  LZ4F_dctx* dctx = compressionContexts->getLz4Decompressor();
+
+  // Read the frame header from a copy, then skip what it consumed
+  uint8_t header[LZ4F_HEADER_SIZE_MAX];
+  size_t skip = Cursor(&buf).pullAtMost(header, sizeof(header));
+  LZ4F_frameInfo_t info;
+  size_t rc = LZ4F_getFrameInfo(dctx, &info, header, &skip);
+  if (LZ4F_isError(rc)) {
+    throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                "lz4 uncompress failure");
+  }
+  size_t chunkSize = kUncompressChunkSize;
+  if (info.contentSize > 0) {
+    chunkSize = std::min<unsigned long long>(info.contentSize,
+                                             kMaxUncompressPrealloc);
+  }
+
+  IOBufQueue out;
+  const IOBuf* cur = &buf;
+  do {
+    const uint8_t* src = cur->data();
+    size_t srcLeft = cur->length();
+    size_t skipped = std::min(skip, srcLeft);
+    src += skipped;
+    srcLeft -= skipped;
+    skip -= skipped;
+
+    bool full;
+    do {
+      auto space = out.preallocate(1, chunkSize);
+      size_t dstSize = space.second;
+      size_t srcSize = srcLeft;
+      rc = LZ4F_decompress(dctx, space.first, &dstSize,
+                           src, &srcSize, nullptr);
+      if (LZ4F_isError(rc)) {
+        throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                    "lz4 uncompress failure");
+      }
+      out.postallocate(dstSize);
+      src += srcSize;
+      srcLeft -= srcSize;
+      full = dstSize == space.second;
+    } while (rc != 0 && (srcLeft > 0 || full));
+    cur = cur->next();
+  } while (cur != &buf && rc != 0);
+
+  if (rc != 0) {
+    throw TApplicationException(TApplicationException::MISSING_RESULT,
+                                "Not enough lz4 data in message");
+  }
+  auto result = out.move();
+  return result ? std::move(result) : IOBuf::create(0);
+}
+
+}
+
 unique_ptr<IOBuf> THeader::untransform(
   unique_ptr<IOBuf> buf, std::vector<uint16_t>& readTrans) {
   for (vector<uint16_t>::const_reverse_iterator it = readTrans.rbegin();
@@ -479,56 +839,44 @@ unique_ptr<IOBuf> THeader::untransform(
       size_t bufSize = 1024;
       unique_ptr<IOBuf> out;
 
-      z_stream stream;
+      z_stream& stream = compressionContexts->getInflater();
       int err;
 
-      // Setting these to 0 means use the default free/alloc functions
-      stream.zalloc = (alloc_func)0;
-      stream.zfree = (free_func)0;
-      stream.opaque = (voidpf)0;
-      err = inflateInit(&stream);
-      if (err != Z_OK) {
-        throw TApplicationException(TApplicationException::MISSING_RESULT,
-                                    "Error while zlib inflate Init");
-      }
-      {
-        SCOPE_EXIT { err = inflateEnd(&stream); };
+      do {
+        if (nullptr == buf) {
+          throw TApplicationException(TApplicationException::MISSING_RESULT,
+              "Not enough zlib data in message");
+        }
+        stream.next_in = buf->writableData();
+        stream.avail_in = buf->length();
         do {
-          if (nullptr == buf) {
+          unique_ptr<IOBuf> tmp(IOBuf::create(bufSize));
+
+          stream.next_out = tmp->writableData();
+          stream.avail_out = bufSize;
+          err = inflate(&stream, Z_NO_FLUSH);
+          if (err == Z_STREAM_ERROR ||
+              err == Z_DATA_ERROR ||
+              err == Z_MEM_ERROR) {
             throw TApplicationException(TApplicationException::MISSING_RESULT,
-                "Not enough zlib data in message");
+                "Error while zlib inflate");
           }
-          stream.next_in = buf->writableData();
-          stream.avail_in = buf->length();
-          do {
-            unique_ptr<IOBuf> tmp(IOBuf::create(bufSize));
-
-            stream.next_out = tmp->writableData();
-            stream.avail_out = bufSize;
-            err = inflate(&stream, Z_NO_FLUSH);
-            if (err == Z_STREAM_ERROR ||
-                err == Z_DATA_ERROR ||
-                err == Z_MEM_ERROR) {
-              throw TApplicationException(TApplicationException::MISSING_RESULT,
-                  "Error while zlib inflate");
-            }
-            tmp->append(bufSize - stream.avail_out);
-            if (out) {
-              // Add buffer to end (circular list, same as prepend)
-              out->prependChain(std::move(tmp));
-            } else {
-              out = std::move(tmp);
-            }
-          } while (stream.avail_out == 0);
-          // try the next buffer
-          buf = buf->pop();
-        } while (err != Z_STREAM_END);
-      }
-      if (err != Z_OK) {
-        throw TApplicationException(TApplicationException::MISSING_RESULT,
-                                    "Error while zlib inflateEnd");
-      }
+          tmp->append(bufSize - stream.avail_out);
+          if (out) {
+            // Add buffer to end (circular list, same as prepend)
+            out->prependChain(std::move(tmp));
+          } else {
+            out = std::move(tmp);
+          }
+        } while (stream.avail_out == 0);
+        // try the next buffer
+        buf = buf->pop();
+      } while (err != Z_STREAM_END);
       buf = std::move(out);
+    } else if (transId == ZSTD_TRANSFORM) {
+      buf = zstdUncompress(*buf);
+    } else if (transId == LZ4_TRANSFORM) {
+      buf = lz4Uncompress(*buf);
     } else if (transId == SNAPPY_TRANSFORM) {
       buf->coalesce(); // required for snappy uncompression
       size_t uncompressed_sz;
@@ -585,7 +933,8 @@ unique_ptr<IOBuf> THeader::untransform(
 unique_ptr<IOBuf> THeader::transform(
   unique_ptr<IOBuf> buf,
   std::vector<uint16_t>& writeTrans,
-uint32_t minCompressBytes) {
+  uint32_t minCompressBytes,
+  const TCompressionDictionary* dictionary) {
   uint32_t dataSize = buf->computeChainDataLength();
 
   for (vector<uint16_t>::iterator it = writeTrans.begin();
@@ -600,21 +949,12 @@ uint32_t minCompressBytes) {
       size_t bufSize = 1024;
       unique_ptr<IOBuf> out;
 
-      z_stream stream;
-      int err;
+      z_stream& stream = compressionContexts->getDeflater();
+      int err = Z_OK;
 
       stream.next_in = (unsigned char*)buf->data();
       stream.avail_in = buf->length();
 
-      stream.zalloc = (alloc_func)0;
-      stream.zfree = (free_func)0;
-      stream.opaque = (voidpf)0;
-      err = deflateInit(&stream, Z_DEFAULT_COMPRESSION);
-      if (err != Z_OK) {
-        throw TTransportException(TTransportException::CORRUPTED_DATA,
-                                  "Error while zlib deflateInit");
-      }
-
       // Loop until deflate() tells us it's done writing all output
       while (err != Z_STREAM_END) {
         // Create a new output chunk
@@ -661,13 +1001,19 @@ uint32_t minCompressBytes) {
         }
       }
 
-      err = deflateEnd(&stream);
-      if (err != Z_OK) {
-        throw TTransportException(TTransportException::CORRUPTED_DATA,
-                                  "Error while zlib deflateEnd");
-      }
-
       buf = std::move(out);
+    } else if (transId == ZSTD_TRANSFORM) {
+      if (dataSize < minCompressBytes) {
+        it = writeTrans.erase(it);
+        continue;
+      }
+      buf = zstdCompress(*buf, dictionary);
+    } else if (transId == LZ4_TRANSFORM) {
+      if (dataSize < minCompressBytes) {
+        it = writeTrans.erase(it);
+        continue;
+      }
+      buf = lz4Compress(*buf);
     } else if (transId == SNAPPY_TRANSFORM) {
       if (dataSize < minCompressBytes) {
         it = writeTrans.erase(it);
@@ -811,6 +1157,14 @@ string THeader::getPeerIdentity() {
   return "";
 }
 
+void THeader::setDictionaryId(uint32_t id) {
+  if (id != 0 && !TCompressionDictionary::get(id)) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "Unknown compression dictionary");
+  }
+  dictionaryId_ = id;
+}
+
 void THeader::setIdentity(const string& identity) {
   this->identity = identity;
 }
@@ -824,7 +1178,8 @@ unique_ptr<IOBuf> THeader::addHeader(unique_ptr<IOBuf> buf,
   if (clientType == THRIFT_HEADER_CLIENT_TYPE ||
       clientType == THRIFT_HEADER_SASL_CLIENT_TYPE) {
     if (transform) {
-      buf = THeader::transform(std::move(buf), writeTrans, minCompressBytes_);
+      buf = THeader::transform(std::move(buf), writeTrans, minCompressBytes_,
+                               writeDictionary_);
     }
   }
   size_t chainSize = buf->computeChainDataLength();
@@ -866,6 +1221,9 @@ unique_ptr<IOBuf> THeader::addHeader(unique_ptr<IOBuf> buf,
       * 5 + 4;
     // add approximate size of info headers
     headerSize += getMaxWriteHeadersSize();
+    if (dictionaryId_ != 0) {
+      headerSize += 5 + 5;  // infoId and dictionary ID (2 varints32)
+    }
 
     // Pkt size
     unique_ptr<IOBuf> header = IOBuf::create(14 + headerSize);
@@ -917,6 +1275,11 @@ unique_ptr<IOBuf> THeader::addHeader(unique_ptr<IOBuf> buf,
     // write non-persistent kv-headers
     flushInfoHeaders(pkt, writeHeaders_, infoIdType::KEYVALUE);
 
+    if (dictionaryId_ != 0) {
+      pkt += writeVarint32(infoIdType::DICTIONARY, pkt);
+      pkt += writeVarint32(dictionaryId_, pkt);
+    }
+
     // TODO(davejwatson) optimize this for writing twice/memcopy to pkt buffer.
     // See code in TBufferTransports
 
@@ -1033,6 +1396,16 @@ void THeader::setClientTimeout(std::chrono::milliseconds timeout) {
   setHeader(CLIENT_TIMEOUT_HEADER, folly::to<std::string>(timeout.count()));
 }
 
+bool THeader::getSkipIndex() const {
+  const auto& map = getHeaders();
+  auto iter = map.find(SKIP_INDEX_HEADER);
+  return iter != map.end() && iter->second == "1";
+}
+
+void THeader::setSkipIndex(bool skipIndex) {
+  setHeader(SKIP_INDEX_HEADER, skipIndex ? "1" : "0");
+}
+
 void THeader::useAsHttpClient(const std::string& host, const std::string& uri) {
   setClientType(THRIFT_HTTP_CLIENT_TYPE);
   httpClientParser_.reset(new THttpClientParser(host, uri));
@@ -67,11 +67,14 @@ namespace apache { namespace thrift { namespace transport {
 
 using apache::thrift::protocol::T_COMPACT_PROTOCOL;
 
+class TAdaptiveCompression;
+class TCompressionDictionary;
+
 /**
  * Class that will take an IOBuf and wrap it in some thrift headers.
  * see thrift/doc/HeaderFormat.txt for details.
  *
- * Supports transforms: zlib snappy hmac qlz
+ * Supports transforms: zlib snappy hmac qlz lz4 zstd
  * Supports headers: http-style key/value per request and per connection
  * other: Protocol Id and seq ID in header.
  *
@@ -94,6 +97,10 @@ class THeader {
     , flags_(0)
     , identity(s_identity)
     , minCompressBytes_(0)
+    , dictionaryId_(0)
+    , peerDictionaryId_(0)
+    , writeDictionary_(nullptr)
+    , recordReadTimes_(false)
   {
     setSupportedClients(nullptr);
   }
@@ -108,6 +115,10 @@ class THeader {
     , flags_(0)
     , identity(s_identity)
     , minCompressBytes_(0)
+    , dictionaryId_(0)
+    , peerDictionaryId_(0)
+    , writeDictionary_(nullptr)
+    , recordReadTimes_(false)
   {
     setSupportedClients(clientTypes);
   }
@@ -169,12 +180,14 @@ class THeader {
    * transformed data.
    *
    * @param IOBuf to transform.  Returns transformed IOBuf (or chain)
+   * @param dictionary used by ZSTD_TRANSFORM, if the peer has it
    * @return transformed data IOBuf
    */
   static std::unique_ptr<folly::IOBuf> transform(
     std::unique_ptr<folly::IOBuf>,
     std::vector<uint16_t>& writeTrans,
-    uint32_t minCompressBytes);
+    uint32_t minCompressBytes,
+    const TCompressionDictionary* dictionary = nullptr);
 
   uint16_t getNumTransforms(std::vector<uint16_t>& transforms) const {
     int trans = transforms.size();
@@ -251,6 +264,8 @@ class THeader {
     HMAC_TRANSFORM = 0x02,
     SNAPPY_TRANSFORM = 0x03,
     QLZ_TRANSFORM = 0x04,
+    LZ4_TRANSFORM = 0x05,
+    ZSTD_TRANSFORM = 0x06,
   };
 
   /**
@@ -319,6 +334,42 @@ class THeader {
     return minCompressBytes_;
   }
 
+  /**
+   * Let the server pick the compression transform of each reply from the
+   * statistics of its method instead of applying the write transforms as
+   * configured.  Shared by all the connections of a server.
+   */
+  void setAdaptiveCompression(
+      const std::shared_ptr<TAdaptiveCompression>& adaptive) {
+    adaptiveCompression_ = adaptive;
+  }
+
+  const std::shared_ptr<TAdaptiveCompression>& getAdaptiveCompression() {
+    return adaptiveCompression_;
+  }
+
+  /**
+   * Offer a registered TCompressionDictionary to the peer.  The ID is sent
+   * in the info section of every message; once the peer offers a
+   * dictionary this side has as well, ZSTD_TRANSFORM compresses with it.
+   * There is no extra round trip: messages are compressed without a
+   * dictionary until the first message from the peer arrives.
+   *
+   * 0 (the default) offers nothing.
+   */
+  void setDictionaryId(uint32_t id);
+
+  uint32_t getDictionaryId() const {
+    return dictionaryId_;
+  }
+
+  /**
+   * Dictionary offered by the peer that we have too, or nullptr
+   */
+  const TCompressionDictionary* getWriteDictionary() const {
+    return writeDictionary_;
+  }
+
   apache::thrift::concurrency::PriorityThreadManager::PRIORITY
   getCallPriority();
 
@@ -329,6 +380,40 @@ class THeader {
 
   void setClientTimeout(std::chrono::milliseconds timeout);
 
+  /**
+   * On a request, whether it was written with the skip index of the
+   * compact protocol (see CompactProtocolWriter::setSkipIndex()).  On a
+   * reply, whether the server reads requests written with it; replies
+   * themselves are always written without it.
+   *
+   * A client that wants to use the index sends the header as "0" until a
+   * reply carries it as "1".
+   */
+  bool getSkipIndex() const;
+
+  void setSkipIndex(bool skipIndex);
+
+  /**
+   * Record when removeHeader() has parsed the header of a message and when
+   * it has untransformed its data, for request tracing.  Off by default.
+   */
+  void setRecordReadTimes(bool record) {
+    recordReadTimes_ = record;
+  }
+
+  /**
+   * Times of the message last returned by removeHeader(), if they were
+   * recorded.  Only header format messages have them; they are the epoch
+   * otherwise.
+   */
+  std::chrono::steady_clock::time_point getHeaderParsedTime() const {
+    return headerParsedTime_;
+  }
+
+  std::chrono::steady_clock::time_point getUntransformedTime() const {
+    return untransformedTime_;
+  }
+
   /**
    * Sets the THeader up in HTTP CLIENT mode. host can be an empty string
    */
@@ -345,6 +430,9 @@ class THeader {
 
   static const uint32_t MAX_FRAME_SIZE = 0x3FFFFFFF;
 
+  // See getSkipIndex()
+  static const std::string SKIP_INDEX_HEADER;
+
  protected:
 
   void setBestClientType();
@@ -388,6 +476,15 @@ class THeader {
   VerifyMacCallback verifyCallback_;
 
   uint32_t minCompressBytes_;
+  std::shared_ptr<TAdaptiveCompression> adaptiveCompression_;
+
+  uint32_t dictionaryId_;
+  uint32_t peerDictionaryId_;
+  const TCompressionDictionary* writeDictionary_;
+
+  bool recordReadTimes_;
+  std::chrono::steady_clock::time_point headerParsedTime_;
+  std::chrono::steady_clock::time_point untransformedTime_;
 
   /**
    * Returns the maximum number of bytes that write k/v headers can take
@@ -406,6 +503,9 @@ class THeader {
       KEYVALUE = 1,
       // for persistent header
       PKEYVALUE = 2,
+      // compression dictionary ID offered by the sender, written last as
+      // older readers stop at the first infoId they do not know
+      DICTIONARY = 3,
       END        // signal the end of infoIds we can handle
     };
   };
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2014 Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <thrift/lib/cpp/transport/TLSTicketKeyManager.h>
+
+#include <string.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+#include <glog/logging.h>
+#include <thrift/lib/cpp/transport/TTransportException.h>
+
+using std::string;
+using std::vector;
+using namespace apache::thrift::concurrency;
+
+namespace apache { namespace thrift { namespace transport {
+
+const size_t TLSTicketKeyManager::kDefaultMaxOldKeys;
+const size_t TLSTicketKeyManager::kKeyPartSize;
+
+TLSTicketKeyManager::TLSTicketKeyManager(size_t maxOldKeys)
+  : maxOldKeys_(maxOldKeys) {
+  keys_.push_back(deriveKey(randomSecret()));
+}
+
+void TLSTicketKeyManager::attach(SSL_CTX* ctx) {
+  SSL_CTX_set_ex_data(ctx, getExDataIndex(), this);
+  SSL_CTX_set_tlsext_ticket_key_cb(ctx, ticketKeyCallback);
+}
+
+void TLSTicketKeyManager::setSecrets(const string& current,
+                                     const vector<string>& old) {
+  // An empty secret would give every server the same, public key
+  if (current.empty()) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "Empty ticket key secret");
+  }
+  std::deque<Key> keys;
+  keys.push_back(deriveKey(current));
+  for (const auto& secret : old) {
+    if (keys.size() > maxOldKeys_) {
+      break;
+    }
+    if (secret.empty()) {
+      throw TTransportException(TTransportException::BAD_ARGS,
+                                "Empty ticket key secret");
+    }
+    keys.push_back(deriveKey(secret));
+  }
+
+  RWGuard g(mutex_, true);
+  keys_.swap(keys);
+}
+
+void TLSTicketKeyManager::rotate() {
+  Key key = deriveKey(randomSecret());
+
+  RWGuard g(mutex_, true);
+  keys_.push_front(key);
+  while (keys_.size() > maxOldKeys_ + 1) {
+    keys_.pop_back();
+  }
+}
+
+size_t TLSTicketKeyManager::getNumKeys() const {
+  RWGuard g(mutex_);
+  return keys_.size();
+}
+
+TLSTicketKeyManager::Key TLSTicketKeyManager::deriveKey(
+    const string& secret) {
+  static_assert(2 * kKeyPartSize == SHA256_DIGEST_LENGTH,
+                "The HMAC and AES keys are the two halves of a digest");
+  Key key;
+  unsigned char digest[SHA256_DIGEST_LENGTH];
+  SHA256(reinterpret_cast<const unsigned char*>(secret.data()),
+         secret.size(),
+         digest);
+  memcpy(key.hmacKey, digest, kKeyPartSize);
+  memcpy(key.aesKey, digest + kKeyPartSize, kKeyPartSize);
+  // The name goes out in the clear with each ticket, so it is a hash of
+  // the keys rather than part of them
+  unsigned char nameDigest[SHA256_DIGEST_LENGTH];
+  SHA256(digest, sizeof(digest), nameDigest);
+  memcpy(key.name, nameDigest, kKeyPartSize);
+  return key;
+}
+
+string TLSTicketKeyManager::randomSecret() {
+  unsigned char secret[SHA256_DIGEST_LENGTH];
+  CHECK_EQ(RAND_bytes(secret, sizeof(secret)), 1)
+    << "Failed to generate a ticket key";
+  return string(reinterpret_cast<const char*>(secret), sizeof(secret));
+}
+
+int TLSTicketKeyManager::processTicket(unsigned char* keyName,
+                                       unsigned char* iv,
+                                       EVP_CIPHER_CTX* cipherCtx,
+                                       HMAC_CTX* hmacCtx,
+                                       int encrypt) {
+  RWGuard g(mutex_);
+
+  if (encrypt) {
+    const Key& key = keys_.front();
+    if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_128_cbc())) != 1) {
+      return -1;
+    }
+    memcpy(keyName, key.name, kKeyPartSize);
+    EVP_EncryptInit_ex(cipherCtx, EVP_aes_128_cbc(), nullptr, key.aesKey, iv);
+    HMAC_Init_ex(hmacCtx, key.hmacKey, kKeyPartSize, EVP_sha256(), nullptr);
+    return 1;
+  }
+
+  for (size_t i = 0; i < keys_.size(); ++i) {
+    const Key& key = keys_[i];
+    if (memcmp(keyName, key.name, kKeyPartSize) != 0) {
+      continue;
+    }
+    HMAC_Init_ex(hmacCtx, key.hmacKey, kKeyPartSize, EVP_sha256(), nullptr);
+    EVP_DecryptInit_ex(cipherCtx, EVP_aes_128_cbc(), nullptr, key.aesKey, iv);
+    // 2 asks OpenSSL to issue a ticket with the current key
+    return i == 0 ? 1 : 2;
+  }
+  // Unknown or expired key: fall back to a full handshake
+  return 0;
+}
+
+int TLSTicketKeyManager::ticketKeyCallback(SSL* ssl,
+                                           unsigned char* keyName,
+                                           unsigned char* iv,
+                                           EVP_CIPHER_CTX* cipherCtx,
+                                           HMAC_CTX* hmacCtx,
+                                           int encrypt) {
+  auto manager = static_cast<TLSTicketKeyManager*>(
+    SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), getExDataIndex()));
+  if (!manager) {
+    return encrypt ? -1 : 0;
+  }
+  return manager->processTicket(keyName, iv, cipherCtx, hmacCtx, encrypt);
+}
+
+int TLSTicketKeyManager::getExDataIndex() {
+  static int index = SSL_CTX_get_ex_new_index(
+    0, (void*)"TLSTicketKeyManager index", nullptr, nullptr, nullptr);
+  return index;
+}
+
+}}} // apache::thrift::transport
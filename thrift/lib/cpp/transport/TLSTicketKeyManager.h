@@ -0,0 +1,116 @@
+/*
+ * Copyright 2014 Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef THRIFT_TRANSPORT_TLSTICKETKEYMANAGER_H_
+#define THRIFT_TRANSPORT_TLSTICKETKEYMANAGER_H_ 1
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/ssl.h>
+#include <thrift/lib/cpp/concurrency/Mutex.h>
+
+namespace apache { namespace thrift { namespace transport {
+
+/**
+ * Keys for TLS session tickets (RFC 5077), with rotation.
+ *
+ * With tickets the client keeps its own session state, encrypted with a
+ * key only the servers know, so resuming it needs no server side cache.
+ * New tickets are encrypted with the current key; tickets encrypted with
+ * one of the previous keys are still accepted, and are replaced by a new
+ * ticket on resumption.
+ *
+ * Servers that are given the same secrets with setSecrets() accept each
+ * other's tickets.  Otherwise the manager starts with a random key and
+ * rotate() replaces it with another random one.  Either way, keys should
+ * be rotated every few hours so that a stolen key only exposes a short
+ * window of sessions.
+ *
+ * Install it with SSLContext::setTicketKeyManager().
+ */
+class TLSTicketKeyManager {
+ public:
+  static const size_t kDefaultMaxOldKeys = 2;
+
+  /**
+   * @param maxOldKeys Number of previous keys still accepted for
+   *                   decryption after a rotation.
+   */
+  explicit TLSTicketKeyManager(size_t maxOldKeys = kDefaultMaxOldKeys);
+
+  /**
+   * Install the manager on ctx.  It must outlive ctx;
+   * SSLContext::setTicketKeyManager() takes care of that.
+   */
+  void attach(SSL_CTX* ctx);
+
+  /**
+   * Derive the keys from secrets: current encrypts new tickets, old ones
+   * (most recent first) are only accepted for decryption.  Replaces all
+   * keys.  Only the first maxOldKeys old secrets are kept.
+   *
+   * @throws TTransportException if a secret is empty
+   */
+  void setSecrets(const std::string& current,
+                  const std::vector<std::string>& old);
+
+  /**
+   * Make a new random key current, keeping the previous one for
+   * decryption.
+   */
+  void rotate();
+
+  size_t getNumKeys() const;
+
+ private:
+  static const size_t kKeyPartSize = 16;
+
+  struct Key {
+    unsigned char name[kKeyPartSize];
+    unsigned char hmacKey[kKeyPartSize];
+    unsigned char aesKey[kKeyPartSize];
+  };
+
+  static Key deriveKey(const std::string& secret);
+  static std::string randomSecret();
+
+  int processTicket(unsigned char* keyName,
+                    unsigned char* iv,
+                    EVP_CIPHER_CTX* cipherCtx,
+                    HMAC_CTX* hmacCtx,
+                    int encrypt);
+
+  static int ticketKeyCallback(SSL* ssl,
+                               unsigned char* keyName,
+                               unsigned char* iv,
+                               EVP_CIPHER_CTX* cipherCtx,
+                               HMAC_CTX* hmacCtx,
+                               int encrypt);
+  static int getExDataIndex();
+
+  const size_t maxOldKeys_;
+  concurrency::ReadWriteMutex mutex_;
+  // Current key first
+  std::deque<Key> keys_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef THRIFT_TRANSPORT_TLSTICKETKEYMANAGER_H_
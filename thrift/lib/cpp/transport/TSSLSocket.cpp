@@ -27,6 +27,8 @@
 #include <openssl/ssl.h>
 #include <openssl/x509v3.h>
 #include <thrift/lib/cpp/concurrency/Mutex.h>
+#include <thrift/lib/cpp/transport/SSLSessionCache.h>
+#include <thrift/lib/cpp/transport/TLSTicketKeyManager.h>
 #ifdef __x86_64__
 #include <folly/SmallLocks.h>
 #include <folly/String.h>
@@ -310,6 +312,9 @@ SSLContext::~SSLContext() {
     SSL_CTX_free(ctx_);
     ctx_ = nullptr;
   }
+  // Only once ctx_ can no longer call them, and before OpenSSL is cleaned up
+  sessionCache_.reset();
+  ticketKeyManager_.reset();
 
 #ifdef OPENSSL_NPN_NEGOTIATED
   deleteNextProtocolsStrings();
@@ -948,6 +953,22 @@ void SSLContext::setOptions(long options) {
   }
 }
 
+void SSLContext::setSessionCache(
+    const std::shared_ptr<SSLSessionCache>& cache) {
+  sessionCache_ = cache;
+  if (cache) {
+    cache->attach(ctx_);
+  }
+}
+
+void SSLContext::setTicketKeyManager(
+    const std::shared_ptr<TLSTicketKeyManager>& manager) {
+  ticketKeyManager_ = manager;
+  if (manager) {
+    manager->attach(ctx_);
+  }
+}
+
 string SSLContext::getErrors(int errnoCopy) {
   string errors;
   ulong  errorCode;
@@ -29,6 +29,8 @@ namespace apache { namespace thrift { namespace transport {
 
 class PasswordCollector;
 class SSLContext;
+class SSLSessionCache;
+class TLSTicketKeyManager;
 class TSocketAddress;
 
 /**
@@ -457,6 +459,29 @@ class SSLContext {
     return ctx_;
   }
 
+  /**
+   * Use cache rather than OpenSSL's internal session cache.  Every socket
+   * accepted with this context shares it, whatever thread accepted it.
+   * Set it before the context is in use.
+   */
+  void setSessionCache(const std::shared_ptr<SSLSessionCache>& cache);
+
+  std::shared_ptr<SSLSessionCache> getSessionCache() const {
+    return sessionCache_;
+  }
+
+  /**
+   * Encrypt and decrypt session tickets with the keys of manager rather
+   * than with a key OpenSSL picks at random for this context.  Set it
+   * before the context is in use.
+   */
+  void setTicketKeyManager(
+      const std::shared_ptr<TLSTicketKeyManager>& manager);
+
+  std::shared_ptr<TLSTicketKeyManager> getTicketKeyManager() const {
+    return ticketKeyManager_;
+  }
+
   enum SSLLockType {
     LOCK_MUTEX,
     LOCK_SPINLOCK,
@@ -510,6 +535,9 @@ class SSLContext {
   bool checkPeerName_;
   std::string peerFixedName_;
   std::shared_ptr<PasswordCollector> collector_;
+  // Released after ctx_ is freed, as its callbacks use them
+  std::shared_ptr<SSLSessionCache> sessionCache_;
+  std::shared_ptr<TLSTicketKeyManager> ticketKeyManager_;
 #if OPENSSL_VERSION_NUMBER >= 0x1000105fL && !defined(OPENSSL_NO_TLSEXT)
   ServerNameCallback serverNameCb_;
   std::vector<ClientHelloCallback> clientHelloCbs_;
@@ -18,15 +18,22 @@
  */
 
 #include <thrift/lib/cpp/transport/THeader.h>
+#include <thrift/lib/cpp/transport/TAdaptiveCompression.h>
+#include <thrift/lib/cpp/transport/TCompressionDictionary.h>
 
 #include <boost/test/unit_test.hpp>
 #include <memory>
+#include <random>
+#include <zdict.h>
+#include <folly/Conv.h>
 #include <folly/io/IOBuf.h>
 #include <folly/io/IOBufQueue.h>
+#include <folly/io/Cursor.h>
 
 using namespace boost;
 using namespace apache::thrift;
 using namespace folly;
+using namespace folly::io;
 using namespace apache::thrift::transport;
 
 BOOST_AUTO_TEST_CASE(largetransform) {
@@ -53,6 +60,130 @@ BOOST_AUTO_TEST_CASE(largetransform) {
   buf = header.removeHeader(queue2.get(), needed);
 }
 
+BOOST_AUTO_TEST_CASE(transform_roundtrip) {
+  std::vector<uint16_t> transforms = {
+    THeader::ZLIB_TRANSFORM,
+    THeader::SNAPPY_TRANSFORM,
+    THeader::LZ4_TRANSFORM,
+    THeader::ZSTD_TRANSFORM,
+  };
+  std::mt19937 rng;
+  for (auto transId : transforms) {
+    for (size_t size : {0, 1, 100, 70000, 1000000}) {
+      // Half repetitive, half random, split into uneven pieces
+      std::string data;
+      for (size_t i = 0; i < size; i++) {
+        data.push_back(i % 2 ? 'a' + i % 7 : rng());
+      }
+      IOBufQueue queue;
+      for (size_t pos = 0; pos < size; ) {
+        size_t len = std::min<size_t>(size - pos, 1 + rng() % 40000);
+        queue.append(IOBuf::copyBuffer(data.data() + pos, len));
+        queue.append(IOBuf::create(0));
+        pos += len;
+      }
+      auto buf = queue.move();
+      if (!buf) {
+        buf = IOBuf::create(0);
+      }
+
+      std::vector<uint16_t> trans{transId};
+      buf = THeader::transform(std::move(buf), trans, 0);
+      BOOST_CHECK_EQUAL(trans.size(), 1);
+
+      // Feed the compressed data back in small chained pieces as well
+      IOBufQueue compressed;
+      Cursor cursor(buf.get());
+      while (!cursor.isAtEnd()) {
+        std::unique_ptr<IOBuf> piece;
+        cursor.clone(piece, std::min<size_t>(cursor.totalLength(), 777));
+        compressed.append(std::move(piece));
+      }
+      buf = THeader::untransform(compressed.move(), trans);
+      BOOST_CHECK_EQUAL(buf->computeChainDataLength(), size);
+      BOOST_CHECK(StringPiece(buf->coalesce()) == data);
+    }
+  }
+}
+
+// Small struct-like messages: the same field layout, different values
+std::string makeSmallMessage(std::mt19937& rng) {
+  std::string msg;
+  for (int field = 1; field <= 20; field++) {
+    msg.push_back(0x08);
+    msg.push_back(field);
+    msg.append(folly::to<std::string>("value_", field % 5, "_"));
+    for (int i = 0; i < 4; i++) {
+      msg.push_back('0' + rng() % 10);
+    }
+  }
+  return msg;
+}
+
+// Train and register a dictionary for makeSmallMessage()
+uint32_t addSmallMessageDictionary(std::mt19937& rng) {
+  std::string samples;
+  std::vector<size_t> sizes;
+  for (int i = 0; i < 2000; i++) {
+    auto msg = makeSmallMessage(rng);
+    samples.append(msg);
+    sizes.push_back(msg.size());
+  }
+  std::string data(4096, '\0');
+  size_t size = ZDICT_trainFromBuffer(&data[0], data.size(), samples.data(),
+                                      sizes.data(), sizes.size());
+  BOOST_REQUIRE(!ZDICT_isError(size));
+  data.resize(size);
+  return TCompressionDictionary::add(ByteRange(StringPiece(data)));
+}
+
+BOOST_AUTO_TEST_CASE(dictionary_compression) {
+  std::mt19937 rng;
+  uint32_t id = addSmallMessageDictionary(rng);
+  BOOST_CHECK(TCompressionDictionary::get(id) != nullptr);
+
+  THeader client;
+  client.setClientType(THRIFT_HEADER_CLIENT_TYPE);
+  client.setTransform(THeader::ZSTD_TRANSFORM);
+  client.setDictionaryId(id);
+  THeader server;
+  server.setDictionaryId(id);
+
+  auto roundtrip = [&](THeader& from, THeader& to, const std::string& msg) {
+    auto buf = from.addHeader(IOBuf::copyBuffer(msg));
+    size_t wireSize = buf->computeChainDataLength();
+    IOBufQueue queue;
+    queue.append(std::move(buf));
+    size_t needed;
+    buf = to.removeHeader(&queue, needed);
+    BOOST_REQUIRE(buf);
+    BOOST_CHECK(StringPiece(buf->coalesce()) == msg);
+    return wireSize;
+  };
+
+  // Neither side knows yet whether the other has the dictionary
+  auto msg = makeSmallMessage(rng);
+  size_t plain = roundtrip(client, server, msg);
+  BOOST_CHECK(client.getWriteDictionary() == nullptr);
+  BOOST_CHECK(server.getWriteDictionary() != nullptr);
+
+  // The reply already uses it, and so does the client from then on
+  roundtrip(server, client, msg);
+  BOOST_CHECK(client.getWriteDictionary() != nullptr);
+  size_t withDictionary = roundtrip(client, server, msg);
+  BOOST_CHECK(withDictionary * 2 < plain);
+
+  // A client that does not offer the dictionary never receives it
+  THeader other;
+  other.setClientType(THRIFT_HEADER_CLIENT_TYPE);
+  other.setTransform(THeader::ZSTD_TRANSFORM);
+  THeader otherServer;
+  otherServer.setDictionaryId(id);
+  roundtrip(other, otherServer, msg);
+  BOOST_CHECK(otherServer.getWriteDictionary() == nullptr);
+  roundtrip(otherServer, other, msg);
+}
+
 BOOST_AUTO_TEST_CASE(http_clear_header) {
   THeader header;
   header.useAsHttpClient("testhost", "testuri");
@@ -67,6 +198,86 @@ BOOST_AUTO_TEST_CASE(http_clear_header) {
   BOOST_CHECK(!header.getPersistentWriteHeaders().empty());
 }
 
+BOOST_AUTO_TEST_CASE(adaptive_compression) {
+  TAdaptiveCompression adaptive;
+  adaptive.setSampleRate(1);
+  adaptive.setMinBytesSavedPerUsec(0);
+
+  size_t buf_size = 64 * 1024;
+  std::unique_ptr<IOBuf> repetitive(IOBuf::create(buf_size));
+  for (size_t i = 0; i < buf_size; i++) {
+    repetitive->writableTail()[i] = "thrift"[i % 6];
+  }
+  repetitive->append(buf_size);
+
+  std::mt19937 rng;
+  std::unique_ptr<IOBuf> random(IOBuf::create(buf_size));
+  for (size_t i = 0; i < buf_size; i++) {
+    random->writableTail()[i] = rng();
+  }
+  random->append(buf_size);
+
+  for (int i = 0; i < 16; i++) {
+    std::vector<uint16_t> trans;
+    auto out = adaptive.transform(repetitive->clone(), "repetitive", trans, 0);
+    BOOST_CHECK_EQUAL(trans.size(), 1);
+    BOOST_CHECK(out->computeChainDataLength() < buf_size);
+    out = THeader::untransform(std::move(out), trans);
+    BOOST_CHECK(out->coalesce() == repetitive->coalesce());
+
+    trans = {THeader::ZLIB_TRANSFORM};
+    out = adaptive.transform(random->clone(), "random", trans, 0);
+    BOOST_CHECK(trans.empty());
+    BOOST_CHECK_EQUAL(out->computeChainDataLength(), buf_size);
+  }
+
+  // Below the minimum size nothing is compressed or sampled
+  std::vector<uint16_t> trans;
+  adaptive.transform(repetitive->clone(), "small", trans, buf_size + 1);
+  BOOST_CHECK(trans.empty());
+
+  auto stats = adaptive.getStats();
+  BOOST_CHECK_EQUAL(stats.size(), 2);
+  BOOST_CHECK_EQUAL(stats["repetitive"].messages, 16);
+  BOOST_CHECK(stats["repetitive"].transform != THeader::NONE);
+  BOOST_CHECK(stats["repetitive"].bytesOut < stats["repetitive"].bytesIn);
+  BOOST_CHECK_EQUAL(stats["random"].transform, THeader::NONE);
+  BOOST_CHECK_EQUAL(stats["random"].bytesOut, stats["random"].bytesIn);
+}
+
+BOOST_AUTO_TEST_CASE(adaptive_compression_dictionary) {
+  std::mt19937 rng;
+  auto dictionary =
+    TCompressionDictionary::get(addSmallMessageDictionary(rng));
+  BOOST_REQUIRE(dictionary != nullptr);
+
+  TAdaptiveCompression adaptive({THeader::ZSTD_TRANSFORM});
+  adaptive.setSampleRate(0);
+  adaptive.setMinBytesSavedPerUsec(0);
+
+  // Only the warm-up messages are sampled, but sampled and unsampled ones
+  // both compress with the dictionary
+  auto msg = makeSmallMessage(rng);
+  for (uint32_t i = 0; i < TAdaptiveCompression::kDefaultWarmupSamples + 2;
+       i++) {
+    std::vector<uint16_t> trans;
+    auto plain = adaptive.transform(IOBuf::copyBuffer(msg), "plain", trans, 0);
+    BOOST_CHECK(trans == std::vector<uint16_t>{THeader::ZSTD_TRANSFORM});
+    trans.clear();
+    auto out = adaptive.transform(IOBuf::copyBuffer(msg), "dictionary",
+                                  trans, 0, dictionary);
+    BOOST_CHECK(trans == std::vector<uint16_t>{THeader::ZSTD_TRANSFORM});
+    BOOST_CHECK(out->computeChainDataLength() * 2 <
+                plain->computeChainDataLength());
+    out = THeader::untransform(std::move(out), trans);
+    BOOST_CHECK(StringPiece(out->coalesce()) == msg);
+  }
+  auto stats = adaptive.getStats();
+  BOOST_CHECK_EQUAL(stats["dictionary"].sampled,
+                    TAdaptiveCompression::kDefaultWarmupSamples);
+  BOOST_CHECK(stats["dictionary"].bytesOut * 2 < stats["plain"].bytesOut);
+}
+
 boost::unit_test::test_suite* init_unit_test_suite(int argc, char* argv[]) {
   boost::unit_test::framework::master_test_suite().p_name.value =
     "THeaderTest";
@@ -55,6 +55,13 @@ uint32_t readVarint32(uint8_t const* ptr, int32_t* i32,
  */
 uint32_t readVarint64(uint8_t const* ptr, int64_t* i64,
                       uint8_t const* boundary) {
+  if (size_t(boundary - ptr) >= detail::kVarintWordBytes) {
+    uint32_t size = detail::decodeVarint(ptr, boundary - ptr, *i64);
+    if (size != 0) {
+      return size;
+    }
+  }
+
   uint32_t rsize = 0;
   uint64_t val = 0;
   int shift = 0;
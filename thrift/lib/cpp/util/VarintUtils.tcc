@@ -17,17 +17,103 @@
  * under the License.
  */
 
+#include <folly/Bits.h>
 #include <folly/io/Cursor.h>
 
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
 namespace apache { namespace thrift {
 
 namespace util {
 
+namespace detail {
+
+// Readable bytes decodeVarint needs at its argument
+const size_t kVarintWordBytes = sizeof(uint64_t);
+
+inline uint64_t loadVarintWord(const uint8_t* p) {
+  uint64_t word;
+  memcpy(&word, p, sizeof(word));
+  return folly::Endian::little(word);
+}
+
+/**
+ * Gather the low 7 bits of each byte of word, least significant byte
+ * first, into the low 56 bits of the result.
+ */
+inline uint64_t packVarintWord(uint64_t word) {
+#ifdef __BMI2__
+  return _pext_u64(word, 0x7f7f7f7f7f7f7f7fULL);
+#else
+  word &= 0x7f7f7f7f7f7f7f7fULL;
+  word = ((word & 0x7f007f007f007f00ULL) >> 1) |
+         (word & 0x007f007f007f007fULL);
+  word = ((word & 0x3fff00003fff0000ULL) >> 2) |
+         (word & 0x00003fff00003fffULL);
+  word = ((word & 0x0fffffff00000000ULL) >> 4) |
+         (word & 0x000000000fffffffULL);
+  return word;
+#endif
+}
+
+/**
+ * Decode the varint at p, of which avail >= kVarintWordBytes bytes are
+ * readable, without branching on its individual bytes.  The terminating
+ * byte is the lowest one without the continuation bit in the first word.
+ * Returns the number of bytes used, or 0 if the varint is invalid for T or
+ * needs more than avail bytes; the caller must then use the byte loop.
+ */
+template <class T>
+inline size_t decodeVarint(const uint8_t* p, size_t avail, T& value) {
+  static const size_t maxSize = (8 * sizeof(T) + 6) / 7;
+  uint64_t word = loadVarintWord(p);
+  uint64_t stop = ~word & 0x8080808080808080ULL;
+  if (stop != 0) {
+    size_t size = __builtin_ctzll(stop) / 8 + 1;
+    if (size > maxSize) {
+      return 0;
+    }
+    // stop ^ (stop - 1) keeps every bit up to the terminator's
+    value = T(packVarintWord(word & (stop ^ (stop - 1))));
+    return size;
+  }
+
+  // Only 64 bit varints are longer than 8 bytes, and end by the 10th
+  if (maxSize <= kVarintWordBytes || avail < 2 * kVarintWordBytes) {
+    return 0;
+  }
+  uint64_t high = loadVarintWord(p + kVarintWordBytes);
+  stop = ~high & 0x8080ULL;
+  if (stop == 0) {
+    return 0;
+  }
+  high = packVarintWord(high & (stop ^ (stop - 1)));
+  value = T(packVarintWord(word) | (high << 56));
+  return __builtin_ctzll(stop) / 8 + 1 + kVarintWordBytes;
+}
+
+} // detail namespace
+
 template <class T, class CursorT,
           typename std::enable_if<
             std::is_constructible<folly::io::Cursor, const CursorT&>::value,
             bool>::type = false>
 uint8_t readVarint(CursorT& c, T& value) {
+  auto data = c.peek();
+  if (data.second >= detail::kVarintWordBytes) {
+    size_t size = detail::decodeVarint(data.first, data.second, value);
+    if (size != 0) {
+      c.skip(size);
+      return size;
+    }
+  }
+
+  // Near the end of a buffer, or invalid
   // ceil(sizeof(T) * 8) / 7
   static const size_t maxSize = (8 * sizeof(T) + 6) / 7;
   T retVal = 0;
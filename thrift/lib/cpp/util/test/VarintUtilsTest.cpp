@@ -0,0 +1,101 @@
+/*
+ * Copyright 2014 Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <thrift/lib/cpp/util/VarintUtils.h>
+
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBufQueue.h>
+
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+using namespace apache::thrift::util;
+using folly::IOBuf;
+using folly::IOBufQueue;
+using folly::io::Cursor;
+using folly::io::QueueAppender;
+
+namespace {
+
+const std::vector<uint64_t> kValues = {
+  0, 1, 127, 128, 300, 16383, 16384, (1ULL << 21) - 1, 1ULL << 28,
+  std::numeric_limits<uint32_t>::max(), 1ULL << 35, 1ULL << 49,
+  (1ULL << 56) - 1, 1ULL << 56, 1ULL << 63,
+  std::numeric_limits<uint64_t>::max(),
+};
+
+// All of kValues, as varints, in buffers of chunkSize bytes
+std::unique_ptr<IOBuf> encode(size_t chunkSize) {
+  IOBufQueue queue;
+  QueueAppender appender(&queue, 1000);
+  for (auto value : kValues) {
+    writeVarint(appender, value);
+  }
+  auto data = queue.move()->moveToFbString();
+  IOBufQueue chunks;
+  for (size_t pos = 0; pos < data.size(); pos += chunkSize) {
+    chunks.append(IOBuf::copyBuffer(data.data() + pos,
+                                    std::min(chunkSize, data.size() - pos)));
+  }
+  return chunks.move();
+}
+
+}
+
+TEST(VarintUtils, ReadAcrossBuffers) {
+  // Small chunks use the byte loop, large ones the word at a time decoder
+  for (size_t chunkSize : {1, 3, 7, 8, 9, 16, 4096}) {
+    auto buf = encode(chunkSize);
+    Cursor c(buf.get());
+    for (auto value : kValues) {
+      uint64_t read;
+      readVarint(c, read);
+      EXPECT_EQ(value, read) << "chunk size " << chunkSize;
+    }
+    EXPECT_TRUE(c.isAtEnd());
+  }
+}
+
+TEST(VarintUtils, ReadPointer) {
+  auto data = encode(4096)->moveToFbString();
+  auto p = reinterpret_cast<const uint8_t*>(data.data());
+  auto end = p + data.size();
+  for (auto value : kValues) {
+    int64_t read;
+    p += readVarint64(p, &read, end);
+    EXPECT_EQ(value, uint64_t(read));
+  }
+  EXPECT_EQ(end, p);
+}
+
+TEST(VarintUtils, ReadTooLong) {
+  // Six bytes is too long for 32 bits, eleven for 64
+  std::vector<uint8_t> data(16, 0x80);
+  data[5] = 0x01;
+  auto buf = IOBuf::wrapBuffer(data.data(), data.size());
+  Cursor c(buf.get());
+  uint32_t value32;
+  EXPECT_THROW(readVarint(c, value32), std::out_of_range);
+
+  data[5] = 0x80;
+  data[10] = 0x01;
+  Cursor c64(buf.get());
+  uint64_t value64;
+  EXPECT_THROW(readVarint(c64, value64), std::out_of_range);
+}
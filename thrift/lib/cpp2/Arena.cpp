@@ -0,0 +1,120 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/lib/cpp2/Arena.h>
+
+#include <cstdlib>
+
+namespace apache { namespace thrift {
+
+const size_t Arena::kDefaultBlockSize;
+const size_t Arena::kAlignment;
+
+__thread Arena* Arena::current_ = nullptr;
+
+Arena::Arena(size_t blockSize)
+  : blockSize_(blockSize)
+  , blocks_(nullptr)
+  , begin_(nullptr)
+  , pos_(nullptr)
+  , end_(nullptr)
+  , used_(0)
+  , destructors_(nullptr) {}
+
+Arena::~Arena() {
+  runDestructors();
+  while (blocks_) {
+    Block* next = blocks_->next;
+    free(blocks_);
+    blocks_ = next;
+  }
+}
+
+char* Arena::startBlock(Block* block) {
+  block->next = blocks_;
+  blocks_ = block;
+  // The header is padded so that the data stays aligned
+  return reinterpret_cast<char*>(block) +
+    ((sizeof(Block) + kAlignment - 1) & ~(kAlignment - 1));
+}
+
+void* Arena::allocateSlow(size_t size) {
+  size_t header = (sizeof(Block) + kAlignment - 1) & ~(kAlignment - 1);
+  if (size > blockSize_ / 4) {
+    // Big allocations get a block of their own, behind the current one so
+    // that the rest of the current block is not wasted
+    auto block = static_cast<Block*>(malloc(header + size));
+    if (!block) {
+      throw std::bad_alloc();
+    }
+    block->size = header + size;
+    if (blocks_) {
+      block->next = blocks_->next;
+      blocks_->next = block;
+    } else {
+      startBlock(block);
+    }
+    used_ += size;
+    return reinterpret_cast<char*>(block) + header;
+  }
+
+  auto block = static_cast<Block*>(malloc(header + blockSize_));
+  if (!block) {
+    throw std::bad_alloc();
+  }
+  block->size = header + blockSize_;
+  used_ += pos_ - begin_;
+  begin_ = pos_ = startBlock(block);
+  end_ = begin_ + blockSize_;
+  void* p = pos_;
+  pos_ += size;
+  return p;
+}
+
+void Arena::runDestructors() {
+  while (destructors_) {
+    Destructor* destructor = destructors_;
+    destructors_ = destructor->next;
+    destructor->destroy(destructor->object);
+  }
+}
+
+void Arena::reset() {
+  runDestructors();
+
+  // Keep the oldest block, which is the last in the list
+  Block* first = nullptr;
+  while (blocks_) {
+    Block* next = blocks_->next;
+    if (next) {
+      free(blocks_);
+    } else {
+      first = blocks_;
+    }
+    blocks_ = next;
+  }
+  used_ = 0;
+  begin_ = pos_ = end_ = nullptr;
+  if (first) {
+    begin_ = pos_ = startBlock(first);
+    end_ = reinterpret_cast<char*>(first) + first->size;
+  }
+}
+
+}} // apache::thrift
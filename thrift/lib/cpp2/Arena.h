@@ -0,0 +1,330 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef THRIFT_CPP2_ARENA_H_
+#define THRIFT_CPP2_ARENA_H_
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include <boost/noncopyable.hpp>
+#include <folly/Hash.h>
+
+/**
+ * Arena allocation for structs generated with the arena flag.
+ *
+ * With the flag, the strings and containers of the generated types use
+ * ArenaAllocator.  An allocator made while an ArenaScope is active takes
+ * its memory from that scope's Arena, and hands nothing back: everything
+ * is freed at once by Arena::reset() or the Arena's destructor.  Outside
+ * of a scope, the allocator uses the heap, so the types behave like the
+ * ones generated without the flag.
+ *
+ * The usual way in is Serializer::deserialize(buf, arena), which reads a
+ * struct made by Arena::create() inside a scope.  reset() destroys such
+ * structs before it frees their memory, so members that own heap memory
+ * (cpp.ref pointers, IOBufs, lazy fields, ...) are released as usual.
+ * Nothing that points into the arena may be used after that; copies of
+ * an ArenaString are deep, so they may.
+ */
+
+namespace apache { namespace thrift {
+
+class Arena : private boost::noncopyable {
+ public:
+  static const size_t kDefaultBlockSize = 64 * 1024;
+
+  explicit Arena(size_t blockSize = kDefaultBlockSize);
+  ~Arena();
+
+  void* allocate(size_t size) {
+    size = (size + kAlignment - 1) & ~(kAlignment - 1);
+    if (size <= size_t(end_ - pos_)) {
+      void* p = pos_;
+      pos_ += size;
+      return p;
+    }
+    return allocateSlow(size);
+  }
+
+  /**
+   * Constructs a T in the arena, with the arena current so that its
+   * members allocate from it too.  reset() destroys it.
+   */
+  template <class T, class... Args>
+  T* create(Args&&... args);
+
+  /**
+   * Destroys the objects made by create(), newest first, then frees
+   * everything allocated from the arena, keeping its first block for the
+   * next use.
+   */
+  void reset();
+
+  // Bytes handed out since the last reset
+  size_t bytesUsed() const {
+    return used_ + (pos_ - begin_);
+  }
+
+  // The arena of the innermost active ArenaScope on this thread, or null
+  static Arena* current() {
+    return current_;
+  }
+
+ private:
+  friend class ArenaScope;
+
+  struct Block {
+    Block* next;
+    size_t size;
+  };
+
+  // An object made by create(), to destroy on reset()
+  struct Destructor {
+    Destructor* next;
+    void (*destroy)(void*);
+    void* object;
+  };
+
+  template <class T>
+  static void destroy(void* object) {
+    static_cast<T*>(object)->~T();
+  }
+
+  void runDestructors();
+
+  static const size_t kAlignment = 2 * sizeof(void*);
+
+  void* allocateSlow(size_t size);
+  char* startBlock(Block* block);
+
+  const size_t blockSize_;
+  Block* blocks_;
+  char* begin_;
+  char* pos_;
+  char* end_;
+  // Bytes used in the blocks before the current one
+  size_t used_;
+  // Newest first
+  Destructor* destructors_;
+
+  static __thread Arena* current_;
+};
+
+/**
+ * Makes arena current on this thread for its lifetime.  Scopes nest.
+ */
+class ArenaScope : private boost::noncopyable {
+ public:
+  explicit ArenaScope(Arena* arena)
+    : previous_(Arena::current_) {
+    Arena::current_ = arena;
+  }
+
+  ~ArenaScope() {
+    Arena::current_ = previous_;
+  }
+
+ private:
+  Arena* previous_;
+};
+
+template <class T, class... Args>
+T* Arena::create(Args&&... args) {
+  ArenaScope scope(this);
+  if (std::is_trivially_destructible<T>::value) {
+    return new (allocate(sizeof(T))) T(std::forward<Args>(args)...);
+  }
+  // The record comes first, so that nothing is left to undo if T throws
+  auto destructor = static_cast<Destructor*>(allocate(sizeof(Destructor)));
+  T* object = new (allocate(sizeof(T))) T(std::forward<Args>(args)...);
+  destructor->next = destructors_;
+  destructor->destroy = &Arena::destroy<T>;
+  destructor->object = object;
+  destructors_ = destructor;
+  return object;
+}
+
+/**
+ * Allocator of the arena current when it was default constructed, or of
+ * the heap if there was none.  Copies of a container are made with the
+ * arena current at the time of the copy.
+ */
+template <class T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+
+  typedef std::false_type propagate_on_container_copy_assignment;
+  typedef std::true_type propagate_on_container_move_assignment;
+  typedef std::true_type propagate_on_container_swap;
+
+  template <class U>
+  struct rebind {
+    typedef ArenaAllocator<U> other;
+  };
+
+  ArenaAllocator()
+    : arena_(Arena::current()) {}
+
+  explicit ArenaAllocator(Arena* arena)
+    : arena_(arena) {}
+
+  template <class U>
+  /* implicit */ ArenaAllocator(const ArenaAllocator<U>& other)
+    : arena_(other.arena()) {}
+
+  T* allocate(size_t n) {
+    if (arena_) {
+      return static_cast<T*>(arena_->allocate(n * sizeof(T)));
+    }
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, size_t /* n */) {
+    if (!arena_) {
+      ::operator delete(p);
+    }
+  }
+
+  template <class U, class... Args>
+  void construct(U* p, Args&&... args) {
+    new (p) U(std::forward<Args>(args)...);
+  }
+
+  template <class U>
+  void destroy(U* p) {
+    p->~U();
+  }
+
+  size_t max_size() const {
+    return size_t(-1) / sizeof(T);
+  }
+
+  ArenaAllocator select_on_container_copy_construction() const {
+    return ArenaAllocator();
+  }
+
+  Arena* arena() const {
+    return arena_;
+  }
+
+ private:
+  Arena* arena_;
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() != b.arena();
+}
+
+/**
+ * std::basic_string with ArenaAllocator.  A copy-on-write basic_string
+ * shares the buffer of the string it is copied from, whatever the
+ * allocators; copies of an ArenaString get their own buffer instead, from
+ * the arena current at the time of the copy, so they stay valid after the
+ * original's arena is reset.
+ */
+class ArenaString : public std::basic_string<char,
+                                             std::char_traits<char>,
+                                             ArenaAllocator<char>> {
+ public:
+  typedef std::basic_string<char, std::char_traits<char>,
+                            ArenaAllocator<char>> Base;
+
+  using Base::Base;
+
+  ArenaString() {}
+
+  ArenaString(const ArenaString& other)
+    : Base(other.data(), other.size()) {}
+
+  ArenaString(ArenaString&& other) noexcept
+    : Base(std::move(other)) {}
+
+  /* implicit */ ArenaString(const Base& other)
+    : Base(other.data(), other.size()) {}
+
+  /* implicit */ ArenaString(Base&& other)
+    : Base(std::move(other)) {}
+
+  ArenaString& operator=(const ArenaString& other) {
+    if (this != &other) {
+      assign(other.data(), other.size());
+    }
+    return *this;
+  }
+
+  ArenaString& operator=(ArenaString&& other) {
+    Base::operator=(std::move(other));
+    return *this;
+  }
+
+  ArenaString& operator=(const Base& other) {
+    if (this != &other) {
+      assign(other.data(), other.size());
+    }
+    return *this;
+  }
+
+  ArenaString& operator=(Base&& other) {
+    Base::operator=(std::move(other));
+    return *this;
+  }
+
+  ArenaString& operator=(const char* str) {
+    Base::operator=(str);
+    return *this;
+  }
+
+  ArenaString& operator=(char c) {
+    Base::operator=(c);
+    return *this;
+  }
+};
+
+}} // apache::thrift
+
+namespace std {
+
+template <>
+struct hash<apache::thrift::ArenaString> {
+  size_t operator()(const apache::thrift::ArenaString& str) const {
+    return folly::hash::fnv64_buf(str.data(), str.size());
+  }
+};
+
+} // std
+
+#endif // #ifndef THRIFT_CPP2_ARENA_H_
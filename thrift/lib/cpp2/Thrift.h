@@ -19,6 +19,9 @@
 
 #include <thrift/lib/cpp/Thrift.h>
 
+#include <atomic>
+#include <type_traits>
+
 namespace apache { namespace thrift {
 
 enum FragileConstructor {
@@ -57,6 +60,67 @@ class Cpp2Ops {
   static uint32_t serializedSizeZC(P*, const T*);
 };
 
+/**
+ * Specialized to std::true_type in generated code (with the size_hints
+ * flag) for types whose output buffer is sized from previous writes
+ * rather than by a serializedSizeZC pass before every write.
+ */
+template <class T>
+struct HasSizeHint : std::false_type {};
+
+/**
+ * Running estimate of the serialized size of T written with protocol P.
+ * It grows at once to any larger size written and shrinks slowly, so the
+ * buffer reserved from it is rarely too small; writing past it only costs
+ * another allocation.  Racing updates may be lost, which is harmless.
+ */
+template <class T, class P>
+class SerializedSizeHint {
+ public:
+  static uint32_t get() {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+  static void update(uint32_t size) {
+    uint32_t hint = size_.load(std::memory_order_relaxed);
+    hint = size > hint ? size : hint - (hint - size) / 8;
+    size_.store(hint, std::memory_order_relaxed);
+  }
+
+ private:
+  static std::atomic<uint32_t> size_;
+};
+
+template <class T, class P>
+std::atomic<uint32_t> SerializedSizeHint<T, P>::size_(0);
+
+/**
+ * Bytes to reserve before writing obj with prot: its size hint once one
+ * has been learned, serializedSizeZC otherwise.
+ */
+template <class P, class T>
+uint32_t serializedSizeHint(P* prot, const T* obj) {
+  if (HasSizeHint<T>::value) {
+    uint32_t hint = SerializedSizeHint<T, P>::get();
+    if (hint != 0) {
+      return hint;
+    }
+  }
+  return Cpp2Ops<T>::serializedSizeZC(prot, obj);
+}
+
+/**
+ * Cpp2Ops<T>::write, also updating the size hint of T if it has one.
+ */
+template <class P, class T>
+uint32_t writeWithSizeHint(P* prot, const T* obj) {
+  uint32_t size = Cpp2Ops<T>::write(prot, obj);
+  if (HasSizeHint<T>::value) {
+    SerializedSizeHint<T, P>::update(size);
+  }
+  return size;
+}
+
 }} // apache::thrift
 
 #endif // #ifndef THRIFT_CPP2_H_
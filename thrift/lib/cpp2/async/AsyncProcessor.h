@@ -19,6 +19,7 @@
 
 #include <thrift/lib/cpp/TProcessor.h>
 #include <thrift/lib/cpp/async/TEventBase.h>
+#include <thrift/lib/cpp/transport/TAdaptiveCompression.h>
 #include <thrift/lib/cpp/transport/THeader.h>
 #include <thrift/lib/cpp/concurrency/Thread.h>
 #include <thrift/lib/cpp/concurrency/ThreadManager.h>
@@ -43,11 +44,14 @@ class EventTask : public virtual apache::thrift::concurrency::Runnable {
   EventTask(std::function<void()>&& taskFunc,
   apache::thrift::ResponseChannel::Request* req,
     apache::thrift::async::TEventBase* base,
-    bool oneway)
+    bool oneway,
+    std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::time_point())
       : taskFunc_(std::move(taskFunc))
       , req_(req)
       , base_(base)
-      , oneway_(oneway) {
+      , oneway_(oneway)
+      , deadline_(deadline) {
 }
 
   void run() {
@@ -65,18 +69,33 @@ class EventTask : public virtual apache::thrift::concurrency::Runnable {
   }
 
   void expired() {
-    if (!oneway_) {
-      auto req = req_;
-      if (req) {
-        base_->runInEventBaseThread([req] () {
-            req->sendErrorWrapped(
-                folly::make_exception_wrapper<TApplicationException>(
-                  "Failed to add task to queue, too full"),
-                kQueueOverloadedErrorCode);
-            delete req;
-          });
-      }
+    auto req = req_;
+    if (!req) {
+      return;
     }
+    // Expired either because the client's deadline passed while queued,
+    // or because the queue was too slow (codel)
+    bool oneway = oneway_;
+    bool timedOut =
+      deadline_ != std::chrono::steady_clock::time_point() &&
+      std::chrono::steady_clock::now() >= deadline_;
+    base_->runInEventBaseThread([req, oneway, timedOut] () {
+        if (oneway) {
+          // Nobody to tell
+        } else if (timedOut) {
+          req->sendErrorWrapped(
+              folly::make_exception_wrapper<TApplicationException>(
+                TApplicationException::TApplicationExceptionType::TIMEOUT,
+                "Task expired"),
+              kTaskExpiredErrorCode);
+        } else {
+          req->sendErrorWrapped(
+              folly::make_exception_wrapper<TApplicationException>(
+                "Failed to add task to queue, too full"),
+              kQueueOverloadedErrorCode);
+        }
+        delete req;
+      });
   }
 
  private:
@@ -84,6 +103,7 @@ class EventTask : public virtual apache::thrift::concurrency::Runnable {
   apache::thrift::ResponseChannel::Request* req_;
   apache::thrift::async::TEventBase* base_;
   bool oneway_;
+  std::chrono::steady_clock::time_point deadline_;
 };
 
 class PriorityEventTask : public apache::thrift::concurrency::PriorityRunnable,
@@ -94,8 +114,10 @@ class PriorityEventTask : public apache::thrift::concurrency::PriorityRunnable,
     std::function<void()>&& taskFunc,
     apache::thrift::ResponseChannel::Request* req,
     apache::thrift::async::TEventBase* base,
-    bool oneway)
-      : EventTask(std::move(taskFunc), req, base, oneway)
+    bool oneway,
+    std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::time_point())
+      : EventTask(std::move(taskFunc), req, base, oneway, deadline)
       , priority_(priority) {}
 
   apache::thrift::concurrency::PriorityThreadManager::PRIORITY
@@ -128,6 +150,14 @@ class GeneratedAsyncProcessor : public AsyncProcessor {
   virtual ~GeneratedAsyncProcessor() {}
 
  protected:
+  // Reads the request with the skip index if the client wrote it with one
+  template <typename ProtocolIn>
+  static void setRequestSkipIndex(ProtocolIn* iprot,
+                                  Cpp2RequestContext* context) {
+    auto header = context ? context->getHeader() : nullptr;
+    apache::thrift::setSkipIndex(iprot, header && header->getSkipIndex());
+  }
+
   template <typename ProtocolIn, typename Args>
   static void deserializeRequest(Args& args,
                                  folly::IOBuf* buf,
@@ -150,12 +180,12 @@ class GeneratedAsyncProcessor : public AsyncProcessor {
                                              apache::thrift::ContextStack* ctx,
                                              const Result& result) {
     folly::IOBufQueue queue(folly::IOBufQueue::cacheChainLength());
-    size_t bufSize = Cpp2Ops<Result>::serializedSizeZC(prot, &result);
+    size_t bufSize = serializedSizeHint(prot, &result);
     bufSize += prot->serializedMessageSize(method);
     prot->setOutput(&queue, bufSize);
     ctx->preWrite();
     prot->writeMessageBegin(method, apache::thrift::T_REPLY, protoSeqId);
-    Cpp2Ops<Result>::write(prot, &result);
+    writeWithSizeHint(prot, &result);
     prot->writeMessageEnd();
     ::apache::thrift::SerializedMessage smsg;
     smsg.protocolType = prot->protocolType();
@@ -204,9 +234,20 @@ class GeneratedAsyncProcessor : public AsyncProcessor {
         req->sendReply(std::unique_ptr<folly::IOBuf>());
       }
     }
+    // Let the thread manager drop the task once the client stops waiting
+    auto deadline = ctx ? ctx->getDeadline() :
+      std::chrono::steady_clock::time_point();
+    int64_t expiration = 0;
+    if (deadline != std::chrono::steady_clock::time_point()) {
+      expiration = std::max<int64_t>(
+        1,
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - std::chrono::steady_clock::now()).count());
+    }
     auto preq = req.get();
     auto iprot_holder = folly::makeMoveWrapper(std::move(iprot));
     auto buf_mw = folly::makeMoveWrapper(std::move(buf));
+    preq->markTrace(apache::thrift::RequestTrace::QUEUE_ENTER);
     try {
       tm->add(
         std::make_shared<apache::thrift::PriorityEventTask>(
@@ -214,6 +255,7 @@ class GeneratedAsyncProcessor : public AsyncProcessor {
           [=]() mutable {
             auto req_mw = folly::makeMoveWrapper(
               std::unique_ptr<apache::thrift::ResponseChannel::Request>(preq));
+            (*req_mw)->markTrace(apache::thrift::RequestTrace::QUEUE_EXIT);
             if ((*req_mw)->getTimestamps().processBegin != 0) {
               // Since this request was queued, reset the processBegin
               // time to the actual start time, and not the queue time.
@@ -234,9 +276,9 @@ class GeneratedAsyncProcessor : public AsyncProcessor {
                         std::move(*iprot_holder), ctx, eb, tm);
 
           },
-          preq, eb, oneway),
+          preq, eb, oneway, deadline),
         0, // timeout
-        0, // expiration
+        expiration,
         true, // cancellable
         true); // numa
       req.release();
@@ -286,6 +328,7 @@ class HandlerCallbackBase {
       , eb_(nullptr)
       , tm_(nullptr)
       , reqCtx_(nullptr)
+      , method_(nullptr)
       , protoSeqId_(0) {}
 
   HandlerCallbackBase(
@@ -303,7 +346,17 @@ class HandlerCallbackBase {
       eb_(eb),
       tm_(tm),
       reqCtx_(reqCtx),
+      method_(ctx_ ? ctx_->getMethod() : nullptr),
       protoSeqId_(0) {
+    // The generated code makes the callback once the arguments are read,
+    // right before it calls the handler
+    auto trace = req_ ? req_->getTrace() : nullptr;
+    if (trace) {
+      trace->mark(RequestTrace::HANDLER_BEGIN);
+      if (method_) {
+        trace->setMethod(method_);
+      }
+    }
   }
 
   virtual ~HandlerCallbackBase() {
@@ -417,8 +470,15 @@ class HandlerCallbackBase {
     tm_ = other.tm_;
   }
 
+  void markTrace(RequestTrace::Event event) {
+    if (req_) {
+      req_->markTrace(event);
+    }
+  }
+
   // Always called in IO thread
   virtual void doException(std::exception_ptr ex) {
+    markTrace(RequestTrace::HANDLER_END);
     if (req_ == nullptr) {
       LOG(ERROR) << folly::exceptionStr(ex);
     } else {
@@ -431,13 +491,24 @@ class HandlerCallbackBase {
   virtual void transform(folly::IOBufQueue& queue) {
     // Do any compression or other transforms in this thread, the same thread
     // that serialization happens on.
+    auto adaptive = reqCtx_->getAdaptiveCompression();
+    if (adaptive && method_) {
+      queue.append(adaptive->transform(queue.move(),
+                                       method_,
+                                       reqCtx_->getTransforms(),
+                                       reqCtx_->getMinCompressBytes(),
+                                       reqCtx_->getWriteDictionary()));
+      return;
+    }
     queue.append(
       transport::THeader::transform(queue.move(),
                                     reqCtx_->getTransforms(),
-                                    reqCtx_->getMinCompressBytes()));
+                                    reqCtx_->getMinCompressBytes(),
+                                    reqCtx_->getWriteDictionary()));
   }
 
   virtual void doExceptionWrapped(folly::exception_wrapper ew) {
+    markTrace(RequestTrace::HANDLER_END);
     if (req_ == nullptr) {
       LOG(ERROR) << ew.what();
     } else {
@@ -459,6 +530,8 @@ class HandlerCallbackBase {
   apache::thrift::async::TEventBase* eb_;
   apache::thrift::concurrency::ThreadManager* tm_;
   Cpp2RequestContext* reqCtx_;
+  // Name of the called method, from the ContextStack
+  const char* method_;
 
   int32_t protoSeqId_;
 };
@@ -513,10 +586,13 @@ class HandlerCallback : public HandlerCallbackBase {
   // Always called in IO thread
   virtual void doResult(const T& r) {
     assert(cp_);
+    markTrace(RequestTrace::HANDLER_END);
     auto queue = cp_(this->protoSeqId_,
                      std::move(this->ctx_),
                      r);
+    markTrace(RequestTrace::SERIALIZED);
     transform(queue);
+    markTrace(RequestTrace::TRANSFORMED);
     sendReply(std::move(queue), r);
   }
 
@@ -619,11 +695,14 @@ class HandlerCallback<std::unique_ptr<T>> : public HandlerCallbackBase {
  protected:
   virtual void doResult(const T& r) {
     assert(cp_);
+    markTrace(RequestTrace::HANDLER_END);
     auto queue = cp_(this->protoSeqId_,
                      std::move(this->ctx_),
                      r);
+    markTrace(RequestTrace::SERIALIZED);
 
     transform(queue);
+    markTrace(RequestTrace::TRANSFORMED);
 
     if (getEventBase()->isInEventBaseThread()) {
       req_->sendReply(queue.move());
@@ -686,9 +765,12 @@ class HandlerCallback<void> : public HandlerCallbackBase {
  protected:
   virtual void doDone() {
     assert(cp_);
+    markTrace(RequestTrace::HANDLER_END);
     auto queue = cp_(this->protoSeqId_,
                      std::move(this->ctx_));
+    markTrace(RequestTrace::SERIALIZED);
     transform(queue);
+    markTrace(RequestTrace::TRANSFORMED);
 
     if (getEventBase()->isInEventBaseThread()) {
       req_->sendReply(queue.move());
@@ -18,6 +18,8 @@
  */
 
 #include <thrift/lib/cpp2/async/Cpp2Channel.h>
+#include <thrift/lib/cpp2/async/ReadBufferPool.h>
+#include <thrift/lib/cpp/async/TAsyncSocket.h>
 #include <thrift/lib/cpp/transport/TTransportException.h>
 #include <thrift/lib/cpp/concurrency/Util.h>
 
@@ -36,10 +38,14 @@ using namespace apache::thrift::transport;
 using apache::thrift::async::TEventBase;
 using namespace apache::thrift::concurrency;
 using apache::thrift::async::TAsyncTransport;
+using apache::thrift::async::TAsyncSocket;
 
 namespace apache { namespace thrift {
 
 const uint32_t Cpp2Channel::DEFAULT_BUFFER_SIZE;
+const uint32_t Cpp2Channel::kMaxPartialFrameCopy;
+const uint32_t Cpp2Channel::kFramesPerSlab;
+const uint32_t Cpp2Channel::kMaxSlabSize;
 
 Cpp2Channel::Cpp2Channel(
   const std::shared_ptr<TAsyncTransport>& transport,
@@ -49,10 +55,18 @@ Cpp2Channel::Cpp2Channel(
     , queue_(new IOBufQueue)
     , readBufferSize_(DEFAULT_BUFFER_SIZE)
     , remaining_(readBufferSize_)
+    , avgFrameSize_(0)
     , recvCallback_(nullptr)
     , closing_(false)
     , eofInvoked_(false)
+    , sendsBytes_(0)
+    , traceRequests_(false)
     , queueSends_(true)
+    , maxSendBytes_(0)
+    , maxSendDelay_(0)
+    , sendTimeout_(this)
+    , numMessagesSent_(0)
+    , numWrites_(0)
     , protectionHandler_(std::move(protectionHandler))
     , framingHandler_(std::move(framingHandler)) {
   if (!protectionHandler_) {
@@ -83,6 +97,12 @@ void Cpp2Channel::attachEventBase(
 }
 
 void Cpp2Channel::detachEventBase() {
+  // Don't leave queued sends behind on the old event base
+  if (sends_) {
+    flushSends();
+  }
+  sendTimeout_.detach();
+
   if (transport_->getReadCallback() == this) {
     transport_->setReadCallback(nullptr);
   }
@@ -95,8 +115,32 @@ TEventBase* Cpp2Channel::getEventBase() {
 }
 
 void Cpp2Channel::getReadBuffer(void** bufReturn, size_t* lenReturn) {
-  // If remaining_ > readBufferSize_, preallocate only allocates
-  // readBufferSize_ chunks at a time.
+  const IOBuf* head = queue_->front();
+  const IOBuf* tail = head ? head->prev() : nullptr;
+  if (!tail || tail->isSharedOne() || tail->tailroom() < readBufferSize_) {
+    // Need a new buffer, take it from this thread's pool.
+    auto& pool = ReadBufferPool::get();
+    size_t partial = head ? head->computeChainDataLength() : 0;
+    if (remaining_ > readBufferSize_ && partial > 0 &&
+        partial <= kMaxPartialFrameCopy) {
+      // We are in the middle of a large frame.  Read the rest of it right
+      // behind a copy of the little we already have, so the whole frame
+      // ends up in one buffer and nobody has to coalesce it later.
+      unique_ptr<IOBuf> buf = pool.allocate(partial + remaining_);
+      Cursor c(head);
+      c.pull(buf->writableTail(), partial);
+      buf->append(partial);
+      queue_->move();
+      queue_->append(std::move(buf));
+    } else {
+      // Small frames share one slab, sized from the frames seen so far.
+      size_t slabSize = std::max<size_t>(readBufferSize_,
+                                         avgFrameSize_ * kFramesPerSlab);
+      slabSize = std::min<size_t>(slabSize, kMaxSlabSize);
+      queue_->append(pool.allocate(std::max<size_t>(remaining_, slabSize)));
+    }
+  }
+
   pair<void*, uint32_t> data = queue_->preallocate(readBufferSize_,
                                                    remaining_);
 
@@ -111,9 +155,10 @@ void Cpp2Channel::readDataAvailable(size_t len) noexcept {
   DestructorGuard dg(this);
 
   queue_->postallocate(len);
+  uint64_t readTime = traceRequests_ ? RequestTrace::now() : 0;
 
   if (recvCallback_ && recvCallback_->shouldSample() && !sample_) {
-    sample_.reset(new RecvCallback::sample);
+    sample_.reset(new RecvCallback::sample());
     sample_->readBegin = Util::currentTimeUsec();
   }
 
@@ -173,9 +218,21 @@ void Cpp2Channel::readDataAvailable(size_t len) noexcept {
       continue;
     }
 
+    // Track a moving average of frame sizes to size read slabs
+    size_t frameSize = unframed->computeChainDataLength();
+    avgFrameSize_ = avgFrameSize_ - avgFrameSize_ / 8 + frameSize / 8;
+
     if (sample_) {
       sample_->readEnd = Util::currentTimeUsec();
     }
+    if (traceRequests_) {
+      // Without sampling the sample only carries the trace
+      if (!sample_) {
+        sample_.reset(new RecvCallback::sample());
+      }
+      sample_->trace.reset(new RequestTrace);
+      sample_->trace->times[RequestTrace::READ_END] = readTime;
+    }
     recvCallback_->messageReceived(std::move(unframed), std::move(sample_));
     if (closing_) {
       return; // don't call more callbacks if we are going to be destroyed
@@ -251,6 +308,7 @@ void Cpp2Channel::sendMessage(SendCallback* callback,
 
   buf = framingHandler_->addFrame(std::move(buf));
   buf = protectionHandler_->encrypt(std::move(buf));
+  ++numMessagesSent_;
 
   if (!queueSends_) {
     // Send immediately.
@@ -259,21 +317,21 @@ void Cpp2Channel::sendMessage(SendCallback* callback,
       cbs.push_back(callback);
     }
     sendCallbacks_.push_back(std::move(cbs));
+    ++numWrites_;
     transport_->writeChain(this, std::move(buf));
   } else {
     // Delay sends to optimize for fewer syscalls
+    sendsBytes_ += buf->computeChainDataLength();
     if (!sends_) {
-      DCHECK(!isLoopCallbackScheduled());
       // Buffer all the sends, and call writev once per event loop.
       sends_ = std::move(buf);
-      getEventBase()->runInLoop(this);
+      scheduleSends();
       std::vector<SendCallback*> cbs;
       if (callback) {
         cbs.push_back(callback);
       }
       sendCallbacks_.push_back(std::move(cbs));
     } else {
-      DCHECK(isLoopCallbackScheduled());
       sends_->prependChain(std::move(buf));
       if (callback) {
         sendCallbacks_.back().push_back(callback);
@@ -282,14 +340,52 @@ void Cpp2Channel::sendMessage(SendCallback* callback,
     if (callback) {
       callback->sendQueued();
     }
+    if (maxSendBytes_ > 0 && sendsBytes_ >= maxSendBytes_) {
+      flushSends();
+    }
   }
 }
 
-void Cpp2Channel::runLoopCallback() noexcept {
+void Cpp2Channel::scheduleSends() {
+  if (maxSendDelay_ > std::chrono::milliseconds(0)) {
+    DCHECK(!sendTimeout_.isScheduled());
+    sendTimeout_.schedule(getEventBase(), maxSendDelay_);
+  } else {
+    DCHECK(!isLoopCallbackScheduled());
+    getEventBase()->runInLoop(this);
+  }
+}
+
+void Cpp2Channel::flushSends() {
   assert(sends_);
+  if (isLoopCallbackScheduled()) {
+    cancelLoopCallback();
+  }
+  sendTimeout_.cancelTimeout();
+  sendsBytes_ = 0;
+  ++numWrites_;
   transport_->writeChain(this, std::move(sends_));
 }
 
+void Cpp2Channel::runLoopCallback() noexcept {
+  flushSends();
+}
+
+bool Cpp2Channel::setZeroCopy(bool enable) {
+  auto socket = dynamic_cast<TAsyncSocket*>(transport_.get());
+  if (!socket) {
+    return !enable;
+  }
+  return socket->setZeroCopy(enable);
+}
+
+void Cpp2Channel::setZeroCopyThreshold(size_t threshold) {
+  auto socket = dynamic_cast<TAsyncSocket*>(transport_.get());
+  if (socket) {
+    socket->setZeroCopyThreshold(threshold);
+  }
+}
+
 void Cpp2Channel::setReceiveCallback(RecvCallback* callback) {
   if (recvCallback_ == callback) {
     return;
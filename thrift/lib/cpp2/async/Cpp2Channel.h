@@ -22,10 +22,12 @@
 #include <thrift/lib/cpp2/async/SaslEndpoint.h>
 #include <thrift/lib/cpp2/async/MessageChannel.h>
 #include <thrift/lib/cpp/async/TDelayedDestruction.h>
+#include <thrift/lib/cpp/async/TAsyncTimeout.h>
 #include <thrift/lib/cpp/async/TAsyncTransport.h>
 #include <thrift/lib/cpp/async/TEventBase.h>
 #include <thrift/lib/cpp/transport/THeader.h>
 #include <folly/io/IOBufQueue.h>
+#include <chrono>
 #include <memory>
 
 #include <deque>
@@ -183,6 +185,43 @@ class Cpp2Channel
     queueSends_ = queueSends;
   }
 
+  // Budget for queued sends.  Queued frames are flushed with a single
+  // writeChain() once maxSendBytes is reached, or at the end of the loop
+  // iteration.  A non-zero maxSendDelay keeps coalescing across loop
+  // iterations until that much time has passed since the first queued
+  // frame.  0 disables either limit.  Only used with queued sends.
+  void setMaxSendBytes(size_t maxSendBytes) {
+    maxSendBytes_ = maxSendBytes;
+  }
+
+  void setMaxSendDelay(std::chrono::milliseconds maxSendDelay) {
+    CHECK(sends_ == nullptr);
+    maxSendDelay_ = maxSendDelay;
+  }
+
+  // Start a RequestTrace for each message received, handed to the
+  // receive callback with its sample.
+  void setTraceRequests(bool traceRequests) {
+    traceRequests_ = traceRequests;
+  }
+
+  // Number of frames handed to sendMessage() and number of writes issued
+  // to the transport for them.  With queued sends, writes per message
+  // drops below 1 as more frames are coalesced per event loop.
+  uint64_t getNumMessagesSent() const {
+    return numMessagesSent_;
+  }
+
+  uint64_t getNumWrites() const {
+    return numWrites_;
+  }
+
+  // Zero copy writes of frames (or coalesced frames, with queued sends) of
+  // at least threshold bytes; see TAsyncSocket::setZeroCopy().  Returns
+  // false if the transport is not a TAsyncSocket or does not support it.
+  bool setZeroCopy(bool enable);
+  void setZeroCopyThreshold(size_t threshold);
+
   ProtectionChannelHandler* getProtectionHandler() const {
     return protectionHandler_.get();
   }
@@ -198,26 +237,78 @@ class Cpp2Channel
   }
 
 private:
+  class SendTimeout : public apache::thrift::async::TAsyncTimeout {
+   public:
+    explicit SendTimeout(Cpp2Channel* channel)
+      : channel_(channel)
+      , eventBase_(nullptr) {}
+
+    void schedule(apache::thrift::async::TEventBase* eventBase,
+                  std::chrono::milliseconds timeout) {
+      if (eventBase != eventBase_) {
+        detach();
+        attachEventBase(eventBase);
+        eventBase_ = eventBase;
+      }
+      scheduleTimeout(timeout.count());
+    }
+
+    void detach() {
+      if (eventBase_) {
+        cancelTimeout();
+        detachEventBase();
+        eventBase_ = nullptr;
+      }
+    }
+
+    void timeoutExpired() noexcept {
+      channel_->flushSends();
+    }
+
+   private:
+    Cpp2Channel* channel_;
+    apache::thrift::async::TEventBase* eventBase_;
+  };
+
+  // Schedule or write out the frames accumulated in sends_
+  void scheduleSends();
+  void flushSends();
+
   std::shared_ptr<apache::thrift::async::TAsyncTransport> transport_;
   std::unique_ptr<folly::IOBufQueue> queue_;
   std::deque<std::vector<SendCallback*>> sendCallbacks_;
 
   static const uint32_t DEFAULT_BUFFER_SIZE = 2048;
+  // Largest partial frame we copy to make a large frame contiguous
+  static const uint32_t kMaxPartialFrameCopy = 64 * 1024;
+  // Read slabs for small frames hold about this many average frames...
+  static const uint32_t kFramesPerSlab = 8;
+  // ...but are never larger than this
+  static const uint32_t kMaxSlabSize = 64 * 1024;
   uint32_t readBufferSize_;
   uint32_t remaining_; // Used to attempt to allocate 'perfect' sized IOBufs
+  size_t avgFrameSize_; // Moving average of received frame sizes
 
   RecvCallback* recvCallback_;
   bool closing_;
   bool eofInvoked_;
 
   std::unique_ptr<folly::IOBuf> sends_; // buffer of data to send.
+  size_t sendsBytes_; // length of sends_
 
   std::unique_ptr<RecvCallback::sample> sample_;
+  bool traceRequests_;
 
   // Queued sends feature - optimizes by minimizing syscalls in high-QPS
   // loads for greater throughput, but at the expense of some
   // minor latency increase.
   bool queueSends_;
+  size_t maxSendBytes_;
+  std::chrono::milliseconds maxSendDelay_;
+  SendTimeout sendTimeout_;
+
+  uint64_t numMessagesSent_;
+  uint64_t numWrites_;
 
   std::unique_ptr<ProtectionChannelHandler> protectionHandler_;
   std::unique_ptr<FramingChannelHandler> framingHandler_;
@@ -17,10 +17,12 @@
 #include <thrift/lib/cpp2/async/HeaderClientChannel.h>
 #include <thrift/lib/cpp2/async/ResponseChannel.h>
 #include <thrift/lib/cpp2/async/GssSaslClient.h>
+#include <thrift/lib/cpp2/async/RequestDeadline.h>
 #include <thrift/lib/cpp/EventHandlerBase.h>
 #include <thrift/lib/cpp/transport/TTransportException.h>
 #include <folly/io/Cursor.h>
 
+#include <algorithm>
 #include <utility>
 
 using std::unique_ptr;
@@ -35,6 +37,26 @@ using apache::thrift::async::RequestContext;
 
 namespace apache { namespace thrift {
 
+namespace {
+
+// Cap timeout (0 for none) at what is left of the deadline of the request
+// being handled, if this call is made on its behalf.  An exhausted budget
+// still gets 1ms, so the call fails as a timeout like any other.
+std::chrono::milliseconds inheritDeadline(std::chrono::milliseconds timeout) {
+  auto deadline = RequestDeadline::get();
+  if (!deadline) {
+    return timeout;
+  }
+  auto remaining = std::max(deadline->getRemaining(),
+                            std::chrono::milliseconds(1));
+  if (timeout <= std::chrono::milliseconds(0) || remaining < timeout) {
+    return remaining;
+  }
+  return timeout;
+}
+
+}
+
 HeaderClientChannel::HeaderClientChannel(
   const std::shared_ptr<TAsyncTransport>& transport)
     : HeaderClientChannel(
@@ -53,6 +75,8 @@ HeaderClientChannel::HeaderClientChannel(
     , suppressSaslFallbackOnTransientFailure_(false)
     , handshakeMessagesSent_(0)
     , keepRegisteredForClose_(true)
+    , skipIndex_(false)
+    , serverSkipIndex_(false)
     , saslClientCallback_(*this)
     , cpp2Channel_(cpp2Channel)
     , timer_(new apache::thrift::async::HHWheelTimer(getEventBase())) {
@@ -305,11 +329,25 @@ void HeaderClientChannel::maybeSetTimeoutHeader(const RpcOptions& rpcOptions) {
     return;
   }
   // continue only for header
-  if (rpcOptions.getTimeout() > std::chrono::milliseconds(0)) {
-    header_->setClientTimeout(rpcOptions.getTimeout());
+  auto timeout = inheritDeadline(rpcOptions.getTimeout());
+  if (timeout > std::chrono::milliseconds(0)) {
+    header_->setClientTimeout(timeout);
+  }
+}
+
+void HeaderClientChannel::maybeSetSkipIndexHeader() {
+  // The request was written with the index if getSkipIndex() is true (see
+  // the generated client).  Until then, this asks the server whether it
+  // reads it.
+  if (skipIndex_ && clientSupportHeader()) {
+    header_->setSkipIndex(getSkipIndex());
   }
 }
 
+bool HeaderClientChannel::getSkipIndex() {
+  return skipIndex_ && serverSkipIndex_ && clientSupportHeader();
+}
+
 bool HeaderClientChannel::clientSupportHeader() {
   return header_->getClientType() == THRIFT_HEADER_CLIENT_TYPE ||
          header_->getClientType() == THRIFT_HEADER_SASL_CLIENT_TYPE;
@@ -335,6 +373,7 @@ uint32_t HeaderClientChannel::sendOnewayRequest(
 
   maybeSetPriorityHeader(rpcOptions);
   maybeSetTimeoutHeader(rpcOptions);
+  maybeSetSkipIndexHeader();
   // Both cb and buf are allowed to be null.
 
   uint32_t oldSeqId = sendSeqId_;
@@ -397,6 +436,7 @@ uint32_t HeaderClientChannel::sendRequest(
   if (rpcOptions.getTimeout() > std::chrono::milliseconds(0)) {
     timeout = rpcOptions.getTimeout();
   }
+  timeout = inheritDeadline(timeout);
 
   auto twcb = new TwowayCallback(this,
                                  sendSeqId_,
@@ -409,6 +449,7 @@ uint32_t HeaderClientChannel::sendRequest(
   }
   maybeSetPriorityHeader(rpcOptions);
   maybeSetTimeoutHeader(rpcOptions);
+  maybeSetSkipIndexHeader();
 
   if (header_->getClientType() != THRIFT_HEADER_CLIENT_TYPE &&
       header_->getClientType() != THRIFT_HEADER_SASL_CLIENT_TYPE) {
@@ -471,6 +512,13 @@ void HeaderClientChannel::messageReceived(
     recvSeqId = header_->getSequenceNumber();
   }
 
+  // The server answers the request's header if it reads the skip index.
+  // Until one of its replies says so, requests are written without it.
+  if (skipIndex_ && !serverSkipIndex_ && clientSupportHeader() &&
+      header_->getSkipIndex()) {
+    serverSkipIndex_ = true;
+  }
+
   auto cb = recvCallbacks_.find(recvSeqId);
 
   // TODO: On some errors, some servers will return 0 for seqid.
@@ -136,6 +136,17 @@ class HeaderClientChannel : public RequestChannel,
     return keepRegisteredForClose_;
   }
 
+  // Write requests with the compact protocol's skip index, so that the
+  // server can skip the fields it does not know in constant time.  Only
+  // has an effect with the header client type, and only once a reply from
+  // the server has said that it reads the index: the requests sent before
+  // that are written without it.
+  void setSkipIndex(bool skipIndex) {
+    skipIndex_ = skipIndex;
+  }
+
+  bool getSkipIndex();
+
   apache::thrift::async::TEventBase* getEventBase() {
       return cpp2Channel_->getEventBase();
   }
@@ -418,6 +429,7 @@ private:
 
   void maybeSetPriorityHeader(const RpcOptions& rpcOptions);
   void maybeSetTimeoutHeader(const RpcOptions& rpcOptions);
+  void maybeSetSkipIndexHeader();
 
   uint32_t sendSeqId_;
   uint32_t sendSecurityPendingSeqId_;
@@ -449,6 +461,9 @@ private:
 
   bool keepRegisteredForClose_;
 
+  bool skipIndex_;
+  bool serverSkipIndex_;
+
   ProtectionState getProtectionState() {
     return cpp2Channel_->getProtectionHandler()->getProtectionState();
   }
@@ -177,6 +177,7 @@ HeaderServerChannel::HeaderRequest::HeaderRequest(
   if (sample) {
     timestamps_.readBegin = sample->readBegin;
     timestamps_.readEnd = sample->readEnd;
+    trace_ = std::move(sample->trace);
   }
 }
 
@@ -301,6 +302,15 @@ void HeaderServerChannel::messageReceived(unique_ptr<IOBuf>&& buf,
     return;
   }
 
+  if (sample && sample->trace) {
+    auto parsed = header_->getHeaderParsedTime();
+    if (parsed != std::chrono::steady_clock::time_point()) {
+      sample->trace->setTime(RequestTrace::HEADER_PARSED, parsed);
+      sample->trace->setTime(RequestTrace::UNTRANSFORMED,
+                             header_->getUntransformedTime());
+    }
+  }
+
   uint32_t recvSeqId = header_->getSequenceNumber();
   bool outOfOrder = (header_->getFlags() & HEADER_FLAG_SUPPORT_OUT_OF_ORDER);
   if (!outOfOrder) {
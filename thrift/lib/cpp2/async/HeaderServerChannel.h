@@ -123,6 +123,11 @@ protected:
 
     bool isOneway() {return seqId_ == ONEWAY_REQUEST_ID; }
 
+    // Transforms applied to the reply, if they differ from the request's
+    void setTransforms(const std::vector<uint16_t>& trans) {
+      transforms_ = trans;
+    }
+
     void sendReply(std::unique_ptr<folly::IOBuf>&& buf,
                    MessageChannel::SendCallback* cb = nullptr) {
       apache::thrift::transport::THeader::StringToStringMap headers;
@@ -181,10 +186,40 @@ protected:
     sampleRate_ = sampleRate;
   }
 
+  // Give each request a RequestTrace of its read
+  void setTraceRequests(bool traceRequests) {
+    cpp2Channel_->setTraceRequests(traceRequests);
+    header_->setRecordReadTimes(traceRequests);
+  }
+
   void setQueueSends(bool queueSends) {
     cpp2Channel_->setQueueSends(queueSends);
   }
 
+  void setMaxSendBytes(size_t maxSendBytes) {
+    cpp2Channel_->setMaxSendBytes(maxSendBytes);
+  }
+
+  void setMaxSendDelay(std::chrono::milliseconds maxSendDelay) {
+    cpp2Channel_->setMaxSendDelay(maxSendDelay);
+  }
+
+  uint64_t getNumMessagesSent() const {
+    return cpp2Channel_->getNumMessagesSent();
+  }
+
+  uint64_t getNumWrites() const {
+    return cpp2Channel_->getNumWrites();
+  }
+
+  bool setZeroCopy(bool enable) {
+    return cpp2Channel_->setZeroCopy(enable);
+  }
+
+  void setZeroCopyThreshold(size_t threshold) {
+    cpp2Channel_->setZeroCopyThreshold(threshold);
+  }
+
   void closeNow() {
     cpp2Channel_->closeNow();
   }
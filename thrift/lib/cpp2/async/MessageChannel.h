@@ -23,6 +23,7 @@
 #include <memory>
 #include <thrift/lib/cpp/async/TDelayedDestruction.h>
 #include <thrift/lib/cpp/Thrift.h>
+#include <thrift/lib/cpp2/async/RequestTrace.h>
 #include <folly/ExceptionWrapper.h>
 
 namespace folly {
@@ -57,6 +58,8 @@ class MessageChannel :
     struct sample {
       uint64_t readBegin;
       uint64_t readEnd;
+      // Set when requests are traced, see Cpp2Channel::setTraceRequests()
+      std::unique_ptr<RequestTrace> trace;
     };
 
     virtual ~RecvCallback() {}
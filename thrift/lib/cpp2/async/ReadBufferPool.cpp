@@ -0,0 +1,240 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/lib/cpp2/async/ReadBufferPool.h>
+
+#include <thrift/lib/cpp/concurrency/NumaThreadManager.h>
+
+#include <folly/Bits.h>
+#include <folly/ThreadLocal.h>
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <numa.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+using apache::thrift::concurrency::NumaThreadFactory;
+using folly::IOBuf;
+using std::unique_ptr;
+
+namespace apache { namespace thrift {
+
+const size_t ReadBufferPool::kMinSizeClassShift;
+const size_t ReadBufferPool::kMaxSizeClassShift;
+const size_t ReadBufferPool::kNumSizeClasses;
+const size_t ReadBufferPool::kMaxCachedBytesPerClass;
+
+namespace {
+
+folly::ThreadLocal<ReadBufferPool> pools;
+
+// The pool of this thread, if it has one
+__thread ReadBufferPool* localPool = nullptr;
+
+size_t sizeClassOf(size_t size) {
+  size_t shift = size <= 1 ? 0 : folly::findLastSet(size - 1);
+  if (shift < ReadBufferPool::kMinSizeClassShift) {
+    shift = ReadBufferPool::kMinSizeClassShift;
+  }
+  return shift - ReadBufferPool::kMinSizeClassShift;
+}
+
+size_t classSize(size_t sizeClass) {
+  return size_t(1) << (sizeClass + ReadBufferPool::kMinSizeClassShift);
+}
+
+// Smaller buffers come from malloc, which shares pages between them
+bool isNodeLocal(size_t sizeClass, int node) {
+  static const size_t pageSize = sysconf(_SC_PAGESIZE);
+  return node >= 0 && classSize(sizeClass) >= pageSize;
+}
+
+void freeBuffer(void* buf, size_t sizeClass, int node) {
+  if (isNodeLocal(sizeClass, node)) {
+    numa_free(buf, classSize(sizeClass));
+  } else {
+    free(buf);
+  }
+}
+
+// Head of a closed return list, see ReadBufferPool::~ReadBufferPool()
+void* const kClosed = reinterpret_cast<void*>(1);
+
+// Buffers on a return list are linked through their first word
+void*& nextBuffer(void* buf) {
+  return *static_cast<void**>(buf);
+}
+
+}
+
+/**
+ * A lock-free stack of freed buffers.  Other threads only ever push, and
+ * the owning pool takes the whole stack at once, so there is no ABA
+ * problem.  The IOBuf free callback of every buffer points here, and each
+ * buffer out holds a reference, so the list outlives its pool.
+ */
+struct ReadBufferPool::ReturnList {
+  ReturnList(size_t sizeClass, int node)
+      : head(nullptr)
+      , refs(1)
+      , sizeClass(sizeClass)
+      , node(node) {}
+
+  void push(void* buf) {
+    void* first = head.load(std::memory_order_relaxed);
+    do {
+      if (first == kClosed) {
+        freeBuffer(buf, sizeClass, node);
+        return;
+      }
+      nextBuffer(buf) = first;
+    } while (!head.compare_exchange_weak(first, buf,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed));
+  }
+
+  void* takeAll(void* replacement) {
+    return head.exchange(replacement, std::memory_order_acquire);
+  }
+
+  void unref() {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  std::atomic<void*> head;
+  // One for the pool, plus one per buffer out
+  std::atomic<size_t> refs;
+  const size_t sizeClass;
+  const int node;
+};
+
+ReadBufferPool& ReadBufferPool::get() {
+  return *pools;
+}
+
+ReadBufferPool::ReadBufferPool()
+    : node_(NumaThreadFactory::getThreadNumaNode())
+    , allocated_(0)
+    , reused_(0)
+    , returned_(0) {
+  for (size_t sizeClass = 0; sizeClass < kNumSizeClasses; ++sizeClass) {
+    returns_[sizeClass] = new ReturnList(sizeClass, node_);
+  }
+  // folly::ThreadLocal constructs the pool on its own thread
+  localPool = this;
+}
+
+ReadBufferPool::~ReadBufferPool() {
+  if (localPool == this) {
+    localPool = nullptr;
+  }
+  for (size_t sizeClass = 0; sizeClass < kNumSizeClasses; ++sizeClass) {
+    for (auto buf : freeLists_[sizeClass]) {
+      freeBuffer(buf, sizeClass, node_);
+    }
+    // Buffers released after this are freed by whoever releases them
+    void* buf = returns_[sizeClass]->takeAll(kClosed);
+    while (buf) {
+      void* next = nextBuffer(buf);
+      freeBuffer(buf, sizeClass, node_);
+      buf = next;
+    }
+    returns_[sizeClass]->unref();
+  }
+}
+
+size_t ReadBufferPool::goodSize(size_t size) {
+  size_t sizeClass = sizeClassOf(size);
+  return sizeClass < kNumSizeClasses ? classSize(sizeClass) : size;
+}
+
+unique_ptr<IOBuf> ReadBufferPool::allocate(size_t size) {
+  size_t sizeClass = sizeClassOf(size);
+  if (sizeClass >= kNumSizeClasses) {
+    return IOBuf::create(size);
+  }
+
+  void* buf;
+  auto& freeList = freeLists_[sizeClass];
+  if (freeList.empty()) {
+    drainReturns(sizeClass);
+  }
+  if (!freeList.empty()) {
+    buf = freeList.back();
+    freeList.pop_back();
+    ++reused_;
+  } else {
+    if (isNodeLocal(sizeClass, node_)) {
+      buf = numa_alloc_onnode(classSize(sizeClass), node_);
+    } else {
+      buf = malloc(classSize(sizeClass));
+    }
+    if (!buf) {
+      throw std::bad_alloc();
+    }
+    ++allocated_;
+  }
+
+  // takeOwnership() calls release() itself if it throws, which drops this
+  // reference again
+  ReturnList* returns = returns_[sizeClass];
+  returns->refs.fetch_add(1, std::memory_order_relaxed);
+  return IOBuf::takeOwnership(buf, classSize(sizeClass), 0,
+                              &ReadBufferPool::release, returns);
+}
+
+void ReadBufferPool::release(void* buf, void* userData) {
+  // Called from whichever thread drops the last reference.
+  auto returns = static_cast<ReturnList*>(userData);
+  if (localPool && localPool->returns_[returns->sizeClass] == returns) {
+    localPool->recycle(buf, returns->sizeClass);
+  } else {
+    returns->push(buf);
+  }
+  returns->unref();
+}
+
+void ReadBufferPool::drainReturns(size_t sizeClass) {
+  void* buf = returns_[sizeClass]->takeAll(nullptr);
+  while (buf) {
+    void* next = nextBuffer(buf);
+    recycle(buf, sizeClass);
+    ++returned_;
+    buf = next;
+  }
+}
+
+void ReadBufferPool::recycle(void* buf, size_t sizeClass) {
+  DCHECK_LT(sizeClass, kNumSizeClasses);
+  auto& freeList = freeLists_[sizeClass];
+  size_t maxCached =
+    std::max<size_t>(2, kMaxCachedBytesPerClass / classSize(sizeClass));
+  if (freeList.size() >= maxCached) {
+    freeBuffer(buf, sizeClass, node_);
+    return;
+  }
+  freeList.push_back(buf);
+}
+
+}} // apache::thrift
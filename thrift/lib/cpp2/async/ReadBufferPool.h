@@ -0,0 +1,111 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef THRIFT_ASYNC_READBUFFERPOOL_H_
+#define THRIFT_ASYNC_READBUFFERPOOL_H_ 1
+
+#include <folly/io/IOBuf.h>
+
+#include <memory>
+#include <vector>
+
+namespace apache { namespace thrift {
+
+/**
+ * Pool of read buffers in power-of-two size classes.
+ *
+ * There is one pool per thread, so every TEventBase thread reads into its
+ * own pool without locking.  A buffer always goes back to the pool that
+ * allocated it: freed on the owning thread it goes straight onto a free
+ * list, freed on any other thread (a handler running in a ThreadManager,
+ * say) it is pushed onto a lock-free return list of the owning pool, which
+ * drains it the next time a size class runs out.  Buffers still out when
+ * their pool's thread exits are freed when they are released.
+ *
+ * Requests larger than the biggest size class are served from the heap.
+ *
+ * On threads pinned to a NUMA node by NumaThreadFactory, page sized and
+ * larger buffers are allocated on that node.
+ */
+class ReadBufferPool {
+ public:
+  static const size_t kMinSizeClassShift = 11;  // 2KB
+  static const size_t kMaxSizeClassShift = 22;  // 4MB
+  static const size_t kNumSizeClasses =
+    kMaxSizeClassShift - kMinSizeClassShift + 1;
+  // Bytes of free buffers kept per size class (at least 2 buffers)
+  static const size_t kMaxCachedBytesPerClass = 8 * 1024 * 1024;
+
+  ReadBufferPool();
+  ~ReadBufferPool();
+
+  /**
+   * The pool of the calling thread.
+   */
+  static ReadBufferPool& get();
+
+  /**
+   * Return an empty IOBuf with at least size bytes of tailroom.  The
+   * buffer goes back to a pool when the IOBuf is freed.
+   */
+  std::unique_ptr<folly::IOBuf> allocate(size_t size);
+
+  /**
+   * Number of buffers allocated from the heap / handed out again from the
+   * free lists, for diagnostics.
+   */
+  uint64_t getNumAllocated() const {
+    return allocated_;
+  }
+
+  uint64_t getNumReused() const {
+    return reused_;
+  }
+
+  /**
+   * Number of buffers freed on other threads and returned to this pool.
+   */
+  uint64_t getNumReturned() const {
+    return returned_;
+  }
+
+  // Round size up to its size class, or return size unchanged if it is too
+  // large to be pooled.
+  static size_t goodSize(size_t size);
+
+ private:
+  // Buffers of one size class freed on other threads
+  struct ReturnList;
+
+  static void release(void* buf, void* userData);
+  void recycle(void* buf, size_t sizeClass);
+  void drainReturns(size_t sizeClass);
+
+  std::vector<void*> freeLists_[kNumSizeClasses];
+  ReturnList* returns_[kNumSizeClasses];
+  // NUMA node buffers are allocated on, or -1
+  const int node_;
+  uint64_t allocated_;
+  uint64_t reused_;
+  uint64_t returned_;
+};
+
+}} // apache::thrift
+
+#endif // THRIFT_ASYNC_READBUFFERPOOL_H_
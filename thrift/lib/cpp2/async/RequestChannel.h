@@ -257,6 +257,14 @@ class RequestChannel : virtual public TDelayedDestruction {
   virtual apache::thrift::transport::THeader* getHeader() {
     return nullptr;
   }
+
+  /**
+   * Whether requests should be written with the compact protocol's skip
+   * index.  The channel must tell the server that they are.
+   */
+  virtual bool getSkipIndex() {
+    return false;
+  }
 };
 
 class ClientSyncCallback : public RequestCallback {
@@ -0,0 +1,58 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/lib/cpp2/async/RequestDeadline.h>
+
+#include <gflags/gflags.h>
+
+#include <algorithm>
+
+DECLARE_bool(enable_request_context);
+
+using apache::thrift::async::RequestContext;
+
+namespace apache { namespace thrift {
+
+const std::string RequestDeadline::kContextKey = "thrift_deadline";
+
+std::chrono::milliseconds RequestDeadline::getRemaining() const {
+  auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+    deadline_ - Clock::now());
+  return std::max(remaining, std::chrono::milliseconds(0));
+}
+
+void RequestDeadline::set(Clock::time_point deadline) {
+  // Without request contexts everything shares one default context
+  if (!FLAGS_enable_request_context || get()) {
+    return;
+  }
+  RequestContext::get()->setContextData(
+    kContextKey,
+    std::unique_ptr<RequestDeadline>(new RequestDeadline(deadline)));
+}
+
+const RequestDeadline* RequestDeadline::get() {
+  if (!FLAGS_enable_request_context) {
+    return nullptr;
+  }
+  return dynamic_cast<RequestDeadline*>(
+    RequestContext::get()->getContextData(kContextKey));
+}
+
+}} // apache::thrift
@@ -0,0 +1,81 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef THRIFT_ASYNC_REQUESTDEADLINE_H_
+#define THRIFT_ASYNC_REQUESTDEADLINE_H_ 1
+
+#include <thrift/lib/cpp/async/Request.h>
+
+#include <chrono>
+#include <string>
+
+namespace apache { namespace thrift {
+
+/**
+ * The time by which the client of the request being handled stops waiting
+ * for its reply.
+ *
+ * The server attaches one to the RequestContext of every request whose
+ * client sent a timeout, and HeaderClientChannel caps the timeout of any
+ * call made under that context at what is left of it, so nested calls
+ * inherit the remaining budget without the handler passing it along.
+ *
+ * Only available when request contexts are enabled
+ * (--enable_request_context).
+ */
+class RequestDeadline : public apache::thrift::async::RequestData {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  explicit RequestDeadline(Clock::time_point deadline)
+      : deadline_(deadline) {}
+
+  Clock::time_point getDeadline() const {
+    return deadline_;
+  }
+
+  /**
+   * Time left until the deadline, never negative.
+   */
+  std::chrono::milliseconds getRemaining() const;
+
+  bool isExpired() const {
+    return Clock::now() >= deadline_;
+  }
+
+  /**
+   * Attach a deadline to the current RequestContext.  Does nothing if it
+   * already has one, or if request contexts are disabled.
+   */
+  static void set(Clock::time_point deadline);
+
+  /**
+   * Deadline of the current RequestContext, nullptr if it has none.
+   */
+  static const RequestDeadline* get();
+
+ private:
+  static const std::string kContextKey;
+
+  Clock::time_point deadline_;
+};
+
+}} // apache::thrift
+
+#endif // #ifndef THRIFT_ASYNC_REQUESTDEADLINE_H_
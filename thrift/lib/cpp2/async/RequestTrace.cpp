@@ -0,0 +1,131 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/lib/cpp2/async/RequestTrace.h>
+
+#include <folly/String.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace apache { namespace thrift {
+
+const size_t RequestTrace::kMaxMethodLength;
+
+RequestTrace::RequestTrace() {
+  std::fill(times, times + NUM_EVENTS, 0);
+  method[0] = '\0';
+}
+
+void RequestTrace::setTime(Event event,
+                           std::chrono::steady_clock::time_point time) {
+  times[event] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    time.time_since_epoch()).count();
+}
+
+void RequestTrace::setMethod(const char* name) {
+  strncpy(method, name, kMaxMethodLength);
+  method[kMaxMethodLength] = '\0';
+}
+
+const char* RequestTrace::getEventName(Event event) {
+  switch (event) {
+    case READ_END: return "read_end";
+    case HEADER_PARSED: return "header_parsed";
+    case UNTRANSFORMED: return "untransformed";
+    case QUEUE_ENTER: return "queue_enter";
+    case QUEUE_EXIT: return "queue_exit";
+    case HANDLER_BEGIN: return "handler_begin";
+    case HANDLER_END: return "handler_end";
+    case SERIALIZED: return "serialized";
+    case TRANSFORMED: return "transformed";
+    case WRITE_END: return "write_end";
+    case NUM_EVENTS: break;
+  }
+  return "unknown";
+}
+
+std::string RequestTrace::describe() const {
+  std::string out = method[0] ? method : "(unknown)";
+  out += ":";
+  for (int i = 0; i < NUM_EVENTS; ++i) {
+    if (times[i] == 0) {
+      continue;
+    }
+    folly::stringAppendf(
+      &out, " %s +%.1fus",
+      getEventName(static_cast<Event>(i)),
+      (static_cast<int64_t>(times[i] - times[READ_END])) / 1000.0);
+  }
+  return out;
+}
+
+RequestTraceRing::RequestTraceRing(size_t size)
+  : size_(size)
+  , slots_(new Slot[size])
+  , head_(0) {
+  CHECK_GT(size, 0);
+  for (size_t i = 0; i < size_; ++i) {
+    slots_[i].seq.store(0, std::memory_order_relaxed);
+  }
+}
+
+void RequestTraceRing::push(const RequestTrace& trace) {
+  uint64_t words[kWords];
+  memcpy(words, &trace, sizeof(trace));
+
+  uint64_t index = head_.load(std::memory_order_relaxed);
+  Slot& slot = slots_[index % size_];
+  slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (size_t i = 0; i < kWords; ++i) {
+    slot.words[i].store(words[i], std::memory_order_relaxed);
+  }
+  slot.seq.store(2 * (index + 1), std::memory_order_release);
+  head_.store(index + 1, std::memory_order_release);
+}
+
+std::vector<RequestTrace> RequestTraceRing::snapshot() const {
+  std::vector<RequestTrace> traces;
+  uint64_t head = head_.load(std::memory_order_acquire);
+  uint64_t begin = head > size_ ? head - size_ : 0;
+  traces.reserve(head - begin);
+  for (uint64_t index = begin; index < head; ++index) {
+    const Slot& slot = slots_[index % size_];
+    uint64_t seq = slot.seq.load(std::memory_order_acquire);
+    if (seq != 2 * (index + 1)) {
+      // Already overwritten by a newer trace
+      continue;
+    }
+    uint64_t words[kWords];
+    for (size_t i = 0; i < kWords; ++i) {
+      words[i] = slot.words[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) != seq) {
+      continue;
+    }
+    traces.emplace_back();
+    memcpy(&traces.back(), words, sizeof(words));
+  }
+  return traces;
+}
+
+}} // apache::thrift
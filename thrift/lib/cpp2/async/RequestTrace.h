@@ -0,0 +1,138 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef THRIFT_ASYNC_REQUESTTRACE_H_
+#define THRIFT_ASYNC_REQUESTTRACE_H_ 1
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace apache { namespace thrift {
+
+/**
+ * Where the time of one request went: when it passed each step of its way
+ * through the server, from the read that completed it to the write of its
+ * reply.
+ *
+ * Times are nanoseconds of std::chrono::steady_clock, 0 for the steps the
+ * request did not take: a request that fails before its handler runs has
+ * no handler times, and requests that are not in header format have no
+ * header times.  A request that timed out has the write time of its
+ * TIMEOUT error, which may come before its handler times.
+ *
+ * Each step is marked by one thread, and the trace is only read once the
+ * request and the write of its reply are both done with it.
+ *
+ * Tracing is off unless ThriftServer::setRequestTraceSize() is called;
+ * ThriftServer::getRequestTraces() returns the last requests of each
+ * worker.
+ */
+struct RequestTrace {
+  enum Event {
+    READ_END = 0,     // the read that completed the request returned
+    HEADER_PARSED,    // the header was parsed
+    UNTRANSFORMED,    // the data was decompressed
+    QUEUE_ENTER,      // added to the ThreadManager
+    QUEUE_EXIT,       // picked up by a ThreadManager thread
+    HANDLER_BEGIN,    // arguments read, handler called
+    HANDLER_END,      // the handler returned its result
+    SERIALIZED,       // the reply was serialized
+    TRANSFORMED,      // the reply was compressed
+    WRITE_END,        // the reply was written to the socket
+    NUM_EVENTS
+  };
+
+  static const size_t kMaxMethodLength = 47;
+
+  RequestTrace();
+
+  static uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  void mark(Event event) {
+    times[event] = now();
+  }
+
+  void setTime(Event event, std::chrono::steady_clock::time_point time);
+
+  // Truncated to kMaxMethodLength
+  void setMethod(const char* name);
+
+  static const char* getEventName(Event event);
+
+  /**
+   * One line with the method and the time of each step taken, relative to
+   * READ_END.
+   */
+  std::string describe() const;
+
+  uint64_t times[NUM_EVENTS];
+  char method[kMaxMethodLength + 1];
+};
+
+/**
+ * The last traces of one thread, overwritten oldest first.
+ *
+ * Only the thread that owns it may push(); any thread may take a
+ * snapshot() at the same time.  Neither takes a lock: each slot has a
+ * sequence number that is odd while the slot is written, and readers
+ * drop the slots that changed while they copied them.
+ */
+class RequestTraceRing {
+ public:
+  explicit RequestTraceRing(size_t size);
+
+  void push(const RequestTrace& trace);
+
+  /**
+   * Oldest first.  Traces pushed while the snapshot is taken may be
+   * missing from it.
+   */
+  std::vector<RequestTrace> snapshot() const;
+
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  static const size_t kWords = sizeof(RequestTrace) / sizeof(uint64_t);
+  static_assert(sizeof(RequestTrace) % sizeof(uint64_t) == 0,
+                "Traces are copied a word at a time");
+
+  struct Slot {
+    // 2 * (index + 1) once the trace with that index is in, odd while it
+    // is written
+    std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> words[kWords];
+  };
+
+  const size_t size_;
+  std::unique_ptr<Slot[]> slots_;
+  // Number of traces pushed so far
+  std::atomic<uint64_t> head_;
+};
+
+}} // apache::thrift
+
+#endif // #ifndef THRIFT_ASYNC_REQUESTTRACE_H_
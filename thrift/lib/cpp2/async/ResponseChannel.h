@@ -74,7 +74,21 @@ class ResponseChannel : virtual public TDelayedDestruction {
       return timestamps_;
     }
 
+    // Null unless requests are traced; each step marks its time with
+    // markTrace().  Shared with the callback of the reply's write, which
+    // may outlive the request.
+    RequestTrace* getTrace() {
+      return trace_.get();
+    }
+
+    void markTrace(RequestTrace::Event event) {
+      if (trace_) {
+        trace_->mark(event);
+      }
+    }
+
     apache::thrift::server::TServerObserver::CallTimestamps timestamps_;
+    std::shared_ptr<RequestTrace> trace_;
    protected:
     std::unique_ptr<folly::IOBuf> buf_;
   };
@@ -55,12 +55,29 @@ class CompactProtocolWriter {
 
   CompactProtocolWriter()
       : out_(nullptr, 0)
-      , booleanField_({nullptr, TType::T_BOOL, 0}) {}
+      , queue_(nullptr)
+      , booleanField_({nullptr, TType::T_BOOL, 0})
+      , skipIndex_(false) {}
 
   static inline ProtocolType protocolType() {
     return ProtocolType::T_COMPACT_PROTOCOL;
   }
 
+  /**
+   * Write the skip index: every struct, map, set and list is preceded by
+   * its length in bytes, as a 4 byte little endian integer, so that a
+   * reader can skip it without parsing it.  This is not the standard
+   * encoding; it must only be used when the reader is known to expect it
+   * (see THeader::setSkipIndex()).
+   */
+  void setSkipIndex(bool skipIndex) {
+    skipIndex_ = skipIndex;
+  }
+
+  bool skipIndex() const {
+    return skipIndex_;
+  }
+
   /**
    * ...
    * The IOBuf itself is managed by the caller.
@@ -74,6 +91,8 @@ class CompactProtocolWriter {
     // Allocate 1MB at a time; leave some room for the IOBuf overhead
     constexpr size_t kDesiredGrowth = (1 << 20) - 64;
     out_.reset(queue, std::min(kDesiredGrowth, maxGrowth));
+    queue_ = queue;
+    lengthSlots_.clear();
   }
 
   inline uint32_t writeMessageBegin(const std::string& name,
@@ -107,6 +126,13 @@ class CompactProtocolWriter {
   inline uint32_t writeI64(int64_t i64);
   inline uint32_t writeDouble(double dub);
   inline uint32_t writeFloat(float flt);
+  /**
+   * Write the elements of a list (after writeListBegin()) straight into
+   * the output buffer, instead of one writeI32() etc. call per element.
+   */
+  inline uint32_t writeI32List(const int32_t* values, uint32_t size);
+  inline uint32_t writeI64List(const int64_t* values, uint32_t size);
+  inline uint32_t writeDoubleList(const double* values, uint32_t size);
   template <typename StrType>
   inline uint32_t writeString(const StrType& str);
   template <typename StrType>
@@ -114,10 +140,7 @@ class CompactProtocolWriter {
   inline uint32_t writeBinary(const std::unique_ptr<IOBuf>& str);
   inline uint32_t writeBinary(const IOBuf& str);
   inline uint32_t writeSerializedData(
-    const std::unique_ptr<folly::IOBuf>& data) {
-    // TODO
-    return 0;
-  }
+    const std::unique_ptr<folly::IOBuf>& data);
 
   /**
    * Functions that return the serialized size
@@ -167,16 +190,20 @@ class CompactProtocolWriter {
     return serializedSizeI32();
   }
   inline uint32_t serializedSizeSerializedData(
-    const std::unique_ptr<folly::IOBuf>& data) {
-    // TODO
-    return 0;
-  }
+    const std::unique_ptr<folly::IOBuf>& data);
 
  protected:
+  template <class T>
+  inline uint32_t writeVarintList(const T* values, uint32_t size);
+
+  inline uint32_t beginLength();
+  inline void endLength();
+
   /**
    * Cursor to write the data out to.
    */
   QueueAppender out_;
+  IOBufQueue* queue_;
 
   struct {
     const char* name;
@@ -187,6 +214,16 @@ class CompactProtocolWriter {
   std::stack<int16_t, folly::fbvector<int16_t>> lastField_;
   int16_t lastFieldId_;
 
+  bool skipIndex_;
+
+  // The skip index lengths still to be filled in, innermost last: the
+  // buffer holding each one and where it is in that buffer
+  struct LengthSlot {
+    const IOBuf* buf;
+    uint8_t* data;
+  };
+  folly::fbvector<LengthSlot> lengthSlots_;
+
 };
 
 class CompactProtocolReader {
@@ -198,14 +235,16 @@ class CompactProtocolReader {
     : string_limit_(0)
     , container_limit_(0)
     , in_(nullptr)
-    , boolValue_({false, false}) {}
+    , boolValue_({false, false})
+    , skipIndex_(false) {}
 
   CompactProtocolReader(int32_t string_limit,
                   int32_t container_limit)
     : string_limit_(string_limit)
     , container_limit_(container_limit)
     , in_(nullptr)
-    , boolValue_({false, false}) {}
+    , boolValue_({false, false})
+    , skipIndex_(false) {}
 
   static inline ProtocolType protocolType() {
     return ProtocolType::T_COMPACT_PROTOCOL;
@@ -219,6 +258,18 @@ class CompactProtocolReader {
     container_limit_ = container_limit;
   }
 
+  /**
+   * Read input written with CompactProtocolWriter::setSkipIndex(true).
+   * skip() then jumps over structs and containers in constant time.
+   */
+  void setSkipIndex(bool skipIndex) {
+    skipIndex_ = skipIndex;
+  }
+
+  bool skipIndex() const {
+    return skipIndex_;
+  }
+
   /**
    * The IOBuf itself is managed by the caller.
    * It must exist for the life of the CompactProtocol as well,
@@ -258,15 +309,22 @@ class CompactProtocolReader {
   inline uint32_t readI64(int64_t& i64);
   inline uint32_t readDouble(double& dub);
   inline uint32_t readFloat(float& flt);
+  /**
+   * Read the elements of a list (after readListBegin()) into values, which
+   * must have room for size of them.  Runs of elements within one buffer
+   * are decoded without going through the cursor for each; varints that
+   * are all one byte long are found 16 or 32 at a time with SSE2/AVX2.
+   */
+  inline uint32_t readI32List(int32_t* values, uint32_t size);
+  inline uint32_t readI64List(int64_t* values, uint32_t size);
+  inline uint32_t readDoubleList(double* values, uint32_t size);
   template<typename StrType>
   inline uint32_t readString(StrType& str);
   template <typename StrType>
   inline uint32_t readBinary(StrType& str);
   inline uint32_t readBinary(std::unique_ptr<IOBuf>& str);
   inline uint32_t readBinary(IOBuf& str);
-  uint32_t skip(TType type) {
-    return apache::thrift::skip(*this, type);
-  }
+  inline uint32_t skip(TType type);
 
   Cursor getCurrentPosition() const {
     return in_;
@@ -287,8 +345,13 @@ class CompactProtocolReader {
  protected:
   inline uint32_t readStringSize(int32_t& size);
 
+  template <class T>
+  inline uint32_t readVarintList(T* values, uint32_t size);
+
   inline TType getType(int8_t type);
 
+  inline uint32_t readLength(uint32_t& length);
+
   int32_t string_limit_;
   int32_t container_limit_;
 
@@ -308,6 +371,63 @@ class CompactProtocolReader {
     bool boolValue;
   } boolValue_;
 
+  bool skipIndex_;
+
+};
+
+// Skip index overloads of the templates in Protocol.h
+inline bool usesSkipIndex(const CompactProtocolReader* prot) {
+  return prot->skipIndex();
+}
+
+inline bool usesSkipIndex(const CompactProtocolWriter* prot) {
+  return prot->skipIndex();
+}
+
+inline void setSkipIndex(CompactProtocolReader* prot, bool skipIndex) {
+  prot->setSkipIndex(skipIndex);
+}
+
+inline void setSkipIndex(CompactProtocolWriter* prot, bool skipIndex) {
+  prot->setSkipIndex(skipIndex);
+}
+
+template <>
+class NumericListOps<CompactProtocolReader> {
+ public:
+  static uint32_t readI32List(CompactProtocolReader* prot, int32_t* values,
+                              uint32_t size) {
+    return prot->readI32List(values, size);
+  }
+
+  static uint32_t readI64List(CompactProtocolReader* prot, int64_t* values,
+                              uint32_t size) {
+    return prot->readI64List(values, size);
+  }
+
+  static uint32_t readDoubleList(CompactProtocolReader* prot, double* values,
+                                 uint32_t size) {
+    return prot->readDoubleList(values, size);
+  }
+};
+
+template <>
+class NumericListOps<CompactProtocolWriter> {
+ public:
+  static uint32_t writeI32List(CompactProtocolWriter* prot,
+                               const int32_t* values, uint32_t size) {
+    return prot->writeI32List(values, size);
+  }
+
+  static uint32_t writeI64List(CompactProtocolWriter* prot,
+                               const int64_t* values, uint32_t size) {
+    return prot->writeI64List(values, size);
+  }
+
+  static uint32_t writeDoubleList(CompactProtocolWriter* prot,
+                                  const double* values, uint32_t size) {
+    return prot->writeDoubleList(values, size);
+  }
 };
 
 }} // apache::thrift
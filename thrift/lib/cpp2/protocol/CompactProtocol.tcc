@@ -23,9 +23,21 @@
 #include <thrift/lib/cpp2/protocol/CompactProtocol.h>
 #include <thrift/lib/cpp/util/VarintUtils.h>
 
+#include <folly/Bits.h>
+
+#include <algorithm>
+#include <cstring>
 #include <limits>
+#include <stdexcept>
+#include <type_traits>
 #include <boost/static_assert.hpp>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace apache { namespace thrift {
 
 namespace detail { namespace compact {
@@ -70,6 +82,94 @@ const int8_t TTypeToCType[20] = {
   CT_FLOAT, // T_FLOAT
 };
 
+template <class T>
+inline T zigzagDecode(typename std::make_unsigned<T>::type n) {
+  return (n >> 1) ^ -(n & 1);
+}
+
+template <class T>
+inline typename std::make_unsigned<T>::type zigzagEncode(T n) {
+  typedef typename std::make_unsigned<T>::type U;
+  return (U(n) << 1) ^ U(n >> (8 * sizeof(T) - 1));
+}
+
+template <class U>
+inline uint8_t* encodeVarint(U value, uint8_t* p) {
+  while (value >= 0x80) {
+    *p++ = uint8_t(value) | 0x80;
+    value >>= 7;
+  }
+  *p++ = uint8_t(value);
+  return p;
+}
+
+#if defined(__AVX2__)
+const size_t kRunWidth = 32;
+#elif defined(__SSE2__)
+const size_t kRunWidth = 16;
+#else
+const size_t kRunWidth = 8;
+#endif
+
+/**
+ * Number of bytes without the continuation bit at the start of the
+ * kRunWidth bytes at p, that is of one byte varints in a row.
+ */
+inline size_t singleByteRun(const uint8_t* p) {
+#if defined(__AVX2__)
+  uint32_t mask = _mm256_movemask_epi8(
+    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+  return mask ? __builtin_ctz(mask) : kRunWidth;
+#elif defined(__SSE2__)
+  uint32_t mask = _mm_movemask_epi8(
+    _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+  return mask ? __builtin_ctz(mask) : kRunWidth;
+#else
+  uint64_t word;
+  memcpy(&word, p, sizeof(word));
+  word = folly::Endian::little(word) & 0x8080808080808080ULL;
+  return word ? __builtin_ctzll(word) / 8 : kRunWidth;
+#endif
+}
+
+/**
+ * Decode up to n zigzag varints from [p, end) into out, advancing p.
+ * Stops early, without reading past end, once the rest of the buffer may
+ * not hold a whole varint; returns the number decoded.
+ */
+template <class T>
+size_t readZigzagRun(const uint8_t*& p, const uint8_t* end,
+                     T* out, size_t n) {
+  typedef typename std::make_unsigned<T>::type U;
+  size_t i = 0;
+  while (i < n) {
+    if (size_t(end - p) >= kRunWidth) {
+      size_t run = std::min(singleByteRun(p), n - i);
+      for (size_t k = 0; k < run; ++k) {
+        out[i + k] = zigzagDecode<T>(p[k]);
+      }
+      p += run;
+      i += run;
+      if (i == n || run == kRunWidth) {
+        continue;
+      }
+    }
+
+    if (size_t(end - p) < util::detail::kVarintWordBytes) {
+      break;
+    }
+    U value;
+    size_t size = util::detail::decodeVarint(p, end - p, value);
+    if (size == 0) {
+      // Invalid, or a 64 bit varint too close to end; readVarint decides
+      break;
+    }
+    p += size;
+    out[i++] = zigzagDecode<T>(value);
+  }
+  return i;
+}
+
 }} // end detail::compact namespace
 
 
@@ -90,15 +190,46 @@ uint32_t CompactProtocolWriter::writeMessageEnd() {
   return 0;
 }
 
+/**
+ * Leaves room for a skip index length, filled in by the matching
+ * endLength() once everything up to there is written.
+ */
+uint32_t CompactProtocolWriter::beginLength() {
+  out_.ensure(sizeof(uint32_t));
+  lengthSlots_.push_back({queue_->front()->prev(), out_.writableData()});
+  out_.append(sizeof(uint32_t));
+  return sizeof(uint32_t);
+}
+
+void CompactProtocolWriter::endLength() {
+  auto slot = lengthSlots_.back();
+  lengthSlots_.pop_back();
+  // Usually still in the same buffer; inserted IOBufs and growth of the
+  // queue add the buffers after it.
+  size_t length = slot.buf->tail() - (slot.data + sizeof(uint32_t));
+  for (auto buf = slot.buf->next(); buf != queue_->front();
+       buf = buf->next()) {
+    length += buf->length();
+  }
+  if (length > std::numeric_limits<uint32_t>::max()) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  uint32_t le = folly::Endian::little(uint32_t(length));
+  memcpy(slot.data, &le, sizeof(le));
+}
+
 uint32_t CompactProtocolWriter::writeStructBegin(const char* name) {
   lastField_.push(lastFieldId_);
   lastFieldId_ = 0;
-  return 0;
+  return skipIndex_ ? beginLength() : 0;
 }
 
 uint32_t CompactProtocolWriter::writeStructEnd() {
   lastFieldId_ = lastField_.top();
   lastField_.pop();
+  if (skipIndex_) {
+    endLength();
+  }
   return 0;
 }
 
@@ -157,7 +288,7 @@ uint32_t CompactProtocolWriter::writeFieldStop() {
 uint32_t CompactProtocolWriter::writeMapBegin(const TType keyType,
                                              TType valType,
                                              uint32_t size) {
-  uint32_t wsize = 0;
+  uint32_t wsize = skipIndex_ ? beginLength() : 0;
 
   if (size == 0) {
     wsize += writeByte(0);
@@ -170,12 +301,15 @@ uint32_t CompactProtocolWriter::writeMapBegin(const TType keyType,
 }
 
 uint32_t CompactProtocolWriter::writeMapEnd() {
+  if (skipIndex_) {
+    endLength();
+  }
   return 0;
 }
 
 uint32_t CompactProtocolWriter::writeCollectionBegin(int8_t elemType,
                                                      int32_t size) {
-  uint32_t wsize = 0;
+  uint32_t wsize = skipIndex_ ? beginLength() : 0;
   if (size <= 14) {
     wsize += writeByte(size << 4 | detail::compact::TTypeToCType[elemType]);
   } else {
@@ -191,6 +325,9 @@ uint32_t CompactProtocolWriter::writeListBegin(TType elemType,
 }
 
 uint32_t CompactProtocolWriter::writeListEnd() {
+  if (skipIndex_) {
+    endLength();
+  }
   return 0;
 }
 
@@ -200,6 +337,9 @@ uint32_t CompactProtocolWriter::writeSetBegin(TType elemType,
 }
 
 uint32_t CompactProtocolWriter::writeSetEnd() {
+  if (skipIndex_) {
+    endLength();
+  }
   return 0;
 }
 
@@ -259,6 +399,58 @@ uint32_t CompactProtocolWriter::writeFloat(float flt) {
   return sizeof(bits);
 }
 
+template <class T>
+uint32_t CompactProtocolWriter::writeVarintList(const T* values,
+                                               uint32_t size) {
+  static const uint32_t kChunk = 1024;
+  static const size_t kMaxBytes = (8 * sizeof(T) + 6) / 7;
+  uint32_t wsize = 0;
+  while (size > 0) {
+    uint32_t n = std::min(size, kChunk);
+    out_.ensure(n * kMaxBytes);
+    uint8_t* begin = out_.writableData();
+    uint8_t* p = begin;
+    for (uint32_t i = 0; i < n; ++i) {
+      p = detail::compact::encodeVarint(
+        detail::compact::zigzagEncode(values[i]), p);
+    }
+    out_.append(p - begin);
+    wsize += p - begin;
+    values += n;
+    size -= n;
+  }
+  return wsize;
+}
+
+uint32_t CompactProtocolWriter::writeI32List(const int32_t* values,
+                                            uint32_t size) {
+  return writeVarintList(values, size);
+}
+
+uint32_t CompactProtocolWriter::writeI64List(const int64_t* values,
+                                            uint32_t size) {
+  return writeVarintList(values, size);
+}
+
+uint32_t CompactProtocolWriter::writeDoubleList(const double* values,
+                                               uint32_t size) {
+  static const uint32_t kChunk = 1024;
+  uint32_t wsize = size * sizeof(uint64_t);
+  while (size > 0) {
+    uint32_t n = std::min(size, kChunk);
+    out_.ensure(n * sizeof(uint64_t));
+    uint8_t* p = out_.writableData();
+    for (uint32_t i = 0; i < n; ++i) {
+      uint64_t bits = folly::Endian::big(bitwise_cast<uint64_t>(values[i]));
+      memcpy(p + i * sizeof(bits), &bits, sizeof(bits));
+    }
+    out_.append(n * sizeof(uint64_t));
+    values += n;
+    size -= n;
+  }
+  return wsize;
+}
+
 template<typename StrType>
 uint32_t CompactProtocolWriter::writeString(const StrType& str) {
   uint32_t size = str.size();
@@ -292,6 +484,15 @@ uint32_t CompactProtocolWriter::writeBinary(
   return result + size;
 }
 
+uint32_t CompactProtocolWriter::writeSerializedData(
+    const std::unique_ptr<folly::IOBuf>& buf) {
+  if (!buf) {
+    return 0;
+  }
+  out_.insert(buf->clone());
+  return buf->computeChainDataLength();
+}
+
 /**
  * Functions that return the serialized size
  */
@@ -310,13 +511,14 @@ uint32_t CompactProtocolWriter::serializedFieldSize(const char* name,
 }
 
 uint32_t CompactProtocolWriter::serializedStructSize(const char* name) {
-  return 0;
+  return skipIndex_ ? sizeof(uint32_t) : 0;
 }
 
 uint32_t CompactProtocolWriter::serializedSizeMapBegin(TType keyType,
                                                       TType valType,
                                                       uint32_t size) {
-  return serializedSizeByte() + serializedSizeByte() +
+  return (skipIndex_ ? sizeof(uint32_t) : 0) +
+         serializedSizeByte() + serializedSizeByte() +
          serializedSizeI32();
 }
 
@@ -326,7 +528,8 @@ uint32_t CompactProtocolWriter::serializedSizeMapEnd() {
 
 uint32_t CompactProtocolWriter::serializedSizeListBegin(TType elemType,
                                                        uint32_t size) {
-  return serializedSizeByte() + serializedSizeI32();
+  return (skipIndex_ ? sizeof(uint32_t) : 0) +
+         serializedSizeByte() + serializedSizeI32();
 }
 
 uint32_t CompactProtocolWriter::serializedSizeListEnd() {
@@ -335,7 +538,8 @@ uint32_t CompactProtocolWriter::serializedSizeListEnd() {
 
 uint32_t CompactProtocolWriter::serializedSizeSetBegin(TType elemType,
                                                       uint32_t size) {
-  return serializedSizeByte() + serializedSizeI32();
+  return (skipIndex_ ? sizeof(uint32_t) : 0) +
+         serializedSizeByte() + serializedSizeI32();
 }
 
 uint32_t CompactProtocolWriter::serializedSizeSetEnd() {
@@ -395,6 +599,12 @@ uint32_t CompactProtocolWriter::serializedSizeBinary(
   return serializedSizeI32() + size;
 }
 
+uint32_t CompactProtocolWriter::serializedSizeSerializedData(
+    const std::unique_ptr<folly::IOBuf>& buf) {
+  // writeSerializedData chains the buffer in, it needs no space of its own
+  return 0;
+}
+
 /**
  * Reading functions
  */
@@ -433,10 +643,31 @@ uint32_t CompactProtocolReader::readMessageEnd() {
   return 0;
 }
 
+uint32_t CompactProtocolReader::readLength(uint32_t& length) {
+  length = in_.readLE<uint32_t>();
+  return sizeof(length);
+}
+
+uint32_t CompactProtocolReader::skip(TType type) {
+  if (skipIndex_ &&
+      (type == TType::T_STRUCT || type == TType::T_MAP ||
+       type == TType::T_SET || type == TType::T_LIST)) {
+    uint32_t length;
+    uint32_t rsize = readLength(length);
+    in_.skip(length);
+    return rsize + length;
+  }
+  return apache::thrift::skip(*this, type);
+}
+
 uint32_t CompactProtocolReader::readStructBegin(std::string& name) {
   name.clear();
   lastField_.push(lastFieldId_);
   lastFieldId_ = 0;
+  if (skipIndex_) {
+    uint32_t length;
+    return readLength(length);
+  }
   return 0;
 }
 
@@ -498,6 +729,11 @@ uint32_t CompactProtocolReader::readMapBegin(TType& keyType,
   int8_t kvType = 0;
   int32_t msize = 0;
 
+  if (skipIndex_) {
+    uint32_t length;
+    rsize += readLength(length);
+  }
+
   rsize += apache::thrift::util::readVarint(in_, msize);
   if (msize != 0)
     rsize += readByte(kvType);
@@ -525,6 +761,10 @@ uint32_t CompactProtocolReader::readListBegin(TType& elemType,
   uint32_t rsize = 0;
   int32_t lsize;
 
+  if (skipIndex_) {
+    uint32_t length;
+    rsize += readLength(length);
+  }
   rsize += readByte(size_and_type);
 
   lsize = ((uint8_t)size_and_type >> 4) & 0x0f;
@@ -621,6 +861,56 @@ uint32_t CompactProtocolReader::readFloat(float& flt) {
   return 4;
 }
 
+template <class T>
+uint32_t CompactProtocolReader::readVarintList(T* values, uint32_t size) {
+  uint32_t rsize = 0;
+  uint32_t i = 0;
+  while (i < size) {
+    auto data = in_.peek();
+    const uint8_t* p = data.first;
+    i += detail::compact::readZigzagRun(p, data.first + data.second,
+                                        values + i, size - i);
+    in_.skip(p - data.first);
+    rsize += p - data.first;
+    if (i < size) {
+      // The next varint may span buffers; let the cursor handle it
+      typename std::make_unsigned<T>::type value;
+      rsize += apache::thrift::util::readVarint(in_, value);
+      values[i++] = detail::compact::zigzagDecode<T>(value);
+    }
+  }
+  return rsize;
+}
+
+uint32_t CompactProtocolReader::readI32List(int32_t* values, uint32_t size) {
+  return readVarintList(values, size);
+}
+
+uint32_t CompactProtocolReader::readI64List(int64_t* values, uint32_t size) {
+  return readVarintList(values, size);
+}
+
+uint32_t CompactProtocolReader::readDoubleList(double* values,
+                                              uint32_t size) {
+  uint32_t i = 0;
+  while (i < size) {
+    auto data = in_.peek();
+    size_t n = std::min<size_t>(size - i, data.second / sizeof(uint64_t));
+    for (size_t k = 0; k < n; ++k) {
+      uint64_t bits;
+      memcpy(&bits, data.first + k * sizeof(bits), sizeof(bits));
+      values[i + k] = bitwise_cast<double>(folly::Endian::big(bits));
+    }
+    in_.skip(n * sizeof(uint64_t));
+    i += n;
+    if (i < size) {
+      // Spans buffers
+      readDouble(values[i++]);
+    }
+  }
+  return size * sizeof(uint64_t);
+}
+
 uint32_t CompactProtocolReader::readStringSize(int32_t& size) {
   uint32_t rsize = apache::thrift::util::readVarint(in_, size);
 
@@ -0,0 +1,110 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef CPP2_PROTOCOL_FIELDMASK_H_
+#define CPP2_PROTOCOL_FIELDMASK_H_ 1
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+namespace apache { namespace thrift {
+
+/**
+ * Masks of field ids for the readProjected() and writeProjected() methods
+ * generated with the projection flag.  Any class with a
+ * bool contains(int16_t) const method will do; these are the two usual
+ * ones.
+ *
+ * A mask only applies to the fields of the struct it is passed to: the
+ * fields of a selected struct field are all read or written.
+ */
+
+/**
+ * Mask built at run time.  Field ids from 0 to 63 are tested with one
+ * bit test, others with a binary search.
+ */
+class FieldMask {
+ public:
+  // Selects no fields
+  FieldMask()
+    : low_(0) {}
+
+  /* implicit */ FieldMask(std::initializer_list<int16_t> ids)
+    : low_(0) {
+    for (auto id : ids) {
+      add(id);
+    }
+  }
+
+  void add(int16_t id) {
+    if (isLow(id)) {
+      low_ |= uint64_t(1) << id;
+    } else {
+      auto it = std::lower_bound(other_.begin(), other_.end(), id);
+      if (it == other_.end() || *it != id) {
+        other_.insert(it, id);
+      }
+    }
+  }
+
+  bool contains(int16_t id) const {
+    if (isLow(id)) {
+      return (low_ >> id) & 1;
+    }
+    return std::binary_search(other_.begin(), other_.end(), id);
+  }
+
+ private:
+  static bool isLow(int16_t id) {
+    return uint16_t(id) < 64;
+  }
+
+  uint64_t low_;
+  // Sorted ids that do not fit in low_
+  std::vector<int16_t> other_;
+};
+
+/**
+ * Mask known at compile time, such as StaticFieldMask<1, 5>.  contains()
+ * is constexpr, and the generated code tests it with each field's constant
+ * id, in its case of readProjected() and its block of writeProjected(), so
+ * the compiler folds every test away.
+ */
+template <int16_t... Ids>
+struct StaticFieldMask;
+
+template <>
+struct StaticFieldMask<> {
+  static constexpr bool contains(int16_t /* id */) {
+    return false;
+  }
+};
+
+template <int16_t Id, int16_t... Ids>
+struct StaticFieldMask<Id, Ids...> {
+  static constexpr bool contains(int16_t id) {
+    return id == Id || StaticFieldMask<Ids...>::contains(id);
+  }
+};
+
+}} // apache::thrift
+
+#endif // #ifndef CPP2_PROTOCOL_FIELDMASK_H_
@@ -0,0 +1,190 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef CPP2_PROTOCOL_LAZYFIELD_H_
+#define CPP2_PROTOCOL_LAZYFIELD_H_ 1
+
+#include <thrift/lib/cpp2/CloneableIOBuf.h>
+#include <thrift/lib/cpp2/protocol/Protocol.h>
+#include <thrift/lib/cpp2/protocol/BinaryProtocol.h>
+#include <thrift/lib/cpp2/protocol/CompactProtocol.h>
+
+#include <utility>
+
+namespace apache { namespace thrift {
+
+/**
+ * Type of the fields annotated with cpp.lazy.
+ *
+ * When read with BinaryProtocol or CompactProtocol, the field keeps the
+ * bytes of its value as a clone of the input IOBuf instead of
+ * deserializing it.  The value is only read the first time it is asked
+ * for with get(); writing the field with the protocol it was read with
+ * chains the saved bytes into the output, so a struct can be forwarded
+ * without the lazy fields it never looked at being read or written.
+ *
+ * Ops is a class generated with the struct that has static read(),
+ * write(), serializedSize() and serializedSizeZC() templates for T.
+ *
+ * Like the rest of a struct, a LazyField is not safe to use from several
+ * threads without locking, even through const methods, since the first
+ * get() deserializes into the field.  The saved bytes share (and keep
+ * alive) the buffer the struct was read from.
+ */
+template <class T, class Ops>
+class LazyField {
+ public:
+  LazyField()
+    : value_()
+    , protocol_(protocol::T_BINARY_PROTOCOL)
+    , skipIndex_(false)
+    , deserialized_(false) {}
+
+  /* implicit */ LazyField(T value)
+    : value_(std::move(value))
+    , protocol_(protocol::T_BINARY_PROTOCOL)
+    , skipIndex_(false)
+    , deserialized_(false) {}
+
+  /**
+   * The value, deserialized from the saved bytes on the first call.  The
+   * bytes are kept, so the field is still written without being
+   * serialized again.
+   */
+  const T& get() const {
+    if (serialized_ && !deserialized_) {
+      deserialize();
+    }
+    return value_;
+  }
+
+  /**
+   * The value, for changing it.  This drops the saved bytes: the field
+   * will be serialized from the value when written.
+   */
+  T& mutable_get() {
+    get();
+    serialized_.reset();
+    return value_;
+  }
+
+  void set(T value) {
+    value_ = std::move(value);
+    serialized_.reset();
+  }
+
+  void clear() {
+    set(T());
+  }
+
+  // Whether the value is still only held as serialized bytes
+  bool isSerialized() const {
+    return serialized_ && !deserialized_;
+  }
+
+  bool operator==(const LazyField& other) const {
+    return get() == other.get();
+  }
+
+  bool operator<(const LazyField& other) const {
+    return get() < other.get();
+  }
+
+  /**
+   * Used by the generated code to read the field's value, whose type on
+   * the wire is type.
+   */
+  template <class Protocol_>
+  uint32_t read(Protocol_* iprot, protocol::TType type) {
+    ProtocolType proto = iprot->protocolType();
+    if (proto != protocol::T_BINARY_PROTOCOL &&
+        proto != protocol::T_COMPACT_PROTOCOL) {
+      set(T());
+      return Ops::read(iprot, value_);
+    }
+    auto begin = iprot->getCurrentPosition();
+    uint32_t xfer = iprot->skip(type);
+    std::unique_ptr<folly::IOBuf> buf;
+    begin.clone(buf, iprot->getCurrentPosition() - begin);
+    value_ = T();
+    serialized_ = std::move(buf);
+    protocol_ = proto;
+    skipIndex_ = usesSkipIndex(iprot);
+    deserialized_ = false;
+    return xfer;
+  }
+
+  template <class Protocol_>
+  uint32_t write(Protocol_* prot) const {
+    if (canWriteSerialized(prot)) {
+      return prot->writeSerializedData(serialized_);
+    }
+    return Ops::write(prot, get());
+  }
+
+  template <class Protocol_>
+  uint32_t serializedSize(Protocol_* prot) const {
+    if (canWriteSerialized(prot)) {
+      return prot->serializedSizeSerializedData(serialized_);
+    }
+    return Ops::serializedSize(prot, get());
+  }
+
+  template <class Protocol_>
+  uint32_t serializedSizeZC(Protocol_* prot) const {
+    if (canWriteSerialized(prot)) {
+      return prot->serializedSizeSerializedData(serialized_);
+    }
+    return Ops::serializedSizeZC(prot, get());
+  }
+
+ private:
+  // Whether the saved bytes are what prot would write for the value
+  template <class Protocol_>
+  bool canWriteSerialized(Protocol_* prot) const {
+    return serialized_ && prot->protocolType() == protocol_ &&
+           usesSkipIndex(prot) == skipIndex_;
+  }
+
+  void deserialize() const {
+    if (protocol_ == protocol::T_COMPACT_PROTOCOL) {
+      CompactProtocolReader reader;
+      reader.setSkipIndex(skipIndex_);
+      reader.setInput(serialized_.get());
+      Ops::read(&reader, value_);
+    } else {
+      BinaryProtocolReader reader;
+      reader.setInput(serialized_.get());
+      Ops::read(&reader, value_);
+    }
+    deserialized_ = true;
+  }
+
+  mutable T value_;
+  // Bytes of the value as read, while they can still be written as they are
+  CloneableIOBuf serialized_;
+  ProtocolType protocol_;
+  // Whether they were read with the compact protocol's skip index
+  bool skipIndex_;
+  mutable bool deserialized_;
+};
+
+}} // apache::thrift
+
+#endif // #ifndef CPP2_PROTOCOL_LAZYFIELD_H_
@@ -171,6 +171,83 @@ uint32_t skip(Protocol_& prot, TType type) {
   }
 }
 
+/**
+ * Whether a protocol reads or writes the skip index (the length of each
+ * struct and container ahead of it).  Only CompactProtocol has one; it
+ * overloads these in CompactProtocol.h.
+ */
+template <class Protocol_>
+bool usesSkipIndex(const Protocol_* prot) {
+  return false;
+}
+
+template <class Protocol_>
+void setSkipIndex(Protocol_* prot, bool skipIndex) {}
+
+/**
+ * Reads and writes of the elements of list<i32>, list<i64> and
+ * list<double>, used by generated code for lists held in a std::vector.
+ * The default goes element by element.  Protocols that can do better on
+ * whole runs of numbers specialize it (see CompactProtocol.h).
+ */
+template <class Protocol_>
+class NumericListOps {
+ public:
+  static uint32_t readI32List(Protocol_* prot, int32_t* values,
+                              uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += prot->readI32(values[i]);
+    }
+    return xfer;
+  }
+
+  static uint32_t readI64List(Protocol_* prot, int64_t* values,
+                              uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += prot->readI64(values[i]);
+    }
+    return xfer;
+  }
+
+  static uint32_t readDoubleList(Protocol_* prot, double* values,
+                                 uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += prot->readDouble(values[i]);
+    }
+    return xfer;
+  }
+
+  static uint32_t writeI32List(Protocol_* prot, const int32_t* values,
+                               uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += prot->writeI32(values[i]);
+    }
+    return xfer;
+  }
+
+  static uint32_t writeI64List(Protocol_* prot, const int64_t* values,
+                               uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += prot->writeI64(values[i]);
+    }
+    return xfer;
+  }
+
+  static uint32_t writeDoubleList(Protocol_* prot, const double* values,
+                                  uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += prot->writeDouble(values[i]);
+    }
+    return xfer;
+  }
+};
+
 template <class StrType>
 struct StringTraits {
   static StrType fromStringLiteral(const char* str) {
@@ -19,9 +19,11 @@
 #ifndef CPP2_SERIALIZER_H
 #define CPP2_SERIALIZER_H
 
+#include <thrift/lib/cpp2/Arena.h>
 #include <thrift/lib/cpp2/Thrift.h>
 #include <thrift/lib/cpp2/protocol/Protocol.h>
 #include <thrift/lib/cpp2/protocol/CompactProtocol.h>
+#include <thrift/lib/cpp2/protocol/FieldMask.h>
 #include <thrift/lib/cpp2/protocol/BinaryProtocol.h>
 #include <thrift/lib/cpp/TApplicationException.h>
 #include <folly/io/IOBuf.h>
@@ -39,6 +41,18 @@ struct Serializer {
     // if you don't need to support thrift1-compatibility types
     apache::thrift::Cpp2Ops<T>::read(&reader, &obj);
   }
+  /**
+   * Reads a T made in arena, with the arena current so that the strings
+   * and containers of a T generated with the arena flag allocate from it.
+   * arena.reset() destroys and frees the object.
+   */
+  template <class T>
+  static T* deserialize(const folly::IOBuf* buf, Arena& arena) {
+    T* obj = arena.create<T>();
+    ArenaScope scope(&arena);
+    deserialize(buf, *obj);
+    return obj;
+  }
   template <class T>
   static void serialize(const T& obj, folly::IOBufQueue* out) {
     Writer writer;
@@ -48,6 +62,25 @@ struct Serializer {
     // if you don't need to support thrift1-compatibility types
     apache::thrift::Cpp2Ops<T>::write(&writer, &obj);
   }
+
+  /**
+   * Read or write only the fields of obj in mask (see FieldMask.h).  T must
+   * be generated with the projection flag.
+   */
+  template <class T, class Mask>
+  static void deserializeProjected(const folly::IOBuf* buf, T& obj,
+                                   const Mask& mask) {
+    Reader reader;
+    reader.setInput(buf);
+    obj.readProjected(&reader, mask);
+  }
+  template <class T, class Mask>
+  static void serializeProjected(const T& obj, folly::IOBufQueue* out,
+                                 const Mask& mask) {
+    Writer writer;
+    writer.setOutput(out);
+    obj.writeProjected(&writer, mask);
+  }
 };
 
 typedef Serializer<CompactProtocolReader, CompactProtocolWriter>
@@ -0,0 +1,65 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef CPP2_PROTOCOL_STRINGVIEW_H_
+#define CPP2_PROTOCOL_STRINGVIEW_H_ 1
+
+#include <thrift/lib/cpp2/CloneableIOBuf.h>
+
+#include <folly/Range.h>
+#include <folly/io/IOBuf.h>
+
+namespace apache { namespace thrift {
+
+/**
+ * Reads a string or binary field whose cpp.type is folly::StringPiece or
+ * folly::ByteRange.
+ *
+ * The view points into the buffer being read: with BinaryProtocol and
+ * CompactProtocol the bytes are not copied unless they span two IOBufs of
+ * the input.  The IOBuf holding them is chained onto anchor, which the
+ * generated struct keeps (as __views) so that the views stay valid for
+ * its lifetime, copies included.  A struct with views keeps the whole
+ * input buffer alive; __clear() lets go of it.
+ */
+template <class Protocol_, class Range>
+uint32_t readStringView(Protocol_* iprot, Range& view,
+                        CloneableIOBuf& anchor) {
+  std::unique_ptr<folly::IOBuf> buf;
+  uint32_t xfer = iprot->readBinary(buf);
+  if (!buf || buf->empty()) {
+    view = Range();
+    return xfer;
+  }
+  if (buf->isChained()) {
+    buf->coalesce();
+  }
+  view = Range(reinterpret_cast<typename Range::iterator>(buf->data()),
+               buf->length());
+  if (anchor) {
+    anchor->prependChain(std::move(buf));
+  } else {
+    anchor = std::move(buf);
+  }
+  return xfer;
+}
+
+}} // apache::thrift
+
+#endif // #ifndef CPP2_PROTOCOL_STRINGVIEW_H_
@@ -0,0 +1,45 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/lib/cpp2/protocol/TableSerializer.h>
+
+namespace apache { namespace thrift {
+
+#define THRIFT_TABLE_BASE_TYPE_INFO(Type, TType)                        \
+  const TypeInfo TypeInfoOf<Type>::info = {                             \
+    protocol::TType, nullptr, nullptr, nullptr, nullptr,                \
+  };
+
+THRIFT_TABLE_BASE_TYPE_INFO(bool, T_BOOL)
+THRIFT_TABLE_BASE_TYPE_INFO(int8_t, T_BYTE)
+THRIFT_TABLE_BASE_TYPE_INFO(int16_t, T_I16)
+THRIFT_TABLE_BASE_TYPE_INFO(int32_t, T_I32)
+THRIFT_TABLE_BASE_TYPE_INFO(int64_t, T_I64)
+THRIFT_TABLE_BASE_TYPE_INFO(double, T_DOUBLE)
+THRIFT_TABLE_BASE_TYPE_INFO(float, T_FLOAT)
+THRIFT_TABLE_BASE_TYPE_INFO(std::string, T_STRING)
+
+#undef THRIFT_TABLE_BASE_TYPE_INFO
+
+template class TableReader<BinaryProtocolReader>;
+template class TableReader<CompactProtocolReader>;
+template class TableWriter<BinaryProtocolWriter>;
+template class TableWriter<CompactProtocolWriter>;
+
+}} // apache::thrift
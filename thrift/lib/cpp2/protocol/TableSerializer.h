@@ -0,0 +1,407 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef CPP2_PROTOCOL_TABLESERIALIZER_H_
+#define CPP2_PROTOCOL_TABLESERIALIZER_H_ 1
+
+#include <thrift/lib/cpp2/protocol/Protocol.h>
+#include <thrift/lib/cpp2/protocol/BinaryProtocol.h>
+#include <thrift/lib/cpp2/protocol/CompactProtocol.h>
+
+#include <cstddef>
+#include <map>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Structs generated with the table_serializer flag describe their fields
+ * with a constant StructInfo table instead of having a read(), write() and
+ * serializedSize() body per protocol; their methods call TableReader and
+ * TableWriter, which walk the table.  The interpreters are instantiated
+ * once for BinaryProtocol and CompactProtocol in the library, so each
+ * struct only costs its table and a few calls in the generated code.
+ *
+ * Tables hold offsets into the struct and point to TypeInfo objects, which
+ * say how a value is put on the wire and, for containers, how to get at
+ * its elements through the ContainerOps of the C++ container type.  Those
+ * are shared by every field of the same type.
+ */
+
+namespace apache { namespace thrift {
+
+struct StructInfo;
+struct ContainerOps;
+
+/**
+ * How a value of some C++ type is serialized.  Get it with
+ * TypeInfoOf<T>::info.
+ */
+struct TypeInfo {
+  TType type;
+  // T_STRUCT
+  const StructInfo* structInfo;
+  // Elements of lists and sets, keys and values of maps
+  const TypeInfo* key;
+  const TypeInfo* value;
+  const ContainerOps* ops;
+};
+
+struct FieldInfo {
+  enum Requiredness {
+    REQUIRED,
+    OPTIONAL,
+    DEFAULT,
+  };
+
+  int16_t id;
+  Requiredness req;
+  const char* name;
+  // Of the value, and of its flag in __isset (-1 for required fields)
+  uint32_t offset;
+  int32_t issetOffset;
+  const TypeInfo* type;
+};
+
+struct StructInfo {
+  const char* name;
+  // Sorted by id
+  const FieldInfo* fields;
+  uint32_t numFields;
+};
+
+/**
+ * Type erased access to a container.  insert() default constructs an
+ * element (or map key), has read fill it in, and adds it; read is called
+ * a second time with isValue set for the value of a map entry.  forEach()
+ * calls write with every element, or key and value.  resize() and data()
+ * are only set for vectors, and only used for vectors of int32_t, int64_t
+ * and double.
+ */
+struct ContainerOps {
+  typedef void (*ReadFn)(void* ctx, void* elem, bool isValue);
+  typedef void (*WriteFn)(void* ctx, const void* elem, const void* value);
+
+  uint32_t (*size)(const void* c);
+  void (*clear)(void* c);
+  void (*insert)(void* c, ReadFn read, void* ctx);
+  void (*forEach)(const void* c, WriteFn write, void* ctx);
+  void* (*resize)(void* c, uint32_t size);
+  const void* (*data)(const void* c);
+};
+
+template <class C>
+struct ContainerOpsOf;
+
+template <class T, class A>
+struct ContainerOpsOf<std::vector<T, A>> {
+  typedef std::vector<T, A> C;
+
+  static uint32_t size(const void* c) {
+    return static_cast<const C*>(c)->size();
+  }
+
+  static void clear(void* c) {
+    static_cast<C*>(c)->clear();
+  }
+
+  static void insert(void* c, ContainerOps::ReadFn read, void* ctx) {
+    auto& v = *static_cast<C*>(c);
+    v.emplace_back();
+    read(ctx, &v.back(), false);
+  }
+
+  static void forEach(const void* c, ContainerOps::WriteFn write,
+                      void* ctx) {
+    for (const auto& elem : *static_cast<const C*>(c)) {
+      write(ctx, &elem, nullptr);
+    }
+  }
+
+  static void* resize(void* c, uint32_t size) {
+    auto& v = *static_cast<C*>(c);
+    v.resize(size);
+    return v.data();
+  }
+
+  static const void* data(const void* c) {
+    return static_cast<const C*>(c)->data();
+  }
+
+  static const ContainerOps ops;
+};
+
+template <class T, class A>
+const ContainerOps ContainerOpsOf<std::vector<T, A>>::ops = {
+  &size, &clear, &insert, &forEach, &resize, &data,
+};
+
+// No addressable elements
+template <class A>
+struct ContainerOpsOf<std::vector<bool, A>> {
+  typedef std::vector<bool, A> C;
+
+  static uint32_t size(const void* c) {
+    return static_cast<const C*>(c)->size();
+  }
+
+  static void clear(void* c) {
+    static_cast<C*>(c)->clear();
+  }
+
+  static void insert(void* c, ContainerOps::ReadFn read, void* ctx) {
+    bool elem;
+    read(ctx, &elem, false);
+    static_cast<C*>(c)->push_back(elem);
+  }
+
+  static void forEach(const void* c, ContainerOps::WriteFn write,
+                      void* ctx) {
+    for (bool elem : *static_cast<const C*>(c)) {
+      write(ctx, &elem, nullptr);
+    }
+  }
+
+  static const ContainerOps ops;
+};
+
+template <class A>
+const ContainerOps ContainerOpsOf<std::vector<bool, A>>::ops = {
+  &size, &clear, &insert, &forEach, nullptr, nullptr,
+};
+
+template <class T, class Compare, class A>
+struct ContainerOpsOf<std::set<T, Compare, A>> {
+  typedef std::set<T, Compare, A> C;
+
+  static uint32_t size(const void* c) {
+    return static_cast<const C*>(c)->size();
+  }
+
+  static void clear(void* c) {
+    static_cast<C*>(c)->clear();
+  }
+
+  static void insert(void* c, ContainerOps::ReadFn read, void* ctx) {
+    T elem;
+    read(ctx, &elem, false);
+    static_cast<C*>(c)->insert(std::move(elem));
+  }
+
+  static void forEach(const void* c, ContainerOps::WriteFn write,
+                      void* ctx) {
+    for (const auto& elem : *static_cast<const C*>(c)) {
+      write(ctx, &elem, nullptr);
+    }
+  }
+
+  static const ContainerOps ops;
+};
+
+template <class T, class Compare, class A>
+const ContainerOps ContainerOpsOf<std::set<T, Compare, A>>::ops = {
+  &size, &clear, &insert, &forEach, nullptr, nullptr,
+};
+
+template <class K, class V, class Compare, class A>
+struct ContainerOpsOf<std::map<K, V, Compare, A>> {
+  typedef std::map<K, V, Compare, A> C;
+
+  static uint32_t size(const void* c) {
+    return static_cast<const C*>(c)->size();
+  }
+
+  static void clear(void* c) {
+    static_cast<C*>(c)->clear();
+  }
+
+  static void insert(void* c, ContainerOps::ReadFn read, void* ctx) {
+    K key;
+    read(ctx, &key, false);
+    read(ctx, &(*static_cast<C*>(c))[std::move(key)], true);
+  }
+
+  static void forEach(const void* c, ContainerOps::WriteFn write,
+                      void* ctx) {
+    for (const auto& elem : *static_cast<const C*>(c)) {
+      write(ctx, &elem.first, &elem.second);
+    }
+  }
+
+  static const ContainerOps ops;
+};
+
+template <class K, class V, class Compare, class A>
+const ContainerOps ContainerOpsOf<std::map<K, V, Compare, A>>::ops = {
+  &size, &clear, &insert, &forEach, nullptr, nullptr,
+};
+
+/**
+ * The primary template is for generated structs, which declare their
+ * table as the static member __table.  Base types are defined in
+ * TableSerializer.cpp.
+ */
+template <class T, class Enable = void>
+struct TypeInfoOf {
+  static const TypeInfo info;
+};
+
+template <class T, class Enable>
+const TypeInfo TypeInfoOf<T, Enable>::info = {
+  protocol::T_STRUCT, &T::__table, nullptr, nullptr, nullptr,
+};
+
+// Enums are read and written in place as i32
+template <class T>
+struct TypeInfoOf<T, typename std::enable_if<std::is_enum<T>::value>::type> {
+  static_assert(sizeof(T) == sizeof(int32_t), "enum must be 32 bits");
+  static const TypeInfo info;
+};
+
+template <class T>
+const TypeInfo TypeInfoOf<
+    T, typename std::enable_if<std::is_enum<T>::value>::type>::info = {
+  protocol::T_I32, nullptr, nullptr, nullptr, nullptr,
+};
+
+#define THRIFT_TABLE_BASE_TYPE(Type)                                    \
+  template <>                                                           \
+  struct TypeInfoOf<Type> {                                             \
+    static const TypeInfo info;                                         \
+  };
+
+THRIFT_TABLE_BASE_TYPE(bool)
+THRIFT_TABLE_BASE_TYPE(int8_t)
+THRIFT_TABLE_BASE_TYPE(int16_t)
+THRIFT_TABLE_BASE_TYPE(int32_t)
+THRIFT_TABLE_BASE_TYPE(int64_t)
+THRIFT_TABLE_BASE_TYPE(double)
+THRIFT_TABLE_BASE_TYPE(float)
+THRIFT_TABLE_BASE_TYPE(std::string)
+
+#undef THRIFT_TABLE_BASE_TYPE
+
+template <class T, class A>
+struct TypeInfoOf<std::vector<T, A>> {
+  static const TypeInfo info;
+};
+
+template <class T, class A>
+const TypeInfo TypeInfoOf<std::vector<T, A>>::info = {
+  protocol::T_LIST, nullptr, &TypeInfoOf<T>::info, nullptr,
+  &ContainerOpsOf<std::vector<T, A>>::ops,
+};
+
+template <class T, class Compare, class A>
+struct TypeInfoOf<std::set<T, Compare, A>> {
+  static const TypeInfo info;
+};
+
+template <class T, class Compare, class A>
+const TypeInfo TypeInfoOf<std::set<T, Compare, A>>::info = {
+  protocol::T_SET, nullptr, &TypeInfoOf<T>::info, nullptr,
+  &ContainerOpsOf<std::set<T, Compare, A>>::ops,
+};
+
+template <class K, class V, class Compare, class A>
+struct TypeInfoOf<std::map<K, V, Compare, A>> {
+  static const TypeInfo info;
+};
+
+template <class K, class V, class Compare, class A>
+const TypeInfo TypeInfoOf<std::map<K, V, Compare, A>>::info = {
+  protocol::T_MAP, nullptr, &TypeInfoOf<K>::info, &TypeInfoOf<V>::info,
+  &ContainerOpsOf<std::map<K, V, Compare, A>>::ops,
+};
+
+/**
+ * Reads the struct described by info into obj, with the same semantics as
+ * a generated read(): unknown fields and fields of the wrong type are
+ * skipped, __isset flags are set for the fields read, and a missing
+ * required field throws after the whole struct has been read.
+ */
+template <class Protocol_>
+class TableReader {
+ public:
+  static uint32_t read(Protocol_* iprot, const StructInfo& info, void* obj);
+
+ private:
+  struct ElemContext {
+    Protocol_* iprot;
+    const TypeInfo* type;
+    uint32_t xfer;
+  };
+
+  static uint32_t readValue(Protocol_* iprot, const TypeInfo& type,
+                            void* value);
+  static uint32_t readContainer(Protocol_* iprot, const TypeInfo& type,
+                                void* value);
+  static void readElem(void* ctx, void* elem, bool isValue);
+};
+
+/**
+ * Writes, or computes the serialized size of, the struct described by
+ * info, as a generated write() or serializedSize() would.  Fields are all
+ * std::string or plain containers, so serializedSizeZC is the same as
+ * serializedSize.
+ */
+template <class Protocol_>
+class TableWriter {
+ public:
+  static uint32_t write(Protocol_* prot, const StructInfo& info,
+                        const void* obj);
+  static uint32_t serializedSize(Protocol_* prot, const StructInfo& info,
+                                 const void* obj);
+
+ private:
+  struct ElemContext {
+    Protocol_* prot;
+    const TypeInfo* type;
+    uint32_t xfer;
+  };
+
+  static uint32_t writeValue(Protocol_* prot, const TypeInfo& type,
+                             const void* value);
+  static uint32_t writeContainer(Protocol_* prot, const TypeInfo& type,
+                                 const void* value);
+  static void writeElem(void* ctx, const void* elem, const void* value);
+
+  static uint32_t sizeValue(Protocol_* prot, const TypeInfo& type,
+                            const void* value);
+  static uint32_t sizeContainer(Protocol_* prot, const TypeInfo& type,
+                                const void* value);
+  static void sizeElem(void* ctx, const void* elem, const void* value);
+};
+
+}} // apache::thrift
+
+#include <thrift/lib/cpp2/protocol/TableSerializer.tcc>
+
+namespace apache { namespace thrift {
+
+// Instantiated in TableSerializer.cpp
+extern template class TableReader<BinaryProtocolReader>;
+extern template class TableReader<CompactProtocolReader>;
+extern template class TableWriter<BinaryProtocolWriter>;
+extern template class TableWriter<CompactProtocolWriter>;
+
+}} // apache::thrift
+
+#endif // #ifndef CPP2_PROTOCOL_TABLESERIALIZER_H_
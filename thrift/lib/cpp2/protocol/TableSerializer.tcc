@@ -0,0 +1,406 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef CPP2_PROTOCOL_TABLESERIALIZER_TCC_
+#define CPP2_PROTOCOL_TABLESERIALIZER_TCC_ 1
+
+#include <thrift/lib/cpp2/protocol/TableSerializer.h>
+
+#include <algorithm>
+
+namespace apache { namespace thrift {
+
+namespace detail { namespace table {
+
+/**
+ * The field with the given id.  Fields usually arrive in id order, so the
+ * one after the previous match is tried first; next is left after the
+ * field found.
+ */
+inline const FieldInfo* findField(const StructInfo& info, int16_t id,
+                                  uint32_t& next) {
+  if (next < info.numFields && info.fields[next].id == id) {
+    return &info.fields[next++];
+  }
+  const FieldInfo* end = info.fields + info.numFields;
+  const FieldInfo* field = std::lower_bound(
+    info.fields, end, id,
+    [](const FieldInfo& f, int16_t i) { return f.id < i; });
+  if (field == end || field->id != id) {
+    return nullptr;
+  }
+  next = field - info.fields + 1;
+  return field;
+}
+
+inline bool isSet(const FieldInfo& field, const void* obj) {
+  return field.req != FieldInfo::OPTIONAL ||
+    *reinterpret_cast<const bool*>(
+      static_cast<const char*>(obj) + field.issetOffset);
+}
+
+inline void setIsset(const FieldInfo& field, void* obj) {
+  *reinterpret_cast<bool*>(static_cast<char*>(obj) + field.issetOffset) =
+    true;
+}
+
+inline const void* fieldValue(const FieldInfo& field, const void* obj) {
+  return static_cast<const char*>(obj) + field.offset;
+}
+
+inline void* fieldValue(const FieldInfo& field, void* obj) {
+  return static_cast<char*>(obj) + field.offset;
+}
+
+}} // detail::table
+
+template <class Protocol_>
+uint32_t TableReader<Protocol_>::read(Protocol_* iprot,
+                                      const StructInfo& info,
+                                      void* obj) {
+  uint32_t xfer = 0;
+  std::string fname;
+  TType ftype;
+  int16_t fid;
+  // Required fields seen, by index; the generator keeps them in the first
+  // 64 fields
+  uint64_t required = 0;
+  uint32_t next = 0;
+
+  xfer += iprot->readStructBegin(fname);
+  while (true) {
+    xfer += iprot->readFieldBegin(fname, ftype, fid);
+    if (ftype == protocol::T_STOP) {
+      break;
+    }
+    const FieldInfo* field = detail::table::findField(info, fid, next);
+    if (field && ftype == field->type->type) {
+      xfer += readValue(iprot, *field->type,
+                        detail::table::fieldValue(*field, obj));
+      if (field->req == FieldInfo::REQUIRED) {
+        required |= uint64_t(1) << (field - info.fields);
+      } else {
+        detail::table::setIsset(*field, obj);
+      }
+    } else {
+      xfer += iprot->skip(ftype);
+    }
+    xfer += iprot->readFieldEnd();
+  }
+  xfer += iprot->readStructEnd();
+
+  for (uint32_t i = 0; i < info.numFields; ++i) {
+    const FieldInfo& field = info.fields[i];
+    if (field.req == FieldInfo::REQUIRED &&
+        !(required & (uint64_t(1) << i))) {
+      throw TProtocolException(
+        TProtocolException::MISSING_REQUIRED_FIELD,
+        std::string("Required field '") + field.name +
+        "' was not found in serialized data! Struct: " + info.name);
+    }
+  }
+  return xfer;
+}
+
+template <class Protocol_>
+uint32_t TableReader<Protocol_>::readValue(Protocol_* iprot,
+                                           const TypeInfo& type,
+                                           void* value) {
+  switch (type.type) {
+    case protocol::T_BOOL:
+      return iprot->readBool(*static_cast<bool*>(value));
+    case protocol::T_BYTE:
+      return iprot->readByte(*static_cast<int8_t*>(value));
+    case protocol::T_I16:
+      return iprot->readI16(*static_cast<int16_t*>(value));
+    case protocol::T_I32:
+      return iprot->readI32(*static_cast<int32_t*>(value));
+    case protocol::T_I64:
+      return iprot->readI64(*static_cast<int64_t*>(value));
+    case protocol::T_DOUBLE:
+      return iprot->readDouble(*static_cast<double*>(value));
+    case protocol::T_FLOAT:
+      return iprot->readFloat(*static_cast<float*>(value));
+    case protocol::T_STRING:
+      return iprot->readString(*static_cast<std::string*>(value));
+    case protocol::T_STRUCT:
+      return read(iprot, *type.structInfo, value);
+    case protocol::T_LIST:
+    case protocol::T_SET:
+    case protocol::T_MAP:
+      return readContainer(iprot, type, value);
+    default:
+      throw TProtocolException(TProtocolException::INVALID_DATA);
+  }
+}
+
+template <class Protocol_>
+uint32_t TableReader<Protocol_>::readContainer(Protocol_* iprot,
+                                               const TypeInfo& type,
+                                               void* value) {
+  const ContainerOps& ops = *type.ops;
+  uint32_t xfer = 0;
+  uint32_t size;
+  TType keyType;
+  TType valueType;
+  ops.clear(value);
+  if (type.type == protocol::T_MAP) {
+    xfer += iprot->readMapBegin(keyType, valueType, size);
+  } else if (type.type == protocol::T_SET) {
+    xfer += iprot->readSetBegin(keyType, size);
+  } else {
+    xfer += iprot->readListBegin(keyType, size);
+    if (type.key == &TypeInfoOf<int32_t>::info) {
+      xfer += NumericListOps<Protocol_>::readI32List(
+        iprot, static_cast<int32_t*>(ops.resize(value, size)), size);
+      return xfer + iprot->readListEnd();
+    } else if (type.key == &TypeInfoOf<int64_t>::info) {
+      xfer += NumericListOps<Protocol_>::readI64List(
+        iprot, static_cast<int64_t*>(ops.resize(value, size)), size);
+      return xfer + iprot->readListEnd();
+    } else if (type.key == &TypeInfoOf<double>::info) {
+      xfer += NumericListOps<Protocol_>::readDoubleList(
+        iprot, static_cast<double*>(ops.resize(value, size)), size);
+      return xfer + iprot->readListEnd();
+    }
+  }
+
+  ElemContext ctx{iprot, &type, 0};
+  for (uint32_t i = 0; i < size; ++i) {
+    ops.insert(value, &readElem, &ctx);
+  }
+  xfer += ctx.xfer;
+
+  if (type.type == protocol::T_MAP) {
+    xfer += iprot->readMapEnd();
+  } else if (type.type == protocol::T_SET) {
+    xfer += iprot->readSetEnd();
+  } else {
+    xfer += iprot->readListEnd();
+  }
+  return xfer;
+}
+
+template <class Protocol_>
+void TableReader<Protocol_>::readElem(void* ctx, void* elem, bool isValue) {
+  auto c = static_cast<ElemContext*>(ctx);
+  c->xfer += readValue(c->iprot, isValue ? *c->type->value : *c->type->key,
+                       elem);
+}
+
+template <class Protocol_>
+uint32_t TableWriter<Protocol_>::write(Protocol_* prot,
+                                       const StructInfo& info,
+                                       const void* obj) {
+  uint32_t xfer = 0;
+  xfer += prot->writeStructBegin(info.name);
+  for (uint32_t i = 0; i < info.numFields; ++i) {
+    const FieldInfo& field = info.fields[i];
+    if (!detail::table::isSet(field, obj)) {
+      continue;
+    }
+    xfer += prot->writeFieldBegin(field.name, field.type->type, field.id);
+    xfer += writeValue(prot, *field.type,
+                       detail::table::fieldValue(field, obj));
+    xfer += prot->writeFieldEnd();
+  }
+  xfer += prot->writeFieldStop();
+  xfer += prot->writeStructEnd();
+  return xfer;
+}
+
+template <class Protocol_>
+uint32_t TableWriter<Protocol_>::writeValue(Protocol_* prot,
+                                            const TypeInfo& type,
+                                            const void* value) {
+  switch (type.type) {
+    case protocol::T_BOOL:
+      return prot->writeBool(*static_cast<const bool*>(value));
+    case protocol::T_BYTE:
+      return prot->writeByte(*static_cast<const int8_t*>(value));
+    case protocol::T_I16:
+      return prot->writeI16(*static_cast<const int16_t*>(value));
+    case protocol::T_I32:
+      return prot->writeI32(*static_cast<const int32_t*>(value));
+    case protocol::T_I64:
+      return prot->writeI64(*static_cast<const int64_t*>(value));
+    case protocol::T_DOUBLE:
+      return prot->writeDouble(*static_cast<const double*>(value));
+    case protocol::T_FLOAT:
+      return prot->writeFloat(*static_cast<const float*>(value));
+    case protocol::T_STRING:
+      return prot->writeString(*static_cast<const std::string*>(value));
+    case protocol::T_STRUCT:
+      return write(prot, *type.structInfo, value);
+    case protocol::T_LIST:
+    case protocol::T_SET:
+    case protocol::T_MAP:
+      return writeContainer(prot, type, value);
+    default:
+      throw TProtocolException(TProtocolException::INVALID_DATA);
+  }
+}
+
+template <class Protocol_>
+uint32_t TableWriter<Protocol_>::writeContainer(Protocol_* prot,
+                                                const TypeInfo& type,
+                                                const void* value) {
+  const ContainerOps& ops = *type.ops;
+  uint32_t xfer = 0;
+  uint32_t size = ops.size(value);
+  if (type.type == protocol::T_MAP) {
+    xfer += prot->writeMapBegin(type.key->type, type.value->type, size);
+  } else if (type.type == protocol::T_SET) {
+    xfer += prot->writeSetBegin(type.key->type, size);
+  } else {
+    xfer += prot->writeListBegin(type.key->type, size);
+    if (type.key == &TypeInfoOf<int32_t>::info) {
+      xfer += NumericListOps<Protocol_>::writeI32List(
+        prot, static_cast<const int32_t*>(ops.data(value)), size);
+      return xfer + prot->writeListEnd();
+    } else if (type.key == &TypeInfoOf<int64_t>::info) {
+      xfer += NumericListOps<Protocol_>::writeI64List(
+        prot, static_cast<const int64_t*>(ops.data(value)), size);
+      return xfer + prot->writeListEnd();
+    } else if (type.key == &TypeInfoOf<double>::info) {
+      xfer += NumericListOps<Protocol_>::writeDoubleList(
+        prot, static_cast<const double*>(ops.data(value)), size);
+      return xfer + prot->writeListEnd();
+    }
+  }
+
+  ElemContext ctx{prot, &type, 0};
+  ops.forEach(value, &writeElem, &ctx);
+  xfer += ctx.xfer;
+
+  if (type.type == protocol::T_MAP) {
+    xfer += prot->writeMapEnd();
+  } else if (type.type == protocol::T_SET) {
+    xfer += prot->writeSetEnd();
+  } else {
+    xfer += prot->writeListEnd();
+  }
+  return xfer;
+}
+
+template <class Protocol_>
+void TableWriter<Protocol_>::writeElem(void* ctx, const void* elem,
+                                       const void* value) {
+  auto c = static_cast<ElemContext*>(ctx);
+  c->xfer += writeValue(c->prot, *c->type->key, elem);
+  if (value) {
+    c->xfer += writeValue(c->prot, *c->type->value, value);
+  }
+}
+
+template <class Protocol_>
+uint32_t TableWriter<Protocol_>::serializedSize(Protocol_* prot,
+                                                const StructInfo& info,
+                                                const void* obj) {
+  uint32_t xfer = 0;
+  xfer += prot->serializedStructSize(info.name);
+  for (uint32_t i = 0; i < info.numFields; ++i) {
+    const FieldInfo& field = info.fields[i];
+    if (!detail::table::isSet(field, obj)) {
+      continue;
+    }
+    xfer += prot->serializedFieldSize(field.name, field.type->type,
+                                      field.id);
+    xfer += sizeValue(prot, *field.type,
+                      detail::table::fieldValue(field, obj));
+  }
+  xfer += prot->serializedSizeStop();
+  return xfer;
+}
+
+template <class Protocol_>
+uint32_t TableWriter<Protocol_>::sizeValue(Protocol_* prot,
+                                           const TypeInfo& type,
+                                           const void* value) {
+  switch (type.type) {
+    case protocol::T_BOOL:
+      return prot->serializedSizeBool(*static_cast<const bool*>(value));
+    case protocol::T_BYTE:
+      return prot->serializedSizeByte(*static_cast<const int8_t*>(value));
+    case protocol::T_I16:
+      return prot->serializedSizeI16(*static_cast<const int16_t*>(value));
+    case protocol::T_I32:
+      return prot->serializedSizeI32(*static_cast<const int32_t*>(value));
+    case protocol::T_I64:
+      return prot->serializedSizeI64(*static_cast<const int64_t*>(value));
+    case protocol::T_DOUBLE:
+      return prot->serializedSizeDouble(*static_cast<const double*>(value));
+    case protocol::T_FLOAT:
+      return prot->serializedSizeFloat(*static_cast<const float*>(value));
+    case protocol::T_STRING:
+      return prot->serializedSizeString(
+        *static_cast<const std::string*>(value));
+    case protocol::T_STRUCT:
+      return serializedSize(prot, *type.structInfo, value);
+    case protocol::T_LIST:
+    case protocol::T_SET:
+    case protocol::T_MAP:
+      return sizeContainer(prot, type, value);
+    default:
+      throw TProtocolException(TProtocolException::INVALID_DATA);
+  }
+}
+
+template <class Protocol_>
+uint32_t TableWriter<Protocol_>::sizeContainer(Protocol_* prot,
+                                               const TypeInfo& type,
+                                               const void* value) {
+  uint32_t xfer = 0;
+  uint32_t size = type.ops->size(value);
+  if (type.type == protocol::T_MAP) {
+    xfer += prot->serializedSizeMapBegin(type.key->type, type.value->type,
+                                         size);
+  } else if (type.type == protocol::T_SET) {
+    xfer += prot->serializedSizeSetBegin(type.key->type, size);
+  } else {
+    xfer += prot->serializedSizeListBegin(type.key->type, size);
+  }
+
+  ElemContext ctx{prot, &type, 0};
+  type.ops->forEach(value, &sizeElem, &ctx);
+  xfer += ctx.xfer;
+
+  if (type.type == protocol::T_MAP) {
+    xfer += prot->serializedSizeMapEnd();
+  } else if (type.type == protocol::T_SET) {
+    xfer += prot->serializedSizeSetEnd();
+  } else {
+    xfer += prot->serializedSizeListEnd();
+  }
+  return xfer;
+}
+
+template <class Protocol_>
+void TableWriter<Protocol_>::sizeElem(void* ctx, const void* elem,
+                                      const void* value) {
+  auto c = static_cast<ElemContext*>(ctx);
+  c->xfer += sizeValue(c->prot, *c->type->key, elem);
+  if (value) {
+    c->xfer += sizeValue(c->prot, *c->type->value, value);
+  }
+}
+
+}} // apache::thrift
+
+#endif // #ifndef CPP2_PROTOCOL_TABLESERIALIZER_TCC_
@@ -0,0 +1,219 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef CPP2_PROTOCOL_TRANSCODER_H_
+#define CPP2_PROTOCOL_TRANSCODER_H_ 1
+
+#include <thrift/lib/cpp2/protocol/Protocol.h>
+
+#include <folly/Range.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/IOBufQueue.h>
+
+#include <memory>
+#include <string>
+
+namespace apache { namespace thrift {
+
+/**
+ * Converts serialized data from one protocol to another without
+ * deserializing it into generated types: each value read from Reader is
+ * written straight to Writer, the way skip() walks a value it does not
+ * know.  Field names are not in the binary encodings, so they are written
+ * empty.  Strings of kMinChainSize bytes or more are passed on as IOBufs,
+ * which the binary and compact writers chain into their output instead of
+ * copying them.
+ *
+ * For example, BinaryProtocol to CompactProtocol:
+ *
+ *   auto out = Transcoder<BinaryProtocolReader, CompactProtocolWriter>
+ *     ::transcodeStruct(buf.get());
+ */
+template <class Reader, class Writer>
+class Transcoder {
+ public:
+  static const size_t kMinChainSize = 4096;
+
+  // A struct, the encoding of Serializer and of struct fields
+  static std::unique_ptr<folly::IOBuf> transcodeStruct(
+      const folly::IOBuf* buf) {
+    Reader reader;
+    reader.setInput(buf);
+    folly::IOBufQueue queue;
+    Writer writer;
+    writer.setOutput(&queue, buf->computeChainDataLength());
+    transcode(reader, writer, protocol::T_STRUCT);
+    return queue.move();
+  }
+
+  // A request or a response: the message header and its struct
+  static std::unique_ptr<folly::IOBuf> transcodeMessage(
+      const folly::IOBuf* buf) {
+    Reader reader;
+    reader.setInput(buf);
+    folly::IOBufQueue queue;
+    Writer writer;
+    writer.setOutput(&queue, buf->computeChainDataLength());
+
+    std::string name;
+    MessageType messageType;
+    int32_t seqid;
+    reader.readMessageBegin(name, messageType, seqid);
+    writer.writeMessageBegin(name, messageType, seqid);
+    transcode(reader, writer, protocol::T_STRUCT);
+    reader.readMessageEnd();
+    writer.writeMessageEnd();
+    return queue.move();
+  }
+
+  /**
+   * Copies one value of type from reader to writer.  Returns the number of
+   * bytes written.
+   */
+  static uint32_t transcode(Reader& reader, Writer& writer, TType type) {
+    switch (type) {
+      case TType::T_BOOL:
+      {
+        bool value;
+        reader.readBool(value);
+        return writer.writeBool(value);
+      }
+      case TType::T_BYTE:
+      {
+        int8_t value;
+        reader.readByte(value);
+        return writer.writeByte(value);
+      }
+      case TType::T_I16:
+      {
+        int16_t value;
+        reader.readI16(value);
+        return writer.writeI16(value);
+      }
+      case TType::T_I32:
+      {
+        int32_t value;
+        reader.readI32(value);
+        return writer.writeI32(value);
+      }
+      case TType::T_I64:
+      {
+        int64_t value;
+        reader.readI64(value);
+        return writer.writeI64(value);
+      }
+      case TType::T_DOUBLE:
+      {
+        double value;
+        reader.readDouble(value);
+        return writer.writeDouble(value);
+      }
+      case TType::T_FLOAT:
+      {
+        float value;
+        reader.readFloat(value);
+        return writer.writeFloat(value);
+      }
+      case TType::T_STRING:
+      {
+        std::unique_ptr<folly::IOBuf> value;
+        reader.readBinary(value);
+        if (value && !value->isChained() &&
+            value->length() < kMinChainSize) {
+          return writer.writeBinary(folly::StringPiece(
+            reinterpret_cast<const char*>(value->data()), value->length()));
+        }
+        return writer.writeBinary(value);
+      }
+      case TType::T_STRUCT:
+      {
+        uint32_t xfer = 0;
+        std::string name;
+        TType ftype;
+        int16_t fid;
+        reader.readStructBegin(name);
+        xfer += writer.writeStructBegin("");
+        while (true) {
+          reader.readFieldBegin(name, ftype, fid);
+          if (ftype == TType::T_STOP) {
+            break;
+          }
+          xfer += writer.writeFieldBegin("", ftype, fid);
+          xfer += transcode(reader, writer, ftype);
+          reader.readFieldEnd();
+          xfer += writer.writeFieldEnd();
+        }
+        xfer += writer.writeFieldStop();
+        reader.readStructEnd();
+        xfer += writer.writeStructEnd();
+        return xfer;
+      }
+      case TType::T_MAP:
+      {
+        uint32_t xfer = 0;
+        TType keyType;
+        TType valType;
+        uint32_t size;
+        reader.readMapBegin(keyType, valType, size);
+        xfer += writer.writeMapBegin(keyType, valType, size);
+        for (uint32_t i = 0; i < size; ++i) {
+          xfer += transcode(reader, writer, keyType);
+          xfer += transcode(reader, writer, valType);
+        }
+        reader.readMapEnd();
+        xfer += writer.writeMapEnd();
+        return xfer;
+      }
+      case TType::T_SET:
+      {
+        uint32_t xfer = 0;
+        TType elemType;
+        uint32_t size;
+        reader.readSetBegin(elemType, size);
+        xfer += writer.writeSetBegin(elemType, size);
+        for (uint32_t i = 0; i < size; ++i) {
+          xfer += transcode(reader, writer, elemType);
+        }
+        reader.readSetEnd();
+        xfer += writer.writeSetEnd();
+        return xfer;
+      }
+      case TType::T_LIST:
+      {
+        uint32_t xfer = 0;
+        TType elemType;
+        uint32_t size;
+        reader.readListBegin(elemType, size);
+        xfer += writer.writeListBegin(elemType, size);
+        for (uint32_t i = 0; i < size; ++i) {
+          xfer += transcode(reader, writer, elemType);
+        }
+        reader.readListEnd();
+        xfer += writer.writeListEnd();
+        return xfer;
+      }
+      default:
+        throw TProtocolException(TProtocolException::INVALID_DATA);
+    }
+  }
+};
+
+}} // apache::thrift
+
+#endif // #ifndef CPP2_PROTOCOL_TRANSCODER_H_
@@ -24,6 +24,7 @@
 #include <thrift/lib/cpp2/async/SaslServer.h>
 #include <thrift/lib/cpp2/async/HeaderClientChannel.h>
 
+#include <chrono>
 #include <memory>
 
 namespace apache { namespace thrift {
@@ -117,7 +118,8 @@ class Cpp2ConnContext : public apache::thrift::server::TConnectionContext {
 class Cpp2RequestContext : public apache::thrift::server::TConnectionContext {
  public:
   explicit Cpp2RequestContext(Cpp2ConnContext* ctx)
-      : ctx_(ctx) {
+      : ctx_(ctx)
+      , dictionary_(nullptr) {
     setConnectionContext(ctx);
   }
 
@@ -129,6 +131,13 @@ class Cpp2RequestContext : public apache::thrift::server::TConnectionContext {
         headers_ = header->getHeaders();
         transforms_ = header->getWriteTransforms();
         minCompressBytes_ = header->getMinCompressBytes();
+        dictionary_ = header->getWriteDictionary();
+        // Only header clients can untransform a reply
+        auto clientType = header->getClientType();
+        if (clientType == THRIFT_HEADER_CLIENT_TYPE ||
+            clientType == THRIFT_HEADER_SASL_CLIENT_TYPE) {
+          adaptiveCompression_ = header->getAdaptiveCompression();
+        }
       }
     }
   }
@@ -190,6 +199,28 @@ class Cpp2RequestContext : public apache::thrift::server::TConnectionContext {
 
   }
 
+  // Compression dictionary shared with the client, if any
+  virtual const apache::thrift::transport::TCompressionDictionary*
+  getWriteDictionary() {
+    return dictionary_;
+  }
+
+  // Null unless the server picks reply compression adaptively
+  virtual apache::thrift::transport::TAdaptiveCompression*
+  getAdaptiveCompression() {
+    return adaptiveCompression_.get();
+  }
+
+  // When the client stops waiting for the reply; the epoch if the client
+  // did not send a timeout
+  void setDeadline(std::chrono::steady_clock::time_point deadline) {
+    deadline_ = deadline;
+  }
+
+  std::chrono::steady_clock::time_point getDeadline() const {
+    return deadline_;
+  }
+
   virtual const apache::thrift::SaslServer* getSaslServer() const {
     return ctx_->getSaslServer();
   }
@@ -218,6 +249,10 @@ class Cpp2RequestContext : public apache::thrift::server::TConnectionContext {
   std::map<std::string, std::string> writeHeaders_;
   std::vector<uint16_t> transforms_;
   uint32_t minCompressBytes_;
+  const apache::thrift::transport::TCompressionDictionary* dictionary_;
+  std::shared_ptr<apache::thrift::transport::TAdaptiveCompression>
+    adaptiveCompression_;
+  std::chrono::steady_clock::time_point deadline_;
 };
 
 } }
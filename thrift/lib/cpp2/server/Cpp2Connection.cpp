@@ -20,6 +20,7 @@
 #include <thrift/lib/cpp/async/TAsyncSocket.h>
 #include <thrift/lib/cpp2/server/ThriftServer.h>
 #include <thrift/lib/cpp2/server/Cpp2Worker.h>
+#include <thrift/lib/cpp2/async/RequestDeadline.h>
 #include <thrift/lib/cpp2/security/SecurityKillSwitch.h>
 #include <thrift/lib/cpp2/protocol/BinaryProtocol.h>
 #include <thrift/lib/cpp/concurrency/NumaThreadManager.h>
@@ -60,11 +61,27 @@ Cpp2Connection::Cpp2Connection(
                channel_->getSaslServer(),
                worker->getServer()->getEventBaseManager(),
                duplexChannel_ ? duplexChannel_->getClientChannel() : nullptr)
-    , socket_(asyncSocket) {
+    , socket_(asyncSocket)
+    , dispatchedRequests_(0)
+    , deficit_(0)
+    , ready_(false) {
 
   channel_->setQueueSends(worker->getServer()->getQueueSends());
+  channel_->setMaxSendBytes(worker->getServer()->getMaxSendBytes());
+  channel_->setMaxSendDelay(worker->getServer()->getMaxSendDelay());
+  auto zeroCopyThreshold = worker->getServer()->getZeroCopyThreshold();
+  if (zeroCopyThreshold > 0 && channel_->setZeroCopy(true)) {
+    channel_->setZeroCopyThreshold(zeroCopyThreshold);
+  }
   channel_->getHeader()->setMinCompressBytes(
     worker_->getServer()->getMinCompressBytes());
+  channel_->getHeader()->setAdaptiveCompression(
+    worker_->getServer()->getAdaptiveCompression());
+  channel_->getHeader()->setDictionaryId(
+    worker_->getServer()->getCompressionDictionaryId());
+  if (worker->getServer()->getRequestTraceSize() > 0) {
+    channel_->setTraceRequests(true);
+  }
   auto observer = worker->getServer()->getObserver();
   if (observer) {
     channel_->setSampleRate(observer->getSampleRate());
@@ -125,6 +142,12 @@ void Cpp2Connection::stop() {
     }
   }
 
+  // Already cancelled above; they hold references to us, so drop them
+  // outside of pendingRequests_.
+  auto pending = std::move(pendingRequests_);
+  pendingRequests_.clear();
+  pending.clear();
+
   if (channel_) {
     channel_->setCallback(nullptr);
   }
@@ -295,6 +318,14 @@ void Cpp2Connection::requestReceived(
     return;
   }
 
+  auto maxQueued = server->getMaxQueuedRequestsPerConnection();
+  if (maxQueued > 0 && pendingRequests_.size() >= maxQueued) {
+    killRequest(*req,
+        TApplicationException::TApplicationExceptionType::LOADSHEDDING,
+        "loadshedding request, too many queued on connection");
+    return;
+  }
+
   int activeRequests = worker_->activeRequests_;
   activeRequests += worker_->pendingCount();
 
@@ -340,6 +371,14 @@ void Cpp2Connection::requestReceived(
   }
   auto reqContext = t2r->getContext();
 
+  // The client timeout is the budget it had left when it sent the request.
+  // Nobody waits for the reply past it, whatever getUseClientTimeout() says
+  // about the server's own timer.
+  auto clientTimeout = channel_->getHeader()->getClientTimeout();
+  if (clientTimeout > std::chrono::milliseconds(0)) {
+    t2r->setDeadline(std::chrono::steady_clock::now() + clientTimeout);
+  }
+
   auto headers = reqContext->getHeaders();
   auto load_header = headers.find(Cpp2Connection::loadHeader);
   if (load_header != headers.end()) {
@@ -350,14 +389,60 @@ void Cpp2Connection::requestReceived(
 
   }
 
+  // The client asks whether it may write its requests with the skip index
+  if (headers.find(THeader::SKIP_INDEX_HEADER) != headers.end()) {
+    reqContext->setHeader(THeader::SKIP_INDEX_HEADER, "1");
+  }
+
+  auto protType = static_cast<apache::thrift::protocol::PROTOCOL_TYPES>(
+    channel_->getHeader()->getProtocolId());
+  if (pendingRequests_.empty() && canDispatch() && worker_->canDispatch()) {
+    dispatchRequest(std::move(t2r), std::move(buf), protType);
+    return;
+  }
+
+  // Wait for the worker to give us a slot
+  size_t cost = buf->computeChainDataLength();
+  pendingRequests_.push_back(
+    PendingRequest{std::move(t2r), std::move(buf), protType, cost});
+  worker_->scheduleDispatch(shared_from_this());
+}
+
+bool Cpp2Connection::canDispatch() const {
+  auto maxRequests =
+    worker_->getServer()->getMaxActiveRequestsPerConnection();
+  return maxRequests == 0 || dispatchedRequests_ < maxRequests;
+}
+
+void Cpp2Connection::dispatchRequest(
+    unique_ptr<Cpp2Request> req,
+    unique_ptr<folly::IOBuf> buf,
+    apache::thrift::protocol::PROTOCOL_TYPES protType) {
+  auto reqContext = req->getContext();
+  auto deadline = reqContext->getDeadline();
+  if (deadline != std::chrono::steady_clock::time_point() &&
+      std::chrono::steady_clock::now() >= deadline) {
+    // Don't bother deserializing it, nobody is waiting for the reply
+    req->timeoutExpired();
+    return;
+  }
+  req->dispatched_ = true;
+  ++dispatchedRequests_;
+  ++worker_->dispatchedRequests_;
+
+  // Requests may be dispatched after others were received, so switch to
+  // this one's context for the thread manager to pick up.
+  auto oldContext = RequestContext::setContext(req->requestContext_);
+  folly::ScopeGuard guard = folly::makeGuard([&]{
+    RequestContext::setContext(oldContext);
+  });
   try {
-    processor_->process(std::move(t2r),
+    processor_->process(std::move(req),
                         std::move(buf),
-                        static_cast<apache::thrift::protocol::PROTOCOL_TYPES>
-                        (channel_->getHeader()->getProtocolId()),
+                        protType,
                         reqContext,
                         worker_->getEventBase(),
-                        server->getThreadManager().get());
+                        worker_->getServer()->getThreadManager().get());
   } catch (...) {
     LOG(WARNING) << "Process exception: " <<
       folly::exceptionStr(std::current_exception());
@@ -365,6 +450,31 @@ void Cpp2Connection::requestReceived(
   }
 }
 
+void Cpp2Connection::dispatchNext() {
+  auto pending = std::move(pendingRequests_.front());
+  pendingRequests_.pop_front();
+  if (!pending.req->isOneway() && !pending.req->isActive()) {
+    // Expired while it was waiting, the client already has its error
+    return;
+  }
+  try {
+    dispatchRequest(std::move(pending.req),
+                    std::move(pending.buf),
+                    pending.protType);
+  } catch (...) {
+    // Already logged, and the request is gone with the exception
+  }
+}
+
+void Cpp2Connection::requestDispatchFinished() {
+  DCHECK_GT(dispatchedRequests_, 0);
+  --dispatchedRequests_;
+  if (!pendingRequests_.empty()) {
+    worker_->scheduleDispatch(shared_from_this());
+  }
+  worker_->requestDispatchFinished();
+}
+
 void Cpp2Connection::channelClosed(folly::exception_wrapper&& ex) {
   // This must be the last call, it may delete this.
   folly::ScopeGuard guard = folly::makeGuard([&]{
@@ -387,8 +497,21 @@ Cpp2Connection::Cpp2Request::Cpp2Request(
     std::shared_ptr<Cpp2Connection> con)
   : req_(static_cast<HeaderServerChannel::HeaderRequest*>(req.release()))
   , connection_(con)
-  , reqContext_(&con->context_) {
+  , reqContext_(&con->context_)
+  , dispatched_(false) {
+  auto traces = con->getWorker()->requestTraces_;
+  if (req_->trace_ && traces) {
+    // The worker keeps the trace once both the request and the write of
+    // its reply are done with it, in the IO thread either way
+    trace_.reset(new RequestTrace(*req_->trace_),
+                 [traces](RequestTrace* trace) {
+                   traces->push(*trace);
+                   delete trace;
+                 });
+    req_->trace_.reset();
+  }
   RequestContext::create();
+  requestContext_ = RequestContext::saveContext();
 
   NumaThreadFactory::setNumaNode();
 }
@@ -410,6 +533,11 @@ Cpp2Connection::Cpp2Request::prepareSendCallback(
       observer,
       sendCallback);
   }
+  if (trace_) {
+    // Cpp2Trace will delete itself too.  The handler may still be marking
+    // the trace if this is a timeout, so it stays ours.
+    cb = new Cpp2Trace(trace_, cb);
+  }
   return cb;
 }
 
@@ -419,6 +547,10 @@ void Cpp2Connection::Cpp2Request::sendReply(
     MessageChannel::SendCallback* sendCallback) {
   if (req_->isActive()) {
     auto observer = connection_->getWorker()->getServer()->getObserver().get();
+    if (reqContext_.getAdaptiveCompression()) {
+      // The compression transform was picked for this reply
+      req_->setTransforms(reqContext_.getTransforms());
+    }
     req_->sendReply(
       std::move(buf),
       prepareSendCallback(sendCallback, observer),
@@ -459,7 +591,18 @@ void Cpp2Connection::Cpp2Request::timeoutExpired() noexcept {
   connection_->requestTimeoutExpired();
 }
 
+void Cpp2Connection::Cpp2Request::setDeadline(
+    std::chrono::steady_clock::time_point deadline) {
+  reqContext_.setDeadline(deadline);
+  auto oldContext = RequestContext::setContext(requestContext_);
+  RequestDeadline::set(deadline);
+  RequestContext::setContext(oldContext);
+}
+
 Cpp2Connection::Cpp2Request::~Cpp2Request() {
+  if (dispatched_) {
+    connection_->requestDispatchFinished();
+  }
   connection_->removeRequest(this);
   cancelTimeout();
   connection_->getWorker()->activeRequests_--;
@@ -515,4 +658,33 @@ Cpp2Connection::Cpp2Sample::~Cpp2Sample() {
   }
 }
 
+Cpp2Connection::Cpp2Trace::Cpp2Trace(
+    std::shared_ptr<RequestTrace> trace,
+    MessageChannel::SendCallback* chainedCallback)
+  : trace_(std::move(trace))
+  , chainedCallback_(chainedCallback) {
+}
+
+void Cpp2Connection::Cpp2Trace::sendQueued() {
+  if (chainedCallback_ != nullptr) {
+    chainedCallback_->sendQueued();
+  }
+}
+
+void Cpp2Connection::Cpp2Trace::messageSent() {
+  trace_->mark(RequestTrace::WRITE_END);
+  if (chainedCallback_ != nullptr) {
+    chainedCallback_->messageSent();
+  }
+  delete this;
+}
+
+void Cpp2Connection::Cpp2Trace::messageSendError(
+    folly::exception_wrapper&& e) {
+  if (chainedCallback_ != nullptr) {
+    chainedCallback_->messageSendError(std::move(e));
+  }
+  delete this;
+}
+
 }} // apache::thrift
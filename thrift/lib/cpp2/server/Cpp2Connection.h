@@ -21,6 +21,7 @@
 #define THRIFT_ASYNC_CPP2CONNECTION_H_ 1
 
 #include <thrift/lib/cpp/async/HHWheelTimer.h>
+#include <thrift/lib/cpp/async/Request.h>
 #include <thrift/lib/cpp/async/TEventConnection.h>
 #include <thrift/lib/cpp/concurrency/Util.h>
 #include <thrift/lib/cpp/transport/TSocketAddress.h>
@@ -31,6 +32,7 @@
 #include <thrift/lib/cpp2/server/ThriftServer.h>
 #include <thrift/lib/cpp2/server/Cpp2Worker.h>
 #include <thrift/lib/cpp2/async/DuplexChannel.h>
+#include <deque>
 #include <memory>
 #include <unordered_set>
 
@@ -129,6 +131,12 @@ class Cpp2Connection
       return &reqContext_;
     }
 
+    /**
+     * Set when the client stops waiting, both for the server and for the
+     * calls the handler makes, see RequestDeadline.
+     */
+    void setDeadline(std::chrono::steady_clock::time_point deadline);
+
     virtual apache::thrift::server::TServerObserver::CallTimestamps&
     getTimestamps() {
       return req_->getTimestamps();
@@ -142,6 +150,9 @@ class Cpp2Connection
     std::unique_ptr<HeaderServerChannel::HeaderRequest> req_;
     std::shared_ptr<Cpp2Connection> connection_;
     Cpp2RequestContext reqContext_;
+    std::shared_ptr<apache::thrift::async::RequestContext> requestContext_;
+    // Handed to the processor, and so counted against the dispatch limits
+    bool dispatched_;
   };
 
   class Cpp2Sample
@@ -163,8 +174,49 @@ class Cpp2Connection
     MessageChannel::SendCallback* chainedCallback_;
   };
 
+  // Marks when the reply of a traced request is written.  The request
+  // pushes the trace to the worker's ring, or this does if the write ends
+  // after the request is gone.
+  class Cpp2Trace
+      : public MessageChannel::SendCallback {
+   public:
+    Cpp2Trace(
+      std::shared_ptr<RequestTrace> trace,
+      MessageChannel::SendCallback* chainedCallback = nullptr);
+
+    void sendQueued();
+    void messageSent();
+    void messageSendError(folly::exception_wrapper&& e);
+
+   private:
+    std::shared_ptr<RequestTrace> trace_;
+    MessageChannel::SendCallback* chainedCallback_;
+  };
+
   std::unordered_set<Cpp2Request*> activeRequests_;
 
+  // A request waiting for a dispatch slot, see Cpp2Worker::dispatchRequests()
+  struct PendingRequest {
+    std::unique_ptr<Cpp2Request> req;
+    std::unique_ptr<folly::IOBuf> buf;
+    apache::thrift::protocol::PROTOCOL_TYPES protType;
+    size_t cost;
+  };
+
+  std::deque<PendingRequest> pendingRequests_;
+  // Requests of ours the processor has and has not finished yet
+  uint32_t dispatchedRequests_;
+  // Deficit round robin state, owned by the worker
+  size_t deficit_;
+  bool ready_;
+
+  bool canDispatch() const;
+  void dispatchRequest(std::unique_ptr<Cpp2Request> req,
+                       std::unique_ptr<folly::IOBuf> buf,
+                       apache::thrift::protocol::PROTOCOL_TYPES protType);
+  void dispatchNext();
+  void requestDispatchFinished();
+
   void removeRequest(Cpp2Request* req);
   void killRequest(ResponseChannel::Request& req,
                    TApplicationException::TApplicationExceptionType reason,
@@ -177,6 +229,7 @@ class Cpp2Connection
     recv_headers);
 
   friend class Cpp2Request;
+  friend class Cpp2Worker;
 
   std::weak_ptr<Cpp2Connection> weakptr_;
 };
@@ -47,6 +47,8 @@ using namespace apache::thrift::async;
 using std::shared_ptr;
 using apache::thrift::concurrency::Util;
 
+const size_t Cpp2Worker::kDispatchQuantum;
+
 /**
  * Creates a new connection either by reusing an object off the stack or
  * by allocating a new one entirely
@@ -79,6 +81,46 @@ void Cpp2Worker::scheduleIdleConnectionTimeout(Cpp2Connection* con) {
   }
 }
 
+void Cpp2Worker::bindListenSocket(
+    const std::vector<TSocketAddress>& addresses) {
+  DCHECK(!listenSocket_);
+  TAsyncServerSocket::UniquePtr socket(new TAsyncServerSocket);
+  socket->setShutdownSocketSet(server_->shutdownSocketSet_.get());
+  socket->setReusePortEnabled(true);
+  socket->bind(addresses);
+  socket->listen(server_->getListenBacklog());
+  socket->setMaxNumMessagesInQueue(server_->getMaxNumMessagesInQueue());
+  socket->setAcceptRateAdjustSpeed(server_->getAcceptRateAdjustSpeed());
+  listenSocket_ = std::move(socket);
+}
+
+void Cpp2Worker::startAccepting() {
+  DCHECK(listenSocket_);
+  DCHECK(eventBase_->isInEventBaseThread());
+  listenSocket_->attachEventBase(eventBase_.get());
+  // The listen socket calls connectionAccepted() straight from its accept
+  // loop on our TEventBase, without a notification queue.
+  listenSocket_->addInlineAcceptCallback(this);
+  listenSocket_->startAccepting();
+}
+
+void Cpp2Worker::stopAccepting() {
+  if (!listenSocket_ || !listenSocket_->getEventBase()) {
+    return;
+  }
+  DCHECK(eventBase_->isInEventBaseThread());
+  // Closing the socket removes our accept callback and calls
+  // acceptStopped(), same as when the server's listen socket goes away.
+  // The socket object stays until we are destroyed, so that other threads
+  // can still call getNumDroppedConnections().
+  listenSocket_->stopAccepting();
+  listenSocket_->detachEventBase();
+}
+
+uint64_t Cpp2Worker::getNumDroppedConnections() const {
+  return listenSocket_ ? listenSocket_->getNumDroppedConnections() : 0;
+}
+
 void Cpp2Worker::connectionAccepted(int fd, const TSocketAddress& clientAddr)
   noexcept {
   TAsyncSocket *asyncSock = nullptr;
@@ -101,6 +143,10 @@ void Cpp2Worker::connectionAccepted(int fd, const TSocketAddress& clientAddr)
                                   eventBase_.get(),
                                   fd,
                                   true);
+    auto handshakeThreadManager = server_->getSSLHandshakeThreadManager();
+    if (handshakeThreadManager) {
+      sslSock->setHandshakeThreadManager(handshakeThreadManager);
+    }
     asyncSock = sslSock;
   } else {
     asyncSock = new TAsyncSocket(eventBase_.get(), fd);
@@ -123,6 +169,14 @@ void Cpp2Worker::connectionAccepted(int fd, const TSocketAddress& clientAddr)
 void Cpp2Worker::handshakeSuccess(TAsyncSSLSocket *sock)
   noexcept {
   VLOG(4) << "Handshake succeeded";
+  auto observer = server_->getObserver();
+  if (observer) {
+    if (sock->getSSLSessionReused()) {
+      observer->sslSessionCacheHit();
+    } else {
+      observer->sslSessionCacheMiss();
+    }
+  }
   finishConnectionAccepted(sock);
 }
 
@@ -185,7 +239,8 @@ void Cpp2Worker::acceptError(const std::exception& ex) noexcept {
 
 void Cpp2Worker::acceptStopped() noexcept {
   if (server_->getStopWorkersOnStopListening()) {
-    stopEventBase();
+    // Behind the handshakes the SSL handshake pool has handed back
+    eventBase_->runInEventBaseThread([this] { stopEventBase(); });
   }
 }
 
@@ -224,14 +279,77 @@ void Cpp2Worker::serve() {
 void Cpp2Worker::closeConnection(
   std::shared_ptr<Cpp2Connection> connection) {
   activeConnections_.erase(connection);
+  if (connection->ready_) {
+    connection->ready_ = false;
+    readyConnections_.remove(connection);
+  }
   connection->stop();
 }
 
 void Cpp2Worker::closeConnections() {
   for (auto& connection : activeConnections_) {
+    connection->ready_ = false;
     connection->stop();
   }
   activeConnections_.clear();
+  readyConnections_.clear();
+}
+
+bool Cpp2Worker::canDispatch() const {
+  auto maxRequests = server_->getMaxDispatchedRequestsPerWorker();
+  return maxRequests == 0 || dispatchedRequests_ < maxRequests;
+}
+
+void Cpp2Worker::scheduleDispatch(shared_ptr<Cpp2Connection> connection) {
+  if (!connection->ready_) {
+    connection->ready_ = true;
+    readyConnections_.push_back(std::move(connection));
+  }
+  if (!isLoopCallbackScheduled()) {
+    eventBase_->runInLoop(this);
+  }
+}
+
+void Cpp2Worker::requestDispatchFinished() {
+  DCHECK_GT(dispatchedRequests_, 0);
+  --dispatchedRequests_;
+  if (!readyConnections_.empty() && !isLoopCallbackScheduled()) {
+    eventBase_->runInLoop(this);
+  }
+}
+
+void Cpp2Worker::runLoopCallback() noexcept {
+  dispatchRequests();
+}
+
+void Cpp2Worker::dispatchRequests() {
+  while (!readyConnections_.empty() && canDispatch()) {
+    auto next = std::move(readyConnections_.front());
+    readyConnections_.pop_front();
+    next->deficit_ += kDispatchQuantum;
+    auto& pending = next->pendingRequests_;
+    while (!pending.empty() &&
+           pending.front().cost <= next->deficit_ &&
+           next->canDispatch() && canDispatch()) {
+      next->deficit_ -= pending.front().cost;
+      next->dispatchNext();
+    }
+
+    if (pending.empty() || !next->canDispatch()) {
+      // Idle, or blocked until one of its own requests finishes; either
+      // way it should not bank credit while it cannot use it.
+      next->ready_ = false;
+      next->deficit_ = 0;
+    } else {
+      if (!canDispatch()) {
+        // Out of slots: the turn ends here all the same, so that the
+        // connections behind this one go first once slots free up.  Credit
+        // left over from a turn cut short is capped at one quantum.
+        next->deficit_ = std::min<size_t>(next->deficit_, kDispatchQuantum);
+      }
+      readyConnections_.push_back(std::move(next));
+    }
+  }
 }
 
 Cpp2Worker::~Cpp2Worker() {
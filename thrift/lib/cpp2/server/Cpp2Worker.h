@@ -24,6 +24,7 @@
 #include <thrift/lib/cpp/async/TEventBase.h>
 #include <thrift/lib/cpp/async/TEventHandler.h>
 #include <thrift/lib/cpp/server/TServer.h>
+#include <list>
 #include <unordered_set>
 
 namespace apache { namespace thrift {
@@ -38,13 +39,25 @@ class ThriftServer;
  * The ThriftServer itself accepts incoming connections, then hands off each
  * connection to a Cpp2Worker running in another thread.  There should
  * typically be around one Cpp2Worker thread per core.
+ *
+ * When the server runs with setReusePort(true), each Cpp2Worker instead owns
+ * a SO_REUSEPORT listen socket driven by its own TEventBase, and accepts its
+ * connections without going through the server's accept thread.
  */
 class Cpp2Worker :
       public apache::thrift::server::TServer,
       public apache::thrift::async::TAsyncServerSocket::AcceptCallback,
-      public apache::thrift::async::TAsyncSSLSocket::HandshakeCallback {
+      public apache::thrift::async::TAsyncSSLSocket::HandshakeCallback,
+      protected apache::thrift::async::TEventBase::LoopCallback {
  public:
 
+  /**
+   * Bytes of request a connection may dispatch per round when the worker
+   * shares its dispatch slots out, see
+   * ThriftServer::setMaxDispatchedRequestsPerWorker().
+   */
+  static const size_t kDispatchQuantum = 16384;
+
   /**
    * Cpp2Worker is the actual server object for existing connections.
    * One or more of these should be created by ThriftServer (one per
@@ -70,8 +83,13 @@ class Cpp2Worker :
     eventBase_(),
     workerID_(workerID),
     activeRequests_(0),
+    dispatchedRequests_(0),
     pendingCount_(0),
     pendingTime_(std::chrono::steady_clock::now()) {
+    if (server_->getRequestTraceSize() > 0) {
+      requestTraces_ = std::make_shared<RequestTraceRing>(
+        server_->getRequestTraceSize());
+    }
     auto observer =
       std::dynamic_pointer_cast<apache::thrift::async::EventBaseObserver>(
       server_->getObserver());
@@ -132,6 +150,35 @@ class Cpp2Worker :
     return workerID_;
   }
 
+  /**
+   * Bind this worker's own SO_REUSEPORT listen socket to the given
+   * addresses and start listening on it.  Only used in reuse-port mode.
+   *
+   * Called from the server thread before the worker thread is started;
+   * throws TTransportException on error.
+   */
+  void bindListenSocket(
+    const std::vector<apache::thrift::transport::TSocketAddress>& addresses);
+
+  /**
+   * Start accepting on the socket set up by bindListenSocket().
+   * Must be called in the worker's TEventBase thread.
+   */
+  void startAccepting();
+
+  /**
+   * Close the socket set up by bindListenSocket().  acceptStopped() will be
+   * invoked as for the server's shared listen socket.
+   * Must be called in the worker's TEventBase thread.
+   */
+  void stopAccepting();
+
+  /**
+   * Number of connections dropped by this worker's own listen socket.
+   * Thread-safe.
+   */
+  uint64_t getNumDroppedConnections() const;
+
   void connectionAccepted(
     int fd,
     const apache::thrift::transport::TSocketAddress& clientAddr) noexcept;
@@ -163,6 +210,34 @@ class Cpp2Worker :
    */
   int getPendingCount() const;
 
+  /**
+   * The last requests this worker finished, oldest first, see
+   * ThriftServer::setRequestTraceSize().  Thread-safe.
+   */
+  std::vector<RequestTrace> getRequestTraces() const {
+    if (!requestTraces_) {
+      return std::vector<RequestTrace>();
+    }
+    return requestTraces_->snapshot();
+  }
+
+  /**
+   * Whether this worker may hand another request to the thread manager.
+   */
+  bool canDispatch() const;
+
+  /**
+   * Queue a connection with requests waiting for a dispatch slot for the
+   * next round of dispatchRequests().
+   */
+  void scheduleDispatch(std::shared_ptr<Cpp2Connection> connection);
+
+  /**
+   * Called when a dispatched request is done, to give its slot to the next
+   * waiting request.
+   */
+  void requestDispatchFinished();
+
 
  protected:
     apache::thrift::async::HHWheelTimer::UniquePtr timer_;
@@ -177,6 +252,9 @@ class Cpp2Worker :
   /// Our ID in [0:nWorkers).
   uint32_t workerID_;
 
+  /// Our own listen socket, in reuse-port mode only.
+  apache::thrift::async::TAsyncServerSocket::UniquePtr listenSocket_;
+
   /**
    * Called when the connection is fully accepted (after SSL accept if needed)
    */
@@ -204,6 +282,18 @@ class Cpp2Worker :
   void useExistingChannel(
       const std::shared_ptr<HeaderServerChannel>& serverChannel);
 
+  /**
+   * Deficit round robin over readyConnections_: each connection in turn
+   * gets kDispatchQuantum more bytes of credit and dispatches requests
+   * while their size fits in its credit, its in-flight limit allows, and
+   * the worker has free slots.  A turn cut short by the worker running out
+   * of slots still ends, and the connection goes to the back of the round.
+   */
+  void dispatchRequests();
+
+  // TEventBase::LoopCallback, runs dispatchRequests() once per loop
+  void runLoopCallback() noexcept;
+
   /**
    * The list of active connections
    */
@@ -211,9 +301,18 @@ class Cpp2Worker :
 
   uint32_t activeRequests_;
 
+  /// Requests handed to the thread manager and not done yet
+  uint32_t dispatchedRequests_;
+
+  /// Connections with requests waiting for a dispatch slot, in round order
+  std::list<std::shared_ptr<Cpp2Connection>> readyConnections_;
+
   int pendingCount_;
   std::chrono::steady_clock::time_point pendingTime_;
 
+  /// Only pushed to from our thread; null unless requests are traced
+  std::shared_ptr<RequestTraceRing> requestTraces_;
+
   friend class Cpp2Connection;
   friend class ThriftServer;
 };
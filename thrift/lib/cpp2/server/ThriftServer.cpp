@@ -26,6 +26,8 @@
 #include <thrift/lib/cpp/concurrency/PosixThreadFactory.h>
 #include <thrift/lib/cpp/concurrency/ThreadManager.h>
 #include <thrift/lib/cpp/concurrency/NumaThreadManager.h>
+#include <thrift/lib/cpp/transport/TCompressionDictionary.h>
+#include <thrift/lib/cpp/transport/TTransportException.h>
 
 #include <boost/thread/barrier.hpp>
 
@@ -57,6 +59,8 @@ using namespace apache::thrift::async;
 using namespace std;
 using std::shared_ptr;
 using apache::thrift::async::TEventBaseManager;
+using apache::thrift::concurrency::NumaThreadFactory;
+using apache::thrift::concurrency::NumaThreadManager;
 using apache::thrift::concurrency::PosixThreadFactory;
 using apache::thrift::concurrency::ThreadFactory;
 using apache::thrift::concurrency::ThreadManager;
@@ -78,8 +82,11 @@ ThriftServer::ThriftServer() :
   port_(-1),
   saslEnabled_(false),
   nonSaslEnabled_(true),
+  nSSLHandshakeThreads_(0),
   shutdownSocketSet_(
     folly::make_unique<apache::thrift::ShutdownSocketSet>()),
+  reusePort_(false),
+  numaPinning_(false),
   serveEventBase_(nullptr),
   nWorkers_(T_ASYNC_DEFAULT_WORKER_THREADS),
   nPoolThreads_(0),
@@ -93,12 +100,20 @@ ThriftServer::ThriftServer() :
   maxConnections_(0),
   maxRequests_(
     apache::thrift::concurrency::ThreadManager::DEFAULT_MAX_QUEUE_SIZE),
+  maxActiveRequestsPerConnection_(0),
+  maxQueuedRequestsPerConnection_(0),
+  maxDispatchedRequestsPerWorker_(0),
   isUnevenLoad_(true),
   useClientTimeout_(true),
   activeRequests_(0),
   minCompressBytes_(0),
+  compressionDictionaryId_(0),
   isOverloaded_([]() { return false; }),
   queueSends_(true),
+  maxSendBytes_(0),
+  maxSendDelay_(0),
+  zeroCopyThreshold_(0),
+  requestTraceSize_(0),
   enableCodel_(false),
   stopWorkersOnStopListening_(true),
   isDuplex_(false) {
@@ -134,6 +149,9 @@ ThriftServer::~ThriftServer() {
   // If the flag is false, neither i/o nor CPU workers aren't stopped at this
   // point. Stop them now.
   threadManager_->join();
+  if (sslHandshakeThreadManager_) {
+    sslHandshakeThreadManager_->join();
+  }
   stopWorkers();
 }
 
@@ -188,6 +206,15 @@ void ThriftServer::setEventBaseManager(TEventBaseManager* ebm) {
   eventBaseManager_ = ebm;
 }
 
+void ThriftServer::setCompressionDictionaryId(uint32_t id) {
+  // Checked here, connections are accepted where nothing can throw
+  if (id != 0 && !TCompressionDictionary::get(id)) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "Unknown compression dictionary");
+  }
+  compressionDictionaryId_ = id;
+}
+
 void ThriftServer::setup() {
   DCHECK_NOTNULL(cpp2Pfac_.get());
   DCHECK_GT(nWorkers_, 0);
@@ -218,6 +245,7 @@ void ThriftServer::setup() {
       if (socket_ == nullptr) {
         socket_.reset(new TAsyncServerSocket());
         socket_->setShutdownSocketSet(shutdownSocketSet_.get());
+        socket_->setReusePortEnabled(reusePort_);
         if (port_ != -1) {
           socket_->bind(port_);
         } else {
@@ -226,9 +254,13 @@ void ThriftServer::setup() {
         }
       }
 
-      socket_->listen(listenBacklog_);
-      socket_->setMaxNumMessagesInQueue(maxNumMsgsInQueue_);
-      socket_->setAcceptRateAdjustSpeed(acceptRateAdjustSpeed_);
+      // In reuse-port mode the workers listen on their own sockets; ours
+      // only holds on to the address.
+      if (!reusePort_) {
+        socket_->listen(listenBacklog_);
+        socket_->setMaxNumMessagesInQueue(maxNumMsgsInQueue_);
+        socket_->setAcceptRateAdjustSpeed(acceptRateAdjustSpeed_);
+      }
     }
 
     // We always need a threadmanager for cpp2.
@@ -274,10 +306,38 @@ void ThriftServer::setup() {
       }
     }
 
+    if (numaPinning_ && NumaThreadFactory::getNumaNodeCount() == 1) {
+      LOG(WARNING) << "NUMA pinning requested, but NUMA is not available "
+                   << "or --thrift_numa_enabled is not set";
+    }
+    if (numaPinning_ && threadManager_ &&
+        !dynamic_cast<NumaThreadManager*>(threadManager_.get())) {
+      LOG(WARNING) << "NUMA pinning needs a NumaThreadManager to run "
+                   << "requests on the node of their worker";
+    }
+
+    if (sslContext_ && nSSLHandshakeThreads_ > 0 &&
+        !sslHandshakeThreadManager_) {
+      sslHandshakeThreadManager_ = ThreadManager::newSimpleThreadManager(
+        nSSLHandshakeThreads_, /* count */
+        0, /* pendingTaskCountMax -- no limit */
+        false, /* enableTaskStats */
+        0 /* maxQueueLen -- large default */);
+      sslHandshakeThreadManager_->setNamePrefix("thrift-tls");
+      sslHandshakeThreadManager_->threadFactory(threadFactory_);
+      sslHandshakeThreadManager_->start();
+    }
+
     if (!threadManager_) {
+      size_t poolThreads = nPoolThreads_ > 0 ? nPoolThreads_ : nWorkers_;
+      if (numaPinning_) {
+        // Every node needs a pool to keep its requests on the node
+        poolThreads = std::max<size_t>(poolThreads,
+                                       NumaThreadFactory::getNumaNodeCount());
+      }
       std::shared_ptr<apache::thrift::concurrency::ThreadManager>
         threadManager(new apache::thrift::concurrency::NumaThreadManager(
-                        nPoolThreads_ > 0 ? nPoolThreads_ : nWorkers_,
+                        poolThreads,
                         true /*stats*/,
                         getMaxRequests() /*maxQueueLen*/));
       threadManager->enableCodel(getEnableCodel());
@@ -304,15 +364,6 @@ void ThriftServer::setup() {
       // regular server
       auto b = std::make_shared<boost::barrier>(nWorkers_ + 1);
 
-      // Create the worker threads.
-      workers_.reserve(nWorkers_);
-      for (uint32_t n = 0; n < nWorkers_; ++n) {
-        addWorker();
-        workers_[n].worker->getEventBase()->runInLoop([b](){
-          b->wait();
-        });
-      }
-
       // Update address_ with the address that we are actually bound to.
       // (This is needed if we were supplied a pre-bound socket, or if
       // address_'s port was set to 0, so an ephemeral port was chosen by
@@ -321,6 +372,23 @@ void ThriftServer::setup() {
         socket_->getAddress(&address_);
       }
 
+      // Create the worker threads.
+      workers_.reserve(nWorkers_);
+      for (uint32_t n = 0; n < nWorkers_; ++n) {
+        addWorker();
+        auto worker = workers_[n].worker.get();
+        if (reusePort_ && socket_) {
+          worker->bindListenSocket(socket_->getAddresses());
+        }
+        bool startAccepting = reusePort_ && socket_;
+        worker->getEventBase()->runInLoop([b, worker, startAccepting](){
+          if (startAccepting) {
+            worker->startAccepting();
+          }
+          b->wait();
+        });
+      }
+
       for (auto& worker: workers_) {
         worker.thread->start();
         ++threadsStarted;
@@ -416,7 +484,13 @@ uint64_t ThriftServer::getNumDroppedConnections() const {
   if (!socket_) {
     return 0;
   }
-  return socket_->getNumDroppedConnections();
+  uint64_t droppedConnections = socket_->getNumDroppedConnections();
+  if (reusePort_) {
+    for (const auto& info : workers_) {
+      droppedConnections += info.worker->getNumDroppedConnections();
+    }
+  }
+  return droppedConnections;
 }
 
 void ThriftServer::stop() {
@@ -438,11 +512,29 @@ void ThriftServer::stopListening() {
       // there aren't tasks completing and trying to write to i/o thread
       // workers after we've stopped the i/o workers.
       threadManager_->join();
+
+      // Each handshake hands its socket back to its worker when it is
+      // done, so the workers must still be running.  stop() would drop the
+      // queued ones, and with them their sockets.
+      if (sslHandshakeThreadManager_) {
+        sslHandshakeThreadManager_->join();
+      }
     }
 
     // Close the listening socket. This will also cause the workers to stop.
     socket_.reset();
 
+    // In reuse-port mode each worker closes its own listen socket, which
+    // stops it the same way.
+    if (reusePort_) {
+      for (auto& info : workers_) {
+        auto worker = info.worker.get();
+        worker->getEventBase()->runInEventBaseThread([worker] {
+          worker->stopAccepting();
+        });
+      }
+    }
+
     // Return now and don't wait for worker threads to stop
   }
 }
@@ -454,10 +546,23 @@ void ThriftServer::addWorker() {
   info.worker.reset(new Cpp2Worker(this, workerID));
 
   // Create the thread
-  info.thread = threadFactory_->newThread(info.worker, ThreadFactory::ATTACHED);
+  int node = numaPinning_ ? NumaThreadFactory::getSpreadNode(
+    workerID, NumaThreadFactory::getNumaNodeCount()) : -1;
+  if (node >= 0) {
+    // Pin the worker to a node explicitly instead of relying on the shared
+    // round robin of the default factory, so workers are spread evenly.
+    // Its requests carry the node, and NumaThreadManager runs them there.
+    // The thread still comes from threadFactory_; if that binds threads
+    // itself, this binding runs last and wins.
+    NumaThreadFactory factory(node, threadFactory_);
+    info.thread = factory.newThread(info.worker, ThreadFactory::ATTACHED);
+  } else {
+    info.thread = threadFactory_->newThread(info.worker,
+                                            ThreadFactory::ATTACHED);
+  }
 
   // Add the worker as an accept callback
-  if (socket_) {
+  if (socket_ && !reusePort_) {
     socket_->addAcceptCallback(info.worker.get(), info.worker->getEventBase());
   }
 
@@ -526,6 +631,15 @@ int32_t ThriftServer::getPendingCount() const {
   return pendingCount;
 }
 
+std::vector<RequestTrace> ThriftServer::getRequestTraces() const {
+  std::vector<RequestTrace> traces;
+  for (const auto& worker : workers_) {
+    auto workerTraces = worker.worker->getRequestTraces();
+    traces.insert(traces.end(), workerTraces.begin(), workerTraces.end());
+  }
+  return traces;
+}
+
 bool ThriftServer::isOverloaded(uint32_t workerActiveRequests) {
   if (UNLIKELY(isOverloaded_())) {
     return true;
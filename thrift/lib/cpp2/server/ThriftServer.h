@@ -32,6 +32,7 @@
 #include <thrift/lib/cpp/concurrency/ThreadManager.h>
 #include <thrift/lib/cpp/server/TServer.h>
 #include <thrift/lib/cpp/server/TServerObserver.h>
+#include <thrift/lib/cpp/transport/TAdaptiveCompression.h>
 #include <thrift/lib/cpp/transport/THeader.h>
 #include <thrift/lib/cpp/transport/TSSLSocket.h>
 #include <thrift/lib/cpp/transport/TSocketAddress.h>
@@ -40,6 +41,7 @@
 #include <thrift/lib/cpp2/async/AsyncProcessor.h>
 #include <thrift/lib/cpp2/async/SaslServer.h>
 #include <thrift/lib/cpp2/async/HeaderServerChannel.h>
+#include <thrift/lib/cpp2/async/RequestTrace.h>
 
 namespace apache { namespace thrift {
 
@@ -139,11 +141,22 @@ class ThriftServer : public apache::thrift::server::TServer {
   std::shared_ptr<apache::thrift::concurrency::ThreadManager>
     saslThreadManager_;
 
+  // Runs SSL_accept() off the workers, see setNSSLHandshakeThreads()
+  int nSSLHandshakeThreads_;
+  std::shared_ptr<apache::thrift::concurrency::ThreadManager>
+    sslHandshakeThreadManager_;
+
   std::unique_ptr<apache::thrift::ShutdownSocketSet> shutdownSocketSet_;
 
   //! Listen socket
   apache::thrift::async::TAsyncServerSocket::UniquePtr socket_;
 
+  //! Give each worker its own SO_REUSEPORT listen socket
+  bool reusePort_;
+
+  //! Pin each worker, and the pool threads serving it, to one NUMA node
+  bool numaPinning_;
+
   //! The TEventBase currently driving serve().  NULL when not serving.
   std::atomic<apache::thrift::async::TEventBase*> serveEventBase_;
 
@@ -224,6 +237,11 @@ class ThriftServer : public apache::thrift::server::TServer {
   // Max active requests
   uint32_t maxRequests_;
 
+  // Fair dispatch limits, see setMaxActiveRequestsPerConnection()
+  uint32_t maxActiveRequestsPerConnection_;
+  uint32_t maxQueuedRequestsPerConnection_;
+  uint32_t maxDispatchedRequestsPerWorker_;
+
   // If it is set true, # of global active requests is tracked
   bool isUnevenLoad_;
 
@@ -239,11 +257,29 @@ class ThriftServer : public apache::thrift::server::TServer {
   // request compression.
   uint32_t minCompressBytes_;
 
+  // Picks reply compression per method when set
+  std::shared_ptr<apache::thrift::transport::TAdaptiveCompression>
+    adaptiveCompression_;
+
+  // Dictionary offered to header clients, 0 if none
+  uint32_t compressionDictionaryId_;
+
   std::function<bool(void)> isOverloaded_;
   std::function<int64_t(const std::string&)> getLoad_;
 
   bool queueSends_;
 
+  // Budget for queued sends on each connection, see setMaxSendBytes()
+  // and setMaxSendDelay()
+  uint32_t maxSendBytes_;
+  std::chrono::milliseconds maxSendDelay_;
+
+  // Smallest write sent with MSG_ZEROCOPY, 0 if zero copy is off
+  uint32_t zeroCopyThreshold_;
+
+  // Traces kept by each worker, 0 if requests are not traced
+  size_t requestTraceSize_;
+
   bool enableCodel_;
 
   bool stopWorkersOnStopListening_;
@@ -374,6 +410,54 @@ class ThriftServer : public apache::thrift::server::TServer {
     maxRequests_ = maxRequests;
   }
 
+  /**
+   * Set the maximum # of requests a single connection may have in the
+   * thread manager (queued or running) at once.  Further requests from
+   * that connection wait in its worker until one of them finishes, so a
+   * client pipelining many requests cannot take over the thread pool.
+   * 0 (the default) means no limit.
+   */
+  void setMaxActiveRequestsPerConnection(uint32_t maxRequests) {
+    maxActiveRequestsPerConnection_ = maxRequests;
+  }
+
+  uint32_t getMaxActiveRequestsPerConnection() const {
+    return maxActiveRequestsPerConnection_;
+  }
+
+  /**
+   * Set the maximum # of requests a single connection may have waiting in
+   * its worker for setMaxActiveRequestsPerConnection() or
+   * setMaxDispatchedRequestsPerWorker().  Requests beyond it are
+   * loadshed, before the server-wide overload check, so one flooding
+   * client sheds its own requests rather than everybody's.
+   * 0 (the default) means no limit.
+   */
+  void setMaxQueuedRequestsPerConnection(uint32_t maxRequests) {
+    maxQueuedRequestsPerConnection_ = maxRequests;
+  }
+
+  uint32_t getMaxQueuedRequestsPerConnection() const {
+    return maxQueuedRequestsPerConnection_;
+  }
+
+  /**
+   * Set the maximum # of requests each worker may have in the thread
+   * manager at once.  Requests past it wait on their connections, and as
+   * slots free up the worker hands them out with deficit round robin
+   * over the waiting connections, weighted by request size.  Keeping this
+   * close to the number of pool threads keeps the thread manager's own
+   * FIFO queue short, so the worker decides who runs next.
+   * 0 (the default) means no limit.
+   */
+  void setMaxDispatchedRequestsPerWorker(uint32_t maxRequests) {
+    maxDispatchedRequestsPerWorker_ = maxRequests;
+  }
+
+  uint32_t getMaxDispatchedRequestsPerWorker() const {
+    return maxDispatchedRequestsPerWorker_;
+  }
+
   /**
    * Get if the server expects uneven load among workers.
    *
@@ -392,6 +476,11 @@ class ThriftServer : public apache::thrift::server::TServer {
     isUnevenLoad_ = isUnevenLoad;
   }
 
+  /**
+   * Whether the client's timeout also caps the task expire time of its
+   * requests (see getTaskExpireTimeForRequest()).  Requests are dropped
+   * once their client's deadline passes either way.
+   */
   bool getUseClientTimeout() const {
     return useClientTimeout_;
   }
@@ -441,7 +530,11 @@ class ThriftServer : public apache::thrift::server::TServer {
   }
 
   /**
-   *
+   * Accept TLS connections with context.  All the workers share it, so a
+   * session cache or ticket key manager set on it lets a client resume its
+   * session on any of them.  Each completed handshake is reported to the
+   * observer, as a sslSessionCacheHit() if it resumed a session and a
+   * sslSessionCacheMiss() if it was a full one.
    */
   void setSSLContext(
     std::shared_ptr<apache::thrift::transport::SSLContext> context) {
@@ -454,6 +547,41 @@ class ThriftServer : public apache::thrift::server::TServer {
     return sslContext_;
   }
 
+  /**
+   * Run the TLS handshakes on a pool of this many threads rather than on
+   * the workers, so that a burst of new connections does not hold up the
+   * requests of the existing ones on the same worker.  The handshake
+   * callbacks of the SSLContext then run on the pool too.  0 (the
+   * default) runs them on the workers.
+   *
+   * @param nSSLHandshakeThreads number of handshake threads
+   */
+  void setNSSLHandshakeThreads(int nSSLHandshakeThreads) {
+    assert(workers_.size() == 0);
+    nSSLHandshakeThreads_ = nSSLHandshakeThreads;
+  }
+
+  int getNSSLHandshakeThreads() const {
+    return nSSLHandshakeThreads_;
+  }
+
+  /**
+   * Run the TLS handshakes on threadManager, which the caller starts;
+   * overrides setNSSLHandshakeThreads().  The server joins it when it
+   * stops listening, like the request thread manager.
+   */
+  void setSSLHandshakeThreadManager(
+    std::shared_ptr<apache::thrift::concurrency::ThreadManager>
+      threadManager) {
+    assert(workers_.size() == 0);
+    sslHandshakeThreadManager_ = threadManager;
+  }
+
+  std::shared_ptr<apache::thrift::concurrency::ThreadManager>
+  getSSLHandshakeThreadManager() const {
+    return sslHandshakeThreadManager_;
+  }
+
   /**
    * Use the provided socket rather than binding to address_.  The caller must
    * call ::bind on this socket, but should not call ::listen.
@@ -623,6 +751,46 @@ class ThriftServer : public apache::thrift::server::TServer {
    */
   uint64_t getNumDroppedConnections() const;
 
+  /**
+   * Set whether each worker should accept on its own SO_REUSEPORT listen
+   * socket instead of sharing the server's one.  The kernel then balances
+   * new connections across workers, and each worker accepts inline on its
+   * own TEventBase: accepted fds skip the serve() thread and the accept
+   * notification queue.
+   *
+   * The server's own socket stays bound (to reserve the address) but does
+   * not listen.  If useExistingSocket() is used, that socket must have
+   * SO_REUSEPORT set before it was bound.
+   */
+  void setReusePort(bool reusePort) {
+    assert(workers_.size() == 0);
+    reusePort_ = reusePort;
+  }
+
+  bool getReusePort() const {
+    return reusePort_;
+  }
+
+  /**
+   * Set whether to pin every worker thread to a NUMA node, spreading the
+   * workers evenly over the nodes, and run the requests of a worker on
+   * pool threads of the same node.  Connection and read buffer memory is
+   * then allocated on the node that handles the connection.
+   *
+   * Needs the default NumaThreadManager (the pool is grown to at least one
+   * thread per node), and only takes effect when --thrift_numa_enabled is
+   * set on a NUMA machine.  Worker threads are still created by the
+   * factory of setThreadFactory(), and bound to their node once started.
+   */
+  void setNumaPinning(bool numaPinning) {
+    assert(workers_.size() == 0);
+    numaPinning_ = numaPinning;
+  }
+
+  bool getNumaPinning() const {
+    return numaPinning_;
+  }
+
   /** Get maximum number of milliseconds we'll wait for data (0 = infinity).
    *
    *  @return number of milliseconds, or 0 if no timeout set.
@@ -839,6 +1007,40 @@ class ThriftServer : public apache::thrift::server::TServer {
     minCompressBytes_ = bytes;
   }
 
+  /**
+   * Choose the compression transform of every reply from statistics kept
+   * per method (see TAdaptiveCompression), instead of mirroring the
+   * transforms the client used.  Replies smaller than getMinCompressBytes()
+   * are still never compressed.  Only header clients are affected.
+   * ZSTD_TRANSFORM still uses the dictionary of setCompressionDictionaryId()
+   * with clients that have it.
+   *
+   * Pass nullptr (the default) to disable.  The per-method statistics can
+   * be read back with getAdaptiveCompression()->getStats().
+   */
+  void setAdaptiveCompression(
+      std::shared_ptr<apache::thrift::transport::TAdaptiveCompression>
+      adaptive) {
+    adaptiveCompression_ = std::move(adaptive);
+  }
+
+  std::shared_ptr<apache::thrift::transport::TAdaptiveCompression>
+  getAdaptiveCompression() const {
+    return adaptiveCompression_;
+  }
+
+  /**
+   * Offer this compression dictionary to clients (see
+   * THeader::setDictionaryId()).  It must have been registered with
+   * TCompressionDictionary::add() first, or TTransportException is thrown.
+   * 0 disables.
+   */
+  void setCompressionDictionaryId(uint32_t id);
+
+  uint32_t getCompressionDictionaryId() const {
+    return compressionDictionaryId_;
+  }
+
   /**
    * Call this to complete initialization
    */
@@ -924,6 +1126,68 @@ class ThriftServer : public apache::thrift::server::TServer {
     return queueSends_;
   }
 
+  /**
+   * With queued sends, write out a connection's queued responses as soon
+   * as they add up to this many bytes instead of waiting for the end of
+   * the loop.  0 (the default) means no limit.
+   */
+  void setMaxSendBytes(uint32_t maxSendBytes) {
+    maxSendBytes_ = maxSendBytes;
+  }
+
+  uint32_t getMaxSendBytes() const {
+    return maxSendBytes_;
+  }
+
+  /**
+   * With queued sends, keep coalescing a connection's responses across
+   * event loop iterations for up to this long before writing them out.
+   * 0 (the default) writes once per loop iteration.
+   */
+  void setMaxSendDelay(std::chrono::milliseconds maxSendDelay) {
+    maxSendDelay_ = maxSendDelay;
+  }
+
+  std::chrono::milliseconds getMaxSendDelay() const {
+    return maxSendDelay_;
+  }
+
+  /**
+   * Send responses (or, with queued sends, batches of responses) of at
+   * least this many bytes with MSG_ZEROCOPY instead of copying them into
+   * the kernel.  Pays off for large responses; see
+   * TAsyncSocket::setZeroCopy().  0 (the default) disables zero copy.
+   */
+  void setZeroCopyThreshold(uint32_t zeroCopyThreshold) {
+    zeroCopyThreshold_ = zeroCopyThreshold;
+  }
+
+  uint32_t getZeroCopyThreshold() const {
+    return zeroCopyThreshold_;
+  }
+
+  /**
+   * Trace every request, and keep the last size traces of each worker for
+   * getRequestTraces().  Tracing takes a few clock reads and an allocation
+   * per request.  0 (the default) disables it, which leaves a null check
+   * at each step.
+   */
+  void setRequestTraceSize(size_t size) {
+    assert(workers_.size() == 0);
+    requestTraceSize_ = size;
+  }
+
+  size_t getRequestTraceSize() const {
+    return requestTraceSize_;
+  }
+
+  /**
+   * The last traces of each worker, see setRequestTraceSize(), in the
+   * order each worker finished them.  Thread-safe; empty if requests are
+   * not traced.
+   */
+  std::vector<RequestTrace> getRequestTraces() const;
+
   /**
    * Codel queuing timeout - limit queueing time before overload
    * http://en.wikipedia.org/wiki/CoDel
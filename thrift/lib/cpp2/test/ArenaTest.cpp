@@ -0,0 +1,101 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include <gtest/gtest.h>
+#include <thrift/lib/cpp2/Arena.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+using namespace apache::thrift;
+
+namespace {
+
+int live = 0;
+
+struct Tracked {
+  Tracked() { ++live; }
+  ~Tracked() { --live; }
+};
+
+// Like a struct generated with the arena flag and a cpp.ref field
+struct Owner {
+  ArenaString name;
+  std::vector<ArenaString, ArenaAllocator<ArenaString>> names;
+  std::map<int, Owner, std::less<int>,
+           ArenaAllocator<std::pair<const int, Owner>>> children;
+  std::unique_ptr<Tracked> ref{new Tracked};
+};
+
+}
+
+TEST(ArenaTest, ResetDestroysObjects) {
+  Arena arena;
+  for (int round = 0; round < 3; ++round) {
+    Owner* owner = arena.create<Owner>();
+    {
+      ArenaScope scope(&arena);
+      owner->name = "owner";
+      owner->names.push_back(ArenaString(100, 'x'));
+      owner->children[1].name = "child";
+    }
+    EXPECT_EQ(2, live);
+    EXPECT_EQ(&arena, owner->names.get_allocator().arena());
+    EXPECT_GT(arena.bytesUsed(), 100);
+
+    // Heap memory owned by objects in the arena is released too
+    arena.reset();
+    EXPECT_EQ(0, live);
+    EXPECT_EQ(0, arena.bytesUsed());
+  }
+
+  {
+    Arena other;
+    other.create<Owner>();
+    EXPECT_EQ(1, live);
+  }
+  EXPECT_EQ(0, live);
+}
+
+TEST(ArenaTest, StringCopiesOutliveArena) {
+  const std::string value(100, 'v');
+  Arena arena;
+  ArenaString* original = arena.create<ArenaString>(value.data(),
+                                                     value.size());
+  EXPECT_EQ(&arena, original->get_allocator().arena());
+
+  // Copies made outside of any scope come from the heap
+  ArenaString copy(*original);
+  ArenaString assigned;
+  assigned = *original;
+  EXPECT_EQ(nullptr, copy.get_allocator().arena());
+  EXPECT_NE(original->data(), copy.data());
+  EXPECT_NE(original->data(), assigned.data());
+
+  // Reuse the memory of the original
+  arena.reset();
+  {
+    ArenaScope scope(&arena);
+    ArenaString overwrite(1000, 'o');
+  }
+  EXPECT_EQ(value, std::string(copy.data(), copy.size()));
+  EXPECT_EQ(value, std::string(assigned.data(), assigned.size()));
+}
@@ -22,6 +22,7 @@
 #include <thrift/lib/cpp2/async/HeaderClientChannel.h>
 #include <thrift/lib/cpp2/async/HeaderServerChannel.h>
 #include <thrift/lib/cpp2/async/Cpp2Channel.h>
+#include <thrift/lib/cpp2/async/ReadBufferPool.h>
 #include <folly/io/IOBuf.h>
 #include <folly/io/IOBufQueue.h>
 #include <thrift/lib/cpp/test/SocketPair.h>
@@ -33,6 +34,8 @@
 #include <thrift/lib/cpp2/async/StubSaslClient.h>
 #include <thrift/lib/cpp2/async/StubSaslServer.h>
 
+#include <thread>
+
 using namespace apache::thrift;
 using namespace apache::thrift::async;
 using namespace apache::thrift::test;
@@ -324,6 +327,222 @@ TEST(Channel, Cpp2Channel) {
   MessageTest(1024*1024).run();
 }
 
+class CoalescedSendTest : public SocketPairTest<Cpp2Channel, Cpp2Channel>
+                        , public MessageCallback {
+ public:
+  CoalescedSendTest(size_t count, size_t maxSendBytes)
+      : count_(count)
+      , maxSendBytes_(maxSendBytes) {
+  }
+
+  void preLoop() {
+    channel0_->setMaxSendBytes(maxSendBytes_);
+    for (size_t i = 0; i < count_; ++i) {
+      channel0_->sendMessage(&sendCallback_, makeTestBuf(100));
+    }
+    channel1_->setReceiveCallback(this);
+  }
+
+  void postLoop() {
+    EXPECT_EQ(sendCallback_.sendError_, 0);
+    EXPECT_EQ(recv_, count_);
+    EXPECT_EQ(sendCallback_.sent_, count_);
+    EXPECT_EQ(channel0_->getNumMessagesSent(), count_);
+    // Each frame is 104 bytes on the wire
+    size_t perWrite = count_;
+    if (maxSendBytes_ > 0) {
+      perWrite = (maxSendBytes_ + 103) / 104;
+    }
+    EXPECT_EQ(channel0_->getNumWrites(), (count_ + perWrite - 1) / perWrite);
+  }
+
+  virtual void messageReceived(unique_ptr<IOBuf>&& buf,
+                               unique_ptr<sample> sample) {
+    MessageCallback::messageReceived(std::move(buf), std::move(sample));
+    if (recv_ == count_) {
+      channel1_->setReceiveCallback(nullptr);
+    }
+  }
+
+ private:
+  size_t count_;
+  size_t maxSendBytes_;
+  MessageCallback sendCallback_;
+};
+
+TEST(Channel, CoalescedSendTest) {
+  // All frames sent in one loop iteration go out in a single write
+  CoalescedSendTest(100, 0).run();
+  // Unless the byte budget forces earlier writes
+  CoalescedSendTest(100, 1000).run();
+}
+
+TEST(Channel, ReadBufferPool) {
+  EXPECT_EQ(ReadBufferPool::goodSize(1), 2048);
+  EXPECT_EQ(ReadBufferPool::goodSize(2049), 4096);
+  EXPECT_EQ(ReadBufferPool::goodSize(100 * 1024 * 1024), 100 * 1024 * 1024);
+
+  auto buf = ReadBufferPool::get().allocate(3000);
+  EXPECT_EQ(buf->length(), 0);
+  EXPECT_EQ(buf->tailroom(), 4096);
+  auto allocated = ReadBufferPool::get().getNumAllocated();
+  auto reused = ReadBufferPool::get().getNumReused();
+
+  // Freed buffers are handed out again for the same size class
+  buf.reset();
+  buf = ReadBufferPool::get().allocate(4096);
+  EXPECT_EQ(ReadBufferPool::get().getNumAllocated(), allocated);
+  EXPECT_EQ(ReadBufferPool::get().getNumReused(), reused + 1);
+
+  // Buffers freed on another thread go back to the pool that allocated them
+  std::thread([&] { buf.reset(); }).join();
+  auto returned = ReadBufferPool::get().getNumReturned();
+  buf = ReadBufferPool::get().allocate(4096);
+  EXPECT_EQ(ReadBufferPool::get().getNumAllocated(), allocated);
+  EXPECT_EQ(ReadBufferPool::get().getNumReused(), reused + 2);
+  EXPECT_EQ(ReadBufferPool::get().getNumReturned(), returned + 1);
+
+  // And buffers that outlive the thread of their pool are simply freed
+  std::thread([&] { buf = ReadBufferPool::get().allocate(4096); }).join();
+  buf.reset();
+}
+
+class LargeFrameTest
+    : public SocketPairTest<HeaderClientChannel, HeaderServerChannel>
+    , public TestRequestCallback
+    , public ResponseCallback {
+ public:
+  explicit LargeFrameTest(size_t len)
+      : len_(len) {
+  }
+
+  class Callback : public TestRequestCallback {
+   public:
+    explicit Callback(LargeFrameTest* c)
+    : c_(c) {}
+    void replyReceived(ClientReceiveState&& state) {
+      // The whole frame was read into one buffer
+      EXPECT_FALSE(state.buf()->isChained());
+      TestRequestCallback::replyReceived(std::move(state));
+      c_->channel1_->setCallback(nullptr);
+    }
+   private:
+    LargeFrameTest* c_;
+  };
+
+  void preLoop() {
+    TestRequestCallback::reset();
+    channel1_->setCallback(this);
+    channel0_->sendRequest(
+      std::unique_ptr<RequestCallback>(new Callback(this)),
+      // Fake method name for creating a ContextStatck
+      std::unique_ptr<ContextStack>(new ContextStack("{ChannelTest}")),
+      makeTestBuf(len_));
+  }
+
+  void requestReceived(unique_ptr<ResponseChannel::Request>&& req) {
+    EXPECT_FALSE(req->getBuf()->isChained());
+    ResponseCallback::requestReceived(std::move(req));
+  }
+
+  void postLoop() {
+    EXPECT_EQ(reply_, 1);
+    EXPECT_EQ(replyError_, 0);
+    EXPECT_EQ(replyBytes_, len_);
+    EXPECT_EQ(request_, 1);
+    EXPECT_EQ(requestBytes_, len_);
+  }
+
+ private:
+  size_t len_;
+};
+
+TEST(Channel, LargeFrameTest) {
+  // Past the biggest pooled size class too
+  LargeFrameTest(1024*1024).run();
+  LargeFrameTest(8*1024*1024).run();
+}
+
+class SkipIndexTest
+    : public SocketPairTest<HeaderClientChannel, HeaderServerChannel>
+    , public TestRequestCallback
+    , public ResponseCallback {
+ public:
+  explicit SkipIndexTest(bool advertise)
+      : advertise_(advertise) {
+  }
+
+  class Callback : public TestRequestCallback {
+   public:
+    explicit Callback(SkipIndexTest* c)
+    : c_(c) {}
+    void replyReceived(ClientReceiveState&& state) {
+      TestRequestCallback::replyReceived(std::move(state));
+      if (reply_ == 1) {
+        c_->sendRequest();
+      } else {
+        c_->channel1_->setCallback(nullptr);
+      }
+    }
+   private:
+    SkipIndexTest* c_;
+  };
+
+  void sendRequest() {
+    channel0_->sendRequest(
+      std::unique_ptr<RequestCallback>(new Callback(this)),
+      // Fake method name for creating a ContextStatck
+      std::unique_ptr<ContextStack>(new ContextStack("{ChannelTest}")),
+      makeTestBuf(1024));
+  }
+
+  void preLoop() {
+    TestRequestCallback::reset();
+    channel0_->setSkipIndex(true);
+    channel1_->setCallback(this);
+    sendRequest();
+  }
+
+  void requestReceived(unique_ptr<ResponseChannel::Request>&& req) {
+    request_++;
+    auto header = channel1_->getHeader();
+    // The client always asks, and only uses the index once answered
+    EXPECT_EQ(header->getHeaders().count(THeader::SKIP_INDEX_HEADER), 1);
+    skipIndex_.push_back(header->getSkipIndex());
+    THeader::StringToStringMap headers;
+    if (advertise_) {
+      headers[THeader::SKIP_INDEX_HEADER] = "1";
+    }
+    auto headerReq = static_cast<HeaderServerChannel::HeaderRequest*>(
+      req.get());
+    headerReq->sendReply(req->extractBuf(), nullptr, std::move(headers));
+  }
+
+  void postLoop() {
+    EXPECT_EQ(reply_, 2);
+    EXPECT_EQ(replyError_, 0);
+    EXPECT_EQ(request_, 2);
+    ASSERT_EQ(skipIndex_.size(), 2);
+    // Nothing is known about the server before its first reply
+    EXPECT_FALSE(skipIndex_[0]);
+    EXPECT_EQ(skipIndex_[1], advertise_);
+    EXPECT_EQ(channel0_->getSkipIndex(), advertise_);
+  }
+
+ private:
+  bool advertise_;
+  std::vector<bool> skipIndex_;
+};
+
+TEST(Channel, SkipIndexTest) {
+  SkipIndexTest(true).run();
+}
+
+TEST(Channel, SkipIndexNotAdvertisedTest) {
+  // An older server would fail to read requests written with the index
+  SkipIndexTest(false).run();
+}
+
 class MessageCloseTest : public SocketPairTest<Cpp2Channel, Cpp2Channel>
                        , public MessageCallback {
 public:
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2014 Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Deserializes the same data into structs generated with and without the
+// arena flag, counting the heap allocations each one makes.
+
+#include <thrift/lib/cpp2/Arena.h>
+#include <thrift/lib/cpp2/protocol/Serializer.h>
+
+#include <thrift/lib/cpp2/test/gen-cpp2/CompactProtocolBenchData_types.h>
+#include <thrift/lib/cpp2/test/gen-cpp2/CompactProtocolBenchArenaData_types.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <folly/Benchmark.h>
+#include <folly/Format.h>
+
+using namespace std;
+using namespace folly;
+using namespace apache::thrift;
+
+namespace arena_data = apache::thrift::test::arena;
+
+atomic<size_t> allocations(0);
+
+void* operator new(size_t size) {
+  allocations.fetch_add(1, memory_order_relaxed);
+  if (void* p = malloc(size)) {
+    return p;
+  }
+  throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+// Strings too long for the small string optimization
+unique_ptr<IOBuf> makeDeep() {
+  ::cpp2::Deep data;
+  for (size_t i = 0; i < 16; ++i) {
+    ::cpp2::Deep1 data1;
+    for (size_t j = 0; j < 16; ++j) {
+      ::cpp2::Deep2 data2;
+      for (size_t k = 0; k < 16; ++k) {
+        data2.datas.push_back(sformat("a longer string [{}, {}, {}]",
+                                      i, j, k));
+      }
+      data1.deeps.push_back(move(data2));
+    }
+    data.deeps.push_back(move(data1));
+  }
+  IOBufQueue bufq;
+  CompactSerializer::serialize(data, &bufq);
+  return bufq.move();
+}
+
+const size_t kArenaBlockSize = 1 << 20;
+
+void readHeap(const IOBuf* buf) {
+  ::cpp2::Deep data;
+  CompactSerializer::deserialize(buf, data);
+}
+
+void readArena(const IOBuf* buf, Arena& arena) {
+  CompactSerializer::deserialize<arena_data::Deep>(buf, arena);
+  arena.reset();
+}
+
+BENCHMARK(CompactProtocolReader_deserialize_deep_heap, iters) {
+  BenchmarkSuspender braces;
+  auto buf = makeDeep();
+  braces.dismiss();
+  while (iters--) {
+    readHeap(buf.get());
+  }
+}
+
+BENCHMARK_RELATIVE(CompactProtocolReader_deserialize_deep_arena, iters) {
+  BenchmarkSuspender braces;
+  auto buf = makeDeep();
+  Arena arena(kArenaBlockSize);
+  braces.dismiss();
+  while (iters--) {
+    readArena(buf.get(), arena);
+  }
+}
+
+template <class F>
+size_t countAllocations(F f) {
+  size_t before = allocations.load();
+  f();
+  return allocations.load() - before;
+}
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  auto buf = makeDeep();
+  Arena arena(kArenaBlockSize);
+  // Warm the arena up, so that its block is already there
+  readArena(buf.get(), arena);
+  cout << "allocations per deserialize: heap "
+       << countAllocations([&] { readHeap(buf.get()); })
+       << ", arena "
+       << countAllocations([&] { readArena(buf.get(), arena); })
+       << endl;
+
+  runBenchmarks();
+  return 0;
+}
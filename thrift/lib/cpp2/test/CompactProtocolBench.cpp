@@ -19,6 +19,7 @@
 #include <thrift/lib/cpp2/test/gen-cpp2/CompactProtocolBenchData_types.h>
 
 #include <iostream>
+#include <random>
 #include <vector>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
@@ -197,6 +198,76 @@ BENCHMARK(CompactProtocolWriter_serialize_deep, kiters) {
   braces.rehire();
 }
 
+// Small values (mostly one byte varints) and full range ones
+NumericLists makeNumericLists(size_t field, size_t size, bool small) {
+  NumericLists data;
+  mt19937_64 rng(size);
+  for (size_t i = 0; i < size; ++i) {
+    int64_t value = small ? int64_t(rng() % 128) - 64 : int64_t(rng());
+    switch (field) {
+      case 1: data.i32s.push_back(int32_t(value)); break;
+      case 2: data.i64s.push_back(value); break;
+      case 3: data.doubles.push_back(double(value) / 3); break;
+    }
+  }
+  return data;
+}
+
+void readNumericLists(size_t field, size_t size, bool small, size_t iters) {
+  BenchmarkSuspender braces;
+  CompactSerializer ser;
+  IOBufQueue bufq;
+  ser.serialize(makeNumericLists(field, size, small), &bufq);
+  auto buf = bufq.move();
+  braces.dismiss();
+  while (iters--) {
+    NumericLists data;
+    ser.deserialize(buf.get(), data);
+  }
+  braces.rehire();
+}
+
+void writeNumericLists(size_t field, size_t size, bool small, size_t iters) {
+  BenchmarkSuspender braces;
+  auto data = makeNumericLists(field, size, small);
+  braces.dismiss();
+  while (iters--) {
+    CompactSerializer ser;
+    IOBufQueue bufq;
+    ser.serialize(data, &bufq);
+  }
+  braces.rehire();
+}
+
+#define NUMERIC_LIST_BENCHMARKS(size)                                    \
+  BENCHMARK(CompactProtocolReader_i32_list_small_##size, iters) {        \
+    readNumericLists(1, size, true, iters);                              \
+  }                                                                      \
+  BENCHMARK(CompactProtocolReader_i32_list_##size, iters) {              \
+    readNumericLists(1, size, false, iters);                             \
+  }                                                                      \
+  BENCHMARK(CompactProtocolReader_i64_list_##size, iters) {              \
+    readNumericLists(2, size, false, iters);                             \
+  }                                                                      \
+  BENCHMARK(CompactProtocolReader_double_list_##size, iters) {           \
+    readNumericLists(3, size, false, iters);                             \
+  }                                                                      \
+  BENCHMARK(CompactProtocolWriter_i32_list_##size, iters) {              \
+    writeNumericLists(1, size, false, iters);                            \
+  }                                                                      \
+  BENCHMARK(CompactProtocolWriter_i64_list_##size, iters) {              \
+    writeNumericLists(2, size, false, iters);                            \
+  }                                                                      \
+  BENCHMARK(CompactProtocolWriter_double_list_##size, iters) {           \
+    writeNumericLists(3, size, false, iters);                            \
+  }                                                                      \
+  BENCHMARK_DRAW_LINE();
+
+NUMERIC_LIST_BENCHMARKS(1000)
+NUMERIC_LIST_BENCHMARKS(10000)
+NUMERIC_LIST_BENCHMARKS(100000)
+NUMERIC_LIST_BENCHMARKS(1000000)
+
 int main(int argc, char** argv) {
   gflags::ParseCommandLineFlags(&argc, &argv, true);
   google::InitGoogleLogging(argv[0]);
@@ -0,0 +1,32 @@
+/*
+ * Copyright 2014 Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+# The Deep structs of CompactProtocolBenchData.thrift, generated with the
+# arena flag.
+
+namespace cpp2 apache.thrift.test.arena
+
+struct Deep2 {
+  1: list<string> datas;
+}
+
+struct Deep1 {
+  1: list<Deep2> deeps;
+}
+
+struct Deep {
+  1: list<Deep1> deeps;
+}
@@ -0,0 +1,46 @@
+# The structs of ProtocolBenchmark.thrift, generated with table_serializer
+# to compare against the per-struct generated code.
+
+namespace cpp apache.thrift.test.table
+namespace cpp2 apache.thrift.test.table
+
+struct IntOnly {
+  1: i32 x,
+}
+
+struct StringOnly {
+  1: string x,
+}
+
+struct BenchmarkObject {
+  1: list<IntOnly> intStructs,
+  2: list<StringOnly> stringStructs,
+  3: list<i32> ints,
+  4: list<string> strings,
+}
+
+enum Color {
+  RED = 1,
+  BLUE = 2,
+}
+
+struct Mixed {
+  1: required i64 id,
+  2: optional string name,
+  3: map<string, list<i64>> lists,
+  4: set<Color> colors,
+  5: list<bool> flags,
+  7: optional IntOnly nested,
+  9: double ratio,
+}
+
+# RecA refers to RecB before the field that rules out its table, so RecB is
+# looked at while RecA still seems supported.  Neither may get a table.
+struct RecA {
+  1: list<RecB> bs,
+  2: map<i32, string> (cpp.template = "std::unordered_map") names,
+}
+
+struct RecB {
+  1: list<RecA> as,
+}
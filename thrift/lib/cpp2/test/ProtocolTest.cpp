@@ -110,6 +110,106 @@ X(CompactProtocol)
 #undef X
 #undef X1
 
+BenchmarkObject makeMixed() {
+  BenchmarkObject obj;
+  for (int i = 0; i < 100; ++i) {
+    IntOnly x;
+    x.x = i;
+    obj.intStructs.push_back(x);
+    StringOnly y;
+    y.x.assign(i, 'y');
+    obj.stringStructs.push_back(y);
+    obj.ints.push_back(i * 1000);
+    obj.strings.emplace_back(i * 10, 's');
+  }
+  return obj;
+}
+
+// Written with the skip index, in buffers of at most maxGrowth bytes
+std::unique_ptr<folly::IOBuf> writeSkipIndex(const BenchmarkObject& obj,
+                                             size_t maxGrowth) {
+  folly::IOBufQueue queue;
+  CompactProtocolWriter writer;
+  writer.setSkipIndex(true);
+  writer.setOutput(&queue, maxGrowth);
+  uint32_t size = Cpp2Ops<BenchmarkObject>::serializedSize(&writer, &obj);
+  uint32_t written = Cpp2Ops<BenchmarkObject>::write(&writer, &obj);
+  EXPECT_LE(written, size);
+  EXPECT_EQ(written, queue.front()->computeChainDataLength());
+  return queue.move();
+}
+
+TEST(CompactProtocolTest, SkipIndexRoundTrip) {
+  auto obj = makeMixed();
+  for (size_t maxGrowth : {16, 1000, 1 << 20}) {
+    auto buf = writeSkipIndex(obj, maxGrowth);
+
+    CompactProtocolReader reader;
+    reader.setSkipIndex(true);
+    reader.setInput(buf.get());
+    BenchmarkObject read;
+    Cpp2Ops<BenchmarkObject>::read(&reader, &read);
+    EXPECT_EQ(obj, read);
+  }
+}
+
+TEST(CompactProtocolTest, SkipIndexSkip) {
+  auto obj = makeMixed();
+  auto buf = writeSkipIndex(obj, 1000);
+  size_t length = buf->computeChainDataLength();
+
+  CompactProtocolReader reader;
+  reader.setSkipIndex(true);
+  reader.setInput(buf.get());
+  EXPECT_EQ(length, reader.skip(protocol::T_STRUCT));
+  EXPECT_TRUE(reader.getCurrentPosition().isAtEnd());
+
+  // Each field is a list that is skipped whole
+  reader.setInput(buf.get());
+  std::string name;
+  TType type;
+  int16_t id;
+  reader.readStructBegin(name);
+  for (int16_t expected = 1; expected <= 4; ++expected) {
+    reader.readFieldBegin(name, type, id);
+    EXPECT_EQ(expected, id);
+    EXPECT_EQ(protocol::T_LIST, type);
+    reader.skip(type);
+    reader.readFieldEnd();
+  }
+  reader.readFieldBegin(name, type, id);
+  EXPECT_EQ(protocol::T_STOP, type);
+  reader.readStructEnd();
+  EXPECT_TRUE(reader.getCurrentPosition().isAtEnd());
+}
+
+template <bool skipIndex>
+void skipBenchmark(int iters) {
+  std::unique_ptr<folly::IOBuf> buf;
+  BENCHMARK_SUSPEND {
+    folly::IOBufQueue queue;
+    CompactProtocolWriter writer;
+    writer.setSkipIndex(skipIndex);
+    writer.setOutput(&queue);
+    Cpp2Ops<BenchmarkObject>::write(&writer, &intStructs);
+    buf = queue.move();
+  }
+  while (iters--) {
+    CompactProtocolReader reader;
+    reader.setSkipIndex(skipIndex);
+    reader.setInput(buf.get());
+    folly::doNotOptimizeAway(reader.skip(protocol::T_STRUCT));
+  }
+}
+
+BENCHMARK(CompactProtocol_skip_intStructs, n) {
+  skipBenchmark<false>(n);
+}
+
+BENCHMARK_RELATIVE(CompactProtocol_skipIndex_intStructs, n) {
+  skipBenchmark<true>(n);
+}
+
 }}}  // namespaces
 
 int main(int argc, char *argv[]) {
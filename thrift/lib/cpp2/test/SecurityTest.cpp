@@ -138,6 +138,20 @@ TEST(Security, CompressionSnappy) {
   });
 }
 
+TEST(Security, CompressionLz4) {
+  runTest([](HeaderClientChannel* channel) {
+    auto header = channel->getHeader();
+    header->setTransform(transport::THeader::LZ4_TRANSFORM);
+  });
+}
+
+TEST(Security, CompressionZstd) {
+  runTest([](HeaderClientChannel* channel) {
+    auto header = channel->getHeader();
+    header->setTransform(transport::THeader::ZSTD_TRANSFORM);
+  });
+}
+
 TEST(Security, DISABLED_CompressionQlz) {
   runTest([](HeaderClientChannel* channel) {
     auto header = channel->getHeader();
@@ -19,6 +19,9 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <vector>
+
 #include <thrift/lib/cpp2/test/gen-cpp2/TestService.h>
 #include <thrift/lib/cpp2/protocol/Serializer.h>
 
@@ -61,6 +64,88 @@ TEST(SerializationTest, Mixed) {
 
 }
 
+// Splits the serialized data into small buffers so that elements straddle
+// buffer boundaries
+std::unique_ptr<folly::IOBuf> splitBuffers(folly::IOBufQueue& q,
+                                           size_t size) {
+  auto data = q.move();
+  data->coalesce();
+  folly::IOBufQueue out;
+  for (size_t pos = 0; pos < data->length(); pos += size) {
+    out.append(folly::IOBuf::copyBuffer(
+      data->data() + pos, std::min(size, data->length() - pos)));
+  }
+  return out.move();
+}
+
+TEST(SerializationTest, CompactNumericLists) {
+  std::vector<int32_t> i32s;
+  std::vector<int64_t> i64s;
+  std::vector<double> doubles;
+  for (int i = 0; i < 1000; ++i) {
+    // Runs of one byte varints mixed with long ones
+    int sign = i % 2 ? 1 : -1;
+    i32s.push_back(i % 100 < 50 ? i % 60 - 30 : i * 104729 * sign);
+    i64s.push_back(i % 3 ? i : (int64_t(i) << 40) * sign);
+    doubles.push_back(i / 3.0);
+  }
+
+  for (size_t bufSize : {1, 7, 33, 4096}) {
+    folly::IOBufQueue q;
+    CompactProtocolWriter writer;
+    writer.setOutput(&q);
+    uint32_t written = writer.writeI32List(i32s.data(), i32s.size());
+    written += writer.writeI64List(i64s.data(), i64s.size());
+    written += writer.writeDoubleList(doubles.data(), doubles.size());
+    auto buf = splitBuffers(q, bufSize);
+
+    CompactProtocolReader reader;
+    reader.setInput(buf.get());
+    std::vector<int32_t> i32sOut(i32s.size());
+    std::vector<int64_t> i64sOut(i64s.size());
+    std::vector<double> doublesOut(doubles.size());
+    uint32_t read = reader.readI32List(i32sOut.data(), i32sOut.size());
+    read += reader.readI64List(i64sOut.data(), i64sOut.size());
+    read += reader.readDoubleList(doublesOut.data(), doublesOut.size());
+
+    EXPECT_EQ(written, read);
+    EXPECT_EQ(i32s, i32sOut);
+    EXPECT_EQ(i64s, i64sOut);
+    EXPECT_EQ(doubles, doublesOut);
+
+    // Same encoding as element by element
+    reader.setInput(buf.get());
+    for (auto value : i32s) {
+      int32_t i32;
+      reader.readI32(i32);
+      EXPECT_EQ(value, i32);
+    }
+  }
+}
+
+namespace apache { namespace thrift {
+template <> struct HasSizeHint<TestStruct> : std::true_type {};
+}}
+
+TEST(SerializationTest, SizeHint) {
+  typedef SerializedSizeHint<TestStruct, CompactProtocolWriter> Hint;
+  CompactProtocolWriter writer;
+  EXPECT_EQ(s.serializedSizeZC(&writer), serializedSizeHint(&writer, &s));
+
+  folly::IOBufQueue q;
+  writer.setOutput(&q);
+  uint32_t size = writeWithSizeHint(&writer, &s);
+  EXPECT_EQ(q.chainLength(), size);
+  EXPECT_EQ(size, Hint::get());
+  EXPECT_EQ(size, serializedSizeHint(&writer, &s));
+
+  // Grows at once, shrinks by an eighth of the difference
+  Hint::update(1000);
+  EXPECT_EQ(1000, Hint::get());
+  Hint::update(200);
+  EXPECT_EQ(900, Hint::get());
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   google::InitGoogleLogging(argv[0]);
@@ -71,4 +156,3 @@ int main(int argc, char** argv) {
 
   return RUN_ALL_TESTS();
 }
-
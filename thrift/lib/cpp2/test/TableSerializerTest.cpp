@@ -0,0 +1,181 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+// Checks that structs generated with table_serializer read and write the
+// same bytes as generated code, and compares their speed.
+
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <folly/Benchmark.h>
+
+#include <thrift/lib/cpp2/protocol/Serializer.h>
+#include <thrift/lib/cpp2/test/gen-cpp2/ProtocolBenchmark_types.h>
+#include <thrift/lib/cpp2/test/gen-cpp2/ProtocolBenchmarkTable_types.h>
+
+using namespace apache::thrift;
+
+namespace generated = apache::thrift::test;
+namespace table = apache::thrift::test::table;
+
+const size_t kElementCount = 10000;
+
+template <class Object>
+Object makeObject() {
+  Object obj;
+  for (size_t i = 0; i < kElementCount; ++i) {
+    obj.intStructs.emplace_back();
+    obj.intStructs.back().x = i;
+    obj.stringStructs.emplace_back();
+    obj.stringStructs.back().x.assign(i % 100, 'x');
+    obj.ints.push_back(i * 1000);
+    obj.strings.emplace_back(i % 100, 'y');
+  }
+  return obj;
+}
+
+generated::BenchmarkObject generatedObject;
+table::BenchmarkObject tableObject;
+
+template <class Serializer, class T>
+std::string serialize(const T& obj) {
+  folly::IOBufQueue queue;
+  Serializer::serialize(obj, &queue);
+  return queue.move()->moveToFbString().toStdString();
+}
+
+template <class Serializer>
+void checkSameBytes() {
+  auto bytes = serialize<Serializer>(generatedObject);
+  EXPECT_EQ(bytes, serialize<Serializer>(tableObject));
+
+  table::BenchmarkObject obj;
+  auto buf = folly::IOBuf::copyBuffer(bytes);
+  Serializer::deserialize(buf.get(), obj);
+  EXPECT_EQ(tableObject, obj);
+
+  CompactProtocolWriter writer;
+  EXPECT_EQ(generatedObject.serializedSize(&writer),
+            tableObject.serializedSize(&writer));
+}
+
+TEST(TableSerializerTest, SameBytes) {
+  checkSameBytes<CompactSerializer>();
+  checkSameBytes<BinarySerializer>();
+}
+
+TEST(TableSerializerTest, Mixed) {
+  table::Mixed obj;
+  obj.id = 1;
+  obj.lists["a"] = {1, -2, 1LL << 40};
+  obj.colors.insert(table::Color::BLUE);
+  obj.flags = {true, false, true};
+  obj.nested.x = 5;
+  obj.__isset.nested = true;
+  obj.ratio = 0.5;
+
+  table::Mixed out;
+  auto buf = folly::IOBuf::copyBuffer(serialize<CompactSerializer>(obj));
+  CompactSerializer::deserialize(buf.get(), out);
+  EXPECT_EQ(obj.id, out.id);
+  EXPECT_FALSE(out.__isset.name);
+  EXPECT_EQ(obj.lists, out.lists);
+  EXPECT_EQ(obj.colors, out.colors);
+  EXPECT_EQ(obj.flags, out.flags);
+  EXPECT_TRUE(out.__isset.nested);
+  EXPECT_EQ(5, out.nested.x);
+  EXPECT_EQ(0.5, out.ratio);
+
+  // id is required
+  table::IntOnly empty;
+  buf = folly::IOBuf::copyBuffer(serialize<CompactSerializer>(empty));
+  EXPECT_THROW(CompactSerializer::deserialize(buf.get(), out),
+               TProtocolException);
+}
+
+TEST(TableSerializerTest, MutualRecursion) {
+  table::RecA obj;
+  obj.bs.emplace_back();
+  obj.bs.back().as.emplace_back();
+  obj.bs.back().as.back().names[1] = "one";
+  obj.names[2] = "two";
+
+  table::RecA out;
+  auto buf = folly::IOBuf::copyBuffer(serialize<CompactSerializer>(obj));
+  CompactSerializer::deserialize(buf.get(), out);
+  ASSERT_EQ(1, out.bs.size());
+  ASSERT_EQ(1, out.bs[0].as.size());
+  EXPECT_EQ(obj.bs[0].as[0].names, out.bs[0].as[0].names);
+  EXPECT_EQ(obj.names, out.names);
+}
+
+template <class Serializer, class T>
+void serializeBenchmark(const T& obj, int iters) {
+  while (iters--) {
+    folly::IOBufQueue queue;
+    Serializer::serialize(obj, &queue);
+  }
+}
+
+template <class Serializer, class T>
+void deserializeBenchmark(const T& obj, int iters) {
+  std::unique_ptr<folly::IOBuf> buf;
+  BENCHMARK_SUSPEND {
+    folly::IOBufQueue queue;
+    Serializer::serialize(obj, &queue);
+    buf = queue.move();
+  }
+  while (iters--) {
+    T out;
+    Serializer::deserialize(buf.get(), out);
+  }
+}
+
+#define TABLE_BENCHMARKS(Serializer)                                    \
+  BENCHMARK(Serializer##_write_generated, n) {                          \
+    serializeBenchmark<Serializer>(generatedObject, n);                 \
+  }                                                                     \
+  BENCHMARK_RELATIVE(Serializer##_write_table, n) {                     \
+    serializeBenchmark<Serializer>(tableObject, n);                     \
+  }                                                                     \
+  BENCHMARK(Serializer##_read_generated, n) {                           \
+    deserializeBenchmark<Serializer>(generatedObject, n);               \
+  }                                                                     \
+  BENCHMARK_RELATIVE(Serializer##_read_table, n) {                      \
+    deserializeBenchmark<Serializer>(tableObject, n);                   \
+  }                                                                     \
+  BENCHMARK_DRAW_LINE();
+
+TABLE_BENCHMARKS(CompactSerializer)
+TABLE_BENCHMARKS(BinarySerializer)
+
+int main(int argc, char *argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  generatedObject = makeObject<generated::BenchmarkObject>();
+  tableObject = makeObject<table::BenchmarkObject>();
+  auto ret = RUN_ALL_TESTS();
+  if (!ret) {
+    folly::runBenchmarksOnFlag();
+  }
+  return ret;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2014 Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Connection-rate benchmark: every iteration opens a new connection, makes
+// one request on it and closes it, comparing the shared accept thread with
+// per-worker SO_REUSEPORT listen sockets.
+
+#include <thrift/lib/cpp2/test/gen-cpp/TestService.h>
+#include <thrift/lib/cpp2/test/gen-cpp2/TestService.h>
+#include <thrift/lib/cpp2/server/ThriftServer.h>
+
+#include <thrift/lib/cpp/util/ScopedServerThread.h>
+#include <thrift/lib/cpp/concurrency/PosixThreadFactory.h>
+#include <thrift/lib/cpp/protocol/TBinaryProtocol.h>
+#include <thrift/lib/cpp/transport/TBufferTransports.h>
+#include <thrift/lib/cpp/transport/TSocket.h>
+
+#include <thread>
+#include <vector>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <folly/Benchmark.h>
+
+DEFINE_int32(clients, 16, "Number of threads opening connections");
+DEFINE_int32(workers, 8, "Number of Cpp2Worker threads in the server");
+
+using namespace apache::thrift;
+using namespace apache::thrift::test::cpp2;
+using namespace apache::thrift::util;
+using namespace apache::thrift::transport;
+using apache::thrift::protocol::TBinaryProtocolT;
+using apache::thrift::test::TestServiceClient;
+
+class AcceptBenchInterface : public TestServiceSvIf {
+  void sendResponse(std::string& _return, int64_t size) {
+    _return = "test";
+  }
+};
+
+std::shared_ptr<ThriftServer> getServer(bool reusePort) {
+  std::shared_ptr<ThriftServer> server(new ThriftServer);
+  server->setPort(0);
+  server->setNWorkerThreads(FLAGS_workers);
+  server->setReusePort(reusePort);
+  server->setSaslEnabled(false);
+  server->setInterface(
+    std::unique_ptr<AcceptBenchInterface>(new AcceptBenchInterface));
+  return server;
+}
+
+void connectLoop(uint16_t port, size_t iters) {
+  std::vector<std::thread> threads;
+  for (int i = 0; i < FLAGS_clients; ++i) {
+    size_t count = iters / FLAGS_clients;
+    if (size_t(i) < iters % FLAGS_clients) {
+      ++count;
+    }
+    threads.emplace_back([port, count] {
+      TSocketAddress address("127.0.0.1", port);
+      for (size_t n = 0; n < count; ++n) {
+        auto socket = std::make_shared<TSocket>(address);
+        socket->open();
+        auto transport = std::make_shared<TFramedTransport>(socket);
+        auto protocol =
+          std::make_shared<TBinaryProtocolT<TBufferBase>>(transport);
+        TestServiceClient client(protocol);
+        std::string response;
+        client.sendResponse(response, 0);
+        socket->close();
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+void runAcceptBench(bool reusePort, size_t iters) {
+  folly::BenchmarkSuspender braces;
+  ScopedServerThread sst(getServer(reusePort));
+  auto port = sst.getAddress()->getPort();
+  braces.dismiss();
+  connectLoop(port, iters);
+  braces.rehire();
+}
+
+BENCHMARK(ThriftServer_accept_shared_socket, iters) {
+  runAcceptBench(false, iters);
+}
+
+BENCHMARK_RELATIVE(ThriftServer_accept_reuse_port, iters) {
+  runAcceptBench(true, iters);
+}
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  folly::runBenchmarks();
+  return 0;
+}
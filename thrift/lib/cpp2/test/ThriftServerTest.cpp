@@ -24,12 +24,24 @@
 #include <thrift/lib/cpp/util/ScopedServerThread.h>
 #include <thrift/lib/cpp/async/TEventBase.h>
 #include <thrift/lib/cpp/async/TAsyncSocket.h>
+#include <thrift/lib/cpp/async/TAsyncSSLSocket.h>
+#include <thrift/lib/cpp/transport/TLSTicketKeyManager.h>
+#include <thrift/lib/cpp/transport/TSSLSocket.h>
 
 #include <thrift/lib/cpp2/async/StubSaslClient.h>
 #include <thrift/lib/cpp2/async/StubSaslServer.h>
 
 #include <boost/cast.hpp>
 #include <boost/lexical_cast.hpp>
+#include <gflags/gflags.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+
+DECLARE_bool(enable_request_context);
 
 using namespace apache::thrift;
 using namespace apache::thrift::test::cpp2;
@@ -438,6 +450,192 @@ TEST(ThriftServer, CompactClientTest) {
   EXPECT_EQ(response, "test64");
 }
 
+TEST(ThriftServer, ReusePortTest) {
+  static std::mutex mutex;
+  static std::set<apache::thrift::async::TEventBase*> workers;
+
+  // 'eb' handlers run on the worker that accepted the connection
+  class WorkerRecordingInterface : public TestServiceSvIf {
+    void async_eb_eventBaseAsync(std::unique_ptr<
+        apache::thrift::HandlerCallback<std::unique_ptr<std::string>>> cb) {
+      {
+        std::lock_guard<std::mutex> g(mutex);
+        workers.insert(cb->getEventBase());
+      }
+      cb->result(std::unique_ptr<std::string>(new std::string("hello world")));
+    }
+  };
+
+  auto server = getServer();
+  server->setInterface(folly::make_unique<WorkerRecordingInterface>());
+  server->setNWorkerThreads(4);
+  server->setReusePort(true);
+  ScopedServerThread sst(server);
+  auto port = sst.getAddress()->getPort();
+
+  // Each connection lands on whichever worker the kernel picks, by hash
+  // of the client's source port.  Keep them all open so that no two
+  // connections can share a source port.
+  TEventBase base;
+  std::vector<std::unique_ptr<TestServiceAsyncClient>> clients;
+  for (int i = 0; i < 32; ++i) {
+    std::shared_ptr<TAsyncSocket> socket(
+      TAsyncSocket::newSocket(&base, "127.0.0.1", port));
+
+    clients.emplace_back(new TestServiceAsyncClient(
+      std::unique_ptr<HeaderClientChannel,
+                      apache::thrift::async::TDelayedDestruction::Destructor>(
+                        new HeaderClientChannel(socket))));
+
+    std::string response;
+    clients.back()->sync_eventBaseAsync(response);
+    EXPECT_EQ(response, "hello world");
+  }
+
+  // With 32 connections over 4 listen sockets, all of them landing on
+  // one worker has probability 4^-31
+  std::lock_guard<std::mutex> g(mutex);
+  EXPECT_GT(workers.size(), 1);
+  EXPECT_LE(workers.size(), 4);
+}
+
+TEST(ThriftServer, NumaPinningThreadFactoryTest) {
+  class CountingThreadFactory
+      : public apache::thrift::concurrency::PosixThreadFactory {
+   public:
+    std::shared_ptr<apache::thrift::concurrency::Thread> newThread(
+        const std::shared_ptr<apache::thrift::concurrency::Runnable>& runnable,
+        DetachState detachState) const {
+      ++threads;
+      return PosixThreadFactory::newThread(runnable, detachState);
+    }
+
+    mutable std::atomic<int> threads{0};
+  };
+  auto factory = std::make_shared<CountingThreadFactory>();
+
+  // Pinned or not, the workers come from our factory
+  auto server = getServer();
+  server->setThreadFactory(factory);
+  server->setNumaPinning(true);
+  server->setNWorkerThreads(3);
+  ScopedServerThread sst(server);
+  EXPECT_GE(factory->threads, 3);
+
+  TEventBase base;
+
+  std::shared_ptr<TAsyncSocket> socket(
+    TAsyncSocket::newSocket(&base, "127.0.0.1", sst.getAddress()->getPort()));
+
+  TestServiceAsyncClient client(
+    std::unique_ptr<HeaderClientChannel,
+                    apache::thrift::async::TDelayedDestruction::Destructor>(
+                      new HeaderClientChannel(socket)));
+
+  std::string response;
+  client.sync_sendResponse(response, 64);
+  EXPECT_EQ(response, "test64");
+}
+
+TEST(ThriftServer, FairDispatchTest) {
+  static std::mutex mutex;
+  static std::condition_variable gateOpened;
+  static bool gateOpen = false;
+  static std::vector<int64_t> order;
+
+  // sendResponse(0) holds the only dispatch slot until the gate opens,
+  // every other size is recorded in dispatch order
+  class OrderingInterface : public TestServiceSvIf {
+    void sendResponse(std::string& _return, int64_t size) {
+      std::unique_lock<std::mutex> g(mutex);
+      if (size == 0) {
+        gateOpened.wait(g, [] { return gateOpen; });
+      } else {
+        order.push_back(size);
+      }
+      _return = "test" + boost::lexical_cast<std::string>(size);
+    }
+  };
+
+  class CountingObserver : public apache::thrift::server::TServerObserver {
+   public:
+    CountingObserver() : received(0) {}
+    void receivedRequest() {
+      ++received;
+    }
+    std::atomic<int> received;
+  };
+  auto observer = std::make_shared<CountingObserver>();
+
+  auto server = getServer();
+  server->setInterface(folly::make_unique<OrderingInterface>());
+  server->setObserver(observer);
+  server->setNWorkerThreads(1);
+  server->setMaxDispatchedRequestsPerWorker(1);
+  ScopedServerThread sst(server);
+  auto port = sst.getAddress()->getPort();
+
+  TEventBase base;
+  auto newClient = [&]() {
+    std::shared_ptr<TAsyncSocket> socket(
+      TAsyncSocket::newSocket(&base, "127.0.0.1", port));
+    return folly::make_unique<TestServiceAsyncClient>(
+      HeaderClientChannel::newChannel(socket));
+  };
+  auto gate = newClient();
+  auto abusive = newClient();
+  auto polite = newClient();
+
+  const int kAbusiveRequests = 8;
+  const int kPoliteRequests = 2;
+  int done = 0;
+  auto send = [&](TestServiceAsyncClient* client, int64_t size) {
+    client->sendResponse([&, size](ClientReceiveState&& state) {
+      std::string response;
+      TestServiceAsyncClient::recv_sendResponse(response, state);
+      EXPECT_EQ("test" + boost::lexical_cast<std::string>(size), response);
+      ++done;
+    }, size);
+  };
+  auto waitForRequests = [&](int requests) {
+    while (observer->received < requests) {
+      usleep(1000);
+    }
+  };
+
+  // Once the gate has the slot, the abusive connection queues all its
+  // requests before the polite one queues any, so it is first in the round
+  send(gate.get(), 0);
+  std::thread sequencer([&] {
+    waitForRequests(1);
+    base.runInEventBaseThread([&] {
+      for (int i = 0; i < kAbusiveRequests; ++i) {
+        send(abusive.get(), 100 + i);
+      }
+    });
+    waitForRequests(1 + kAbusiveRequests);
+    base.runInEventBaseThread([&] {
+      for (int i = 0; i < kPoliteRequests; ++i) {
+        send(polite.get(), 200 + i);
+      }
+    });
+    waitForRequests(1 + kAbusiveRequests + kPoliteRequests);
+    std::lock_guard<std::mutex> g(mutex);
+    gateOpen = true;
+    gateOpened.notify_all();
+  });
+
+  base.loop();
+  sequencer.join();
+  EXPECT_EQ(1 + kAbusiveRequests + kPoliteRequests, done);
+
+  // Every request uses up the worker's only slot, which ends the turn of
+  // its connection, so the two take turns until the polite one is done
+  std::vector<int64_t> expected{100, 200, 101, 201, 102, 103, 104, 105, 106,
+                                107};
+  EXPECT_EQ(expected, order);
+}
+
 TEST(ThriftServer, CompressionClientTest) {
 
   ScopedServerThread sst(getServer());
@@ -472,6 +670,161 @@ TEST(ThriftServer, CompressionClientTest) {
   }
 }
 
+TEST(ThriftServer, UnknownCompressionDictionaryTest) {
+  auto server = getServer();
+
+  // Rejected right away, instead of when the first connection is accepted
+  EXPECT_THROW(server->setCompressionDictionaryId(0xbad1d),
+               TTransportException);
+  EXPECT_EQ(server->getCompressionDictionaryId(), 0);
+
+  ScopedServerThread sst(server);
+  auto port = sst.getAddress()->getPort();
+
+  TEventBase base;
+
+  std::shared_ptr<TAsyncSocket> socket(
+    TAsyncSocket::newSocket(&base, "127.0.0.1", port));
+
+  TestServiceAsyncClient client(
+    std::unique_ptr<HeaderClientChannel,
+                    apache::thrift::async::TDelayedDestruction::Destructor>(
+                      new HeaderClientChannel(socket)));
+
+  std::string response;
+  client.sync_sendResponse(response, 64);
+  EXPECT_EQ(response, "test64");
+}
+
+TEST(ThriftServer, RequestTraceTest) {
+  auto server = getServer();
+  server->setNWorkerThreads(1);
+  server->setRequestTraceSize(4);
+  ScopedServerThread sst(server);
+  auto port = sst.getAddress()->getPort();
+
+  TEventBase base;
+
+  std::shared_ptr<TAsyncSocket> socket(
+    TAsyncSocket::newSocket(&base, "127.0.0.1", port));
+
+  TestServiceAsyncClient client(
+    std::unique_ptr<HeaderClientChannel,
+                    apache::thrift::async::TDelayedDestruction::Destructor>(
+                      new HeaderClientChannel(socket)));
+
+  // Compressed, so that the server untransforms the request
+  auto header = boost::polymorphic_downcast<HeaderClientChannel*>(
+    client.getChannel())->getHeader();
+  header->setTransform(
+    apache::thrift::transport::THeader::ZLIB_TRANSFORM);
+  header->setMinCompressBytes(1);
+
+  for (int i = 0; i < 6; ++i) {
+    std::string response;
+    client.sync_sendResponse(response, 1000);
+    EXPECT_EQ(response, "test1000");
+  }
+
+  // The worker keeps the trace once the reply is written, which may be
+  // after the client has it
+  std::vector<RequestTrace> traces;
+  for (int i = 0; i < 100; ++i) {
+    traces = server->getRequestTraces();
+    if (traces.size() == 4 && traces.back().times[RequestTrace::WRITE_END]) {
+      break;
+    }
+    usleep(10000);
+  }
+
+  // Only the last 4 are kept
+  ASSERT_EQ(traces.size(), 4);
+  for (const auto& trace : traces) {
+    EXPECT_STREQ(trace.method, "TestService.sendResponse");
+    for (int event = 0; event < RequestTrace::NUM_EVENTS; ++event) {
+      EXPECT_NE(trace.times[event], 0)
+        << RequestTrace::getEventName(RequestTrace::Event(event));
+      if (event > 0) {
+        EXPECT_LE(trace.times[event - 1], trace.times[event])
+          << RequestTrace::getEventName(RequestTrace::Event(event));
+      }
+    }
+    // The handler sleeps for 1ms
+    EXPECT_GE(trace.times[RequestTrace::HANDLER_END] -
+              trace.times[RequestTrace::HANDLER_BEGIN],
+              1000000);
+  }
+}
+
+TEST(ThriftServer, RequestTraceTimeoutTest) {
+  auto server = getServer();
+  server->setNWorkerThreads(1);
+  server->setRequestTraceSize(4);
+  server->setTaskExpireTime(std::chrono::milliseconds(50));
+  ScopedServerThread sst(server);
+  auto port = sst.getAddress()->getPort();
+
+  TEventBase base;
+
+  std::shared_ptr<TAsyncSocket> socket(
+    TAsyncSocket::newSocket(&base, "127.0.0.1", port));
+
+  TestServiceAsyncClient client(
+    std::unique_ptr<HeaderClientChannel,
+                    apache::thrift::async::TDelayedDestruction::Destructor>(
+                      new HeaderClientChannel(socket)));
+
+  // The TIMEOUT error is written while the handler still runs and marks
+  // the trace
+  std::string response;
+  try {
+    client.sync_sendResponse(response, 200000);
+    ADD_FAILURE() << "The request should have timed out";
+  } catch (const TApplicationException& e) {
+    EXPECT_EQ(TApplicationException::TApplicationExceptionType::TIMEOUT,
+              e.getType());
+  }
+
+  // The worker keeps the trace once the handler is done with it
+  std::vector<RequestTrace> traces;
+  for (int i = 0; i < 100; ++i) {
+    traces = server->getRequestTraces();
+    if (!traces.empty()) {
+      break;
+    }
+    usleep(10000);
+  }
+
+  ASSERT_EQ(traces.size(), 1);
+  const auto& trace = traces[0];
+  EXPECT_STREQ(trace.method, "TestService.sendResponse");
+  EXPECT_NE(trace.times[RequestTrace::HANDLER_BEGIN], 0);
+  EXPECT_NE(trace.times[RequestTrace::WRITE_END], 0);
+  EXPECT_LT(trace.times[RequestTrace::WRITE_END],
+            trace.times[RequestTrace::HANDLER_END]);
+}
+
+TEST(ThriftServer, RequestTraceOffTest) {
+  auto server = getServer();
+  ScopedServerThread sst(server);
+  auto port = sst.getAddress()->getPort();
+
+  TEventBase base;
+
+  std::shared_ptr<TAsyncSocket> socket(
+    TAsyncSocket::newSocket(&base, "127.0.0.1", port));
+
+  TestServiceAsyncClient client(
+    std::unique_ptr<HeaderClientChannel,
+                    apache::thrift::async::TDelayedDestruction::Destructor>(
+                      new HeaderClientChannel(socket)));
+
+  std::string response;
+  client.sync_sendResponse(response, 64);
+  EXPECT_EQ(response, "test64");
+  EXPECT_TRUE(server->getRequestTraces().empty());
+}
+
 TEST(ThriftServer, ClientTimeoutTest) {
 
   ScopedServerThread sst(getServer());
@@ -508,6 +861,136 @@ TEST(ThriftServer, ClientTimeoutTest) {
   base.loop();
 }
 
+TEST(ThriftServer, DeadlineDropTest) {
+  static std::atomic<int> lateCalls(0);
+
+  class CountingInterface : public TestServiceSvIf {
+    void sendResponse(std::string& _return, int64_t size) {
+      if (size == 0) {
+        ++lateCalls;
+      }
+      usleep(size);
+      _return = "test" + boost::lexical_cast<std::string>(size);
+    }
+  };
+
+  auto server = getServer();
+  server->setInterface(folly::make_unique<CountingInterface>());
+  // Neither the server's own timer nor the thread manager may drop the
+  // request: it waits in the worker, and only its propagated deadline can
+  // stop it from being dispatched.
+  server->setUseClientTimeout(false);
+  server->setTaskExpireTime(std::chrono::milliseconds(10000));
+  server->setMaxActiveRequestsPerConnection(1);
+  ScopedServerThread sst(server);
+  auto port = sst.getAddress()->getPort();
+
+  TEventBase base;
+
+  std::shared_ptr<TAsyncSocket> socket(
+    TAsyncSocket::newSocket(&base, "127.0.0.1", port));
+
+  TestServiceAsyncClient client(
+    std::unique_ptr<HeaderClientChannel,
+                    apache::thrift::async::TDelayedDestruction::Destructor>(
+                      new HeaderClientChannel(socket)));
+
+  // Occupy the connection's only dispatch slot
+  client.sendResponse([](ClientReceiveState&& state) {
+    std::string response;
+    TestServiceAsyncClient::recv_sendResponse(response, state);
+    EXPECT_EQ("test100000", response);
+  }, 100000);
+
+  // Its deadline passes while it waits for the slot
+  RpcOptions options;
+  options.setTimeout(std::chrono::milliseconds(20));
+  client.sendResponse(options, std::unique_ptr<RequestCallback>(
+    new FunctionReplyCallback([](ClientReceiveState&& state) {
+      EXPECT_TRUE(state.exception() != nullptr);
+    })), 0);
+  base.loop();
+
+  // The server dropped it when the slot freed up
+  usleep(50000);
+  EXPECT_EQ(0, lateCalls);
+}
+
+TEST(ThriftServer, DeadlineInheritanceTest) {
+  // Deadline the backend saw, as time left when its handler ran
+  static std::atomic<int64_t> backendRemaining(-1);
+
+  class BackendInterface : public TestServiceSvIf {
+    void sendResponse(std::string& _return, int64_t size) {
+      auto deadline = getConnectionContext()->getDeadline();
+      if (deadline != std::chrono::steady_clock::time_point()) {
+        backendRemaining =
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+      }
+      _return = "backend";
+    }
+  };
+
+  // Calls the backend with a long timeout of its own, under the
+  // RequestContext of the request it is handling
+  class FrontendInterface : public TestServiceSvIf {
+   public:
+    explicit FrontendInterface(uint16_t backendPort)
+      : backendPort_(backendPort) {}
+
+    void sendResponse(std::string& _return, int64_t size) {
+      TEventBase base;
+      std::shared_ptr<TAsyncSocket> socket(
+        TAsyncSocket::newSocket(&base, "127.0.0.1", backendPort_));
+      TestServiceAsyncClient client(
+        std::unique_ptr<HeaderClientChannel,
+                        apache::thrift::async::TDelayedDestruction::Destructor>(
+                          new HeaderClientChannel(socket)));
+      RpcOptions options;
+      options.setTimeout(std::chrono::milliseconds(10000));
+      client.sync_sendResponse(options, _return, size);
+    }
+
+   private:
+    uint16_t backendPort_;
+  };
+
+  bool enableRequestContext = FLAGS_enable_request_context;
+  FLAGS_enable_request_context = true;
+  {
+    auto backend = getServer();
+    backend->setInterface(folly::make_unique<BackendInterface>());
+    ScopedServerThread backendThread(backend);
+
+    auto frontend = getServer();
+    frontend->setInterface(folly::make_unique<FrontendInterface>(
+      backendThread.getAddress()->getPort()));
+    ScopedServerThread frontendThread(frontend);
+
+    TEventBase base;
+    std::shared_ptr<TAsyncSocket> socket(
+      TAsyncSocket::newSocket(&base, "127.0.0.1",
+                              frontendThread.getAddress()->getPort()));
+    TestServiceAsyncClient client(
+      std::unique_ptr<HeaderClientChannel,
+                      apache::thrift::async::TDelayedDestruction::Destructor>(
+                        new HeaderClientChannel(socket)));
+
+    RpcOptions options;
+    options.setTimeout(std::chrono::milliseconds(1000));
+    std::string response;
+    client.sync_sendResponse(options, response, 0);
+    EXPECT_EQ("backend", response);
+  }
+  FLAGS_enable_request_context = enableRequestContext;
+
+  // The nested call carried what was left of the outer 1s budget, not its
+  // own 10s timeout
+  EXPECT_GT(backendRemaining, 0);
+  EXPECT_LE(backendRemaining, 1000);
+}
+
 TEST(ThriftServer, ConnectionIdleTimeoutTest) {
   std::shared_ptr<ThriftServer> server = getServer();
   server->setIdleTimeout(std::chrono::milliseconds(20));
@@ -559,6 +1042,105 @@ TEST(ThriftServer, Thrift1OnewayRequestTest) {
   client->sendResponse(response, 0);
 }
 
+#if OPENSSL_VERSION_NUMBER >= 0x1000105fL && !defined(OPENSSL_NO_TLSEXT)
+TEST(ThriftServer, SSLHandshakeThreadsTest) {
+  auto server = getServer();
+  server->setNWorkerThreads(1);
+  server->setNSSLHandshakeThreads(2);
+
+  std::shared_ptr<SSLContext> serverCtx(new SSLContext);
+  serverCtx->loadCertificate("thrift/lib/cpp/test/ssl/tests-cert.pem");
+  serverCtx->loadPrivateKey("thrift/lib/cpp/test/ssl/tests-key.pem");
+  serverCtx->ciphers("ALL:!ADH:!LOW:!EXP:!MD5:@STRENGTH");
+  // The ClientHello is read inside SSL_accept(): count where it runs
+  std::atomic<int> onWorker(0);
+  std::atomic<int> offWorker(0);
+  auto eventBaseManager = server->getEventBaseManager();
+  serverCtx->addClientHelloCallback([&](SSL* ssl) {
+    if (eventBaseManager->getExistingEventBase()) {
+      ++onWorker;
+    } else {
+      ++offWorker;
+    }
+  });
+  server->setSSLContext(serverCtx);
+
+  ScopedServerThread sst(server);
+  TSocketAddress address("127.0.0.1", sst.getAddress()->getPort());
+
+  std::shared_ptr<SSLContext> clientCtx(new SSLContext);
+  clientCtx->ciphers("ALL:!ADH:!LOW:!EXP:!MD5:@STRENGTH");
+  for (int i = 0; i < 3; ++i) {
+    auto socket = std::make_shared<TSSLSocket>(clientCtx, address);
+    socket->open();
+    auto transport = std::make_shared<TFramedTransport>(socket);
+    auto protocol =
+      std::make_shared<TBinaryProtocolT<TBufferBase>>(transport);
+    TestServiceClient client(protocol);
+
+    std::string response;
+    client.sendResponse(response, 64);
+    EXPECT_EQ(response, "test64");
+    socket->close();
+  }
+
+  EXPECT_EQ(onWorker, 0);
+  EXPECT_EQ(offWorker, 3);
+}
+#endif
+
+TEST(ThriftServer, SSLSessionResumptionObserverTest) {
+  class SessionObserver : public apache::thrift::server::TServerObserver {
+   public:
+    SessionObserver() : hits(0), misses(0) {}
+    void sslSessionCacheHit() {
+      ++hits;
+    }
+    void sslSessionCacheMiss() {
+      ++misses;
+    }
+    std::atomic<int> hits;
+    std::atomic<int> misses;
+  };
+  auto observer = std::make_shared<SessionObserver>();
+
+  auto server = getServer();
+  std::shared_ptr<SSLContext> serverCtx(new SSLContext);
+  serverCtx->loadCertificate("thrift/lib/cpp/test/ssl/tests-cert.pem");
+  serverCtx->loadPrivateKey("thrift/lib/cpp/test/ssl/tests-key.pem");
+  serverCtx->setTicketKeyManager(std::make_shared<TLSTicketKeyManager>());
+  server->setSSLContext(serverCtx);
+  server->setObserver(observer);
+  ScopedServerThread sst(server);
+  TSocketAddress address("127.0.0.1", sst.getAddress()->getPort());
+
+  // A full handshake, then one resuming its session from the ticket
+  std::shared_ptr<SSLContext> clientCtx(new SSLContext);
+  SSL_SESSION* session = nullptr;
+  for (int i = 0; i < 2; ++i) {
+    TEventBase base;
+    auto socket = TAsyncSSLSocket::newSocket(clientCtx, &base);
+    if (session) {
+      socket->setSSLSession(session, true);
+    }
+    socket->connect(nullptr, address);
+    base.loop();
+
+    TestServiceAsyncClient client(HeaderClientChannel::newChannel(socket));
+    std::string response;
+    // The reply also brings the ticket along with TLS 1.3
+    client.sync_sendResponse(response, 64);
+    EXPECT_EQ(response, "test64");
+    EXPECT_EQ(i == 1, socket->getSSLSessionReused());
+    session = socket->getSSLSession();
+  }
+  SSL_SESSION_free(session);
+
+  // Counted when the handshakes completed, before the requests ran
+  EXPECT_EQ(observer->misses, 1);
+  EXPECT_EQ(observer->hits, 1);
+}
+
 class Callback : public RequestCallback {
   void requestSent() {
     ADD_FAILURE();
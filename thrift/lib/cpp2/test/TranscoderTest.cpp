@@ -0,0 +1,184 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string>
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <folly/Benchmark.h>
+#include <folly/Format.h>
+
+#include <thrift/lib/cpp2/protocol/DebugProtocol.h>
+#include <thrift/lib/cpp2/protocol/Serializer.h>
+#include <thrift/lib/cpp2/protocol/Transcoder.h>
+#include <thrift/lib/cpp2/test/gen-cpp2/CompactProtocolBenchData_types.h>
+
+using namespace apache::thrift;
+using namespace ::cpp2;
+
+namespace {
+
+Deep makeDeep() {
+  Deep data;
+  for (size_t i = 0; i < 16; ++i) {
+    Deep1 data1;
+    for (size_t j = 0; j < 16; ++j) {
+      Deep2 data2;
+      for (size_t k = 0; k < 16; ++k) {
+        data2.datas.push_back(folly::sformat("omg[{}, {}, {}]", i, j, k));
+      }
+      // One string big enough to be chained instead of copied
+      if (j == 0) {
+        data2.datas.emplace_back(10000, 'x');
+      }
+      data1.deeps.push_back(std::move(data2));
+    }
+    data.deeps.push_back(std::move(data1));
+  }
+  return data;
+}
+
+template <class Serializer, class T>
+std::unique_ptr<folly::IOBuf> serialize(const T& obj) {
+  folly::IOBufQueue queue;
+  Serializer::serialize(obj, &queue);
+  return queue.move();
+}
+
+std::string toString(std::unique_ptr<folly::IOBuf> buf) {
+  return buf->moveToFbString().toStdString();
+}
+
+typedef Transcoder<BinaryProtocolReader, CompactProtocolWriter>
+  BinaryToCompact;
+typedef Transcoder<CompactProtocolReader, BinaryProtocolWriter>
+  CompactToBinary;
+
+}
+
+TEST(TranscoderTest, Struct) {
+  auto deep = makeDeep();
+  auto binary = serialize<BinarySerializer>(deep);
+  auto compact = BinaryToCompact::transcodeStruct(binary.get());
+  EXPECT_EQ(toString(serialize<CompactSerializer>(deep)),
+            toString(compact->clone()));
+  EXPECT_EQ(toString(binary->clone()),
+            toString(CompactToBinary::transcodeStruct(compact.get())));
+}
+
+TEST(TranscoderTest, Message) {
+  Shallow shallow;
+  shallow.one = 1;
+  shallow.two = 2;
+
+  folly::IOBufQueue queue;
+  BinaryProtocolWriter writer;
+  writer.setOutput(&queue);
+  writer.writeMessageBegin("method", T_CALL, 7);
+  shallow.write(&writer);
+  writer.writeMessageEnd();
+  auto compact = BinaryToCompact::transcodeMessage(queue.move().get());
+
+  CompactProtocolReader reader;
+  reader.setInput(compact.get());
+  std::string name;
+  MessageType type;
+  int32_t seqid;
+  reader.readMessageBegin(name, type, seqid);
+  EXPECT_EQ("method", name);
+  EXPECT_EQ(T_CALL, type);
+  EXPECT_EQ(7, seqid);
+  Shallow read;
+  read.read(&reader);
+  EXPECT_EQ(shallow, read);
+}
+
+TEST(TranscoderTest, Debug) {
+  Shallow shallow;
+  shallow.one = 750;
+  shallow.two = 42;
+  auto compact = serialize<CompactSerializer>(shallow);
+  auto debug = Transcoder<CompactProtocolReader, DebugProtocolWriter>
+    ::transcodeStruct(compact.get());
+  auto text = toString(std::move(debug));
+  EXPECT_NE(std::string::npos, text.find("750"));
+  EXPECT_NE(std::string::npos, text.find("42"));
+}
+
+TEST(TranscoderTest, Truncated) {
+  auto binary = serialize<BinarySerializer>(makeDeep());
+  binary->coalesce();
+  binary->trimEnd(binary->length() / 2);
+  EXPECT_ANY_THROW(BinaryToCompact::transcodeStruct(binary.get()));
+}
+
+BENCHMARK(BinaryToCompact_roundTrip, iters) {
+  std::unique_ptr<folly::IOBuf> binary;
+  BENCHMARK_SUSPEND {
+    binary = serialize<BinarySerializer>(makeDeep());
+  }
+  while (iters--) {
+    Deep deep;
+    BinarySerializer::deserialize(binary.get(), deep);
+    folly::doNotOptimizeAway(serialize<CompactSerializer>(deep));
+  }
+}
+
+BENCHMARK_RELATIVE(BinaryToCompact_transcode, iters) {
+  std::unique_ptr<folly::IOBuf> binary;
+  BENCHMARK_SUSPEND {
+    binary = serialize<BinarySerializer>(makeDeep());
+  }
+  while (iters--) {
+    folly::doNotOptimizeAway(BinaryToCompact::transcodeStruct(binary.get()));
+  }
+}
+
+BENCHMARK(CompactToBinary_roundTrip, iters) {
+  std::unique_ptr<folly::IOBuf> compact;
+  BENCHMARK_SUSPEND {
+    compact = serialize<CompactSerializer>(makeDeep());
+  }
+  while (iters--) {
+    Deep deep;
+    CompactSerializer::deserialize(compact.get(), deep);
+    folly::doNotOptimizeAway(serialize<BinarySerializer>(deep));
+  }
+}
+
+BENCHMARK_RELATIVE(CompactToBinary_transcode, iters) {
+  std::unique_ptr<folly::IOBuf> compact;
+  BENCHMARK_SUSPEND {
+    compact = serialize<CompactSerializer>(makeDeep());
+  }
+  while (iters--) {
+    folly::doNotOptimizeAway(CompactToBinary::transcodeStruct(compact.get()));
+  }
+}
+
+int main(int argc, char *argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  auto ret = RUN_ALL_TESTS();
+  if (!ret) {
+    folly::runBenchmarksOnFlag();
+  }
+  return ret;
+}
@@ -0,0 +1,109 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/lib/cpp2/protocol/Serializer.h>
+
+#include "thrift/test/gen-cpp2/LazyFieldTest_types.h"
+
+#include <gtest/gtest.h>
+
+using namespace thrift::test::lazy::cpp2;
+using namespace apache::thrift;
+using namespace std;
+
+Eager makeEager() {
+  Eager eager;
+  eager.destination = "somewhere";
+  for (int64_t i = 0; i < 1000; ++i) {
+    eager.payload.values.push_back(i * i);
+  }
+  eager.payload.name = "payload";
+  eager.tags = {"a", "b", "c"};
+  eager.blob = string(10000, 'x');
+  return eager;
+}
+
+template <class Serializer, class T>
+string serialize(const T& obj) {
+  folly::IOBufQueue queue;
+  Serializer::serialize(obj, &queue);
+  return queue.move()->moveToFbString().toStdString();
+}
+
+template <class Serializer>
+void checkForward() {
+  auto eager = makeEager();
+  auto bytes = serialize<Serializer>(eager);
+  auto buf = folly::IOBuf::copyBuffer(bytes);
+
+  Routed routed;
+  Serializer::deserialize(buf.get(), routed);
+  EXPECT_EQ(eager.destination, routed.destination);
+  EXPECT_TRUE(routed.payload.isSerialized());
+  EXPECT_TRUE(routed.tags.isSerialized());
+  EXPECT_TRUE(routed.blob.isSerialized());
+
+  // Untouched fields are written as they were read
+  EXPECT_EQ(bytes, serialize<Serializer>(routed));
+
+  EXPECT_EQ(eager.payload, routed.payload.get());
+  EXPECT_EQ(eager.tags, routed.tags.get());
+  EXPECT_EQ(eager.blob, routed.blob.get());
+  EXPECT_FALSE(routed.payload.isSerialized());
+  EXPECT_EQ(bytes, serialize<Serializer>(routed));
+
+  // Changed fields are serialized again
+  routed.payload.mutable_get().name = "changed";
+  routed.tags.set({"d"});
+  eager.payload.name = "changed";
+  eager.tags = {"d"};
+  EXPECT_EQ(serialize<Serializer>(eager), serialize<Serializer>(routed));
+}
+
+TEST(LazyField, ForwardCompact) {
+  checkForward<CompactSerializer>();
+}
+
+TEST(LazyField, ForwardBinary) {
+  checkForward<BinarySerializer>();
+}
+
+TEST(LazyField, ChangeProtocol) {
+  auto eager = makeEager();
+  auto buf = folly::IOBuf::copyBuffer(serialize<CompactSerializer>(eager));
+  Routed routed;
+  CompactSerializer::deserialize(buf.get(), routed);
+  EXPECT_EQ(serialize<BinarySerializer>(eager),
+            serialize<BinarySerializer>(routed));
+}
+
+TEST(LazyField, CopyAndCompare) {
+  auto eager = makeEager();
+  auto buf = folly::IOBuf::copyBuffer(serialize<CompactSerializer>(eager));
+  Routed routed;
+  CompactSerializer::deserialize(buf.get(), routed);
+  Routed copy = routed;
+  EXPECT_TRUE(copy.payload.isSerialized());
+  EXPECT_EQ(routed, copy);
+
+  copy.__clear();
+  EXPECT_FALSE(copy.payload.isSerialized());
+  EXPECT_TRUE(copy.payload.get().values.empty());
+  EXPECT_FALSE(routed == copy);
+}
@@ -0,0 +1,21 @@
+namespace cpp thrift.test.lazy
+
+struct Payload {
+  1: list<i64> values,
+  2: string name,
+}
+
+// Reads only destination, and forwards the rest as it came
+struct Routed {
+  1: string destination,
+  2: Payload payload (cpp.lazy = "true"),
+  3: list<string> tags (cpp.lazy = "true"),
+  4: binary blob (cpp.lazy = "true"),
+}
+
+struct Eager {
+  1: string destination,
+  2: Payload payload,
+  3: list<string> tags,
+  4: binary blob,
+}
@@ -0,0 +1,134 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/lib/cpp2/protocol/Serializer.h>
+
+#include "thrift/test/gen-cpp2/ProjectionTest_types.h"
+
+#include <gtest/gtest.h>
+
+using namespace thrift::test::projection::cpp2;
+using namespace apache::thrift;
+using namespace std;
+
+Record makeRecord() {
+  Record record;
+  record.id = 42;
+  record.name = "record";
+  record.inner.a = 7;
+  record.inner.b = "inner";
+  record.tags = {"x", "y"};
+  record.note = "note";
+  record.__isset.note = true;
+  record.far = 100;
+  return record;
+}
+
+template <class Serializer, class T>
+unique_ptr<folly::IOBuf> serialize(const T& obj) {
+  folly::IOBufQueue queue;
+  Serializer::serialize(obj, &queue);
+  return queue.move();
+}
+
+template <class Serializer, class Mask>
+void checkRead(const Mask& mask) {
+  auto record = makeRecord();
+  auto buf = serialize<Serializer>(record);
+
+  Record read;
+  Serializer::deserializeProjected(buf.get(), read, mask);
+  EXPECT_EQ(42, read.id);
+  EXPECT_EQ("", read.name);
+  EXPECT_EQ(record.inner, read.inner);
+  EXPECT_TRUE(read.tags.empty());
+  EXPECT_FALSE(read.__isset.note);
+  EXPECT_EQ(100, read.far);
+}
+
+TEST(ProjectionTest, ReadRuntimeMask) {
+  FieldMask mask{1, 3, 100};
+  checkRead<CompactSerializer>(mask);
+  checkRead<BinarySerializer>(mask);
+}
+
+TEST(ProjectionTest, ReadStaticMask) {
+  StaticFieldMask<1, 3, 100> mask;
+  checkRead<CompactSerializer>(mask);
+  checkRead<BinarySerializer>(mask);
+}
+
+TEST(ProjectionTest, Write) {
+  auto record = makeRecord();
+  folly::IOBufQueue queue;
+  CompactSerializer::serializeProjected(record, &queue, FieldMask{2, 5});
+
+  Record read;
+  auto buf = queue.move();
+  CompactSerializer::deserialize(buf.get(), read);
+  EXPECT_EQ(0, read.id);
+  EXPECT_EQ("record", read.name);
+  EXPECT_EQ(Inner(), read.inner);
+  EXPECT_TRUE(read.__isset.note);
+  EXPECT_EQ("note", read.note);
+  EXPECT_EQ(0, read.far);
+
+  // Everything selected is the same as write()
+  FieldMask all{1, 2, 3, 4, 5, 100};
+  queue.clear();
+  CompactSerializer::serializeProjected(record, &queue, all);
+  auto whole = serialize<CompactSerializer>(record);
+  EXPECT_EQ(whole->moveToFbString(), queue.move()->moveToFbString());
+}
+
+TEST(ProjectionTest, RequiredFields) {
+  Strict strict;
+  strict.key = 1;
+  strict.value = "one";
+  strict.extra = 2;
+  auto buf = serialize<CompactSerializer>(strict);
+
+  // Required fields that are not selected are not missing
+  Strict read;
+  CompactSerializer::deserializeProjected(buf.get(), read, FieldMask{1});
+  EXPECT_EQ(1, read.key);
+  EXPECT_EQ("", read.value);
+
+  // But selected ones are
+  folly::IOBufQueue queue;
+  CompactSerializer::serializeProjected(strict, &queue, FieldMask{1, 3});
+  auto trimmed = queue.move();
+  EXPECT_THROW(CompactSerializer::deserializeProjected(
+                 trimmed.get(), read, FieldMask{1, 2}),
+               TProtocolException);
+}
+
+TEST(ProjectionTest, FieldMask) {
+  FieldMask mask{0, 63, 64, -1, 1000};
+  mask.add(1000);
+  for (int16_t id : {0, 63, 64, -1, 1000}) {
+    EXPECT_TRUE(mask.contains(id)) << id;
+  }
+  for (int16_t id : {1, 62, 65, -2, 999}) {
+    EXPECT_FALSE(mask.contains(id)) << id;
+  }
+  EXPECT_FALSE(FieldMask().contains(0));
+  static_assert(StaticFieldMask<3, 4>::contains(4), "");
+  static_assert(!StaticFieldMask<3, 4>::contains(5), "");
+}
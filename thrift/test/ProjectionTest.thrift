@@ -0,0 +1,23 @@
+# Generated with the projection flag
+
+namespace cpp thrift.test.projection
+
+struct Inner {
+  1: i32 a,
+  2: string b,
+}
+
+struct Record {
+  1: i64 id,
+  2: string name,
+  3: Inner inner,
+  4: list<string> tags,
+  5: optional string note,
+  100: i32 far,
+}
+
+struct Strict {
+  1: required i32 key,
+  2: required string value,
+  3: i32 extra,
+}
@@ -0,0 +1,130 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <thrift/lib/cpp2/protocol/Serializer.h>
+
+#include "thrift/test/gen-cpp2/StringViewTest_types.h"
+
+#include <gtest/gtest.h>
+
+using namespace thrift::test::view::cpp2;
+using namespace apache::thrift;
+using namespace std;
+
+OwnedBlobs makeOwned() {
+  OwnedBlobs owned;
+  owned.name = "name";
+  owned.data = string(100000, 'd');
+  owned.owned = {"a", "b"};
+  owned.extra = "extra";
+  owned.__isset.extra = true;
+  return owned;
+}
+
+template <class Serializer, class T>
+unique_ptr<folly::IOBuf> serialize(const T& obj) {
+  folly::IOBufQueue queue;
+  Serializer::serialize(obj, &queue);
+  return queue.move();
+}
+
+// Whether range lies in the buffer of buf
+bool pointsInto(folly::ByteRange range, const folly::IOBuf* buf) {
+  return range.begin() >= buf->data() && range.end() <= buf->tail();
+}
+
+template <class Serializer>
+void checkRead() {
+  auto owned = makeOwned();
+  auto buf = serialize<Serializer>(owned);
+  buf->coalesce();
+
+  Blobs blobs;
+  Serializer::deserialize(buf.get(), blobs);
+  EXPECT_EQ("name", blobs.name);
+  EXPECT_EQ(folly::ByteRange(folly::StringPiece(owned.data)), blobs.data);
+  EXPECT_EQ(owned.owned, blobs.owned);
+  EXPECT_TRUE(blobs.__isset.extra);
+  EXPECT_EQ(folly::ByteRange(folly::StringPiece("extra")), blobs.extra);
+
+  // Nothing was copied
+  EXPECT_TRUE(pointsInto(folly::ByteRange(blobs.name), buf.get()));
+  EXPECT_TRUE(pointsInto(blobs.data, buf.get()));
+  EXPECT_TRUE(pointsInto(blobs.extra, buf.get()));
+
+  // The views outlive the input buffer
+  buf.reset();
+  Blobs copy = blobs;
+  blobs.__clear();
+  EXPECT_EQ("name", copy.name);
+  EXPECT_EQ(owned.data.size(), copy.data.size());
+  EXPECT_EQ('d', copy.data[owned.data.size() - 1]);
+
+  // And they are written as strings
+  auto rewritten = serialize<Serializer>(copy);
+  OwnedBlobs read;
+  Serializer::deserialize(rewritten.get(), read);
+  EXPECT_EQ(owned, read);
+}
+
+TEST(StringViewTest, ReadCompact) {
+  checkRead<CompactSerializer>();
+}
+
+TEST(StringViewTest, ReadBinary) {
+  checkRead<BinarySerializer>();
+}
+
+TEST(StringViewTest, SpansBuffers) {
+  auto owned = makeOwned();
+  auto bytes = serialize<CompactSerializer>(owned)->moveToFbString();
+  // Split the input in the middle of data
+  size_t half = bytes.size() / 2;
+  auto buf = folly::IOBuf::copyBuffer(bytes.data(), half);
+  buf->prependChain(folly::IOBuf::copyBuffer(bytes.data() + half,
+                                             bytes.size() - half));
+
+  Blobs blobs;
+  CompactSerializer::deserialize(buf.get(), blobs);
+  buf.reset();
+  EXPECT_EQ(folly::ByteRange(folly::StringPiece(owned.data)), blobs.data);
+  EXPECT_EQ("name", blobs.name);
+}
+
+TEST(StringViewTest, ReadAgain) {
+  auto first = serialize<CompactSerializer>(makeOwned());
+  first->coalesce();
+  OwnedBlobs owned;
+  owned.name = "other";
+  owned.data = string(1000, 'o');
+  auto second = serialize<CompactSerializer>(owned);
+  second->coalesce();
+
+  Blobs blobs;
+  CompactSerializer::deserialize(first.get(), blobs);
+  EXPECT_TRUE(first->isShared());
+  CompactSerializer::deserialize(second.get(), blobs);
+
+  // The first buffer is no longer held, and nothing points into it
+  EXPECT_FALSE(first->isShared());
+  EXPECT_EQ("other", blobs.name);
+  EXPECT_EQ(folly::ByteRange(folly::StringPiece(owned.data)), blobs.data);
+  EXPECT_TRUE(pointsInto(blobs.data, second.get()));
+  EXPECT_TRUE(blobs.extra.empty());
+}
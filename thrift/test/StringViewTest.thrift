@@ -0,0 +1,18 @@
+namespace cpp thrift.test.view
+
+typedef binary (cpp.type = "folly::ByteRange") Bytes
+
+struct Blobs {
+  1: string (cpp.type = "folly::StringPiece") name,
+  2: Bytes data,
+  3: list<string> owned,
+  4: optional Bytes extra,
+}
+
+// The same fields as owning strings
+struct OwnedBlobs {
+  1: string name,
+  2: binary data,
+  3: list<string> owned,
+  4: optional binary extra,
+}